@@ -194,6 +194,20 @@ struct lsquic_stream_if {
      * perform a zero-RTT handshake next time around.
      */
     void (*on_zero_rtt_info)(lsquic_conn_t *c, const unsigned char *, size_t);
+    /**
+     * This optional callback is only used when batch dispatch is enabled
+     * (see @ref es_batch_dispatch).  It is called once per call to
+     * @ref lsquic_engine_process_conns() with all user streams from all
+     * connections that are ready to be read from or written to.  If it
+     * is not specified, `on_read' and `on_write' are called for each
+     * stream instead.
+     *
+     * The callback should use lsquic_stream_read*() and lsquic_stream_write*()
+     * family of functions as usual.  The streams are valid for the duration
+     * of the call.
+     */
+    void (*on_batch)(void *stream_if_ctx, lsquic_stream_t *const *streams,
+                                                        unsigned n_streams);
 };
 
 struct ssl_ctx_st;
@@ -339,6 +353,30 @@ typedef struct ssl_ctx_st * (*lsquic_lookup_cert_f)(
 /* 1: Cubic; 2: BBR */
 #define LSQUIC_DF_CC_ALGO 1
 
+/** Dispatch stream events from inside connection ticks by default */
+#define LSQUIC_DF_BATCH_DISPATCH 0
+
+/** Do not collect latency histograms by default */
+#define LSQUIC_DF_LAT_HIST 0
+
+/** Keep up to this many server SSL objects per SSL_CTX for reuse */
+#define LSQUIC_DF_SSL_POOL 32
+
+/** Maximum number of pooled client connections to the same destination */
+#define LSQUIC_DF_POOL_MAX_CONNS 4
+
+/** Serve streams of the same priority round-robin by default */
+#define LSQUIC_DF_STREAM_SCHED 0
+
+/** Stream that has not been able to write for this long is served first */
+#define LSQUIC_DF_SCHED_MAX_WAIT 100
+
+/** By default, engine is not tied to any CPU */
+#define LSQUIC_DF_CPU (-1)
+
+/** By default, engine memory is placed on NUMA node of es_cpu, if set */
+#define LSQUIC_DF_NUMA_NODE (-1)
+
 struct lsquic_engine_settings {
     /**
      * This is a bit mask wherein each bit corresponds to a value in
@@ -737,6 +775,99 @@ struct lsquic_engine_settings {
      * Default value is @ref LSQUIC_DF_TIMESTAMPS
      */
     int             es_timestamps;
+
+    /**
+     * If set to true, read and write events for user streams are not
+     * dispatched while the connection is being ticked.  Instead, ready
+     * streams are collected from all connections processed by a call to
+     * @ref lsquic_engine_process_conns() and dispatched together after
+     * all connections have been ticked: either via a single call to
+     * `on_batch' callback or, if it is not set, by calling `on_read' and
+     * `on_write' for each stream in turn.
+     *
+     * Data written to streams during batch dispatch is packetized when
+     * the connection is ticked next: such connections are made tickable,
+     * so that the following call to @ref lsquic_engine_process_conns()
+     * sends it out.
+     *
+     * Default value is @ref LSQUIC_DF_BATCH_DISPATCH
+     */
+    int             es_batch_dispatch;
+
+    /**
+     * If set to true, the engine maintains latency histograms.  See
+     * @ref lsquic_engine_get_lat_hist().  This costs a few calls to
+     * read the clock per connection tick.
+     *
+     * Default value is @ref LSQUIC_DF_LAT_HIST
+     */
+    int             es_lat_hist;
+
+    /**
+     * Server: number of SSL objects to keep for reuse for each SSL_CTX
+     * returned by ea_get_ssl_ctx.  Once a handshake is done, the SSL
+     * object is reset using SSL_clear() instead of being freed, which is
+     * cheaper than creating a new one.  Set to zero to disable.
+     *
+     * Default value is @ref LSQUIC_DF_SSL_POOL
+     */
+    unsigned        es_ssl_pool;
+
+    /**
+     * Client: maximum number of connections to the same destination that
+     * @ref lsquic_engine_pool_make_stream() opens.
+     *
+     * Default value is @ref LSQUIC_DF_POOL_MAX_CONNS
+     */
+    unsigned        es_pool_max_conns;
+
+    /**
+     * How to order streams of the same priority when dispatching write
+     * events:
+     *  0:  Round-robin
+     *  1:  Shortest remaining first: streams with fewer bytes left to
+     *        write (see @ref lsquic_stream_set_size_hint()) go first.  If
+     *        the size is not known, streams that have written fewer bytes
+     *        go first.
+     *  2:  Earliest deadline first: streams with deadlines (see
+     *        @ref lsquic_stream_set_deadline()) go first, the rest are
+     *        ordered as in (1).
+     *
+     * Critical streams always go first.
+     *
+     * Default value is @ref LSQUIC_DF_STREAM_SCHED
+     */
+    unsigned        es_stream_sched;
+
+    /**
+     * Used if es_stream_sched is not zero: a stream that has not been able
+     * to write for this many milliseconds is served before the others.
+     * This prevents large streams from starving.
+     *
+     * Default value is @ref LSQUIC_DF_SCHED_MAX_WAIT
+     */
+    unsigned        es_sched_max_wait;
+
+    /**
+     * CPU the engine is to run on, or -1.  The engine records it; the
+     * thread is pinned to it by @ref lsquic_engine_bind_thread().  If
+     * es_numa_node is -1, the node this CPU belongs to is used.
+     *
+     * Default value is @ref LSQUIC_DF_CPU
+     */
+    int             es_cpu;
+
+    /**
+     * NUMA node to place engine memory on, or -1.  The engine's data
+     * structures are allocated on this node when the engine is created.
+     * To keep memory allocated later on the same node, call
+     * @ref lsquic_engine_bind_thread() from the thread that runs the
+     * engine.  This is only supported on Linux and does nothing on hosts
+     * with a single node.
+     *
+     * Default value is @ref LSQUIC_DF_NUMA_NODE
+     */
+    int             es_numa_node;
 };
 
 /* Initialize `settings' to default values */
@@ -1018,6 +1149,24 @@ struct lsquic_engine_api
      * is not set.
      */
     const char                          *ea_alpn;
+
+    /**
+     * Optional callback used in server mode to decide whether to accept
+     * 0-RTT data.  It is called after the certificate has been looked up
+     * and before any early data is read.  Return 0 to reject early data:
+     * the client resends it in 1-RTT packets after the handshake.
+     *
+     * Early data is only ever accepted if it is enabled in the SSL_CTX
+     * returned by @ref ea_get_ssl_ctx (see SSL_CTX_set_early_data_enabled()).
+     * Data that arrived in 0-RTT packets can be replayed by an attacker:
+     * use lsquic_stream_is_early() to only process idempotent requests.
+     */
+    int                                (*ea_early_data_ok)(
+                                            void *early_data_ctx,
+                                            const struct sockaddr *local,
+                                            const struct sockaddr *peer,
+                                            const char *sni);
+    void                                *ea_early_data_ctx;
 };
 
 /**
@@ -1056,6 +1205,67 @@ lsquic_engine_connect (lsquic_engine_t *, enum lsquic_version,
                        /** Resumption token: optional */
                        const unsigned char *token, size_t token_sz);
 
+/**
+ * Destination of pooled client connections.  Connections are shared by
+ * requests with the same peer address, hostname, and version.  In HTTP
+ * mode, the version determines ALPN; otherwise, ALPN is the same for all
+ * connections in the engine.
+ */
+struct lsquic_pool_dest
+{
+    const struct sockaddr  *local_sa;
+    const struct sockaddr  *peer_sa;
+    /** Passed to @ref lsquic_engine_connect() for new connections */
+    void                   *peer_ctx;
+    /** SNI; may be NULL if not required */
+    const char             *hostname;
+    /** Use N_LSQVER to let the engine pick */
+    enum lsquic_version     version;
+    /** Zero means infer it from `peer_sa' */
+    unsigned short          max_packet_size;
+};
+
+/**
+ * Create a new stream on a pooled connection to `dest'.  The stream is
+ * placed on the connection with the most stream credit -- allowed streams
+ * not yet claimed by pending streams -- and, among equals, the lowest
+ * smoothed RTT.  Until a connection's handshake is done, the peer's limit
+ * is assumed to be the same as seen on other connections to `dest' or,
+ * if there were none, es_init_max_streams_bidi.
+ *
+ * A new connection is opened only if no connection has credit left and
+ * there are fewer than es_pool_max_conns of them.  Otherwise, the stream
+ * is queued as pending on the connection with the fewest pending streams.
+ * Connections that are going away or closing are dropped from the pool.
+ *
+ * As with @ref lsquic_conn_make_stream(), on_new_stream() is called when
+ * the stream is created.  When this function is called from a callback,
+ * new connections cannot be opened and the stream is placed onto one of
+ * the existing connections.  Returns the connection the stream was placed
+ * on or NULL on error.
+ */
+lsquic_conn_t *
+lsquic_engine_pool_make_stream (lsquic_engine_t *,
+                                        const struct lsquic_pool_dest *dest);
+
+/**
+ * Open connections to `dest' until there are at least `n_conns' of them
+ * in the pool, but no more than es_pool_max_conns.  Returns the number of
+ * connections in the pool or -1 on error.
+ */
+int
+lsquic_engine_pool_prewarm (lsquic_engine_t *,
+                    const struct lsquic_pool_dest *dest, unsigned n_conns);
+
+/**
+ * Pin the calling thread to the engine's CPU (es_cpu) and make it prefer
+ * allocating memory on the engine's NUMA node.  This is meant for programs
+ * that run one engine per thread: call it from that thread.  Returns 0 on
+ * success and -1 if neither CPU nor node was set or placement failed.
+ */
+int
+lsquic_engine_bind_thread (lsquic_engine_t *);
+
 /**
  * Pass incoming packet to the QUIC engine.  This function can be called
  * more than once in a row.  After you add one or more packets, call
@@ -1207,6 +1417,38 @@ lsquic_stream_readf (lsquic_stream_t *s,
     size_t (*readf)(void *ctx, const unsigned char *buf, size_t len, int fin),
     void *ctx);
 
+/**
+ * Register buffer into which incoming stream payload is copied as soon as
+ * it arrives, bypassing buffering in the library.  HTTP/3 framing is
+ * stripped.  This is meant for large request bodies: each byte is copied
+ * once, from the incoming packet into @param buf.
+ *
+ * Once the buffer is registered, `on_read' is called when the buffer is
+ * full, when the end of stream has been reached, or on error.  Use
+ * @ref lsquic_stream_read_buf_len() to find out how much data is in the
+ * buffer and call this function again to register the next buffer (or the
+ * same buffer, after its contents have been consumed).
+ *
+ * Headers are not placed into the buffer: they are read as usual.  Passing
+ * NULL as @param buf unregisters the buffer.
+ *
+ * Returns 0 on success or -1 on error, in which case errno is set.  Possible
+ * errno values:
+ *
+ *  EBADF           The stream is closed for reading.
+ *  EINVAL          @param buf_sz is zero.
+ */
+int
+lsquic_stream_set_read_buf (lsquic_stream_t *s, void *buf, size_t buf_sz);
+
+/**
+ * Returns number of bytes placed into the buffer registered using
+ * @ref lsquic_stream_set_read_buf().  If @param fin is not NULL, it is
+ * set to true when the end of stream payload has been reached.
+ */
+size_t
+lsquic_stream_read_buf_len (const lsquic_stream_t *s, int *fin);
+
 /**
  * Set whether you want to write to stream.  If @param is_want is true,
  * @ref on_write() will be called when it is possible to write data to
@@ -1373,6 +1615,36 @@ lsquic_stream_get_ctx (const lsquic_stream_t *s);
 int
 lsquic_stream_is_pushed (const lsquic_stream_t *s);
 
+/**
+ * Stream lifecycle timestamps, in microseconds on the library's monotonic
+ * clock.  Only differences between them are meaningful.  A value of zero
+ * means that the event has not happened (yet).
+ */
+struct lsquic_stream_times
+{
+    /** First byte of the stream (or, in gQUIC, its headers) received */
+    unsigned long long  st_first_recv;
+    /** Incoming headers have been decoded */
+    unsigned long long  st_headers_done;
+    /** Application first wrote data or headers to the stream */
+    unsigned long long  st_first_write;
+    /** Packet carrying the first byte of the stream sent */
+    unsigned long long  st_first_sent;
+    /** Packet carrying the FIN sent */
+    unsigned long long  st_fin_sent;
+    /** All stream data, including the FIN, acknowledged by the peer */
+    unsigned long long  st_fin_acked;
+};
+
+/**
+ * Get stream lifecycle timestamps.  This function may be called from
+ * @ref on_close, in which case `st_fin_acked' may still be zero: the
+ * stream may be closed before the peer acknowledges the FIN.
+ */
+void
+lsquic_stream_get_times (const lsquic_stream_t *s,
+                                            struct lsquic_stream_times *);
+
 /**
  * Returns true if this stream was rejected, false otherwise.  Use this as
  * an aid to distinguish between errors.
@@ -1380,6 +1652,16 @@ lsquic_stream_is_pushed (const lsquic_stream_t *s);
 int
 lsquic_stream_is_rejected (const lsquic_stream_t *s);
 
+/**
+ * Returns true if some of the data on this stream arrived in 0-RTT packets.
+ * Such data may be replayed by an attacker: a server should only act on
+ * requests that are safe to repeat (see RFC 8470).
+ *
+ * @see ea_early_data_ok
+ */
+int
+lsquic_stream_is_early (const lsquic_stream_t *s);
+
 /**
  * Refuse pushed stream.  Call it from @ref on_new_stream.
  *
@@ -1416,6 +1698,21 @@ unsigned lsquic_stream_priority (const lsquic_stream_t *s);
  */
 int lsquic_stream_set_priority (lsquic_stream_t *s, unsigned priority);
 
+/**
+ * Tell the scheduler how many bytes in total the application is going to
+ * write to the stream.  Zero means unknown.  Only used if es_stream_sched
+ * is not zero.
+ */
+void
+lsquic_stream_set_size_hint (lsquic_stream_t *s, uint64_t size);
+
+/**
+ * Set the stream's deadline to `usec' microseconds from now.  Zero clears
+ * the deadline.  Only used if es_stream_sched is 2.
+ */
+void
+lsquic_stream_set_deadline (lsquic_stream_t *s, unsigned usec);
+
 /**
  * Get a pointer to the connection object.  Use it with lsquic_conn_*
  * functions.
@@ -1593,6 +1890,28 @@ lsquic_alpn2ver (const char *alpn, size_t len);
 void
 lsquic_engine_cooldown (lsquic_engine_t *);
 
+/**
+ * Close all connections at once.  This is meant for mass shutdown, such
+ * as during server restart.  The engine enters cooldown mode (see
+ * @ref lsquic_engine_cooldown()), all full connections are aborted with
+ * the specified error, and each of them is ticked in a single pass, which
+ * generates CONNECTION_CLOSE packets and sends them out using the largest
+ * batch size.  Connections are destroyed as soon as their packets are sent.
+ *
+ * If @param is_app is true, @param error_code is an application error code;
+ * otherwise, it is a transport error code.  @param reason may be NULL.
+ * Transport error code zero closes connections with NO_ERROR, the same way
+ * @ref lsquic_conn_abort() does; in this case, @param reason is not sent.
+ *
+ * Packets that could not be sent are sent by subsequent calls to
+ * @ref lsquic_engine_send_unsent_packets().
+ *
+ * Returns number of connections that have been closed.
+ */
+unsigned
+lsquic_engine_close_all (lsquic_engine_t *, int is_app, unsigned error_code,
+                                                        const char *reason);
+
 /**
  * Get user-supplied context associated with the connection.
  */
@@ -1666,6 +1985,153 @@ lsquic_engine_earliest_adv_tick (lsquic_engine_t *engine, int *diff);
 unsigned
 lsquic_engine_count_attq (lsquic_engine_t *engine, int from_now);
 
+/**
+ * Counters of datagrams dropped by the server before any per-packet state
+ * is allocated.  All counters are cumulative.
+ */
+struct lsquic_engine_drop_stats
+{
+    /** Long-header datagram too short to contain version and DCID length */
+    unsigned long   ds_short;
+    /** Version Negotiation packet sent to the server */
+    unsigned long   ds_verneg;
+    /** Destination connection ID is longer than 20 bytes in a packet of
+     *  a supported version
+     */
+    unsigned long   ds_cid_len;
+    /** Unsupported version in a datagram too small to warrant Version
+     *  Negotiation
+     */
+    unsigned long   ds_small_unsup;
+    /** Initial packet in a datagram smaller than 1200 bytes */
+    unsigned long   ds_small_initial;
+};
+
+/**
+ * Get counters of incoming datagrams dropped early.  These are only
+ * collected in server mode.
+ */
+void
+lsquic_engine_get_drop_stats (const lsquic_engine_t *engine,
+                                    struct lsquic_engine_drop_stats *stats);
+
+/**
+ * Incoming stream data that has not yet been read by the application.
+ * Most of the time, this data is kept in the packets it arrived in.
+ * When the packets take up much more memory than the data in them, the
+ * data is copied out and the packets are released.
+ */
+struct lsquic_engine_data_in_stats
+{
+    /** Size of packets referenced by unread stream data.  A packet that
+     *  carries more than one stream frame is counted more than once.
+     */
+    unsigned long long  dis_pinned;
+    /** Size of unread stream data in those packets */
+    unsigned long long  dis_used;
+    /** Number of times stream data was copied out to release packets */
+    unsigned long       dis_compactions;
+};
+
+/**
+ * Get memory usage by unread incoming stream data.
+ */
+void
+lsquic_engine_get_data_in_stats (const lsquic_engine_t *engine,
+                                    struct lsquic_engine_data_in_stats *stats);
+
+/**
+ * Engine-wide memory usage and connection counts.  This does not include
+ * memory used by individual connections.
+ */
+struct lsquic_engine_mem_stats
+{
+    /** Memory used by the engine's packet and buffer pools */
+    unsigned long long  ems_mm;
+    /** Memory used by the connections hash */
+    unsigned long long  ems_conns_hash;
+    /** Number of elements in the connections hash.  A connection is
+     *  hashed once for each of its source connection IDs.
+     */
+    unsigned            ems_conns_hash_count;
+    /** Number of connections, including mini connections */
+    unsigned            ems_n_conns;
+    /** Number of mini connections: server handshakes in progress */
+    unsigned            ems_n_mini_conns;
+};
+
+/**
+ * Get engine-wide memory usage.  This walks the engine's buffer pools and
+ * should not be called on every tick.
+ */
+void
+lsquic_engine_get_mem_stats (const lsquic_engine_t *engine,
+                                    struct lsquic_engine_mem_stats *stats);
+
+/** Latency histograms maintained by the engine when es_lat_hist is set */
+enum lsquic_lat_hist_type
+{
+    /** From @ref lsquic_engine_packet_in() until the connection the packet
+     *  was delivered to is ticked.
+     */
+    LSQLH_RECV_TO_TICK,
+    /** Duration of a single connection tick */
+    LSQLH_TICK,
+    /** From the time a packet is scheduled until it is passed to
+     *  ea_packets_out.
+     */
+    LSQLH_SCHED_TO_SEND,
+    /** Time a connection is prevented from sending by the pacer */
+    LSQLH_PACER_DELAY,
+    /** Duration of @ref lsquic_engine_process_conns() */
+    LSQLH_PROCESS_CONNS,
+    N_LSQLH
+};
+
+#define LSQUIC_LAT_HIST_N_BUCKETS 272
+
+/**
+ * Values are in microseconds.  Buckets are log-linear: values smaller
+ * than 8 are counted exactly and each subsequent power of two is divided
+ * into eight buckets.  Use @ref lsquic_lat_hist_bucket_min() to get
+ * the lower bound of a bucket.  The last bucket also counts all values
+ * larger than 2^36 microseconds.
+ */
+struct lsquic_lat_hist
+{
+    unsigned long long  lh_count;
+    unsigned long long  lh_sum;
+    unsigned long long  lh_max;
+    unsigned long long  lh_buckets[LSQUIC_LAT_HIST_N_BUCKETS];
+};
+
+/**
+ * Copy latency histogram into `hist'.
+ *
+ * @retval  0   Success.
+ * @retval -1   Histograms are not enabled or `type' is invalid.
+ */
+int
+lsquic_engine_get_lat_hist (const lsquic_engine_t *engine,
+                    enum lsquic_lat_hist_type type, struct lsquic_lat_hist *hist);
+
+/** Reset all latency histograms */
+void
+lsquic_engine_reset_lat_hists (lsquic_engine_t *engine);
+
+/** Return smallest value counted in bucket `idx' */
+unsigned long long
+lsquic_lat_hist_bucket_min (unsigned idx);
+
+/**
+ * Return approximate value at `percentile' (0 to 100), that is, the lower
+ * bound of the bucket containing it.  If `percentile' is 100, the maximum
+ * value is returned.
+ */
+unsigned long long
+lsquic_lat_hist_percentile (const struct lsquic_lat_hist *hist,
+                                                        double percentile);
+
 enum LSQUIC_CONN_STATUS
 {
     LSCONN_ST_HSK_IN_PROGRESS,
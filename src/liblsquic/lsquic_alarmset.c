@@ -95,3 +95,35 @@ lsquic_alarmset_mintime (const lsquic_alarmset_t *alset, enum alarm_id *idp)
     else
         return 0;
 }
+
+
+lsquic_time_t
+lsquic_alarmset_mintime_coarse (const lsquic_alarmset_t *alset,
+        enum alarm_id_bit coarse_set, lsquic_time_t granularity,
+        enum alarm_id *idp)
+{
+    lsquic_time_t expiry, al_expiry;
+    enum alarm_id al_id, ret_id;
+
+    if (alset->as_armed_set)
+    {
+        expiry = UINT64_MAX;
+        for (al_id = 0, ret_id = 0; al_id < MAX_LSQUIC_ALARMS; ++al_id)
+            if (alset->as_armed_set & (1 << al_id))
+            {
+                al_expiry = alset->as_expiry[al_id];
+                if (coarse_set & (1 << al_id))
+                    al_expiry = (al_expiry + granularity - 1)
+                                                / granularity * granularity;
+                if (al_expiry < expiry)
+                {
+                    expiry = al_expiry;
+                    ret_id = al_id;
+                }
+            }
+        *idp = ret_id;
+        return expiry;
+    }
+    else
+        return 0;
+}
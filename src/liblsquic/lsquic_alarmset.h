@@ -93,6 +93,15 @@ lsquic_alarmset_ring_expired (lsquic_alarmset_t *, lsquic_time_t now);
 lsquic_time_t
 lsquic_alarmset_mintime (const lsquic_alarmset_t *, enum alarm_id *);
 
+/* Same as lsquic_alarmset_mintime(), except that times of alarms in
+ * `coarse_set' are rounded up to `granularity'.  An alarm due before the
+ * rounded time is returned instead.
+ */
+lsquic_time_t
+lsquic_alarmset_mintime_coarse (const lsquic_alarmset_t *,
+        enum alarm_id_bit coarse_set, lsquic_time_t granularity,
+        enum alarm_id *);
+
 extern const char *const lsquic_alid2str[];
 
 #endif
@@ -6,6 +6,13 @@
  * element having the minimum advsory time.  To speed up removal, each
  * element has an index it has in the heap array.  The index is updated
  * as elements are moved around in the array when heap is updated.
+ *
+ * Idle and keep-alive alarms, which is what most idle connections wait on,
+ * are not placed into the heap.  Instead, their time is rounded up to the
+ * wheel granularity and they are put into a timer wheel: a ring of lists,
+ * one per time slot.  This way, mostly idle connections cost no heap
+ * operations.  The wheel covers a window of ATTQ_WHEEL_SIZE slots starting
+ * with aq_wheel_slot; times outside of this window go into the heap.
  */
 
 #include <assert.h>
@@ -26,12 +33,23 @@
 #include "lsquic_conn.h"
 
 
+TAILQ_HEAD(attq_bucket, attq_elem);
+
 struct attq
 {
     struct malo        *aq_elem_malo;
     struct attq_elem  **aq_heap;
     unsigned            aq_nelem;
     unsigned            aq_nalloc;
+    /* Number of elements in the wheel */
+    unsigned            aq_wheel_nelem;
+    /* All elements in the wheel have slots in the range
+     * [aq_wheel_slot, aq_wheel_max_slot].  The range is never wider than
+     * the wheel.
+     */
+    uint64_t            aq_wheel_slot,
+                        aq_wheel_max_slot;
+    struct attq_bucket  aq_wheel[ATTQ_WHEEL_SIZE];
 };
 
 
@@ -40,6 +58,7 @@ lsquic_attq_create (void)
 {
     struct attq *q;
     struct malo *malo;
+    unsigned i;
 
     malo = lsquic_malo_create(sizeof(struct attq_elem));
     if (!malo)
@@ -53,6 +72,8 @@ lsquic_attq_create (void)
     }
 
     q->aq_elem_malo = malo;
+    for (i = 0; i < ATTQ_WHEEL_SIZE; ++i)
+        TAILQ_INIT(&q->aq_wheel[i]);
     return q;
 }
 
@@ -107,6 +128,92 @@ attq_swap (struct attq *q, unsigned a, unsigned b)
 }
 
 
+static int
+attq_why_is_coarse (enum ae_why why)
+{
+    return why >= N_AEWS && why < N_AEWS + MAX_LSQUIC_ALARMS
+        && (ATTQ_WHEEL_ALARMS & (1 << (why - N_AEWS)));
+}
+
+
+lsquic_time_t
+lsquic_attq_adv_time (lsquic_time_t advisory_time, enum ae_why why)
+{
+    if (attq_why_is_coarse(why))
+        return ATTQ_WHEEL_ROUND(advisory_time);
+    else
+        return advisory_time;
+}
+
+
+/* Return true if element was placed into the wheel */
+static int
+attq_wheel_add (struct attq *q, struct attq_elem *el)
+{
+    uint64_t slot;
+
+    slot = el->ae_adv_time / ATTQ_WHEEL_GRANULARITY;
+    if (q->aq_wheel_nelem == 0)
+        q->aq_wheel_slot = q->aq_wheel_max_slot = slot;
+    else if (slot < q->aq_wheel_slot)
+    {
+        if (q->aq_wheel_max_slot - slot >= ATTQ_WHEEL_SIZE)
+            return 0;
+        q->aq_wheel_slot = slot;
+    }
+    else if (slot > q->aq_wheel_max_slot)
+    {
+        if (slot - q->aq_wheel_slot >= ATTQ_WHEEL_SIZE)
+            return 0;
+        q->aq_wheel_max_slot = slot;
+    }
+
+    el->ae_heap_idx = ATTQ_IN_WHEEL;
+    TAILQ_INSERT_TAIL(&q->aq_wheel[slot % ATTQ_WHEEL_SIZE], el,
+                                                            ae_next_bucket);
+    ++q->aq_wheel_nelem;
+    return 1;
+}
+
+
+/* Move aq_wheel_max_slot back past empty slots, so that the wheel window
+ * is not held open by elements that are gone.
+ */
+static void
+attq_wheel_shrink (struct attq *q)
+{
+    if (q->aq_wheel_nelem == 0)
+        q->aq_wheel_max_slot = q->aq_wheel_slot;
+    else
+        while (q->aq_wheel_max_slot > q->aq_wheel_slot
+                && TAILQ_EMPTY(&q->aq_wheel[
+                                q->aq_wheel_max_slot % ATTQ_WHEEL_SIZE]))
+            --q->aq_wheel_max_slot;
+}
+
+
+/* Return first element in the earliest non-empty slot, advancing
+ * aq_wheel_slot past empty slots.
+ */
+static struct attq_elem *
+attq_wheel_first (struct attq *q)
+{
+    struct attq_elem *el;
+
+    if (q->aq_wheel_nelem == 0)
+        return NULL;
+
+    while (!(el = TAILQ_FIRST(&q->aq_wheel[
+                                    q->aq_wheel_slot % ATTQ_WHEEL_SIZE])))
+    {
+        assert(q->aq_wheel_slot < q->aq_wheel_max_slot);
+        ++q->aq_wheel_slot;
+    }
+
+    return el;
+}
+
+
 int
 lsquic_attq_add (struct attq *q, struct lsquic_conn *conn,
                                 lsquic_time_t advisory_time, enum ae_why why)
@@ -114,6 +221,26 @@ lsquic_attq_add (struct attq *q, struct lsquic_conn *conn,
     struct attq_elem *el, **heap;
     unsigned n, i;
 
+    /* Coarse times are rounded up whether or not they fit into the wheel,
+     * so that the same time is always stored the same way.
+     */
+    advisory_time = lsquic_attq_adv_time(advisory_time, why);
+    if (attq_why_is_coarse(why))
+    {
+        el = lsquic_malo_get(q->aq_elem_malo);
+        if (!el)
+            return -1;
+        el->ae_adv_time = advisory_time;
+        el->ae_why = why;
+        if (attq_wheel_add(q, el))
+        {
+            el->ae_conn = conn;
+            conn->cn_attq_elem = el;
+            return 0;
+        }
+        lsquic_malo_put(el);
+    }
+
     if (q->aq_nelem >= q->aq_nalloc)
     {
         if (q->aq_nalloc > 0)
@@ -160,11 +287,8 @@ lsquic_attq_pop (struct attq *q, lsquic_time_t cutoff)
     struct lsquic_conn *conn;
     struct attq_elem *el;
 
-    if (q->aq_nelem == 0)
-        return NULL;
-
-    el = q->aq_heap[0];
-    if (el->ae_adv_time >= cutoff)
+    el = (struct attq_elem *) lsquic_attq_next(q);
+    if (!el || el->ae_adv_time >= cutoff)
         return NULL;
 
     conn = el->ae_conn;
@@ -212,6 +336,18 @@ lsquic_attq_remove (struct attq *q, struct lsquic_conn *conn)
     el = conn->cn_attq_elem;
     idx = el->ae_heap_idx;
 
+    if (idx == ATTQ_IN_WHEEL)
+    {
+        assert(q->aq_wheel_nelem > 0);
+        conn->cn_attq_elem = NULL;
+        TAILQ_REMOVE(&q->aq_wheel[ (el->ae_adv_time / ATTQ_WHEEL_GRANULARITY)
+                                    % ATTQ_WHEEL_SIZE ], el, ae_next_bucket);
+        --q->aq_wheel_nelem;
+        attq_wheel_shrink(q);
+        lsquic_malo_put(el);
+        return;
+    }
+
     assert(q->aq_nelem > 0);
     assert(q->aq_heap[idx] == el);
     assert(conn->cn_attq_elem == el);
@@ -238,12 +374,31 @@ lsquic_attq_remove (struct attq *q, struct lsquic_conn *conn)
 }
 
 
+static unsigned
+attq_wheel_count_before (struct attq *q, lsquic_time_t cutoff)
+{
+    const struct attq_elem *el;
+    uint64_t slot;
+    unsigned count;
+
+    count = 0;
+    if (q->aq_wheel_nelem > 0)
+        for (slot = q->aq_wheel_slot; slot <= q->aq_wheel_max_slot
+                        && slot * ATTQ_WHEEL_GRANULARITY < cutoff; ++slot)
+            TAILQ_FOREACH(el, &q->aq_wheel[slot % ATTQ_WHEEL_SIZE],
+                                                            ae_next_bucket)
+                ++count;
+
+    return count;
+}
+
+
 unsigned
 lsquic_attq_count_before (struct attq *q, lsquic_time_t cutoff)
 {
     unsigned level, total_count, level_count, i, level_max;
 
-    total_count = 0;
+    total_count = attq_wheel_count_before(q, cutoff);
     for (i = 0, level = 0;; ++level)
     {
         level_count = 0;
@@ -262,10 +417,14 @@ lsquic_attq_count_before (struct attq *q, lsquic_time_t cutoff)
 const struct attq_elem *
 lsquic_attq_next (struct attq *q)
 {
-    if (q->aq_nelem > 0)
+    struct attq_elem *el;
+
+    el = attq_wheel_first(q);
+    if (q->aq_nelem > 0 && (!el
+                        || q->aq_heap[0]->ae_adv_time < el->ae_adv_time))
         return q->aq_heap[0];
     else
-        return NULL;
+        return el;
 }
 
 
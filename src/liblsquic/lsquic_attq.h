@@ -17,7 +17,7 @@ struct attq_elem
 {
     struct lsquic_conn  *ae_conn;
     lsquic_time_t        ae_adv_time;
-    unsigned             ae_heap_idx;
+    unsigned             ae_heap_idx;   /* ATTQ_IN_WHEEL if not in heap */
     /* The "why" describes why the connection is in the Advisory Tick Time
      * Queue.  Values past the range describe different alarm types (see
      * enum alarm_id).
@@ -27,8 +27,25 @@ struct attq_elem
         AEW_MINI_EXPIRE,
         N_AEWS
     }                    ae_why;
+    /* Used when element is in the coarse timer wheel */
+    TAILQ_ENTRY(attq_elem) ae_next_bucket;
 };
 
+#define ATTQ_IN_WHEEL (~0U)
+
+/* Idle and keep-alive alarms are tracked with this granularity.  They are
+ * kept in a timer wheel instead of the heap, which makes adding and removing
+ * them O(1).  Connections get their next tick time using
+ * lsquic_alarmset_mintime_coarse(), so that other alarms due before the
+ * rounded time are not delayed.
+ */
+#define ATTQ_WHEEL_GRANULARITY 1000000ULL   /* One second */
+#define ATTQ_WHEEL_SIZE 128                 /* Number of buckets */
+#define ATTQ_WHEEL_ALARMS (ALBIT_IDLE|ALBIT_PING)
+
+#define ATTQ_WHEEL_ROUND(t) (((t) + ATTQ_WHEEL_GRANULARITY - 1)             \
+                            / ATTQ_WHEEL_GRANULARITY * ATTQ_WHEEL_GRANULARITY)
+
 
 struct attq *
 lsquic_attq_create (void);
@@ -44,6 +61,10 @@ lsquic_attq_add (struct attq *, struct lsquic_conn *, lsquic_time_t advisory_tim
 void
 lsquic_attq_remove (struct attq *, struct lsquic_conn *);
 
+/* Return advisory time as it would be stored by lsquic_attq_add() */
+lsquic_time_t
+lsquic_attq_adv_time (lsquic_time_t advisory_time, enum ae_why);
+
 struct lsquic_conn *
 lsquic_attq_pop (struct attq *, lsquic_time_t cutoff);
 
@@ -36,7 +36,7 @@ enum lsquic_conn_flags {
     LSCONN_HASHED         = (1 << 2),
     LSCONN_MINI           = (1 << 3),   /* This is a mini connection */
     LSCONN_IMMED_CLOSE    = (1 << 4),
-    LSCONN_UNUSED_5       = (1 << 5),
+    LSCONN_CLOSE_ALL      = (1 << 5),   /* Aborted by lsquic_engine_close_all() */
     LSCONN_HANDSHAKE_DONE = (1 << 6),
     LSCONN_CLOSING        = (1 << 7),
     LSCONN_PEER_GOING_AWAY= (1 << 8),
@@ -49,7 +49,7 @@ enum lsquic_conn_flags {
     LSCONN_SEND_BLOCKED   = (1 <<15),   /* Send connection blocked frame */
     LSCONN_PROMOTED       = (1 <<16),   /* Promoted.  Only set if LSCONN_MINI is set */
     LSCONN_NEVER_TICKABLE = (1 <<17),   /* Do not put onto the Tickable Queue */
-    LSCONN_UNUSED_18      = (1 <<18),
+    LSCONN_POOLED         = (1 <<18),   /* In engine's connection pool */
     LSCONN_ATTQ           = (1 <<19),
     LSCONN_SKIP_ON_PROC   = (1 <<20),
     LSCONN_UNUSED_21      = (1 <<21),
@@ -239,6 +239,16 @@ struct conn_iface
     /* Optional method.  Only used by the IETF client code. */
     void
     (*ci_drop_crypto_streams) (struct lsquic_conn *);
+
+    /* Optional method.  Only used by the IETF client code: the server
+     * rejected 0-RTT data.
+     */
+    void
+    (*ci_early_data_failed) (struct lsquic_conn *);
+
+    /* Optional method: smoothed RTT in microseconds or zero if not known */
+    lsquic_time_t
+    (*ci_srtt) (const struct lsquic_conn *);
 };
 
 #define LSCONN_CCE_BITS 3
@@ -284,11 +294,22 @@ struct lsquic_conn
     TAILQ_ENTRY(lsquic_conn)     cn_next_ticked;
     TAILQ_ENTRY(lsquic_conn)     cn_next_out;
     TAILQ_ENTRY(lsquic_conn)     cn_next_pr;
+#if LSQUIC_CONN_FIFO
+    /* Links for the Tickable and Outgoing queues.  See lsquic_conn_fifo.h */
+    struct lsquic_conn          *cn_next_tickable;
+    struct lsquic_conn          *cn_next_has_out;
+#endif
     const struct conn_iface     *cn_if;
     const struct parse_funcs    *cn_pf;
     struct attq_elem            *cn_attq_elem;
     lsquic_time_t                cn_last_sent;
     lsquic_time_t                cn_last_ticked;
+    lsquic_time_t                cn_oldest_recv;    /* Receive time of the
+                                                     * oldest packet not yet
+                                                     * followed by a tick.  Only
+                                                     * set if latency
+                                                     * histograms are on.
+                                                     */
     struct conn_cid_elem        *cn_cces;   /* At least one is available */
     enum lsquic_conn_flags       cn_flags;
     enum lsquic_version          cn_version:8;
@@ -0,0 +1,71 @@
+/* Copyright (c) 2017 - 2020 LiteSpeed Technologies Inc.  See LICENSE. */
+/*
+ * lsquic_conn_fifo.c
+ */
+
+#include <assert.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "lsquic_conn_fifo.h"
+
+
+#define CF_NEXT(fifo, conn) \
+    (*(struct lsquic_conn **) ((char *) (conn) + (fifo)->cf_link_off))
+
+
+void
+lsquic_cf_init (struct conn_fifo *fifo, unsigned link_off)
+{
+    fifo->cf_lists[0].head = NULL;
+    fifo->cf_lists[0].tail = &fifo->cf_lists[0].head;
+    fifo->cf_lists[1].head = NULL;
+    fifo->cf_lists[1].tail = &fifo->cf_lists[1].head;
+    fifo->cf_round = 0;
+    fifo->cf_max = 0;
+    fifo->cf_nelem = 0;
+    fifo->cf_link_off = link_off;
+}
+
+
+void
+lsquic_cf_insert (struct conn_fifo *fifo, struct lsquic_conn *conn,
+                                                                uint64_t val)
+{
+    unsigned idx;
+
+    idx = val >= fifo->cf_round;
+    CF_NEXT(fifo, conn) = NULL;
+    *fifo->cf_lists[idx].tail = conn;
+    fifo->cf_lists[idx].tail = &CF_NEXT(fifo, conn);
+    if (val > fifo->cf_max)
+        fifo->cf_max = val;
+    ++fifo->cf_nelem;
+}
+
+
+struct lsquic_conn *
+lsquic_cf_pop (struct conn_fifo *fifo)
+{
+    struct lsquic_conn *conn;
+
+    if (!fifo->cf_lists[0].head)
+    {
+        if (!fifo->cf_lists[1].head)
+            return NULL;
+        /* Start new round */
+        fifo->cf_lists[0].head = fifo->cf_lists[1].head;
+        fifo->cf_lists[0].tail = fifo->cf_lists[1].tail;
+        fifo->cf_lists[1].head = NULL;
+        fifo->cf_lists[1].tail = &fifo->cf_lists[1].head;
+        fifo->cf_round = fifo->cf_max + 1;
+    }
+
+    conn = fifo->cf_lists[0].head;
+    fifo->cf_lists[0].head = CF_NEXT(fifo, conn);
+    if (!fifo->cf_lists[0].head)
+        fifo->cf_lists[0].tail = &fifo->cf_lists[0].head;
+    assert(fifo->cf_nelem > 0);
+    --fifo->cf_nelem;
+    return conn;
+}
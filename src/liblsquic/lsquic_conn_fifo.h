@@ -0,0 +1,57 @@
+/* Copyright (c) 2017 - 2020 LiteSpeed Technologies Inc.  See LICENSE. */
+/*
+ * lsquic_conn_fifo.h -- Round-robin connection queue
+ *
+ * This is an alternative to the min-heap (see lsquic_min_heap.h) for the
+ * Tickable and Outgoing queues.  The heap orders connections by the time
+ * they were last ticked or last sent; the engine only uses this to get
+ * approximately round-robin order.  The FIFO gets the same fairness with
+ * O(1) insertion and removal.
+ *
+ * The queue keeps two intrusive lists: connections that have not been
+ * serviced in the current round and those that have.  A connection is
+ * placed on the first list if its value (last tick or send time) is
+ * smaller than the value at which the current round started.  When the
+ * first list is exhausted, the second list becomes the first and a new
+ * round begins.
+ *
+ * The link is a pointer to the next connection at offset `cf_link_off'
+ * inside struct lsquic_conn, making it possible to use several queues
+ * with the same connection.
+ */
+
+#ifndef LSQUIC_CONN_FIFO_H
+#define LSQUIC_CONN_FIFO_H 1
+
+struct lsquic_conn;
+
+struct conn_fifo
+{
+    struct {
+        struct lsquic_conn  *head,
+                           **tail;
+    }                        cf_lists[2];   /* Current and next rounds */
+    uint64_t                 cf_round;      /* Values smaller than this are
+                                             * placed on the current list.
+                                             */
+    uint64_t                 cf_max;        /* Largest value inserted */
+    unsigned                 cf_nelem;
+    unsigned                 cf_link_off;
+};
+
+
+void
+lsquic_cf_init (struct conn_fifo *, unsigned link_off);
+
+void
+lsquic_cf_insert (struct conn_fifo *, struct lsquic_conn *conn, uint64_t val);
+
+struct lsquic_conn *
+lsquic_cf_pop (struct conn_fifo *);
+
+#define lsquic_cf_peek(fifo) ((fifo)->cf_lists[0].head ? \
+                    (fifo)->cf_lists[0].head : (fifo)->cf_lists[1].head)
+
+#define lsquic_cf_count(fifo) (+(fifo)->cf_nelem)
+
+#endif
@@ -0,0 +1,440 @@
+/* Copyright (c) 2017 - 2020 LiteSpeed Technologies Inc.  See LICENSE. */
+/*
+ * lsquic_conn_pool.c -- Pool of client connections
+ *
+ * Each destination has a fixed array of es_pool_max_conns slots, so that
+ * the hash element of a slot, which maps a connection back to its slot,
+ * never moves.  A destination is freed when its last connection is gone.
+ *
+ * Stream credit of a connection is the number of streams the peer allows
+ * minus the number of pending streams.  Until handshake is done, the
+ * peer's limit is not known; the highest number of available streams seen
+ * on other connections to the same destination is used instead.
+ */
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/queue.h>
+#ifndef WIN32
+#include <netinet/in.h>
+#else
+#include <vc_compat.h>
+#include <ws2ipdef.h>
+#endif
+
+#include "lsquic.h"
+#include "lsquic_types.h"
+#include "lsquic_int_types.h"
+#include "lsquic_hash.h"
+#include "lsquic_conn.h"
+#include "lsquic_conn_pool.h"
+
+
+/* Version, address family, port, and address, followed by hostname */
+#define CPOOL_KEY_HEAD 20
+#define CPOOL_MAX_KEY (CPOOL_KEY_HEAD + 0x100)
+
+
+struct cpool_slot
+{
+    struct lsquic_hash_elem     ps_hash_el;
+    struct lsquic_conn         *ps_conn;
+    struct cpool_dest          *ps_dest;
+};
+
+
+struct cpool_dest
+{
+    struct lsquic_hash_elem     pd_hash_el;
+    unsigned char              *pd_key;
+    unsigned                    pd_key_sz;
+    unsigned                    pd_n_conns;
+    /* Highest number of available streams seen after handshake */
+    unsigned                    pd_peer_limit;
+    struct cpool_slot           pd_slots[];
+};
+
+
+struct conn_pool
+{
+    struct lsquic_hash         *cp_dests;
+    struct lsquic_hash         *cp_conns;
+    cpool_connect_f             cp_connect;
+    void                       *cp_connect_ctx;
+    unsigned                    cp_max_conns;
+    unsigned                    cp_stream_limit;
+};
+
+
+struct conn_pool *
+lsquic_cpool_new (unsigned max_conns, unsigned stream_limit,
+                                    cpool_connect_f connect, void *conn_ctx)
+{
+    struct conn_pool *pool;
+
+    if (max_conns == 0)
+        return NULL;
+
+    pool = malloc(sizeof(*pool));
+    if (!pool)
+        return NULL;
+
+    pool->cp_dests = lsquic_hash_create();
+    pool->cp_conns = lsquic_hash_create();
+    if (!(pool->cp_dests && pool->cp_conns))
+    {
+        if (pool->cp_dests)
+            lsquic_hash_destroy(pool->cp_dests);
+        if (pool->cp_conns)
+            lsquic_hash_destroy(pool->cp_conns);
+        free(pool);
+        return NULL;
+    }
+
+    pool->cp_connect = connect;
+    pool->cp_connect_ctx = conn_ctx;
+    pool->cp_max_conns = max_conns;
+    pool->cp_stream_limit = stream_limit;
+    return pool;
+}
+
+
+static int
+cpool_gen_key (const struct lsquic_pool_dest *dest, unsigned char *key,
+                                                            unsigned *key_sz)
+{
+    const struct sockaddr_in *sin;
+    const struct sockaddr_in6 *sin6;
+    size_t hostname_sz;
+
+    memset(key, 0, CPOOL_KEY_HEAD);
+    key[0] = dest->version < N_LSQVER ? dest->version : N_LSQVER;
+    switch (dest->peer_sa->sa_family)
+    {
+    case AF_INET:
+        sin = (const struct sockaddr_in *) dest->peer_sa;
+        key[1] = 4;
+        memcpy(key + 2, &sin->sin_port, 2);
+        memcpy(key + 4, &sin->sin_addr, 4);
+        break;
+    case AF_INET6:
+        sin6 = (const struct sockaddr_in6 *) dest->peer_sa;
+        key[1] = 6;
+        memcpy(key + 2, &sin6->sin6_port, 2);
+        memcpy(key + 4, &sin6->sin6_addr, 16);
+        break;
+    default:
+        return -1;
+    }
+
+    if (dest->hostname)
+    {
+        hostname_sz = strlen(dest->hostname);
+        if (hostname_sz >= CPOOL_MAX_KEY - CPOOL_KEY_HEAD)
+            return -1;
+        memcpy(key + CPOOL_KEY_HEAD, dest->hostname, hostname_sz);
+    }
+    else
+        hostname_sz = 0;
+
+    *key_sz = CPOOL_KEY_HEAD + hostname_sz;
+    return 0;
+}
+
+
+static struct cpool_dest *
+cpool_find_dest (struct conn_pool *pool, const struct lsquic_pool_dest *dest,
+                                                                int create)
+{
+    struct lsquic_hash_elem *el;
+    struct cpool_dest *pd;
+    unsigned char key[CPOOL_MAX_KEY];
+    unsigned key_sz, i;
+
+    if (0 != cpool_gen_key(dest, key, &key_sz))
+        return NULL;
+
+    el = lsquic_hash_find(pool->cp_dests, key, key_sz);
+    if (el)
+        return lsquic_hashelem_getdata(el);
+    if (!create)
+        return NULL;
+
+    pd = malloc(sizeof(*pd) + sizeof(pd->pd_slots[0]) * pool->cp_max_conns
+                                                                    + key_sz);
+    if (!pd)
+        return NULL;
+
+    pd->pd_key = (unsigned char *) &pd->pd_slots[pool->cp_max_conns];
+    memcpy(pd->pd_key, key, key_sz);
+    pd->pd_key_sz = key_sz;
+    pd->pd_n_conns = 0;
+    pd->pd_peer_limit = 0;
+    for (i = 0; i < pool->cp_max_conns; ++i)
+    {
+        pd->pd_slots[i].ps_conn = NULL;
+        pd->pd_slots[i].ps_dest = pd;
+    }
+
+    if (!lsquic_hash_insert(pool->cp_dests, pd->pd_key, pd->pd_key_sz, pd,
+                                                            &pd->pd_hash_el))
+    {
+        free(pd);
+        return NULL;
+    }
+
+    return pd;
+}
+
+
+static void
+cpool_maybe_free_dest (struct conn_pool *pool, struct cpool_dest *pd)
+{
+    if (pd->pd_n_conns == 0)
+    {
+        lsquic_hash_erase(pool->cp_dests, &pd->pd_hash_el);
+        free(pd);
+    }
+}
+
+
+/* Does not free the destination, as the caller may still be using it */
+static void
+cpool_drop_slot (struct conn_pool *pool, struct cpool_slot *slot)
+{
+    assert(slot->ps_conn);
+    lsquic_hash_erase(pool->cp_conns, &slot->ps_hash_el);
+    slot->ps_conn->cn_flags &= ~LSCONN_POOLED;
+    slot->ps_conn = NULL;
+    --slot->ps_dest->pd_n_conns;
+}
+
+
+/* Returns number of usable connections in the destination.  Connections
+ * that are closing or going away are dropped.
+ */
+static unsigned
+cpool_prune (struct conn_pool *pool, struct cpool_dest *pd)
+{
+    struct cpool_slot *slot;
+
+    for (slot = pd->pd_slots; slot < pd->pd_slots + pool->cp_max_conns;
+                                                                    ++slot)
+        if (slot->ps_conn && (slot->ps_conn->cn_flags
+                                & (LSCONN_CLOSING|LSCONN_PEER_GOING_AWAY)))
+            cpool_drop_slot(pool, slot);
+
+    return pd->pd_n_conns;
+}
+
+
+static struct lsquic_conn *
+cpool_connect (struct conn_pool *pool, struct cpool_dest *pd,
+                                        const struct lsquic_pool_dest *dest)
+{
+    struct cpool_slot *slot;
+    struct lsquic_conn *conn;
+
+    for (slot = pd->pd_slots; slot < pd->pd_slots + pool->cp_max_conns;
+                                                                    ++slot)
+        if (!slot->ps_conn)
+            break;
+    assert(slot < pd->pd_slots + pool->cp_max_conns);
+
+    conn = pool->cp_connect(pool->cp_connect_ctx, dest);
+    if (!conn)
+        return NULL;
+
+    /* The key must outlive this call, so it is the slot's pointer */
+    slot->ps_conn = conn;
+    if (!lsquic_hash_insert(pool->cp_conns, &slot->ps_conn,
+                            sizeof(slot->ps_conn), slot, &slot->ps_hash_el))
+    {
+        slot->ps_conn = NULL;
+        return conn;    /* Usable, just not pooled */
+    }
+
+    ++pd->pd_n_conns;
+    conn->cn_flags |= LSCONN_POOLED;
+    return conn;
+}
+
+
+static unsigned
+cpool_credit (const struct conn_pool *pool, struct cpool_dest *pd,
+                                                    struct lsquic_conn *conn)
+{
+    unsigned avail, pending;
+
+    avail = conn->cn_if->ci_n_avail_streams(conn);
+    pending = conn->cn_if->ci_n_pending_streams(conn);
+    if (conn->cn_flags & LSCONN_HANDSHAKE_DONE)
+    {
+        if (avail > pd->pd_peer_limit)
+            pd->pd_peer_limit = avail;
+    }
+    else if (avail == 0)
+        avail = pd->pd_peer_limit ? pd->pd_peer_limit : pool->cp_stream_limit;
+
+    return avail > pending ? avail - pending : 0;
+}
+
+
+static lsquic_time_t
+cpool_srtt (const struct lsquic_conn *conn)
+{
+    if (conn->cn_if->ci_srtt)
+        return conn->cn_if->ci_srtt(conn);
+    else
+        return 0;
+}
+
+
+/* Unknown RTT is worse than any known RTT */
+static int
+cpool_rtt_better (lsquic_time_t a, lsquic_time_t b)
+{
+    if (a && b)
+        return a < b;
+    else
+        return a != 0 && b == 0;
+}
+
+
+struct lsquic_conn *
+lsquic_cpool_make_stream (struct conn_pool *pool,
+                                        const struct lsquic_pool_dest *dest)
+{
+    struct cpool_dest *pd;
+    struct cpool_slot *slot;
+    struct lsquic_conn *conn, *best, *least_pending;
+    unsigned credit, best_credit, pending, min_pending;
+    lsquic_time_t srtt, best_srtt;
+
+    pd = cpool_find_dest(pool, dest, 1);
+    if (!pd)
+        return NULL;
+
+    best = NULL;
+    best_credit = 0;
+    best_srtt = 0;
+    least_pending = NULL;
+    min_pending = 0;
+    if (cpool_prune(pool, pd) > 0)
+        for (slot = pd->pd_slots; slot < pd->pd_slots + pool->cp_max_conns;
+                                                                    ++slot)
+        {
+            conn = slot->ps_conn;
+            if (!conn)
+                continue;
+            credit = cpool_credit(pool, pd, conn);
+            srtt = cpool_srtt(conn);
+            if (credit > best_credit || (credit && credit == best_credit
+                                        && cpool_rtt_better(srtt, best_srtt)))
+            {
+                best = conn;
+                best_credit = credit;
+                best_srtt = srtt;
+            }
+            pending = conn->cn_if->ci_n_pending_streams(conn);
+            if (!least_pending || pending < min_pending)
+            {
+                least_pending = conn;
+                min_pending = pending;
+            }
+        }
+
+    if (!best && pd->pd_n_conns < pool->cp_max_conns)
+    {
+        best = cpool_connect(pool, pd, dest);
+        if (!best)
+            best = least_pending;
+    }
+    else if (!best)
+        best = least_pending;
+
+    if (best)
+        lsquic_conn_make_stream(best);
+    else
+        cpool_maybe_free_dest(pool, pd);
+
+    return best;
+}
+
+
+int
+lsquic_cpool_prewarm (struct conn_pool *pool,
+                    const struct lsquic_pool_dest *dest, unsigned n_conns)
+{
+    struct cpool_dest *pd;
+    unsigned count;
+
+    pd = cpool_find_dest(pool, dest, 1);
+    if (!pd)
+        return -1;
+
+    if (n_conns > pool->cp_max_conns)
+        n_conns = pool->cp_max_conns;
+
+    count = cpool_prune(pool, pd);
+    while (count < n_conns && cpool_connect(pool, pd, dest)
+                                            && pd->pd_n_conns > count)
+        count = pd->pd_n_conns;
+
+    if (count == 0 && n_conns > 0)
+    {
+        cpool_maybe_free_dest(pool, pd);
+        return -1;
+    }
+
+    return (int) count;
+}
+
+
+void
+lsquic_cpool_remove (struct conn_pool *pool, struct lsquic_conn *conn)
+{
+    struct lsquic_hash_elem *el;
+    struct cpool_slot *slot;
+    struct cpool_dest *pd;
+
+    el = lsquic_hash_find(pool->cp_conns, &conn, sizeof(conn));
+    if (!el)
+        return;
+
+    slot = lsquic_hashelem_getdata(el);
+    pd = slot->ps_dest;
+    cpool_drop_slot(pool, slot);
+    cpool_maybe_free_dest(pool, pd);
+}
+
+
+unsigned
+lsquic_cpool_count (const struct conn_pool *pool)
+{
+    return lsquic_hash_count(pool->cp_conns);
+}
+
+
+void
+lsquic_cpool_destroy (struct conn_pool *pool)
+{
+    struct lsquic_hash_elem *el;
+    struct cpool_dest *pd;
+    struct cpool_slot *slot;
+
+    while ((el = lsquic_hash_first(pool->cp_dests)))
+    {
+        pd = lsquic_hashelem_getdata(el);
+        for (slot = pd->pd_slots; slot < pd->pd_slots + pool->cp_max_conns;
+                                                                    ++slot)
+            if (slot->ps_conn)
+                cpool_drop_slot(pool, slot);
+        cpool_maybe_free_dest(pool, pd);
+    }
+    lsquic_hash_destroy(pool->cp_conns);
+    lsquic_hash_destroy(pool->cp_dests);
+    free(pool);
+}
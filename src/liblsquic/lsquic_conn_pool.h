@@ -0,0 +1,45 @@
+/* Copyright (c) 2017 - 2020 LiteSpeed Technologies Inc.  See LICENSE. */
+/*
+ * lsquic_conn_pool.h -- Pool of client connections
+ *
+ * Connections are grouped by destination: peer address, hostname, and
+ * version.  New streams are placed on the connection with the most stream
+ * credit; a new connection is opened only when there is no credit left.
+ */
+
+#ifndef LSQUIC_CONN_POOL_H
+#define LSQUIC_CONN_POOL_H 1
+
+struct conn_pool;
+struct lsquic_conn;
+struct lsquic_pool_dest;
+
+/* Open new connection to `dest'.  Returns NULL on failure. */
+typedef struct lsquic_conn * (*cpool_connect_f)(void *ctx,
+                                        const struct lsquic_pool_dest *dest);
+
+/* `stream_limit' is the number of bidirectional streams the peer is assumed
+ * to allow until a connection to the destination has completed handshake.
+ */
+struct conn_pool *
+lsquic_cpool_new (unsigned max_conns, unsigned stream_limit,
+                                    cpool_connect_f connect, void *conn_ctx);
+
+struct lsquic_conn *
+lsquic_cpool_make_stream (struct conn_pool *, const struct lsquic_pool_dest *);
+
+int
+lsquic_cpool_prewarm (struct conn_pool *, const struct lsquic_pool_dest *,
+                                                            unsigned n_conns);
+
+/* Called when pooled connection is destroyed */
+void
+lsquic_cpool_remove (struct conn_pool *, struct lsquic_conn *);
+
+unsigned
+lsquic_cpool_count (const struct conn_pool *);
+
+void
+lsquic_cpool_destroy (struct conn_pool *);
+
+#endif
@@ -14,6 +14,7 @@
 #endif
 
 #include "lsquic_int_types.h"
+#include "lsquic.h"
 #include "lsquic_types.h"
 #include "lsquic_hash.h"
 #include "lsquic_util.h"
@@ -90,7 +90,12 @@ struct hash_data_in
 
 
 #define N_BUCKETS(n_bits) (1U << (n_bits))
-#define BUCKNO(n_bits, off) ((off / DB_DATA_SIZE) & (N_BUCKETS(n_bits) - 1))
+/* Use Fibonacci hashing of the block number: if bucket number were taken
+ * from the lower bits, the peer could place all blocks into the same bucket
+ * by sending frames at offsets that are a large power of two apart.
+ */
+#define BUCKNO(n_bits, off) ((unsigned) \
+    ((((off) / DB_DATA_SIZE) * 0x9E3779B97F4A7C15ull) >> (64 - (n_bits))))
 
 
 static unsigned
@@ -175,10 +180,9 @@ hash_di_destroy (struct data_in *data_in)
 static int
 hash_grow (struct hash_data_in *hdi)
 {
-    struct dblock_head *new_buckets, *new[2];
+    struct dblock_head *new_buckets;
     struct data_block *block;
     unsigned n, old_nbits;
-    int idx;
 
     old_nbits = hdi->hdi_nbits;
     LSQ_DEBUG("doubling number of buckets to %u", N_BUCKETS(old_nbits + 1));
@@ -190,19 +194,16 @@ hash_grow (struct hash_data_in *hdi)
         return -1;
     }
 
+    for (n = 0; n < N_BUCKETS(old_nbits + 1); ++n)
+        TAILQ_INIT(&new_buckets[n]);
+
     for (n = 0; n < N_BUCKETS(old_nbits); ++n)
-    {
-        new[0] = &new_buckets[n];
-        new[1] = &new_buckets[n + N_BUCKETS(old_nbits)];
-        TAILQ_INIT(new[0]);
-        TAILQ_INIT(new[1]);
         while ((block = TAILQ_FIRST(&hdi->hdi_buckets[n])))
         {
             TAILQ_REMOVE(&hdi->hdi_buckets[n], block, db_next);
-            idx = (BUCKNO(old_nbits + 1, block->db_off) >> old_nbits) & 1;
-            TAILQ_INSERT_TAIL(new[idx], block, db_next);
+            TAILQ_INSERT_TAIL(&new_buckets[
+                    BUCKNO(old_nbits + 1, block->db_off)], block, db_next);
         }
-    }
     free(hdi->hdi_buckets);
     hdi->hdi_nbits   = old_nbits + 1;
     hdi->hdi_buckets = new_buckets;
@@ -39,6 +39,13 @@
  * If average stream frame size is smaller than EFF_TINY_FRAME_SZ bytes,
  * (B) condition is true.  In addition, if there are more than EFF_MAX_HOLES
  * in the stream, this is also indicative of (B).
+ *
+ * (B) is also true when the referenced packets take up much more memory
+ * than the stream data in them -- for example, if the reader is slow and
+ * frames are small.  This is checked regardless of the number of frames:
+ * see EFF_PINNED_THRESH and EFF_ENGINE_PINNED_THRESH.  Switching to the
+ * other implementation copies the data into compact blocks and releases
+ * the packets.
  */
 
 
@@ -65,6 +72,7 @@
 #include "lsquic_malo.h"
 #include "lsquic_conn.h"
 #include "lsquic_conn_public.h"
+#include "lsquic_engine_public.h"
 #include "lsquic_data_in_if.h"
 
 
@@ -95,6 +103,19 @@
  */
 #define EFF_TINY_FRAME_SZ       64
 
+/* If packets referenced by the stream take up more than this many bytes
+ * and stream data in them is less than 1/EFF_PINNED_RATIO of that, the
+ * data is compacted.
+ */
+#define EFF_PINNED_THRESH       (16 * 1024)
+#define EFF_PINNED_RATIO        4
+
+/* If packets referenced by all no-copy streams in the engine take up more
+ * than this many bytes, data of any stream that uses less than half of
+ * the bytes it pins is compacted.
+ */
+#define EFF_ENGINE_PINNED_THRESH (32 * 1024 * 1024)
+
 
 TAILQ_HEAD(stream_frames_tailq, stream_frame);
 
@@ -105,6 +126,7 @@ struct nocopy_data_in
     struct data_in              ncdi_data_in;
     struct lsquic_conn_public  *ncdi_conn_pub;
     uint64_t                    ncdi_byteage;
+    uint64_t                    ncdi_pinned;    /* Sum of referenced packet sizes */
     uint64_t                    ncdi_fin_off;
     lsquic_stream_id_t          ncdi_stream_id;
     unsigned                    ncdi_n_frames;
@@ -113,6 +135,7 @@ struct nocopy_data_in
     enum {
         NCDI_FIN_SET        = 1 << 0,
         NCDI_FIN_REACHED    = 1 << 1,
+        NCDI_COMPACT        = 1 << 2,   /* Switching to save memory */
     }                           ncdi_flags;
 };
 
@@ -143,6 +166,7 @@ lsquic_data_in_nocopy_new (struct lsquic_conn_public *conn_pub,
     ncdi->ncdi_conn_pub         = conn_pub;
     ncdi->ncdi_stream_id        = stream_id;
     ncdi->ncdi_byteage          = 0;
+    ncdi->ncdi_pinned           = 0;
     ncdi->ncdi_n_frames         = 0;
     ncdi->ncdi_n_holes          = 0;
     ncdi->ncdi_cons_far         = 0;
@@ -153,6 +177,17 @@ lsquic_data_in_nocopy_new (struct lsquic_conn_public *conn_pub,
 }
 
 
+static void
+unpin_frame (struct nocopy_data_in *ncdi, const struct stream_frame *frame)
+{
+    struct lsquic_engine_public *const enpub = ncdi->ncdi_conn_pub->enpub;
+
+    ncdi->ncdi_pinned -= frame->packet_in->pi_data_sz;
+    enpub->enp_di_pinned -= frame->packet_in->pi_data_sz;
+    enpub->enp_di_used -= DF_SIZE(frame);
+}
+
+
 static void
 nocopy_di_destroy (struct data_in *data_in)
 {
@@ -161,6 +196,7 @@ nocopy_di_destroy (struct data_in *data_in)
     while ((frame = TAILQ_FIRST(&ncdi->ncdi_frames_in)))
     {
         TAILQ_REMOVE(&ncdi->ncdi_frames_in, frame, next_frame);
+        unpin_frame(ncdi, frame);
         lsquic_packet_in_put(ncdi->ncdi_conn_pub->mm, frame->packet_in);
         lsquic_malo_put(frame);
     }
@@ -331,15 +367,39 @@ insert_frame (struct nocopy_data_in *ncdi, struct stream_frame *new_frame,
 
     ++ncdi->ncdi_n_frames;
     ncdi->ncdi_byteage += DF_SIZE(new_frame);
+    ncdi->ncdi_pinned += new_frame->packet_in->pi_data_sz;
+    ncdi->ncdi_conn_pub->enpub->enp_di_pinned
+                                        += new_frame->packet_in->pi_data_sz;
+    ncdi->ncdi_conn_pub->enpub->enp_di_used += DF_SIZE(new_frame);
     *p_n_frames = count;
 
     return INS_FRAME_OK                                         | CASE('Z');
 }
 
 
+static int
+check_memory (const struct nocopy_data_in *ncdi)
+{
+    if (ncdi->ncdi_pinned > EFF_PINNED_THRESH
+            && ncdi->ncdi_byteage * EFF_PINNED_RATIO < ncdi->ncdi_pinned)
+        return 1;
+    if (ncdi->ncdi_conn_pub->enpub->enp_di_pinned > EFF_ENGINE_PINNED_THRESH
+            && ncdi->ncdi_byteage * 2 < ncdi->ncdi_pinned)
+        return 1;
+    return 0;
+}
+
+
 static int
 check_efficiency (struct nocopy_data_in *ncdi, unsigned count)
 {
+    if (check_memory(ncdi))
+    {
+        LSQ_DEBUG("%"PRIu64" bytes of data pin %"PRIu64" bytes of packets",
+                                    ncdi->ncdi_byteage, ncdi->ncdi_pinned);
+        ncdi->ncdi_flags |= NCDI_COMPACT;
+        return 1;
+    }
     if (ncdi->ncdi_n_frames <= EFF_CHECK_THRESH_LOW)
     {
         ncdi->ncdi_cons_far = 0;
@@ -439,6 +499,7 @@ nocopy_di_frame_done (struct data_in *data_in, struct data_frame *data_frame)
                     frame->data_frame.df_size != first->data_frame.df_offset;
     --ncdi->ncdi_n_frames;
     ncdi->ncdi_byteage -= frame->data_frame.df_size;
+    unpin_frame(ncdi, frame);
     if (DF_FIN(frame))
     {
         ncdi->ncdi_flags |= NCDI_FIN_REACHED;
@@ -472,11 +533,19 @@ nocopy_di_switch_impl (struct data_in *data_in, uint64_t read_offset)
     if (!new_data_in)
         goto end;
 
+    if (ncdi->ncdi_flags & NCDI_COMPACT)
+    {
+        LSQ_DEBUG("compact %"PRIu64" bytes of data, release %"PRIu64
+            " bytes of packets", ncdi->ncdi_byteage, ncdi->ncdi_pinned);
+        ++ncdi->ncdi_conn_pub->enpub->enp_di_compactions;
+    }
+
     while ((frame = TAILQ_FIRST(&ncdi->ncdi_frames_in)))
     {
         TAILQ_REMOVE(&ncdi->ncdi_frames_in, frame, next_frame);
         ins = lsquic_data_in_hash_insert_data_frame(new_data_in,
                                             &frame->data_frame, read_offset);
+        unpin_frame(ncdi, frame);
         lsquic_packet_in_put(ncdi->ncdi_conn_pub->mm, frame->packet_in);
         lsquic_malo_put(frame);
         if (INS_FRAME_ERR == ins)
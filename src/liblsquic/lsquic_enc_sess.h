@@ -303,6 +303,12 @@ struct enc_session_funcs_iquic
     int
     (*esfi_data_in)(enc_session_t *, enum enc_level,
                                             const unsigned char *, size_t);
+
+    /* Client: if 0-RTT packets can be sent, decode transport parameters
+     * remembered from the previous connection into `params' and return 0.
+     */
+    int
+    (*esfi_get_zero_rtt_tp)(enc_session_t *, struct transport_params *params);
 };
 
 extern
@@ -43,6 +43,8 @@
 #include "lsquic_ver_neg.h"
 #include "lsquic_frab_list.h"
 #include "lsquic_tokgen.h"
+#include "lsquic_ssl_pool.h"
+#include "lsquic_ikey_cache.h"
 #include "lsquic_ietf.h"
 #include "lsquic_alarmset.h"
 
@@ -142,6 +144,21 @@ struct crypto_ctx_pair
 };
 
 
+/* Key must already be in yk_key_buf */
+static int
+init_aead_ctx (struct crypto_ctx *crypto_ctx, const EVP_AEAD *aead,
+                                                enum evp_aead_direction_t dir)
+{
+    if (!EVP_AEAD_CTX_init_with_direction(&crypto_ctx->yk_aead_ctx, aead,
+            crypto_ctx->yk_key_buf, crypto_ctx->yk_key_sz, IQUIC_TAG_LEN, dir))
+        return -1;
+
+    crypto_ctx->yk_flags |= YK_INITED;
+
+    return 0;
+}
+
+
 /* [draft-ietf-quic-tls-12] Section 5.3.6 */
 static int
 init_crypto_ctx (struct crypto_ctx *crypto_ctx, const EVP_MD *md,
@@ -161,13 +178,8 @@ init_crypto_ctx (struct crypto_ctx *crypto_ctx, const EVP_MD *md,
         crypto_ctx->yk_key_buf, crypto_ctx->yk_key_sz);
     lsquic_qhkdf_expand(md, secret, secret_sz, IV_LABEL, IV_LABEL_SZ,
         crypto_ctx->yk_iv_buf, crypto_ctx->yk_iv_sz);
-    if (!EVP_AEAD_CTX_init_with_direction(&crypto_ctx->yk_aead_ctx, aead,
-            crypto_ctx->yk_key_buf, crypto_ctx->yk_key_sz, IQUIC_TAG_LEN, dir))
-        return -1;
-
-    crypto_ctx->yk_flags |= YK_INITED;
 
-    return 0;
+    return init_aead_ctx(crypto_ctx, aead, dir);
 }
 
 
@@ -237,6 +249,7 @@ struct enc_sess_iquic
         ESI_WANT_TICKET  = 1 << 11,
         ESI_RECV_QL_BITS = 1 << 12,
         ESI_SEND_QL_BITS = 1 << 13,
+        ESI_SSL_NO_REUSE = 1 << 14, /* Cannot return esi_ssl to the pool */
     }                    esi_flags;
     enum evp_aead_direction_t
                          esi_dir[2];        /* client, server */
@@ -250,6 +263,11 @@ struct enc_sess_iquic
     const unsigned char *esi_alpn;
     unsigned char       *esi_zero_rtt_buf;
     size_t               esi_zero_rtt_sz;
+    /* Server transport parameters from the previous connection.  They
+     * point into esi_zero_rtt_buf.
+     */
+    const unsigned char *esi_zero_rtt_tp_buf;
+    size_t               esi_zero_rtt_tp_sz;
     /* Need MD and AEAD for key rotation */
     const EVP_MD        *esi_md;
     const EVP_AEAD      *esi_aead;
@@ -268,6 +286,8 @@ struct enc_sess_iquic
     struct lsquic_alarmset
                         *esi_alset;
     unsigned             esi_max_streams_uni;
+    /* Server: esi_ssl was created from this context */
+    SSL_CTX             *esi_ssl_ctx;
 };
 
 
@@ -422,12 +442,132 @@ strip_hp (struct enc_sess_iquic *enc_sess,
 }
 
 
+/* Add transport parameters that only depend on engine settings */
+static void
+add_common_trans_params (const struct enc_sess_iquic *enc_sess,
+                                            struct transport_params *params)
+{
+    const struct lsquic_engine_settings *const settings =
+                                    &enc_sess->esi_enpub->enp_settings;
+
+    params->tp_init_max_data = settings->es_init_max_data;
+    params->tp_init_max_stream_data_bidi_local
+                            = settings->es_init_max_stream_data_bidi_local;
+    params->tp_init_max_stream_data_bidi_remote
+                            = settings->es_init_max_stream_data_bidi_remote;
+    params->tp_init_max_stream_data_uni
+                            = settings->es_init_max_stream_data_uni;
+    params->tp_init_max_streams_uni
+                            = enc_sess->esi_max_streams_uni;
+    params->tp_init_max_streams_bidi
+                            = settings->es_init_max_streams_bidi;
+    params->tp_ack_delay_exponent
+                            = TP_DEF_ACK_DELAY_EXP;
+    params->tp_max_idle_timeout = settings->es_idle_timeout * 1000;
+    params->tp_max_ack_delay = TP_DEF_MAX_ACK_DELAY;
+    params->tp_max_packet_size = 1370 /* XXX: based on socket */;
+    params->tp_active_connection_id_limit = MAX_IETF_CONN_DCIDS;
+    params->tp_set |= (1 << TPI_INIT_MAX_DATA)
+                   |  (1 << TPI_INIT_MAX_STREAM_DATA_BIDI_LOCAL)
+                   |  (1 << TPI_INIT_MAX_STREAM_DATA_BIDI_REMOTE)
+                   |  (1 << TPI_INIT_MAX_STREAM_DATA_UNI)
+                   |  (1 << TPI_INIT_MAX_STREAMS_UNI)
+                   |  (1 << TPI_INIT_MAX_STREAMS_BIDI)
+                   |  (1 << TPI_ACK_DELAY_EXPONENT)
+                   |  (1 << TPI_MAX_IDLE_TIMEOUT)
+                   |  (1 << TPI_MAX_ACK_DELAY)
+                   |  (1 << TPI_MAX_PACKET_SIZE)
+                   |  (1 << TPI_ACTIVE_CONNECTION_ID_LIMIT)
+                   ;
+    if (!settings->es_allow_migration)
+        params->tp_set |= 1 << TPI_DISABLE_ACTIVE_MIGRATION;
+    if (settings->es_ql_bits)
+    {
+        params->tp_loss_bits = settings->es_ql_bits - 1;
+        params->tp_set |= 1 << TPI_LOSS_BITS;
+    }
+    if (settings->es_delayed_acks)
+    {
+        params->tp_numerics[TPI_MIN_ACK_DELAY] = 10000;    /* TODO: make into a constant? make configurable? */
+        params->tp_set |= 1 << TPI_MIN_ACK_DELAY;
+    }
+    if (settings->es_timestamps)
+        params->tp_set |= 1 << TPI_TIMESTAMPS;
+}
+
+
+static int
+encode_trans_params (const struct enc_sess_iquic *enc_sess,
+        const struct transport_params *params, unsigned char *buf, size_t bufsz)
+{
+    return (enc_sess->esi_conn->cn_version == LSQVER_ID25
+                ? lsquic_tp_encode_id25 : lsquic_tp_encode)(params,
+                                enc_sess->esi_flags & ESI_SERVER, buf, bufsz);
+}
+
+
+/* Transport parameters that differ between server connections -- preferred
+ * address, original connection ID, and stateless reset token -- come last
+ * in the encoding.  The parameters that precede them are the same for all
+ * connections: they are encoded once and the rest is appended to them.
+ */
+static int
+gen_server_trans_params (struct enc_sess_iquic *enc_sess,
+                const struct transport_params *conn_params,
+                unsigned char *buf, size_t bufsz)
+{
+    struct lsquic_engine_public *const enpub = enc_sess->esi_enpub;
+    const int id25 = enc_sess->esi_conn->cn_version == LSQVER_ID25;
+    struct transport_params params;
+    unsigned char *p;
+    unsigned total;
+    int len;
+
+    if (0 == enpub->enp_tp_tmpls[id25].len)
+    {
+        memset(&params, 0, sizeof(params));
+        add_common_trans_params(enc_sess, &params);
+        len = encode_trans_params(enc_sess, &params,
+                enpub->enp_tp_tmpls[id25].buf,
+                sizeof(enpub->enp_tp_tmpls[id25].buf));
+        if (len < 0)
+            return -1;
+        enpub->enp_tp_tmpls[id25].len = len;
+        LSQ_DEBUG("generated transport parameters template of %d bytes", len);
+    }
+
+    if (enpub->enp_tp_tmpls[id25].len > bufsz)
+    {
+        errno = ENOBUFS;
+        return -1;
+    }
+    memcpy(buf, enpub->enp_tp_tmpls[id25].buf, enpub->enp_tp_tmpls[id25].len);
+    p = buf + enpub->enp_tp_tmpls[id25].len;
+    len = encode_trans_params(enc_sess, conn_params, p,
+                                    bufsz - enpub->enp_tp_tmpls[id25].len);
+    if (len < 0)
+        return -1;
+
+    if (id25)
+    {
+        /* Both buffers start with two-byte length: drop the second one and
+         * update the first.
+         */
+        memmove(p, p + 2, len - 2);
+        len -= 2;
+        total = enpub->enp_tp_tmpls[id25].len + len - 2;
+        buf[0] = total >> 8;
+        buf[1] = total;
+    }
+
+    return enpub->enp_tp_tmpls[id25].len + len;
+}
+
+
 static int
 gen_trans_params (struct enc_sess_iquic *enc_sess, unsigned char *buf,
                                                                 size_t bufsz)
 {
-    const struct lsquic_engine_settings *const settings =
-                                    &enc_sess->esi_enpub->enp_settings;
     struct transport_params params;
     int len;
 
@@ -517,52 +657,13 @@ gen_trans_params (struct enc_sess_iquic *enc_sess, unsigned char *buf,
             params.tp_set |= 1 << TPI_QUANTUM_READINESS;
     }
 #endif
-    params.tp_init_max_data = settings->es_init_max_data;
-    params.tp_init_max_stream_data_bidi_local
-                            = settings->es_init_max_stream_data_bidi_local;
-    params.tp_init_max_stream_data_bidi_remote
-                            = settings->es_init_max_stream_data_bidi_remote;
-    params.tp_init_max_stream_data_uni
-                            = settings->es_init_max_stream_data_uni;
-    params.tp_init_max_streams_uni
-                            = enc_sess->esi_max_streams_uni;
-    params.tp_init_max_streams_bidi
-                            = settings->es_init_max_streams_bidi;
-    params.tp_ack_delay_exponent
-                            = TP_DEF_ACK_DELAY_EXP;
-    params.tp_max_idle_timeout = settings->es_idle_timeout * 1000;
-    params.tp_max_ack_delay = TP_DEF_MAX_ACK_DELAY;
-    params.tp_max_packet_size = 1370 /* XXX: based on socket */;
-    params.tp_active_connection_id_limit = MAX_IETF_CONN_DCIDS;
-    params.tp_set |= (1 << TPI_INIT_MAX_DATA)
-                  |  (1 << TPI_INIT_MAX_STREAM_DATA_BIDI_LOCAL)
-                  |  (1 << TPI_INIT_MAX_STREAM_DATA_BIDI_REMOTE)
-                  |  (1 << TPI_INIT_MAX_STREAM_DATA_UNI)
-                  |  (1 << TPI_INIT_MAX_STREAMS_UNI)
-                  |  (1 << TPI_INIT_MAX_STREAMS_BIDI)
-                  |  (1 << TPI_ACK_DELAY_EXPONENT)
-                  |  (1 << TPI_MAX_IDLE_TIMEOUT)
-                  |  (1 << TPI_MAX_ACK_DELAY)
-                  |  (1 << TPI_MAX_PACKET_SIZE)
-                  |  (1 << TPI_ACTIVE_CONNECTION_ID_LIMIT)
-                  ;
-    if (!settings->es_allow_migration)
-        params.tp_set |= 1 << TPI_DISABLE_ACTIVE_MIGRATION;
-    if (settings->es_ql_bits)
-    {
-        params.tp_loss_bits = settings->es_ql_bits - 1;
-        params.tp_set |= 1 << TPI_LOSS_BITS;
-    }
-    if (settings->es_delayed_acks)
+    if (enc_sess->esi_flags & ESI_SERVER)
+        len = gen_server_trans_params(enc_sess, &params, buf, bufsz);
+    else
     {
-        params.tp_numerics[TPI_MIN_ACK_DELAY] = 10000;    /* TODO: make into a constant? make configurable? */
-        params.tp_set |= 1 << TPI_MIN_ACK_DELAY;
+        add_common_trans_params(enc_sess, &params);
+        len = encode_trans_params(enc_sess, &params, buf, bufsz);
     }
-    if (settings->es_timestamps)
-        params.tp_set |= 1 << TPI_TIMESTAMPS;
-
-    len = (enc_sess->esi_conn->cn_version == LSQVER_ID25 ? lsquic_tp_encode_id25 :
-        lsquic_tp_encode)(&params, enc_sess->esi_flags & ESI_SERVER, buf, bufsz);
     if (len >= 0)
         LSQ_DEBUG("generated transport parameters buffer of %d bytes", len);
     else
@@ -660,8 +761,6 @@ maybe_create_SSL_SESSION (struct enc_sess_iquic *enc_sess,
     p += trapa_sz;
     assert(p == end);
 
-    (void) /* TODO */ trapa_buf;
-
     ssl_session = SSL_SESSION_from_bytes(ticket_buf, ticket_sz, ssl_ctx);
     if (!ssl_session)
     {
@@ -669,6 +768,10 @@ maybe_create_SSL_SESSION (struct enc_sess_iquic *enc_sess,
         return NULL;
     }
 
+    /* Limits for 0-RTT data are those the server gave us last time */
+    enc_sess->esi_zero_rtt_tp_buf = trapa_buf;
+    enc_sess->esi_zero_rtt_tp_sz = trapa_sz;
+
     LSQ_INFO("instantiated SSL_SESSION from serialized buffer");
     return ssl_session;
 }
@@ -876,17 +979,59 @@ log_hp (const struct enc_sess_iquic *enc_sess,
 
 
 /* [draft-ietf-quic-tls-12] Section 5.3.2 */
+/* Initial secrets, keys, IVs, and header protection keys all derive from
+ * the DCID.
+ */
+static void
+derive_initial_keys (struct enc_sess_iquic *enc_sess, const lsquic_cid_t *cid,
+                                                struct ikey_material *ikm)
+{
+    const EVP_MD *const md = EVP_sha256();
+    size_t hsk_secret_sz;
+    unsigned char hsk_secret[EVP_MAX_MD_SIZE];
+    char hexbuf[EVP_MAX_MD_SIZE * 2 + 1];
+    unsigned i;
+
+    HKDF_extract(hsk_secret, &hsk_secret_sz, md, cid->idbuf, cid->len,
+                                                        HSK_SALT, HSK_SALT_SZ);
+    if (enc_sess->esi_flags & ESI_LOG_SECRETS)
+    {
+        LSQ_DEBUG("handshake salt: %s", HEXSTR(HSK_SALT, HSK_SALT_SZ, hexbuf));
+        LSQ_DEBUG("handshake secret: %s", HEXSTR(hsk_secret, hsk_secret_sz,
+                                                                    hexbuf));
+    }
+
+    lsquic_qhkdf_expand(md, hsk_secret, hsk_secret_sz, CLIENT_LABEL,
+                CLIENT_LABEL_SZ, ikm->ikm_secret[0], IKC_SECRET_SZ);
+    lsquic_qhkdf_expand(md, hsk_secret, hsk_secret_sz, SERVER_LABEL,
+                SERVER_LABEL_SZ, ikm->ikm_secret[1], IKC_SECRET_SZ);
+    for (i = 0; i < 2; ++i)
+    {
+        lsquic_qhkdf_expand(md, ikm->ikm_secret[i], IKC_SECRET_SZ, KEY_LABEL,
+                KEY_LABEL_SZ, ikm->ikm_key[i], IKC_KEY_SZ);
+        lsquic_qhkdf_expand(md, ikm->ikm_secret[i], IKC_SECRET_SZ, IV_LABEL,
+                IV_LABEL_SZ, ikm->ikm_iv[i], IKC_IV_SZ);
+        lsquic_qhkdf_expand(md, ikm->ikm_secret[i], IKC_SECRET_SZ, PN_LABEL,
+                PN_LABEL_SZ, ikm->ikm_hp[i], IKC_KEY_SZ);
+    }
+}
+
+
 static int
 setup_handshake_keys (struct enc_sess_iquic *enc_sess, const lsquic_cid_t *cid)
 {
-    const EVP_MD *const md = EVP_sha256();
     const EVP_AEAD *const aead = EVP_aead_aes_128_gcm();
+    struct ikey_cache *const cache = enc_sess->esi_enpub
+                            ? enc_sess->esi_enpub->enp_ikey_cache : NULL;
+    const struct ikey_material *ikm;
     struct crypto_ctx_pair *pair;
     struct header_prot *hp;
-    size_t hsk_secret_sz;
-    unsigned char hsk_secret[EVP_MAX_MD_SIZE];
-    unsigned char secret[2][SHA256_DIGEST_LENGTH];  /* client, server */
-    char hexbuf[EVP_MAX_MD_SIZE * 2 + 1];
+    struct ikey_material material;
+    unsigned i;
+    char hexbuf[IKC_SECRET_SZ * 2 + 1];
+
+    assert(EVP_AEAD_key_length(aead) == IKC_KEY_SZ);
+    assert(EVP_AEAD_nonce_length(aead) == IKC_IV_SZ);
 
     if (!enc_sess->esi_hsk_pairs)
     {
@@ -905,29 +1050,31 @@ setup_handshake_keys (struct enc_sess_iquic *enc_sess, const lsquic_cid_t *cid)
     pair->ykp_thresh = IQUIC_INVALID_PACKNO;
     hp = &enc_sess->esi_hsk_hps[ENC_LEV_CLEAR];
 
-    HKDF_extract(hsk_secret, &hsk_secret_sz, md, cid->idbuf, cid->len,
-                                                        HSK_SALT, HSK_SALT_SZ);
-    if (enc_sess->esi_flags & ESI_LOG_SECRETS)
+    /* Repeated Initials and retries may use the same DCID */
+    ikm = cache ? lsquic_ikc_get(cache, cid) : NULL;
+    if (ikm)
+        LSQ_DEBUG("use cached Initial keys");
+    else
     {
-        LSQ_DEBUG("handshake salt: %s", HEXSTR(HSK_SALT, HSK_SALT_SZ, hexbuf));
-        LSQ_DEBUG("handshake secret: %s", HEXSTR(hsk_secret, hsk_secret_sz,
-                                                                    hexbuf));
+        derive_initial_keys(enc_sess, cid, &material);
+        if (cache)
+            lsquic_ikc_put(cache, cid, &material);
+        ikm = &material;
     }
 
-    lsquic_qhkdf_expand(md, hsk_secret, hsk_secret_sz, CLIENT_LABEL,
-                CLIENT_LABEL_SZ, secret[0], sizeof(secret[0]));
     LSQ_DEBUG("client handshake secret: %s",
-        HEXSTR(secret[0], sizeof(secret[0]), hexbuf));
-    if (0 != init_crypto_ctx(&pair->ykp_ctx[0], md, aead, secret[0],
-                sizeof(secret[0]), enc_sess->esi_dir[0]))
-        goto err;
-    lsquic_qhkdf_expand(md, hsk_secret, hsk_secret_sz, SERVER_LABEL,
-                SERVER_LABEL_SZ, secret[1], sizeof(secret[1]));
+        HEXSTR(ikm->ikm_secret[0], IKC_SECRET_SZ, hexbuf));
     LSQ_DEBUG("server handshake secret: %s",
-        HEXSTR(secret[1], sizeof(secret[1]), hexbuf));
-    if (0 != init_crypto_ctx(&pair->ykp_ctx[1], md, aead, secret[1],
-                sizeof(secret[1]), enc_sess->esi_dir[1]))
-        goto err;
+        HEXSTR(ikm->ikm_secret[1], IKC_SECRET_SZ, hexbuf));
+    for (i = 0; i < 2; ++i)
+    {
+        pair->ykp_ctx[i].yk_key_sz = IKC_KEY_SZ;
+        pair->ykp_ctx[i].yk_iv_sz = IKC_IV_SZ;
+        memcpy(pair->ykp_ctx[i].yk_key_buf, ikm->ikm_key[i], IKC_KEY_SZ);
+        memcpy(pair->ykp_ctx[i].yk_iv_buf, ikm->ikm_iv[i], IKC_IV_SZ);
+        if (0 != init_aead_ctx(&pair->ykp_ctx[i], aead, enc_sess->esi_dir[i]))
+            goto err;
+    }
 
     /* [draft-ietf-quic-tls-12] Section 5.6.1: AEAD_AES_128_GCM implies
      * 128-bit AES-CTR.
@@ -935,7 +1082,9 @@ setup_handshake_keys (struct enc_sess_iquic *enc_sess, const lsquic_cid_t *cid)
     hp->hp_cipher = EVP_aes_128_ecb();
     hp->hp_gen_mask = gen_hp_mask_aes;
     hp->hp_enc_level = ENC_LEV_CLEAR;
-    derive_hp_secrets(hp, md, aead, sizeof(secret[0]), secret[0], secret[1]);
+    hp->hp_sz = IKC_KEY_SZ;
+    memcpy(hp->hp_buf[0], ikm->ikm_hp[0], IKC_KEY_SZ);
+    memcpy(hp->hp_buf[1], ikm->ikm_hp[1], IKC_KEY_SZ);
 
     if (enc_sess->esi_flags & ESI_LOG_SECRETS)
     {
@@ -1065,6 +1214,16 @@ iquic_lookup_cert (SSL *ssl, void *arg)
                                     SSL_get_options(enc_sess->esi_ssl));
             SSL_set_options(enc_sess->esi_ssl,
                             SSL_CTX_get_options(ssl_ctx) & ~SSL_OP_NO_TLSv1_3);
+            if (enc_sess->esi_enpub->enp_early_data_ok
+                && !enc_sess->esi_enpub->enp_early_data_ok(
+                        enc_sess->esi_enpub->enp_early_data_ctx,
+                        NP_LOCAL_SA(path), NP_PEER_SA(path), server_name))
+            {
+                LSQ_DEBUG("application does not want early data");
+                SSL_set_early_data_enabled(enc_sess->esi_ssl, 0);
+                /* The pool cannot tell what to set it back to */
+                enc_sess->esi_flags |= ESI_SSL_NO_REUSE;
+            }
             return 1;
         }
         else
@@ -1125,13 +1284,21 @@ iquic_esfi_init_server (enc_session_t *enc_session_p)
         return -1;
     }
 
-    enc_sess->esi_ssl = SSL_new(ssl_ctx);
-    if (!enc_sess->esi_ssl)
+    if (enc_sess->esi_enpub->enp_ssl_pool
+        && (enc_sess->esi_ssl = lsquic_sslp_get(
+                                enc_sess->esi_enpub->enp_ssl_pool, ssl_ctx)))
+        LSQ_DEBUG("reuse SSL object");
+    else
     {
-        LSQ_ERROR("cannot create SSL object: %s",
-            ERR_error_string(ERR_get_error(), u.errbuf));
-        return -1;
+        enc_sess->esi_ssl = SSL_new(ssl_ctx);
+        if (!enc_sess->esi_ssl)
+        {
+            LSQ_ERROR("cannot create SSL object: %s",
+                ERR_error_string(ERR_get_error(), u.errbuf));
+            return -1;
+        }
     }
+    enc_sess->esi_ssl_ctx = ssl_ctx;
     if (!(SSL_set_quic_method(enc_sess->esi_ssl, &cry_quic_method)))
     {
         LSQ_INFO("could not set stream method");
@@ -1565,10 +1732,11 @@ maybe_get_peer_transport_params (struct enc_sess_iquic *enc_sess)
 static enum iquic_handshake_status
 iquic_esfi_handshake (struct enc_sess_iquic *enc_sess)
 {
-    int s, err;
+    int s, err, early_data;
     enum lsquic_hsk_status hsk_status;
     char errbuf[ERR_ERROR_STRING_BUF_LEN];
 
+  do_handshake:
     s = SSL_do_handshake(enc_sess->esi_ssl);
     if (s <= 0)
     {
@@ -1582,10 +1750,17 @@ iquic_esfi_handshake (struct enc_sess_iquic *enc_sess)
             LSQ_DEBUG("retry write");
             return IHS_WANT_WRITE;
         case SSL_ERROR_EARLY_DATA_REJECTED:
+            /* The handshake goes on as if 0-RTT were never attempted.  The
+             * connection resends its 0-RTT data after the handshake.
+             */
             LSQ_DEBUG("early data rejected");
-            hsk_status = LSQ_HSK_0RTT_FAIL;
-            goto err;
-            /* fall through */
+            SSL_reset_early_data_reject(enc_sess->esi_ssl);
+            enc_sess->esi_flags &= ~ESI_USE_SSL_TICKET;
+            enc_sess->esi_zero_rtt_tp_buf = NULL;
+            if (enc_sess->esi_conn->cn_if->ci_early_data_failed)
+                enc_sess->esi_conn->cn_if->ci_early_data_failed(
+                                                    enc_sess->esi_conn);
+            goto do_handshake;
         default:
             LSQ_DEBUG("handshake: %s", ERR_error_string(err, errbuf));
             hsk_status = LSQ_HSK_FAIL;
@@ -1594,14 +1769,22 @@ iquic_esfi_handshake (struct enc_sess_iquic *enc_sess)
     }
 
 
-    if (SSL_in_early_data(enc_sess->esi_ssl))
+    early_data = SSL_in_early_data(enc_sess->esi_ssl);
+    if (early_data)
     {
         LSQ_DEBUG("in early data");
-        if (enc_sess->esi_flags & ESI_SERVER)
-            LSQ_DEBUG("TODO");
-        else
+        if (!(enc_sess->esi_flags & ESI_SERVER))
             return IHS_WANT_READ;
+        /* The server accepted early data and has sent its flight.  Report
+         * the handshake as done now: this promotes the mini connection, so
+         * that 0-RTT streams are processed without waiting for client
+         * Finished.  The full connection completes the handshake.  Until
+         * the client address is validated, the full connection observes the
+         * same anti-amplification limit as the mini connection does.
+         */
     }
+    else if (enc_sess->esi_flags & ESI_SERVER)
+        early_data = SSL_early_data_accepted(enc_sess->esi_ssl);
 
     hsk_status = LSQ_HSK_OK;
     LSQ_DEBUG("handshake reported complete");
@@ -1610,7 +1793,7 @@ iquic_esfi_handshake (struct enc_sess_iquic *enc_sess)
      * If the handshake is complete, and the client attempted 0-RTT, it
      * must have succeeded.
      */
-    if (enc_sess->esi_flags & ESI_USE_SSL_TICKET)
+    if ((enc_sess->esi_flags & ESI_USE_SSL_TICKET) || early_data)
     {
         hsk_status = LSQ_HSK_0RTT_OK;
         EV_LOG_ZERO_RTT(LSQUIC_LOG_CONN_ID);
@@ -1664,6 +1847,20 @@ iquic_esfi_get_peer_transport_params (enc_session_t *enc_session_p)
 }
 
 
+/* Server SSL objects are reset and kept for reuse */
+static void
+free_SSL (struct enc_sess_iquic *enc_sess)
+{
+    if (enc_sess->esi_ssl_ctx && enc_sess->esi_enpub->enp_ssl_pool
+                            && !(enc_sess->esi_flags & ESI_SSL_NO_REUSE))
+        lsquic_sslp_put(enc_sess->esi_enpub->enp_ssl_pool,
+                                    enc_sess->esi_ssl_ctx, enc_sess->esi_ssl);
+    else
+        SSL_free(enc_sess->esi_ssl);
+    enc_sess->esi_ssl = NULL;
+}
+
+
 static void
 iquic_esfi_destroy (enc_session_t *enc_session_p)
 {
@@ -1678,7 +1875,7 @@ iquic_esfi_destroy (enc_session_t *enc_session_p)
     if (enc_sess->esi_keylog_handle)
         enc_sess->esi_enpub->enp_kli->kli_close(enc_sess->esi_keylog_handle);
     if (enc_sess->esi_ssl)
-        SSL_free(enc_sess->esi_ssl);
+        free_SSL(enc_sess);
 
     free_handshake_keys(enc_sess);
 
@@ -1731,8 +1928,10 @@ iquic_esf_encrypt_packet (enc_session_t *enc_session_p,
     char errbuf[ERR_ERROR_STRING_BUF_LEN];
 
     pns = lsquic_packet_out_pns(packet_out);
-    /* TODO Obviously, will need more logic for 0-RTT */
-    enc_level = pns2enc_level[ pns ];
+    if (UNLIKELY(packet_out->po_header_type == HETY_0RTT))
+        enc_level = ENC_LEV_EARLY;
+    else
+        enc_level = pns2enc_level[ pns ];
 
     cliser = !!(enc_sess->esi_flags & ESI_SERVER);
     if (enc_level == ENC_LEV_FORW)
@@ -2228,6 +2427,30 @@ iquic_esf_zero_rtt_enabled (enc_session_t *enc_session_p)
 }
 
 
+static int
+iquic_esfi_get_zero_rtt_tp (enc_session_t *enc_session_p,
+                                            struct transport_params *params)
+{
+    struct enc_sess_iquic *const enc_sess = enc_session_p;
+
+    if (!(enc_sess->esi_zero_rtt_tp_buf && enc_sess->esi_hsk_pairs
+            && (enc_sess->esi_hsk_pairs[ENC_LEV_EARLY].ykp_ctx[0].yk_flags
+                                                                & YK_INITED)))
+        return -1;
+
+    if (0 > (enc_sess->esi_conn->cn_version == LSQVER_ID25
+                ? lsquic_tp_decode_id25 : lsquic_tp_decode)(
+                    enc_sess->esi_zero_rtt_tp_buf, enc_sess->esi_zero_rtt_tp_sz,
+                    1, params))
+    {
+        LSQ_INFO("could not decode remembered transport parameters");
+        return -1;
+    }
+
+    return 0;
+}
+
+
 static int
 iquic_esfi_reset_dcid (enc_session_t *enc_session_p,
         const lsquic_cid_t *old_dcid, const lsquic_cid_t *new_dcid)
@@ -2336,6 +2559,8 @@ const struct enc_session_funcs_iquic lsquic_enc_session_iquic_ietf_v1 =
                          = iquic_esfi_handshake_confirmed,
     .esfi_in_init        = iquic_esfi_in_init,
     .esfi_data_in        = iquic_esfi_data_in,
+    .esfi_get_zero_rtt_tp
+                         = iquic_esfi_get_zero_rtt_tp,
 };
 
 
@@ -2376,8 +2601,7 @@ drop_SSL (struct enc_sess_iquic *enc_sess)
         enc_sess->esi_conn->cn_if->ci_drop_crypto_streams(
                                                     enc_sess->esi_conn);
     cache_info(enc_sess);
-    SSL_free(enc_sess->esi_ssl);
-    enc_sess->esi_ssl = NULL;
+    free_SSL(enc_sess);
     free_handshake_keys(enc_sess);
 }
 
@@ -53,7 +53,10 @@
 #include "lsquic_set.h"
 #include "lsquic_conn_flow.h"
 #include "lsquic_sfcw.h"
+#include "lsquic_varint.h"
+#include "lsquic_hq.h"
 #include "lsquic_hash.h"
+#include "lsquic_stream.h"
 #include "lsquic_conn.h"
 #include "lsquic_full_conn.h"
 #include "lsquic_util.h"
@@ -72,10 +75,17 @@
 #include "lsquic_tokgen.h"
 #include "lsquic_attq.h"
 #include "lsquic_min_heap.h"
+#include "lsquic_conn_fifo.h"
+#include "lsquic_lat_hist.h"
+#include "lsquic_ssl_pool.h"
+#include "lsquic_ikey_cache.h"
+#include "lsquic_conn_pool.h"
+#include "lsquic_numa.h"
 #include "lsquic_http1x_if.h"
 #include "lsquic_handshake.h"
 #include "lsquic_crand.h"
 #include "lsquic_ietf.h"
+#include "lsquic_packet_ietf.h"
 
 #define LSQUIC_LOGGER_MODULE LSQLM_ENGINE
 #include "lsquic_logger.h"
@@ -95,6 +105,9 @@
 #define MIN_OUT_BATCH_SIZE 4
 #define INITIAL_OUT_BATCH_SIZE 32
 
+/* Number of DCIDs whose Initial keys are kept for reuse */
+#define IKEY_CACHE_SIZE 32
+
 struct out_batch
 {
     lsquic_conn_t           *conns  [MAX_OUT_BATCH_SIZE];
@@ -177,6 +190,25 @@ force_close_conn (lsquic_engine_t *engine, lsquic_conn_t *conn);
                         |LSCONN_CLOSING         \
                         |LSCONN_ATTQ)
 
+/* The Tickable and Outgoing queues are min-heaps ordered by the time the
+ * connection was last ticked or last sent.  When LSQUIC_CONN_FIFO is set,
+ * round-robin FIFOs are used instead: this gives the same fairness with
+ * O(1) insertion and removal.  See lsquic_conn_fifo.h.
+ */
+#if LSQUIC_CONN_FIFO
+typedef struct conn_fifo        conn_queue_t;
+#define connq_insert            lsquic_cf_insert
+#define connq_pop               lsquic_cf_pop
+#define connq_peek              lsquic_cf_peek
+#define connq_count             lsquic_cf_count
+#else
+typedef struct min_heap         conn_queue_t;
+#define connq_insert            lsquic_mh_insert
+#define connq_pop               lsquic_mh_pop
+#define connq_peek              lsquic_mh_peek
+#define connq_count             lsquic_mh_count
+#endif
+
 
 
 
@@ -206,6 +238,9 @@ struct lsquic_engine
                                          */
         ENG_CONNS_BY_ADDR
                         = (1 <<  9),    /* Connections are hashed by address */
+        ENG_SHORT_FAST  = (1 << 10),    /* Use fast path for IETF short
+                                         * header packets.
+                                         */
 #ifndef NDEBUG
         ENG_COALESCE    = (1 << 24),    /* Packet coalescing is enabled */
         ENG_LOSE_PACKETS= (1 << 25),    /* Lose *some* outgoing packets */
@@ -219,8 +254,14 @@ struct lsquic_engine
     lsquic_cids_update_f               report_old_scids;
     void                              *scids_ctx;
     struct lsquic_hash                *conns_hash;
-    struct min_heap                    conns_tickable;
-    struct min_heap                    conns_out;
+    /* Result of the last successful lookup by CID: consecutive datagrams
+     * usually belong to the same connection.  Reset when the element is
+     * removed from conns_hash.
+     */
+    struct lsquic_hash_elem           *last_conn_el;
+    lsquic_cid_t                       last_conn_cid;
+    conn_queue_t                       conns_tickable;
+    conn_queue_t                       conns_out;
     struct eng_hist                    history;
     unsigned                           batch_size;
     struct pr_queue                   *pr_queue;
@@ -257,6 +298,21 @@ struct lsquic_engine
 #endif
     struct crand                       crand;
     EVP_AEAD_CTX                       retry_aead_ctx;
+    /* User streams whose events are dispatched after all connections
+     * have been ticked.  See es_batch_dispatch.
+     */
+    struct lsquic_streams_tailq        batch_streams;
+    struct lsquic_stream             **batch_arr;
+    unsigned                           n_batch_streams,
+                                       batch_arr_sz;
+    struct lsquic_engine_drop_stats    drop_stats;
+    /* Client connection pool, created on first use */
+    struct conn_pool                  *conn_pool;
+    /* CPU the engine runs on and NUMA node its memory was placed on, or
+     * -1 if not specified.
+     */
+    int                                cpu,
+                                       numa_node;
 };
 
 
@@ -336,6 +392,14 @@ lsquic_engine_init_settings (struct lsquic_engine_settings *settings,
     settings->es_spin            = LSQUIC_DF_SPIN;
     settings->es_delayed_acks    = LSQUIC_DF_DELAYED_ACKS;
     settings->es_timestamps      = LSQUIC_DF_TIMESTAMPS;
+    settings->es_batch_dispatch  = LSQUIC_DF_BATCH_DISPATCH;
+    settings->es_lat_hist        = LSQUIC_DF_LAT_HIST;
+    settings->es_ssl_pool        = LSQUIC_DF_SSL_POOL;
+    settings->es_pool_max_conns  = LSQUIC_DF_POOL_MAX_CONNS;
+    settings->es_stream_sched    = LSQUIC_DF_STREAM_SCHED;
+    settings->es_sched_max_wait  = LSQUIC_DF_SCHED_MAX_WAIT;
+    settings->es_cpu             = LSQUIC_DF_CPU;
+    settings->es_numa_node       = LSQUIC_DF_NUMA_NODE;
 }
 
 
@@ -419,6 +483,30 @@ lsquic_engine_check_settings (const struct lsquic_engine_settings *settings,
         return -1;
     }
 
+    if (settings->es_stream_sched > 2)
+    {
+        if (err_buf)
+            snprintf(err_buf, err_buf_sz, "Invalid stream scheduler value %u",
+                settings->es_stream_sched);
+        return -1;
+    }
+
+    if (settings->es_cpu < -1)
+    {
+        if (err_buf)
+            snprintf(err_buf, err_buf_sz, "Invalid CPU value %d",
+                settings->es_cpu);
+        return -1;
+    }
+
+    if (settings->es_numa_node < -1)
+    {
+        if (err_buf)
+            snprintf(err_buf, err_buf_sz, "Invalid NUMA node value %d",
+                settings->es_numa_node);
+        return -1;
+    }
+
     return 0;
 }
 
@@ -459,9 +547,8 @@ hash_conns_by_addr (const struct lsquic_engine *engine)
 }
 
 
-lsquic_engine_t *
-lsquic_engine_new (unsigned flags,
-                   const struct lsquic_engine_api *api)
+static lsquic_engine_t *
+engine_new (unsigned flags, const struct lsquic_engine_api *api)
 {
     lsquic_engine_t *engine;
     size_t alpn_len;
@@ -537,9 +624,12 @@ lsquic_engine_new (unsigned flags,
     engine->report_old_scids  = api->ea_old_scids;
     engine->scids_ctx         = api->ea_cids_update_ctx;
     cub_init(&engine->new_scids, engine->report_new_scids, engine->scids_ctx);
+    TAILQ_INIT(&engine->batch_streams);
     engine->pub.enp_lookup_cert  = api->ea_lookup_cert;
     engine->pub.enp_cert_lu_ctx  = api->ea_cert_lu_ctx;
     engine->pub.enp_get_ssl_ctx  = api->ea_get_ssl_ctx;
+    engine->pub.enp_early_data_ok  = api->ea_early_data_ok;
+    engine->pub.enp_early_data_ctx = api->ea_early_data_ctx;
     if (api->ea_shi)
     {
         engine->pub.enp_shi      = api->ea_shi;
@@ -582,6 +672,9 @@ lsquic_engine_new (unsigned flags,
     engine->pub.enp_engine = engine;
     if (hash_conns_by_addr(engine))
         engine->flags |= ENG_CONNS_BY_ADDR;
+    else if (engine->pub.enp_settings.es_scid_len
+                && (engine->pub.enp_settings.es_versions & LSQUIC_IETF_VERSIONS))
+        engine->flags |= ENG_SHORT_FAST;
     engine->conns_hash = lsquic_hash_create();
     engine->pub.enp_tokgen = lsquic_tg_new(&engine->pub);
     if (!engine->pub.enp_tokgen)
@@ -607,6 +700,12 @@ lsquic_engine_new (unsigned flags,
         }
     }
     engine->attq = lsquic_attq_create();
+#if LSQUIC_CONN_FIFO
+    lsquic_cf_init(&engine->conns_tickable,
+                        offsetof(struct lsquic_conn, cn_next_tickable));
+    lsquic_cf_init(&engine->conns_out,
+                        offsetof(struct lsquic_conn, cn_next_has_out));
+#endif
     eng_hist_init(&engine->history);
     engine->batch_size = INITIAL_OUT_BATCH_SIZE;
     if (engine->pub.enp_settings.es_honor_prst)
@@ -619,6 +718,38 @@ lsquic_engine_new (unsigned flags,
         }
     }
 
+    if ((flags & ENG_SERVER) && engine->pub.enp_settings.es_ssl_pool)
+    {
+        engine->pub.enp_ssl_pool = lsquic_sslp_new(
+                                    engine->pub.enp_settings.es_ssl_pool);
+        if (!engine->pub.enp_ssl_pool)
+        {
+            lsquic_engine_destroy(engine);
+            return NULL;
+        }
+    }
+
+    if (engine->pub.enp_settings.es_versions & LSQUIC_IETF_VERSIONS)
+    {
+        engine->pub.enp_ikey_cache = lsquic_ikc_new(IKEY_CACHE_SIZE);
+        if (!engine->pub.enp_ikey_cache)
+        {
+            lsquic_engine_destroy(engine);
+            return NULL;
+        }
+    }
+
+    if (engine->pub.enp_settings.es_lat_hist)
+    {
+        engine->pub.enp_lat_hists = calloc(N_LSQLH,
+                                    sizeof(engine->pub.enp_lat_hists[0]));
+        if (!engine->pub.enp_lat_hists)
+        {
+            lsquic_engine_destroy(engine);
+            return NULL;
+        }
+    }
+
     if (alpn_len)
     {
         engine->pub.enp_alpn = malloc(alpn_len + 1);
@@ -682,6 +813,69 @@ lsquic_engine_new (unsigned flags,
 }
 
 
+lsquic_engine_t *
+lsquic_engine_new (unsigned flags,
+                   const struct lsquic_engine_api *api)
+{
+    lsquic_engine_t *engine;
+    struct numa_policy saved;
+    int cpu, node, placed;
+
+    if (api->ea_settings)
+    {
+        cpu = api->ea_settings->es_cpu;
+        node = api->ea_settings->es_numa_node;
+    }
+    else
+        cpu = node = -1;
+    if (node < 0)
+        node = lsquic_numa_cpu_node(cpu);
+
+    /* Engine data structures are allocated -- and touched for the first
+     * time -- while the engine is created.  Place them on the node.
+     */
+    placed = node >= 0 && 0 == lsquic_numa_prefer(node, &saved);
+    engine = engine_new(flags, api);
+    if (placed)
+        lsquic_numa_restore(&saved);
+
+    if (engine)
+    {
+        engine->cpu = cpu;
+        engine->numa_node = placed ? node : -1;
+        if (cpu >= 0 || placed)
+            LSQ_INFO("engine CPU: %d; NUMA node: %d", engine->cpu,
+                                                        engine->numa_node);
+    }
+    return engine;
+}
+
+
+int
+lsquic_engine_bind_thread (lsquic_engine_t *engine)
+{
+    int s;
+
+    if (engine->cpu < 0 && engine->numa_node < 0)
+        return -1;
+
+    s = 0;
+    if (engine->cpu >= 0 && 0 != lsquic_numa_bind_cpu(engine->cpu))
+    {
+        LSQ_WARN("cannot bind thread to CPU %d", engine->cpu);
+        s = -1;
+    }
+    if (engine->numa_node >= 0
+                        && 0 != lsquic_numa_prefer(engine->numa_node, NULL))
+    {
+        LSQ_WARN("cannot set preferred NUMA node to %d", engine->numa_node);
+        s = -1;
+    }
+
+    return s;
+}
+
+
 #if LOG_PACKET_CHECKSUM
 static void
 log_packet_checksum (const lsquic_cid_t *cid, const char *direction,
@@ -819,6 +1013,8 @@ destroy_conn (struct lsquic_engine *engine, struct lsquic_conn *conn,
 #if LSQUIC_CONN_STATS
     update_stats_sum(engine, conn);
 #endif
+    if (conn->cn_flags & LSCONN_POOLED)
+        lsquic_cpool_remove(engine->conn_pool, conn);
     --engine->n_conns;
     conn->cn_flags |= LSCONN_NEVER_TICKABLE;
     conn->cn_if->ci_destroy(conn);
@@ -828,6 +1024,9 @@ destroy_conn (struct lsquic_engine *engine, struct lsquic_conn *conn,
 static int
 maybe_grow_conn_heaps (struct lsquic_engine *engine)
 {
+#if LSQUIC_CONN_FIFO
+    return 0;   /* FIFOs are intrusive: nothing to allocate */
+#else
     struct min_heap_elem *els;
     unsigned count;
 
@@ -857,11 +1056,22 @@ maybe_grow_conn_heaps (struct lsquic_engine *engine)
     engine->conns_tickable.mh_nalloc = count / 2;
     engine->conns_out.mh_nalloc = count / 2;
     return 0;
+#endif
+}
+
+
+static void
+erase_from_conns_hash (struct lsquic_engine *engine,
+                                                struct lsquic_hash_elem *el)
+{
+    if (engine->last_conn_el == el)
+        engine->last_conn_el = NULL;
+    lsquic_hash_erase(engine->conns_hash, el);
 }
 
 
 static void
-remove_cces_from_hash (struct lsquic_hash *hash, struct lsquic_conn *conn,
+remove_cces_from_hash (struct lsquic_engine *engine, struct lsquic_conn *conn,
                                                                 unsigned todo)
 {
     unsigned n;
@@ -869,14 +1079,15 @@ remove_cces_from_hash (struct lsquic_hash *hash, struct lsquic_conn *conn,
     for (n = 0; todo; todo &= ~(1 << n++))
         if ((todo & (1 << n)) &&
                         (conn->cn_cces[n].cce_hash_el.qhe_flags & QHE_HASHED))
-            lsquic_hash_erase(hash, &conn->cn_cces[n].cce_hash_el);
+            erase_from_conns_hash(engine, &conn->cn_cces[n].cce_hash_el);
 }
 
 
 static void
-remove_all_cces_from_hash (struct lsquic_hash *hash, struct lsquic_conn *conn)
+remove_all_cces_from_hash (struct lsquic_engine *engine,
+                                                    struct lsquic_conn *conn)
 {
-    remove_cces_from_hash(hash, conn, conn->cn_cces_mask);
+    remove_cces_from_hash(engine, conn, conn->cn_cces_mask);
 }
 
 
@@ -911,7 +1122,7 @@ insert_conn_into_hash (struct lsquic_engine *engine, struct lsquic_conn *conn,
     return 0;
 
   err:
-    remove_cces_from_hash(engine->conns_hash, conn, done);
+    remove_cces_from_hash(engine, conn, done);
     return -1;
 }
 
@@ -1044,6 +1255,24 @@ find_conn_by_addr (struct lsquic_hash *hash, const struct sockaddr *sa)
 }
 
 
+static struct lsquic_hash_elem *
+find_conn_by_cid (struct lsquic_engine *engine, const lsquic_cid_t *cid)
+{
+    struct lsquic_hash_elem *el;
+
+    if (engine->last_conn_el && LSQUIC_CIDS_EQ(&engine->last_conn_cid, cid))
+        return engine->last_conn_el;
+
+    el = lsquic_hash_find_std(engine->conns_hash, cid->idbuf, cid->len);
+    if (el)
+    {
+        engine->last_conn_el = el;
+        engine->last_conn_cid = *cid;
+    }
+    return el;
+}
+
+
 static lsquic_conn_t *
 find_conn (lsquic_engine_t *engine, lsquic_packet_in_t *packet_in,
          struct packin_parse_state *ppstate, const struct sockaddr *sa_local)
@@ -1054,8 +1283,7 @@ find_conn (lsquic_engine_t *engine, lsquic_packet_in_t *packet_in,
     if (engine->flags & ENG_CONNS_BY_ADDR)
         el = find_conn_by_addr(engine->conns_hash, sa_local);
     else if (packet_in->pi_flags & PI_CONN_ID)
-        el = lsquic_hash_find(engine->conns_hash,
-                    packet_in->pi_conn_id.idbuf, packet_in->pi_conn_id.len);
+        el = find_conn_by_cid(engine, &packet_in->pi_conn_id);
     else
     {
         LSQ_DEBUG("packet header does not have connection ID: discarding");
@@ -1094,8 +1322,7 @@ find_or_create_conn (lsquic_engine_t *engine, lsquic_packet_in_t *packet_in,
         LSQ_DEBUG("packet header does not have connection ID: discarding");
         return NULL;
     }
-    el = lsquic_hash_find(engine->conns_hash,
-                    packet_in->pi_conn_id.idbuf, packet_in->pi_conn_id.len);
+    el = find_conn_by_cid(engine, &packet_in->pi_conn_id);
 
     if (el)
     {
@@ -1246,12 +1473,95 @@ lsquic_engine_add_conn_to_tickable (struct lsquic_engine_public *enpub,
         0 == (conn->cn_flags & (LSCONN_TICKABLE|LSCONN_NEVER_TICKABLE)))
     {
         lsquic_engine_t *engine = (lsquic_engine_t *) enpub;
-        lsquic_mh_insert(&engine->conns_tickable, conn, conn->cn_last_ticked);
+        connq_insert(&engine->conns_tickable, conn, conn->cn_last_ticked);
         engine_incref_conn(conn, LSCONN_TICKABLE);
     }
 }
 
 
+int
+lsquic_engine_batch_stream (struct lsquic_engine_public *enpub,
+                                                struct lsquic_stream *stream)
+{
+    lsquic_engine_t *const engine = (lsquic_engine_t *) enpub;
+    struct lsquic_stream **new_arr;
+    unsigned new_sz;
+
+    assert(!(stream->sm_qflags & SMQF_BATCHED));
+
+    if (engine->n_batch_streams >= engine->batch_arr_sz)
+    {
+        new_sz = engine->batch_arr_sz ? engine->batch_arr_sz * 2 : 32;
+        new_arr = realloc(engine->batch_arr, sizeof(new_arr[0]) * new_sz);
+        if (!new_arr)
+            return -1;
+        engine->batch_arr = new_arr;
+        engine->batch_arr_sz = new_sz;
+    }
+
+    TAILQ_INSERT_TAIL(&engine->batch_streams, stream, next_batch_stream);
+    stream->sm_qflags |= SMQF_BATCHED;
+    ++engine->n_batch_streams;
+    return 0;
+}
+
+
+void
+lsquic_engine_unbatch_stream (struct lsquic_engine_public *enpub,
+                                                struct lsquic_stream *stream)
+{
+    lsquic_engine_t *const engine = (lsquic_engine_t *) enpub;
+
+    assert(stream->sm_qflags & SMQF_BATCHED);
+    assert(engine->n_batch_streams > 0);
+    TAILQ_REMOVE(&engine->batch_streams, stream, next_batch_stream);
+    stream->sm_qflags &= ~SMQF_BATCHED;
+    --engine->n_batch_streams;
+}
+
+
+/* Streams are dispatched after all connections have been ticked, which
+ * makes it no different from the user calling stream functions from outside
+ * of the callbacks.  ENPUB_PROC is dropped for the duration of the dispatch
+ * so that the stream code puts connections onto the Tickable Queue when
+ * there is new work for them.
+ */
+static void
+dispatch_batched_streams (struct lsquic_engine *engine)
+{
+    const struct lsquic_stream_if *const stream_if = engine->pub.enp_stream_if;
+    struct lsquic_stream *stream;
+    unsigned n, i;
+
+    n = 0;
+    while ((stream = TAILQ_FIRST(&engine->batch_streams)))
+    {
+        lsquic_engine_unbatch_stream(&engine->pub, stream);
+        if (!(lsquic_stream_conn(stream)->cn_flags & LSCONN_CLOSING)
+                && (stream->sm_qflags & (SMQF_WANT_READ|SMQF_WRITE_Q_FLAGS)))
+            engine->batch_arr[n++] = stream;
+    }
+
+    if (n == 0)
+        return;
+
+    LSQ_DEBUG("dispatch events for %u batched streams", n);
+    engine->pub.enp_flags &= ~ENPUB_PROC;
+    if (stream_if->on_batch)
+        stream_if->on_batch(engine->pub.enp_stream_if_ctx, engine->batch_arr, n);
+    else
+        for (i = 0; i < n; ++i)
+        {
+            stream = engine->batch_arr[i];
+            if (stream->sm_qflags & SMQF_WANT_READ)
+                lsquic_stream_dispatch_read_events(stream);
+            if (stream->sm_qflags & SMQF_WRITE_Q_FLAGS)
+                lsquic_stream_dispatch_write_events(stream);
+        }
+    engine->pub.enp_flags |= ENPUB_PROC;
+}
+
+
 void
 lsquic_engine_add_conn_to_attq (struct lsquic_engine_public *enpub,
                     lsquic_conn_t *conn, lsquic_time_t tick_time, unsigned why)
@@ -1266,7 +1576,8 @@ lsquic_engine_add_conn_to_attq (struct lsquic_engine_public *enpub,
     }
     else if (conn->cn_flags & LSCONN_ATTQ)
     {
-        if (lsquic_conn_adv_time(conn) != tick_time)
+        if (lsquic_conn_adv_time(conn)
+                                != lsquic_attq_adv_time(tick_time, why))
         {
             lsquic_attq_remove(engine->attq, conn);
             if (0 != lsquic_attq_add(engine->attq, conn, tick_time, why))
@@ -1300,6 +1611,52 @@ find_conn_by_srst (struct lsquic_engine *engine,
 }
 
 
+static void
+deliver_packet_in (lsquic_engine_t *engine, lsquic_conn_t *conn,
+        lsquic_packet_in_t *packet_in, const struct sockaddr *sa_local,
+        const struct sockaddr *sa_peer, void *peer_ctx)
+{
+    const unsigned char *packet_in_data;
+    size_t packet_in_size;
+
+    if (0 == (conn->cn_flags & LSCONN_TICKABLE))
+    {
+        connq_insert(&engine->conns_tickable, conn, conn->cn_last_ticked);
+        engine_incref_conn(conn, LSCONN_TICKABLE);
+    }
+    packet_in->pi_path_id = lsquic_conn_record_sockaddr(conn, peer_ctx,
+                                                        sa_local, sa_peer);
+    lsquic_packet_in_upref(packet_in);
+#if LOG_PACKET_CHECKSUM
+    log_packet_checksum(lsquic_conn_log_cid(conn), "in", packet_in->pi_data,
+                                                    packet_in->pi_data_sz);
+#endif
+    /* Note on QLog:
+     * For the PACKET_RX QLog event, we are interested in logging these things:
+     *  - raw packet (however it comes in, encrypted or not)
+     *  - frames (list of frame names)
+     *  - packet type and number
+     *  - packet rx timestamp
+     *
+     * Since only some of these items are available at this code
+     * juncture, we will wait until after the packet has been
+     * decrypted (if necessary) and parsed to call the log functions.
+     *
+     * Once the PACKET_RX event is finally logged, the timestamp
+     * will come from packet_in->pi_received. For correct sequential
+     * ordering of QLog events, be sure to process the QLogs downstream.
+     * (Hint: Use the qlog_parser.py tool in tools/ for full QLog processing.)
+     */
+    packet_in_data = packet_in->pi_data;
+    packet_in_size = packet_in->pi_data_sz;
+    if (engine->pub.enp_lat_hists && !conn->cn_oldest_recv)
+        conn->cn_oldest_recv = packet_in->pi_received;
+    conn->cn_if->ci_packet_in(conn, packet_in);
+    QLOG_PACKET_RX(lsquic_conn_log_cid(conn), packet_in, packet_in_data, packet_in_size);
+    lsquic_packet_in_put(&engine->pub.enp_mm, packet_in);
+}
+
+
 /* Return 0 if packet is being processed by a real connection (mini or full),
  * otherwise return 1.
  */
@@ -1309,7 +1666,6 @@ process_packet_in (lsquic_engine_t *engine, lsquic_packet_in_t *packet_in,
        const struct sockaddr *sa_peer, void *peer_ctx, size_t packet_in_size)
 {
     lsquic_conn_t *conn;
-    const unsigned char *packet_in_data;
 
     if (lsquic_packet_in_is_gquic_prst(packet_in)
                                 && !engine->pub.enp_settings.es_honor_prst)
@@ -1339,7 +1695,7 @@ process_packet_in (lsquic_engine_t *engine, lsquic_packet_in_t *packet_in,
             if (!(conn->cn_flags & LSCONN_TICKABLE)
                 && conn->cn_if->ci_is_tickable(conn))
             {
-                lsquic_mh_insert(&engine->conns_tickable, conn,
+                connq_insert(&engine->conns_tickable, conn,
                                                         conn->cn_last_ticked);
                 engine_incref_conn(conn, LSCONN_TICKABLE);
             }
@@ -1352,43 +1708,56 @@ process_packet_in (lsquic_engine_t *engine, lsquic_packet_in_t *packet_in,
         return 1;
     }
 
-    if (0 == (conn->cn_flags & LSCONN_TICKABLE))
-    {
-        lsquic_mh_insert(&engine->conns_tickable, conn, conn->cn_last_ticked);
-        engine_incref_conn(conn, LSCONN_TICKABLE);
-    }
-    packet_in->pi_path_id = lsquic_conn_record_sockaddr(conn, peer_ctx,
-                                                        sa_local, sa_peer);
-    lsquic_packet_in_upref(packet_in);
-#if LOG_PACKET_CHECKSUM
-    log_packet_checksum(lsquic_conn_log_cid(conn), "in", packet_in->pi_data,
-                                                    packet_in->pi_data_sz);
-#endif
-    /* Note on QLog:
-     * For the PACKET_RX QLog event, we are interested in logging these things:
-     *  - raw packet (however it comes in, encrypted or not)
-     *  - frames (list of frame names)
-     *  - packet type and number
-     *  - packet rx timestamp
-     *
-     * Since only some of these items are available at this code
-     * juncture, we will wait until after the packet has been
-     * decrypted (if necessary) and parsed to call the log functions.
-     *
-     * Once the PACKET_RX event is finally logged, the timestamp
-     * will come from packet_in->pi_received. For correct sequential
-     * ordering of QLog events, be sure to process the QLogs downstream.
-     * (Hint: Use the qlog_parser.py tool in tools/ for full QLog processing.)
-     */
-    packet_in_data = packet_in->pi_data;
-    packet_in_size = packet_in->pi_data_sz;
-    conn->cn_if->ci_packet_in(conn, packet_in);
-    QLOG_PACKET_RX(lsquic_conn_log_cid(conn), packet_in, packet_in_data, packet_in_size);
-    lsquic_packet_in_put(&engine->pub.enp_mm, packet_in);
+    deliver_packet_in(engine, conn, packet_in, sa_local, sa_peer, peer_ctx);
     return 0;
 }
 
 
+/* Fast path for the most common case: IETF short header packet destined
+ * for an existing connection.  The header is parsed and the connection is
+ * looked up without going through function pointers.
+ *
+ * Returns 0 if the packet has been processed and -1 if it should go through
+ * the general path.
+ */
+static int
+short_packet_in_fast (struct lsquic_engine *engine,
+    const unsigned char *packet_in_data, size_t packet_in_size,
+    const struct sockaddr *sa_local, const struct sockaddr *sa_peer,
+    void *peer_ctx, int ecn)
+{
+    const unsigned cid_len = engine->pub.enp_settings.es_scid_len;
+    struct lsquic_hash_elem *el;
+    struct lsquic_packet_in *packet_in;
+    lsquic_conn_t *conn;
+
+    packet_in = lsquic_mm_get_packet_in(&engine->pub.enp_mm);
+    if (!packet_in)
+        return -1;
+
+    /* See comment in lsquic_engine_packet_in() */
+    packet_in->pi_data = (unsigned char *) packet_in_data;
+    lsquic_ietf_v1_parse_packet_in_short_fast(packet_in, packet_in_size,
+                                                                    cid_len);
+    el = find_conn_by_cid(engine, &packet_in->pi_dcid);
+    if (!el)
+        goto general;
+    conn = lsquic_hashelem_getdata(el);
+    if (!((1 << conn->cn_version) & LSQUIC_IETF_VERSIONS))
+        goto general;
+
+    packet_in->pi_received = lsquic_time_now();
+    packet_in->pi_flags |= (3 & ecn) << PIBIT_ECN_SHIFT;
+    eng_hist_inc(&engine->history, packet_in->pi_received, sl_packets_in);
+    deliver_packet_in(engine, conn, packet_in, sa_local, sa_peer, peer_ctx);
+    return 0;
+
+  general:
+    lsquic_mm_put_packet_in(&engine->pub.enp_mm, packet_in);
+    return -1;
+}
+
+
 void
 lsquic_engine_destroy (lsquic_engine_t *engine)
 {
@@ -1400,13 +1769,13 @@ lsquic_engine_destroy (lsquic_engine_t *engine)
     engine->flags |= ENG_DTOR;
 #endif
 
-    while ((conn = lsquic_mh_pop(&engine->conns_out)))
+    while ((conn = connq_pop(&engine->conns_out)))
     {
         assert(conn->cn_flags & LSCONN_HAS_OUTGOING);
         (void) engine_decref_conn(engine, conn, LSCONN_HAS_OUTGOING);
     }
 
-    while ((conn = lsquic_mh_pop(&engine->conns_tickable)))
+    while ((conn = connq_pop(&engine->conns_tickable)))
     {
         assert(conn->cn_flags & LSCONN_TICKABLE);
         (void) engine_decref_conn(engine, conn, LSCONN_TICKABLE);
@@ -1428,12 +1797,16 @@ lsquic_engine_destroy (lsquic_engine_t *engine)
         lsquic_purga_destroy(engine->purga);
     lsquic_attq_destroy(engine->attq);
 
-    assert(0 == lsquic_mh_count(&engine->conns_out));
-    assert(0 == lsquic_mh_count(&engine->conns_tickable));
+    assert(0 == connq_count(&engine->conns_out));
+    assert(0 == connq_count(&engine->conns_tickable));
+    assert(TAILQ_EMPTY(&engine->batch_streams));
+    free(engine->batch_arr);
     if (engine->pub.enp_shi == &stock_shi)
         lsquic_stock_shared_hash_destroy(engine->pub.enp_shi_ctx);
     lsquic_mm_cleanup(&engine->pub.enp_mm);
+#if !LSQUIC_CONN_FIFO
     free(engine->conns_tickable.mh_elems);
+#endif
 #ifndef NDEBUG
     if (engine->flags & ENG_LOSE_PACKETS)
         regfree(&engine->lose_packets_re);
@@ -1487,7 +1860,15 @@ lsquic_engine_destroy (lsquic_engine_t *engine)
 #endif
     if (engine->pub.enp_retry_aead_ctx)
         EVP_AEAD_CTX_cleanup(engine->pub.enp_retry_aead_ctx);
+    /* Connections have been destroyed: their SSL objects are in the pool */
+    if (engine->pub.enp_ssl_pool)
+        lsquic_sslp_destroy(engine->pub.enp_ssl_pool);
+    if (engine->pub.enp_ikey_cache)
+        lsquic_ikc_destroy(engine->pub.enp_ikey_cache);
+    if (engine->conn_pool)
+        lsquic_cpool_destroy(engine->conn_pool);
     free(engine->pub.enp_alpn);
+    free(engine->pub.enp_lat_hists);
     free(engine);
 }
 
@@ -1615,7 +1996,7 @@ lsquic_engine_connect (lsquic_engine_t *engine, enum lsquic_version version,
                                  callbacks */
                              )));
     conn->cn_flags |= LSCONN_HASHED;
-    lsquic_mh_insert(&engine->conns_tickable, conn, conn->cn_last_ticked);
+    connq_insert(&engine->conns_tickable, conn, conn->cn_last_ticked);
     engine_incref_conn(conn, LSCONN_TICKABLE);
     lsquic_conn_set_ctx(conn, conn_ctx);
     conn->cn_if->ci_client_call_on_new(conn);
@@ -1628,10 +2009,79 @@ lsquic_engine_connect (lsquic_engine_t *engine, enum lsquic_version version,
 }
 
 
+static struct lsquic_conn *
+pool_connect (void *ctx, const struct lsquic_pool_dest *dest)
+{
+    struct lsquic_engine *const engine = ctx;
+
+    /* Called from a callback: stream goes onto an existing connection */
+    if (engine->pub.enp_flags & ENPUB_PROC)
+    {
+        LSQ_DEBUG("cannot open pooled connection from a callback");
+        return NULL;
+    }
+
+    return lsquic_engine_connect(engine, dest->version, dest->local_sa,
+                dest->peer_sa, dest->peer_ctx, NULL, dest->hostname,
+                dest->max_packet_size, NULL, 0, NULL, 0);
+}
+
+
+static struct conn_pool *
+get_conn_pool (struct lsquic_engine *engine)
+{
+    if (engine->flags & ENG_SERVER)
+    {
+        LSQ_ERROR("connection pool must only be used in client mode");
+        return NULL;
+    }
+
+    if (!engine->conn_pool)
+    {
+        engine->conn_pool = lsquic_cpool_new(
+                    engine->pub.enp_settings.es_pool_max_conns,
+                    engine->pub.enp_settings.es_init_max_streams_bidi,
+                    pool_connect, engine);
+        if (!engine->conn_pool)
+            LSQ_WARN("cannot create connection pool");
+    }
+
+    return engine->conn_pool;
+}
+
+
+lsquic_conn_t *
+lsquic_engine_pool_make_stream (lsquic_engine_t *engine,
+                                        const struct lsquic_pool_dest *dest)
+{
+    struct conn_pool *pool;
+
+    pool = get_conn_pool(engine);
+    if (pool)
+        return lsquic_cpool_make_stream(pool, dest);
+    else
+        return NULL;
+}
+
+
+int
+lsquic_engine_pool_prewarm (lsquic_engine_t *engine,
+                    const struct lsquic_pool_dest *dest, unsigned n_conns)
+{
+    struct conn_pool *pool;
+
+    pool = get_conn_pool(engine);
+    if (pool)
+        return lsquic_cpool_prewarm(pool, dest, n_conns);
+    else
+        return -1;
+}
+
+
 static void
 remove_conn_from_hash (lsquic_engine_t *engine, lsquic_conn_t *conn)
 {
-    remove_all_cces_from_hash(engine->conns_hash, conn);
+    remove_all_cces_from_hash(engine, conn);
     (void) engine_decref_conn(engine, conn, LSCONN_HASHED);
 }
 
@@ -1727,14 +2177,14 @@ conn_iter_next_tickable (struct lsquic_engine *engine)
     if (engine->flags & ENG_SERVER)
         while (1)
         {
-            conn = lsquic_mh_pop(&engine->conns_tickable);
+            conn = connq_pop(&engine->conns_tickable);
             if (conn && (conn->cn_flags & LSCONN_SKIP_ON_PROC))
                 (void) engine_decref_conn(engine, conn, LSCONN_TICKABLE);
             else
                 break;
         }
     else
-        conn = lsquic_mh_pop(&engine->conns_tickable);
+        conn = connq_pop(&engine->conns_tickable);
 
     if (conn)
         conn = engine_decref_conn(engine, conn, LSCONN_TICKABLE);
@@ -1835,12 +2285,14 @@ lsquic_engine_process_conns (lsquic_engine_t *engine)
         conn = engine_decref_conn(engine, conn, LSCONN_ATTQ);
         if (conn && !(conn->cn_flags & LSCONN_TICKABLE))
         {
-            lsquic_mh_insert(&engine->conns_tickable, conn, conn->cn_last_ticked);
+            connq_insert(&engine->conns_tickable, conn, conn->cn_last_ticked);
             engine_incref_conn(conn, LSCONN_TICKABLE);
         }
     }
 
     process_connections(engine, conn_iter_next_tickable, now);
+    LAT_HIST_RECORD(&engine->pub, LSQLH_PROCESS_CONNS,
+                                                lsquic_time_now() - now);
     ENGINE_OUT(engine);
 }
 
@@ -1923,7 +2375,7 @@ TAILQ_HEAD(conns_tailq, lsquic_conn);
 
 struct conns_out_iter
 {
-    struct min_heap            *coi_heap;
+    conn_queue_t               *coi_heap;
     struct pr_queue            *coi_prq;
     TAILQ_HEAD(, lsquic_conn)   coi_active_list,
                                 coi_inactive_list;
@@ -1953,12 +2405,12 @@ coi_next (struct conns_out_iter *iter)
 {
     lsquic_conn_t *conn;
 
-    if (lsquic_mh_count(iter->coi_heap) > 0)
+    if (connq_count(iter->coi_heap) > 0)
     {
-        conn = lsquic_mh_pop(iter->coi_heap);
+        conn = connq_pop(iter->coi_heap);
         TAILQ_INSERT_TAIL(&iter->coi_active_list, conn, cn_next_out);
         conn->cn_flags |= LSCONN_COI_ACTIVE;
-#ifndef NDEBUG
+#if !defined(NDEBUG) && !LSQUIC_CONN_FIFO
         if (iter->coi_last_sent)
             assert(iter->coi_last_sent <= conn->cn_last_sent);
         iter->coi_last_sent = conn->cn_last_sent;
@@ -2019,7 +2471,7 @@ coi_reheap (struct conns_out_iter *iter, lsquic_engine_t *engine)
         conn->cn_flags &= ~LSCONN_COI_ACTIVE;
         if ((conn->cn_flags & CONN_REF_FLAGS) != LSCONN_HAS_OUTGOING
                                 && !(conn->cn_flags & LSCONN_IMMED_CLOSE))
-            lsquic_mh_insert(iter->coi_heap, conn, conn->cn_last_sent);
+            connq_insert(iter->coi_heap, conn, conn->cn_last_sent);
         else    /* Closed connection gets one shot at sending packets */
             (void) engine_decref_conn(engine, conn, LSCONN_HAS_OUTGOING);
     }
@@ -2145,7 +2597,15 @@ send_batch (lsquic_engine_t *engine, const struct send_batch_ctx *sb_ctx,
         packet_out = &batch->packets[off];
         end = packet_out + count;
         do
+        {
             (*packet_out)->po_sent = now;
+            if ((*packet_out)->po_scheduled)
+            {
+                LAT_HIST_RECORD(&engine->pub, LSQLH_SCHED_TO_SEND,
+                                        now - (*packet_out)->po_scheduled);
+                (*packet_out)->po_scheduled = 0;
+            }
+        }
         while (++packet_out < end);
     }
     n_sent = engine->packets_out(engine->packets_out_ctx, batch->outs,
@@ -2431,7 +2891,7 @@ send_packets_out (struct lsquic_engine *engine,
 int
 lsquic_engine_has_unsent_packets (lsquic_engine_t *engine)
 {
-    return lsquic_mh_count(&engine->conns_out) > 0
+    return connq_count(&engine->conns_out) > 0
              || (engine->pr_queue && lsquic_prq_have_pending(engine->pr_queue))
     ;
 }
@@ -2490,6 +2950,28 @@ next_new_full_conn (struct conns_stailq *new_full_conns)
 }
 
 
+/* Tick connection and record receive-to-tick latency and tick duration */
+static enum tick_st
+tick_conn_lat_hist (struct lsquic_engine *engine, struct lsquic_conn *conn,
+                                                            lsquic_time_t now)
+{
+    lsquic_time_t start;
+    enum tick_st tick_st;
+
+    start = lsquic_time_now();
+    if (conn->cn_oldest_recv)
+    {
+        lsquic_lat_hist_record(&engine->pub.enp_lat_hists[LSQLH_RECV_TO_TICK],
+            start > conn->cn_oldest_recv ? start - conn->cn_oldest_recv : 0);
+        conn->cn_oldest_recv = 0;
+    }
+    tick_st = conn->cn_if->ci_tick(conn, now);
+    lsquic_lat_hist_record(&engine->pub.enp_lat_hists[LSQLH_TICK],
+                                                lsquic_time_now() - start);
+    return tick_st;
+}
+
+
 static void
 process_connections (lsquic_engine_t *engine, conn_iter_f next_conn,
                      lsquic_time_t now)
@@ -2525,7 +3007,10 @@ process_connections (lsquic_engine_t *engine, conn_iter_f next_conn,
     while ((conn = next_conn(engine))
                             || (conn = next_new_full_conn(&new_full_conns)))
     {
-        tick_st = conn->cn_if->ci_tick(conn, now);
+        if (engine->pub.enp_lat_hists)
+            tick_st = tick_conn_lat_hist(engine, conn, now);
+        else
+            tick_st = conn->cn_if->ci_tick(conn, now);
         conn->cn_last_ticked = now + i /* Maintain relative order */ ++;
         if (tick_st & TICK_PROMOTE)
         {
@@ -2547,7 +3032,7 @@ process_connections (lsquic_engine_t *engine, conn_iter_f next_conn,
         {
             if (!(conn->cn_flags & LSCONN_HAS_OUTGOING))
             {
-                lsquic_mh_insert(&engine->conns_out, conn, conn->cn_last_sent);
+                connq_insert(&engine->conns_out, conn, conn->cn_last_sent);
                 engine_incref_conn(conn, LSCONN_HAS_OUTGOING);
             }
         }
@@ -2568,6 +3053,9 @@ process_connections (lsquic_engine_t *engine, conn_iter_f next_conn,
         }
     }
 
+    if (engine->n_batch_streams)
+        dispatch_batched_streams(engine);
+
     if ((engine->pub.enp_flags & ENPUB_CAN_SEND)
                         && lsquic_engine_has_unsent_packets(engine))
         send_packets_out(engine, &ticked_conns, &closed_conns);
@@ -2587,7 +3075,7 @@ process_connections (lsquic_engine_t *engine, conn_iter_f next_conn,
             && conn->cn_if->ci_is_tickable(conn))
         {
             /* Floyd heapification is not faster, don't bother. */
-            lsquic_mh_insert(&engine->conns_tickable, conn, conn->cn_last_ticked);
+            connq_insert(&engine->conns_tickable, conn, conn->cn_last_ticked);
             engine_incref_conn(conn, LSCONN_TICKABLE);
         }
         else if (!(conn->cn_flags & LSCONN_ATTQ))
@@ -2614,6 +3102,133 @@ process_connections (lsquic_engine_t *engine, conn_iter_f next_conn,
 }
 
 
+/* Stateless checks performed on an incoming server datagram before any
+ * packet_in is allocated.  This keeps the cost of Initial floods and of
+ * junk addressed to the server low.  Only the first packet in the datagram
+ * is looked at; coalesced packets are parsed as usual.  The checks must
+ * not reject anything the parsers would accept for a supported version:
+ * gQUIC long headers are left to the regular parsers.
+ *
+ * Returns true if the datagram should be dropped.
+ */
+static int
+server_drop_early (struct lsquic_engine *engine,
+                            const unsigned char *data, size_t size)
+{
+    lsquic_ver_tag_t ver_tag;
+    enum lsquic_version version;
+
+    if (!(size > 0 && (data[0] & 0x80)))
+        return 0;                       /* Short header or gQUIC */
+
+    /* Flags, version, and DCIL */
+    if (size < 6)
+    {
+        ++engine->drop_stats.ds_short;
+        return 1;
+    }
+
+    memcpy(&ver_tag, data + 1, sizeof(ver_tag));
+    if (ver_tag == 0)
+    {
+        ++engine->drop_stats.ds_verneg;
+        return 1;
+    }
+
+    if (data[1] == 'Q')
+        return 0;                       /* Q046 and Q050 long headers */
+
+    version = lsquic_tag2ver(ver_tag);
+    if (!(version < N_LSQVER
+                && (engine->pub.enp_settings.es_versions & (1 << version))))
+    {
+        if (size >= IQUIC_MIN_INIT_PACKET_SZ)
+            return 0;                   /* Version Negotiation */
+        /* [draft-ietf-quic-transport-27] Section 6.1: servers should drop
+         * small packets that specify unsupported versions.
+         */
+        ++engine->drop_stats.ds_small_unsup;
+        return 1;
+    }
+
+    /* [draft-ietf-quic-transport-27] Section 17.2: the limit applies to
+     * this version only.  Other versions may use longer connection IDs.
+     */
+    if (data[5] > MAX_CID_LEN)
+    {
+        ++engine->drop_stats.ds_cid_len;
+        return 1;
+    }
+
+    if (size >= IQUIC_MIN_INIT_PACKET_SZ)
+        return 0;
+
+    if ((data[0] & 0x30) == 0)
+    {
+        /* [draft-ietf-quic-transport-27] Section 14: clients must pad
+         * datagrams carrying Initial packets.
+         */
+        ++engine->drop_stats.ds_small_initial;
+        return 1;
+    }
+
+    return 0;
+}
+
+
+void
+lsquic_engine_get_drop_stats (const lsquic_engine_t *engine,
+                                    struct lsquic_engine_drop_stats *stats)
+{
+    *stats = engine->drop_stats;
+}
+
+
+int
+lsquic_engine_get_lat_hist (const lsquic_engine_t *engine,
+                    enum lsquic_lat_hist_type type, struct lsquic_lat_hist *hist)
+{
+    if (engine->pub.enp_lat_hists && (unsigned) type < N_LSQLH)
+    {
+        *hist = engine->pub.enp_lat_hists[type];
+        return 0;
+    }
+    else
+        return -1;
+}
+
+
+void
+lsquic_engine_reset_lat_hists (lsquic_engine_t *engine)
+{
+    if (engine->pub.enp_lat_hists)
+        memset(engine->pub.enp_lat_hists, 0,
+                        sizeof(engine->pub.enp_lat_hists[0]) * N_LSQLH);
+}
+
+
+void
+lsquic_engine_get_data_in_stats (const lsquic_engine_t *engine,
+                                    struct lsquic_engine_data_in_stats *stats)
+{
+    stats->dis_pinned      = engine->pub.enp_di_pinned;
+    stats->dis_used        = engine->pub.enp_di_used;
+    stats->dis_compactions = engine->pub.enp_di_compactions;
+}
+
+
+void
+lsquic_engine_get_mem_stats (const lsquic_engine_t *engine,
+                                    struct lsquic_engine_mem_stats *stats)
+{
+    stats->ems_mm               = lsquic_mm_mem_used(&engine->pub.enp_mm);
+    stats->ems_conns_hash       = lsquic_hash_mem_used(engine->conns_hash);
+    stats->ems_conns_hash_count = lsquic_hash_count(engine->conns_hash);
+    stats->ems_n_conns          = engine->n_conns;
+    stats->ems_n_mini_conns     = engine->mini_conns_count;
+}
+
+
 /* Return 0 if packet is being processed by a real connection, 1 if the
  * packet was processed, but not by a connection, and -1 on error.
  */
@@ -2633,6 +3248,14 @@ lsquic_engine_packet_in (lsquic_engine_t *engine,
 
     ENGINE_CALLS_INCR(engine);
 
+    /* Short header packet takes up the rest of the datagram */
+    if ((engine->flags & ENG_SHORT_FAST)
+            && packet_in_size > engine->pub.enp_settings.es_scid_len
+            && (packet_in_data[0] & 0xC0) == 0x40
+            && 0 == short_packet_in_fast(engine, packet_in_data,
+                            packet_in_size, sa_local, sa_peer, peer_ctx, ecn))
+        return 0;
+
     if (engine->flags & ENG_SERVER)
         parse_packet_in_begin = lsquic_parse_packet_in_server_begin;
     else if (engine->flags & ENG_CONNS_BY_ADDR)
@@ -2663,6 +3286,10 @@ lsquic_engine_packet_in (lsquic_engine_t *engine,
     else
         parse_packet_in_begin = lsquic_parse_packet_in_begin;
 
+    if ((engine->flags & ENG_SERVER)
+            && server_drop_early(engine, packet_in_data, packet_in_size))
+        return 1;
+
     n_zeroes = 0;
     do
     {
@@ -2732,6 +3359,70 @@ lsquic_engine_cooldown (lsquic_engine_t *engine)
 }
 
 
+unsigned
+lsquic_engine_close_all (lsquic_engine_t *engine, int is_app,
+                                    unsigned error_code, const char *reason)
+{
+    struct lsquic_hash_elem *el;
+    lsquic_conn_t *conn;
+    lsquic_time_t start, now;
+    unsigned n_conns, batch_size;
+
+    ENGINE_IN(engine);
+
+    start = lsquic_time_now();
+    if (!reason)
+        reason = "closing all connections";
+    engine->flags |= ENG_COOLDOWN;
+    LSQ_INFO("closing all connections, is_app: %d, error code: %u, "
+                                    "reason: %s", is_app, error_code, reason);
+    if (engine->flags & ENG_SERVER)
+        drop_all_mini_conns(engine);
+
+    /* A connection may be hashed under several CIDs: LSCONN_CLOSE_ALL
+     * makes sure it is aborted and counted only once.
+     */
+    n_conns = 0;
+    for (el = lsquic_hash_first(engine->conns_hash); el;
+                                el = lsquic_hash_next(engine->conns_hash))
+    {
+        conn = lsquic_hashelem_getdata(el);
+        if (conn->cn_flags & LSCONN_MINI)
+            continue;
+        if (!(conn->cn_flags & LSCONN_CLOSE_ALL))
+        {
+            conn->cn_flags |= LSCONN_CLOSE_ALL;
+            if (is_app || error_code)
+                conn->cn_if->ci_abort_error(conn, is_app, error_code, "%s",
+                                                                    reason);
+            else
+                /* Zero error code would be taken to mean internal error */
+                conn->cn_if->ci_abort(conn);
+            ++n_conns;
+        }
+        if (!(conn->cn_flags & (LSCONN_TICKABLE|LSCONN_NEVER_TICKABLE)))
+        {
+            connq_insert(&engine->conns_tickable, conn,
+                                                    conn->cn_last_ticked);
+            engine_incref_conn(conn, LSCONN_TICKABLE);
+        }
+    }
+
+    /* All connections are ticked in one go: use the largest batches */
+    batch_size = engine->batch_size;
+    engine->batch_size = MAX_OUT_BATCH_SIZE;
+    now = lsquic_time_now();
+    process_connections(engine, conn_iter_next_tickable, now);
+    engine->batch_size = batch_size;
+
+    LSQ_NOTICE("closed %u connection%s in %"PRIu64" usec; %u remain",
+        n_conns, n_conns == 1 ? "" : "s", lsquic_time_now() - start,
+        engine->n_conns);
+    ENGINE_OUT(engine);
+    return n_conns;
+}
+
+
 int
 lsquic_engine_earliest_adv_tick (lsquic_engine_t *engine, int *diff)
 {
@@ -2745,15 +3436,15 @@ lsquic_engine_earliest_adv_tick (lsquic_engine_t *engine, int *diff)
     ENGINE_CALLS_INCR(engine);
 
     if ((engine->flags & ENG_PAST_DEADLINE)
-                                    && lsquic_mh_count(&engine->conns_out))
+                                    && connq_count(&engine->conns_out))
     {
 #if LSQUIC_DEBUG_NEXT_ADV_TICK
-        conn = lsquic_mh_peek(&engine->conns_out);
+        conn = connq_peek(&engine->conns_out);
         engine->last_logged_conn = 0;
         LSQ_LOGC(L, "next advisory tick is now: went past deadline last time "
             "and have %u outgoing connection%.*s (%"CID_FMT" first)",
-            lsquic_mh_count(&engine->conns_out),
-            lsquic_mh_count(&engine->conns_out) != 1, "s",
+            connq_count(&engine->conns_out),
+            connq_count(&engine->conns_out) != 1, "s",
             CID_BITS(lsquic_conn_log_cid(conn)));
 #endif
         *diff = 0;
@@ -2770,15 +3461,15 @@ lsquic_engine_earliest_adv_tick (lsquic_engine_t *engine, int *diff)
         return 1;
     }
 
-    if (lsquic_mh_count(&engine->conns_tickable))
+    if (connq_count(&engine->conns_tickable))
     {
 #if LSQUIC_DEBUG_NEXT_ADV_TICK
-        conn = lsquic_mh_peek(&engine->conns_tickable);
+        conn = connq_peek(&engine->conns_tickable);
         engine->last_logged_conn = 0;
         LSQ_LOGC(L, "next advisory tick is now: have %u tickable "
             "connection%.*s (%"CID_FMT" first)",
-            lsquic_mh_count(&engine->conns_tickable),
-            lsquic_mh_count(&engine->conns_tickable) != 1, "s",
+            connq_count(&engine->conns_tickable),
+            connq_count(&engine->conns_tickable) != 1, "s",
             CID_BITS(lsquic_conn_log_cid(conn)));
 #endif
         *diff = 0;
@@ -2894,7 +3585,7 @@ lsquic_engine_retire_cid (struct lsquic_engine_public *enpub,
     assert(cce_idx < conn->cn_n_cces);
 
     if (cce->cce_hash_el.qhe_flags & QHE_HASHED)
-        lsquic_hash_erase(engine->conns_hash, &cce->cce_hash_el);
+        erase_from_conns_hash(engine, &cce->cce_hash_el);
 
     if (engine->purga)
     {
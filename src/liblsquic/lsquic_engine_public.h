@@ -15,9 +15,13 @@ struct lsquic_engine;
 struct stack_st_X509;
 struct lsquic_hash;
 struct lsquic_stream_if;
+struct lsquic_stream;
 struct ssl_ctx_st;
+struct sockaddr;
 struct crand;
 struct evp_aead_ctx_st;
+struct ssl_pool;
+struct ikey_cache;
 
 enum warning_type
 {
@@ -36,6 +40,11 @@ struct lsquic_engine_public {
     lsquic_lookup_cert_f            enp_lookup_cert;
     void                           *enp_cert_lu_ctx;
     struct ssl_ctx_st *           (*enp_get_ssl_ctx)(void *peer_ctx);
+    int                           (*enp_early_data_ok)(void *,
+                                            const struct sockaddr *,
+                                            const struct sockaddr *,
+                                            const char *);
+    void                           *enp_early_data_ctx;
     const struct lsquic_shared_hash_if
                                    *enp_shi;
     void                           *enp_shi_ctx;
@@ -66,6 +75,26 @@ struct lsquic_engine_public {
     struct crand                   *enp_crand;
     struct evp_aead_ctx_st         *enp_retry_aead_ctx;
     unsigned char                  *enp_alpn;   /* May be set if not HTTP */
+    /* Incoming packets referenced by no-copy stream data and the size of
+     * the unread stream data in them.  See lsquic_di_nocopy.c.
+     */
+    unsigned long long              enp_di_pinned;
+    unsigned long long              enp_di_used;
+    unsigned long                   enp_di_compactions;
+    /* Array of N_LSQLH histograms if es_lat_hist is set, NULL otherwise */
+    struct lsquic_lat_hist         *enp_lat_hists;
+    /* Server SSL objects kept for reuse; NULL if es_ssl_pool is zero */
+    struct ssl_pool                *enp_ssl_pool;
+    /* Initial keys derived for recently seen DCIDs */
+    struct ikey_cache              *enp_ikey_cache;
+    /* Server: encoded transport parameters that are the same for all
+     * connections, one for each encoding: ID-25 and later.  Generated on
+     * first use; see gen_trans_params().
+     */
+    struct {
+        unsigned short              len;    /* Zero if not generated yet */
+        unsigned char               buf[200];
+    }                               enp_tp_tmpls[2];
 };
 
 /* Put connection onto the Tickable Queue if it is not already on it.  If
@@ -75,6 +104,18 @@ void
 lsquic_engine_add_conn_to_tickable (struct lsquic_engine_public *,
                                                         lsquic_conn_t *);
 
+/* Put user stream onto the list of streams whose events are dispatched
+ * after all connections have been ticked.  See es_batch_dispatch.  Returns
+ * 0 on success and -1 if memory could not be allocated.
+ */
+int
+lsquic_engine_batch_stream (struct lsquic_engine_public *,
+                                                    struct lsquic_stream *);
+
+void
+lsquic_engine_unbatch_stream (struct lsquic_engine_public *,
+                                                    struct lsquic_stream *);
+
 /* Put connection onto Advisory Tick Time  Queue if it is not already on it.
  */
 void
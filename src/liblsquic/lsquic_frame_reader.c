@@ -109,6 +109,7 @@ struct lsquic_frame_reader
     struct lshpack_dec              *fr_hdec;
     struct lsquic_stream            *fr_stream;
     fr_stream_read_f                 fr_read;
+    fr_stream_readf_f                fr_readf;      /* May be NULL */
     const struct frame_reader_callbacks
                                     *fr_callbacks;
     void                            *fr_cb_ctx;
@@ -194,6 +195,7 @@ lsquic_frame_reader_new (enum frame_reader_flags flags,
     fr->fr_flags          = flags;
     fr->fr_stream         = stream;
     fr->fr_read           = read;
+    fr->fr_readf          = NULL;
     fr->fr_callbacks      = cb;
     fr->fr_cb_ctx         = frame_reader_cb_ctx;
     fr->fr_header_block   = NULL;
@@ -218,6 +220,14 @@ lsquic_frame_reader_new (enum frame_reader_flags flags,
 }
 
 
+void
+lsquic_frame_reader_set_readf (struct lsquic_frame_reader *fr,
+                                                    fr_stream_readf_f readf)
+{
+    fr->fr_readf = readf;
+}
+
+
 void
 lsquic_frame_reader_destroy (struct lsquic_frame_reader *fr)
 {
@@ -510,7 +520,8 @@ skip_headers_padding (struct lsquic_frame_reader *fr)
 
 
 static int
-decode_and_pass_payload (struct lsquic_frame_reader *fr)
+decode_and_pass_payload (struct lsquic_frame_reader *fr,
+                        const unsigned char *header_block, size_t block_sz)
 {
     struct headers_state *hs = &fr->fr_state.by_type.headers_state;
     const unsigned char *comp, *end;
@@ -530,8 +541,8 @@ decode_and_pass_payload (struct lsquic_frame_reader *fr)
         goto stream_error;
     }
 
-    comp = fr->fr_header_block;
-    end = comp + fr->fr_header_block_sz;
+    comp = header_block;
+    end = comp + block_sz;
 
     while (comp < end)
     {
@@ -616,7 +627,7 @@ decode_and_pass_payload (struct lsquic_frame_reader *fr)
     else
         fr->fr_callbacks->frc_on_push_promise(fr->fr_cb_ctx, uh);
 #if LSQUIC_CONN_STATS
-    fr->fr_conn_stats->in.headers_comp += fr->fr_header_block_sz;
+    fr->fr_conn_stats->in.headers_comp += block_sz;
 #endif
 
     return 0;
@@ -630,13 +641,87 @@ decode_and_pass_payload (struct lsquic_frame_reader *fr)
 }
 
 
+struct block_readf_ctx
+{
+    struct lsquic_frame_reader  *fr;
+    unsigned                     payload_length;
+    int                          done;      /* If set, return `rv' */
+    int                          rv;
+};
+
+
+/* Called with the first contiguous piece of the header block.  If it
+ * contains the whole block, decode it in place.  Otherwise, start
+ * buffering the block like read_headers_block_fragment() would.
+ */
+static size_t
+header_block_readf (void *ctx, const unsigned char *buf, size_t len, int fin)
+{
+    struct block_readf_ctx *const brc = ctx;
+    struct lsquic_frame_reader *const fr = brc->fr;
+
+    if (brc->done || len == 0)
+        return 0;
+
+    if (len >= brc->payload_length && !fr->fr_header_block)
+    {
+        LSQ_DEBUG("decode %u-byte header block in place", brc->payload_length);
+        brc->rv = decode_and_pass_payload(fr, buf, brc->payload_length);
+        brc->done = 1;
+        return brc->payload_length;
+    }
+
+    if (!fr->fr_header_block)
+    {
+        fr->fr_header_block_sz = brc->payload_length;
+        fr->fr_header_block = malloc(brc->payload_length);
+        if (!fr->fr_header_block)
+        {
+            brc->rv = -1;
+            brc->done = 1;
+            return 0;
+        }
+    }
+    if (len > brc->payload_length - fr->fr_state.by_type.headers_state.nread)
+        len = brc->payload_length - fr->fr_state.by_type.headers_state.nread;
+    memcpy(fr->fr_header_block + fr->fr_state.by_type.headers_state.nread,
+                                                                    buf, len);
+    fr->fr_state.by_type.headers_state.nread += len;
+    return len;
+}
+
+
 static int
 read_headers_block_fragment (struct lsquic_frame_reader *fr)
 {
     struct headers_state *hs = &fr->fr_state.by_type.headers_state;
+    struct block_readf_ctx brc;
     ssize_t nr;
     unsigned payload_length = fr->fr_state.payload_length - hs->pesw_size -
                                                                 hs->pad_length;
+    if (!fr->fr_header_block && fr->fr_readf && 0 == hs->nread
+                        && (fr->fr_state.header.hfh_flags & HFHF_END_HEADERS))
+    {
+        brc = (struct block_readf_ctx) {
+            .fr             = fr,
+            .payload_length = payload_length,
+        };
+        nr = fr->fr_readf(fr->fr_stream, header_block_readf, &brc);
+        if (brc.done)
+        {
+            if (0 == brc.rv)
+                hs->nread = payload_length;
+            return brc.rv;
+        }
+        if (nr <= 0)
+        {
+            free(fr->fr_header_block);
+            fr->fr_header_block = NULL;
+            RETURN_ERROR(nr);
+        }
+        goto check_done;
+    }
+
     if (!fr->fr_header_block)
     {
         fr->fr_header_block_sz = payload_length;
@@ -653,10 +738,12 @@ read_headers_block_fragment (struct lsquic_frame_reader *fr)
         RETURN_ERROR(nr);
     }
     hs->nread += nr;
+  check_done:
     if (hs->nread == payload_length &&
                 (fr->fr_state.header.hfh_flags & HFHF_END_HEADERS))
     {
-        int rv = decode_and_pass_payload(fr);
+        int rv = decode_and_pass_payload(fr, fr->fr_header_block,
+                                                    fr->fr_header_block_sz);
         free(fr->fr_header_block);
         fr->fr_header_block = NULL;
         return rv;
@@ -796,7 +883,8 @@ read_contin (struct lsquic_frame_reader *fr)
     {
         if (fr->fr_state.header.hfh_flags & HFHF_END_HEADERS)
         {
-            int rv = decode_and_pass_payload(fr);
+            int rv = decode_and_pass_payload(fr, fr->fr_header_block,
+                                                    fr->fr_header_block_sz);
             free(fr->fr_header_block);
             fr->fr_header_block = NULL;
             reset_state(fr);
@@ -68,6 +68,9 @@ struct frame_reader_callbacks
 
 typedef ssize_t (*fr_stream_read_f)(struct lsquic_stream *, void *, size_t);
 
+typedef ssize_t (*fr_stream_readf_f)(struct lsquic_stream *,
+        size_t (*)(void *, const unsigned char *, size_t, int), void *);
+
 struct lsquic_frame_reader *
 lsquic_frame_reader_new (enum frame_reader_flags, unsigned max_headers_sz,
                          struct lsquic_mm *, struct lsquic_stream *,
@@ -78,6 +81,14 @@ lsquic_frame_reader_new (enum frame_reader_flags, unsigned max_headers_sz,
 #endif
                          const struct lsquic_hset_if *, void *hsi_ctx);
 
+/* If `readf' is set, a header block that is not split across frames and
+ * is available in one contiguous piece is decoded directly from the
+ * stream's buffer.  Otherwise, it is copied and buffered as usual.
+ */
+void
+lsquic_frame_reader_set_readf (struct lsquic_frame_reader *,
+                                                        fr_stream_readf_f);
+
 int
 lsquic_frame_reader_read (struct lsquic_frame_reader *);
 
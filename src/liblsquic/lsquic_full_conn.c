@@ -3000,6 +3000,8 @@ process_streams_read_events (struct full_conn *conn)
     for (stream = lsquic_spi_first(&spi); stream;
                                             stream = lsquic_spi_next(&spi))
     {
+        if (lsquic_stream_batch_events(stream))
+            continue;
         q_flags = stream->sm_qflags & SMQF_SERVICE_FLAGS;
         lsquic_stream_dispatch_read_events(stream);
         needs_service |= q_flags ^ (stream->sm_qflags & SMQF_SERVICE_FLAGS);
@@ -3025,7 +3027,8 @@ process_streams_read_events (struct full_conn *conn)
             filter_out_old_streams, &fctx);
         for (stream = lsquic_spi_first(&spi); stream;
                                                 stream = lsquic_spi_next(&spi))
-            lsquic_stream_dispatch_read_events(stream);
+            if (!lsquic_stream_batch_events(stream))
+                lsquic_stream_dispatch_read_events(stream);
     }
 }
 
@@ -3049,6 +3052,8 @@ process_streams_write_events (struct full_conn *conn, int high_prio)
 {
     lsquic_stream_t *stream;
     struct stream_prio_iter spi;
+    const enum spi_sched sched = conn->fc_enpub->enp_settings.es_stream_sched;
+    lsquic_time_t now;
 
     lsquic_spi_init(&spi, TAILQ_FIRST(&conn->fc_pub.write_streams),
         TAILQ_LAST(&conn->fc_pub.write_streams, lsquic_streams_tailq),
@@ -3061,10 +3066,23 @@ process_streams_write_events (struct full_conn *conn, int high_prio)
     else
         lsquic_spi_drop_high(&spi);
 
+    if (sched != SPI_SCHED_RR)
+    {
+        now = lsquic_time_now();
+        lsquic_spi_sort(&spi, sched, now,
+                conn->fc_enpub->enp_settings.es_sched_max_wait * 1000);
+    }
+    else
+        now = 0;
+
     for (stream = lsquic_spi_first(&spi); stream && write_is_possible(conn);
                                             stream = lsquic_spi_next(&spi))
-        if (stream->sm_qflags & SMQF_WRITE_Q_FLAGS)
+        if ((stream->sm_qflags & SMQF_WRITE_Q_FLAGS)
+                                    && !lsquic_stream_batch_events(stream))
+        {
             lsquic_stream_dispatch_write_events(stream);
+            stream->sm_last_write = now;
+        }
 
     maybe_conn_flush_headers_stream(conn);
 }
@@ -4132,6 +4150,15 @@ full_conn_ci_get_ctx (const struct lsquic_conn *lconn)
 }
 
 
+static lsquic_time_t
+full_conn_ci_srtt (const struct lsquic_conn *lconn)
+{
+    const struct full_conn *conn = (const struct full_conn *) lconn;
+
+    return lsquic_rtt_stats_get_srtt(&conn->fc_pub.rtt_stats);
+}
+
+
 static void
 full_conn_ci_set_ctx (struct lsquic_conn *lconn, lsquic_conn_ctx_t *ctx)
 {
@@ -4276,7 +4303,8 @@ full_conn_ci_next_tick_time (lsquic_conn_t *lconn, unsigned *why)
     lsquic_time_t alarm_time, pacer_time, now;
     enum alarm_id al_id;
 
-    alarm_time = lsquic_alarmset_mintime(&conn->fc_alset, &al_id);
+    alarm_time = lsquic_alarmset_mintime_coarse(&conn->fc_alset,
+                        ATTQ_WHEEL_ALARMS, ATTQ_WHEEL_GRANULARITY, &al_id);
     pacer_time = lsquic_send_ctl_next_pacer_time(&conn->fc_send_ctl);
 
     if (pacer_time && LSQ_LOG_ENABLED(LSQ_LOG_DEBUG))
@@ -4444,6 +4472,7 @@ static const struct conn_iface full_conn_iface = {
      */
     .ci_report_live          =  NULL,
     .ci_set_ctx              =  full_conn_ci_set_ctx,
+    .ci_srtt                 =  full_conn_ci_srtt,
     .ci_status               =  full_conn_ci_status,
     .ci_tick                 =  full_conn_ci_tick,
     .ci_write_ack            =  full_conn_ci_write_ack,
@@ -398,6 +398,7 @@ struct ietf_full_conn
             enum {
                 IFCLI_PUSH_ENABLED    = 1 << 0,
                 IFCLI_HSK_SENT_OR_DEL = 1 << 1,
+                IFCLI_ZERO_RTT        = 1 << 2,   /* Sending 0-RTT data */
             }           ifcli_flags;
             unsigned    ifcli_packets_out;
         }                           cli;
@@ -1450,6 +1451,13 @@ lsquic_ietf_full_conn_server_new (struct lsquic_engine_public *enpub,
         lsquic_packet_in_put(conn->ifc_pub.mm, packet_in);
     }
 
+    /* The mini connection is promoted before the client's Handshake flight
+     * arrives when 0-RTT data is accepted.
+     */
+    if (!(imc->imc_flags & IMC_ADDR_VALIDATED))
+        lsquic_send_ctl_anti_ampl(&conn->ifc_send_ctl, imc->imc_bytes_in,
+                                                        imc->imc_bytes_out);
+
     LSQ_DEBUG("logging using %s SCID",
         LSQUIC_LOG_CONN_ID == CN_SCID(&conn->ifc_conn) ? "server" : "client");
     return &conn->ifc_conn;
@@ -2706,6 +2714,15 @@ ietf_full_conn_ci_drain_time (const struct lsquic_conn *lconn)
 }
 
 
+static lsquic_time_t
+ietf_full_conn_ci_srtt (const struct lsquic_conn *lconn)
+{
+    const struct ietf_full_conn *conn = (const struct ietf_full_conn *) lconn;
+
+    return lsquic_rtt_stats_get_srtt(&conn->ifc_pub.rtt_stats);
+}
+
+
 static void
 ietf_full_conn_ci_going_away (struct lsquic_conn *lconn)
 {
@@ -2916,6 +2933,51 @@ maybe_start_migration (struct ietf_full_conn *conn)
 }
 
 
+/* Client: once 0-RTT keys are available, streams are created and written
+ * before the handshake completes, using the limits the server gave us on
+ * the previous connection.  handshake_ok() replaces them with the current
+ * limits.  HTTP/3 would also need the remembered SETTINGS: 0-RTT data is
+ * only sent in non-HTTP mode.
+ */
+static int
+maybe_start_zero_rtt (struct ietf_full_conn *conn)
+{
+    struct transport_params params;
+    enum stream_id_type sit;
+
+    if (conn->ifc_u.cli.ifcli_flags & IFCLI_ZERO_RTT)
+        return 1;
+
+    if ((conn->ifc_flags & (IFC_SERVER|IFC_HTTP))
+            || 0 != conn->ifc_conn.cn_esf.i->esfi_get_zero_rtt_tp(
+                                    conn->ifc_conn.cn_enc_session, &params))
+        return 0;
+
+    if (params.tp_init_max_streams_bidi > (1ull << 60)
+                            || params.tp_init_max_streams_uni > (1ull << 60))
+    {
+        LSQ_INFO("remembered stream limits are too large: no 0-RTT");
+        return 0;
+    }
+
+    sit = gen_sit(0, SD_BIDI);
+    conn->ifc_max_allowed_stream_id[sit] =
+                        params.tp_init_max_streams_bidi << SIT_SHIFT;
+    sit = gen_sit(0, SD_UNI);
+    conn->ifc_max_allowed_stream_id[sit] =
+                        params.tp_init_max_streams_uni << SIT_SHIFT;
+    conn->ifc_max_stream_data_uni = params.tp_init_max_stream_data_uni;
+    conn->ifc_pub.conn_cap.cc_max = params.tp_init_max_data;
+    conn->ifc_cfg.max_stream_send = params.tp_init_max_stream_data_bidi_remote;
+
+    conn->ifc_u.cli.ifcli_flags |= IFCLI_ZERO_RTT;
+    conn->ifc_send_ctl.sc_flags |= SC_0RTT;
+    LSQ_DEBUG("start sending 0-RTT data");
+    maybe_create_delayed_streams(conn);
+    return 1;
+}
+
+
 static int
 handshake_ok (struct lsquic_conn *lconn)
 {
@@ -3175,7 +3237,10 @@ ietf_full_conn_ci_hsk_done (struct lsquic_conn *lconn,
         if (0 == handshake_ok(lconn))
         {
             if (!(conn->ifc_flags & IFC_SERVER))
+            {
+                lsquic_send_ctl_respool_0rtt(&conn->ifc_send_ctl);
                 lsquic_send_ctl_begin_optack_detection(&conn->ifc_send_ctl);
+            }
         }
         else
         {
@@ -3282,6 +3347,7 @@ ietf_full_conn_ci_push_stream (struct lsquic_conn *lconn, void *hset,
     int own_hset, stx_tab_id;
     unsigned char discard[2];
     struct lsxpack_header *xhdr;
+    struct lsxpack_header enc_xhdr;
     size_t req_space;
 
     if (!ietf_full_conn_ci_is_push_enabled(lconn)
@@ -3340,11 +3406,12 @@ ietf_full_conn_ci_push_stream (struct lsquic_conn *lconn, void *hset,
                 header < all_headers[i].headers + all_headers[i].count;
                     ++header)
         {
+            lsxpack_header_set_ptr(&enc_xhdr, header->name.iov_base,
+                header->name.iov_len, header->value.iov_base,
+                header->value.iov_len);
             hea_sz = end - p;
             enc_st = lsqpack_enc_encode(&conn->ifc_qeh.qeh_encoder, NULL,
-                &enc_sz, p, &hea_sz, header->name.iov_base,
-                header->name.iov_len, header->value.iov_base,
-                header->value.iov_len, LQEF_NO_HIST_UPD|LQEF_NO_DYN);
+                &enc_sz, p, &hea_sz, &enc_xhdr, LQEF_NO_HIST_UPD|LQEF_NO_DYN);
             if (enc_st == LQES_OK)
                 p += hea_sz;
             else
@@ -3710,6 +3777,8 @@ process_streams_read_events (struct ietf_full_conn *conn)
         for (stream = lsquic_spi_first(&spi); stream;
                                                 stream = lsquic_spi_next(&spi))
         {
+            if (lsquic_stream_batch_events(stream))
+                continue;
             q_flags = stream->sm_qflags & SMQF_SERVICE_FLAGS;
             lsquic_stream_dispatch_read_events(stream);
             needs_service |= q_flags ^ (stream->sm_qflags & SMQF_SERVICE_FLAGS);
@@ -3787,6 +3856,8 @@ process_streams_write_events (struct ietf_full_conn *conn, int high_prio)
 {
     struct lsquic_stream *stream;
     struct stream_prio_iter spi;
+    const enum spi_sched sched = conn->ifc_enpub->enp_settings.es_stream_sched;
+    lsquic_time_t now;
 
     lsquic_spi_init(&spi, TAILQ_FIRST(&conn->ifc_pub.write_streams),
         TAILQ_LAST(&conn->ifc_pub.write_streams, lsquic_streams_tailq),
@@ -3799,10 +3870,23 @@ process_streams_write_events (struct ietf_full_conn *conn, int high_prio)
     else
         lsquic_spi_drop_high(&spi);
 
+    if (sched != SPI_SCHED_RR)
+    {
+        now = lsquic_time_now();
+        lsquic_spi_sort(&spi, sched, now,
+                conn->ifc_enpub->enp_settings.es_sched_max_wait * 1000);
+    }
+    else
+        now = 0;
+
     for (stream = lsquic_spi_first(&spi); stream && write_is_possible(conn);
                                             stream = lsquic_spi_next(&spi))
-        if (stream->sm_qflags & SMQF_WRITE_Q_FLAGS)
+        if ((stream->sm_qflags & SMQF_WRITE_Q_FLAGS)
+                                    && !lsquic_stream_batch_events(stream))
+        {
             lsquic_stream_dispatch_write_events(stream);
+            stream->sm_last_write = now;
+        }
 
     maybe_conn_flush_special_streams(conn);
 }
@@ -4095,7 +4179,8 @@ ietf_full_conn_ci_next_tick_time (struct lsquic_conn *lconn, unsigned *why)
     lsquic_time_t alarm_time, pacer_time, now;
     enum alarm_id al_id;
 
-    alarm_time = lsquic_alarmset_mintime(&conn->ifc_alset, &al_id);
+    alarm_time = lsquic_alarmset_mintime_coarse(&conn->ifc_alset,
+                        ATTQ_WHEEL_ALARMS, ATTQ_WHEEL_GRANULARITY, &al_id);
     pacer_time = lsquic_send_ctl_next_pacer_time(&conn->ifc_send_ctl);
 
     if (pacer_time && LSQ_LOG_ENABLED(LSQ_LOG_DEBUG))
@@ -4909,18 +4994,24 @@ process_stream_frame (struct ietf_full_conn *conn,
             lsquic_malo_put(stream_frame);
             return 0;
         }
-        stream = new_stream(conn, stream_frame->stream_id, SCF_CALL_ON_NEW);
+        stream = new_stream(conn, stream_frame->stream_id, 0);
         if (!stream)
         {
             ABORT_ERROR("cannot create new stream: %s", strerror(errno));
             lsquic_malo_put(stream_frame);
             return 0;
         }
+        /* Set before on_new_stream() so that the user can check it there */
+        if (lsquic_packet_in_enc_level(packet_in) == ENC_LEV_EARLY)
+            stream->stream_flags |= STREAM_EARLY_DATA;
+        lsquic_stream_call_on_new(stream);
         if (SD_BIDI == ((stream_frame->stream_id >> SD_SHIFT) & 1)
                 && (!valid_stream_id(conn->ifc_max_req_id)
                         || conn->ifc_max_req_id < stream_frame->stream_id))
             conn->ifc_max_req_id = stream_frame->stream_id;
     }
+    else if (lsquic_packet_in_enc_level(packet_in) == ENC_LEV_EARLY)
+        stream->stream_flags |= STREAM_EARLY_DATA;
 
     stream_frame->packet_in = lsquic_packet_in_get(packet_in);
     if (0 != lsquic_stream_frame_in(stream, stream_frame))
@@ -6313,6 +6404,10 @@ process_regular_packet (struct ietf_full_conn *conn,
 
     EV_LOG_PACKET_IN(LSQUIC_LOG_CONN_ID, packet_in);
 
+    /* Only the client can produce a valid Handshake packet */
+    if (pns == PNS_HSK)
+        lsquic_send_ctl_addr_validated(&conn->ifc_send_ctl);
+
     packno_increased = packet_in->pi_packno
                 > lsquic_rechist_largest_packno(&conn->ifc_rechist[pns]);
     st = lsquic_rechist_received(&conn->ifc_rechist[pns], packet_in->pi_packno,
@@ -6496,6 +6591,7 @@ ietf_full_conn_ci_packet_in (struct lsquic_conn *lconn,
     if (conn->ifc_idle_to)
         lsquic_alarmset_set(&conn->ifc_alset, AL_IDLE,
                 packet_in->pi_received + conn->ifc_idle_to);
+    lsquic_send_ctl_ampl_bytes_in(&conn->ifc_send_ctl, packet_in->pi_data_sz);
     if (0 == (conn->ifc_flags & IFC_IMMEDIATE_CLOSE_FLAGS))
         if (0 != conn->ifc_process_incoming_packet(conn, packet_in))
             conn->ifc_flags |= IFC_ERROR;
@@ -6753,7 +6849,8 @@ ietf_full_conn_ci_tick (struct lsquic_conn *lconn, lsquic_time_t now)
         conn->ifc_flags |= (s < 0) << IFC_BIT_ERROR;
         if (0 == s)
             process_crypto_stream_write_events(conn);
-        goto end_write;
+        if (!maybe_start_zero_rtt(conn))
+            goto end_write;
     }
 
     maybe_conn_flush_special_streams(conn);
@@ -7175,6 +7272,22 @@ ietf_full_conn_ci_drop_crypto_streams (struct lsquic_conn *lconn)
 }
 
 
+/* Stream data sent in 0-RTT packets is resent after the handshake, when
+ * the stashed packets are rescheduled as 1-RTT packets.  No more 0-RTT
+ * packets are produced in the meantime.
+ */
+static void
+ietf_full_conn_ci_early_data_failed (struct lsquic_conn *lconn)
+{
+    struct ietf_full_conn *conn = (struct ietf_full_conn *) lconn;
+
+    LSQ_DEBUG("early data rejected: resend 0-RTT data after handshake");
+    conn->ifc_u.cli.ifcli_flags &= ~IFCLI_ZERO_RTT;
+    conn->ifc_send_ctl.sc_flags &= ~SC_0RTT;
+    lsquic_send_ctl_stash_0rtt_packets(&conn->ifc_send_ctl);
+}
+
+
 #define IETF_FULL_CONN_FUNCS \
     .ci_abort                =  ietf_full_conn_ci_abort, \
     .ci_abort_error          =  ietf_full_conn_ci_abort_error, \
@@ -7186,6 +7299,7 @@ ietf_full_conn_ci_drop_crypto_streams (struct lsquic_conn *lconn)
     .ci_destroy              =  ietf_full_conn_ci_destroy, \
     .ci_drain_time           =  ietf_full_conn_ci_drain_time, \
     .ci_drop_crypto_streams  =  ietf_full_conn_ci_drop_crypto_streams, \
+    .ci_early_data_failed    =  ietf_full_conn_ci_early_data_failed, \
     .ci_get_ctx              =  ietf_full_conn_ci_get_ctx, \
     .ci_get_engine           =  ietf_full_conn_ci_get_engine, \
     .ci_get_log_cid          =  ietf_full_conn_ci_get_log_cid, \
@@ -7204,6 +7318,7 @@ ietf_full_conn_ci_drop_crypto_streams (struct lsquic_conn *lconn)
     .ci_record_addrs         =  ietf_full_conn_ci_record_addrs, \
     .ci_report_live          =  ietf_full_conn_ci_report_live, \
     .ci_set_ctx              =  ietf_full_conn_ci_set_ctx, \
+    .ci_srtt                 =  ietf_full_conn_ci_srtt, \
     .ci_status               =  ietf_full_conn_ci_status, \
     .ci_stateless_reset      =  ietf_full_conn_ci_stateless_reset, \
     .ci_tick                 =  ietf_full_conn_ci_tick, \
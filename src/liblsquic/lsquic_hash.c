@@ -162,6 +162,54 @@ lsquic_hash_find (struct lsquic_hash *hash, const void *key, unsigned key_sz)
 }
 
 
+/* Eight bytes is the default CID length: compare such keys using a single
+ * load instead of calling memcmp().
+ */
+static struct lsquic_hash_elem *
+find_std_8 (struct lsquic_hash *hash, const void *key, unsigned hash_val)
+{
+    struct lsquic_hash_elem *el;
+    uint64_t a, b;
+
+    memcpy(&a, key, 8);
+    TAILQ_FOREACH(el, &hash->qh_buckets[BUCKNO(hash->qh_nbits, hash_val)],
+                                                            qhe_next_bucket)
+        if (hash_val == el->qhe_hash_val && 8 == el->qhe_key_len)
+        {
+            memcpy(&b, el->qhe_key_data, 8);
+            if (a == b)
+                return el;
+        }
+
+    return NULL;
+}
+
+
+struct lsquic_hash_elem *
+lsquic_hash_find_std (struct lsquic_hash *hash, const void *key,
+                                                            unsigned key_sz)
+{
+    unsigned buckno, hash_val;
+    struct lsquic_hash_elem *el;
+
+    assert(hash->qh_hash == XXH32 && hash->qh_cmp == memcmp);
+    hash_val = XXH32(key, key_sz, (uintptr_t) hash);
+    if (key_sz == 8)
+        return find_std_8(hash, key, hash_val);
+
+    buckno = BUCKNO(hash->qh_nbits, hash_val);
+    TAILQ_FOREACH(el, &hash->qh_buckets[buckno], qhe_next_bucket)
+        if (hash_val == el->qhe_hash_val &&
+            key_sz   == el->qhe_key_len &&
+            0 == memcmp(key, el->qhe_key_data, key_sz))
+        {
+            return el;
+        }
+
+    return NULL;
+}
+
+
 void
 lsquic_hash_erase (struct lsquic_hash *hash, struct lsquic_hash_elem *el)
 {
@@ -205,7 +253,7 @@ lsquic_hash_next (struct lsquic_hash *hash)
 
 
 unsigned
-lsquic_hash_count (struct lsquic_hash *hash)
+lsquic_hash_count (const struct lsquic_hash *hash)
 {
     return hash->qh_count;
 }
@@ -39,6 +39,12 @@ lsquic_hash_insert (struct lsquic_hash *, const void *key, unsigned key_sz,
 struct lsquic_hash_elem *
 lsquic_hash_find (struct lsquic_hash *, const void *key, unsigned key_sz);
 
+/* Same as lsquic_hash_find(), for hashes created by lsquic_hash_create()
+ * only: hash and comparison functions are called directly.
+ */
+struct lsquic_hash_elem *
+lsquic_hash_find_std (struct lsquic_hash *, const void *key, unsigned key_sz);
+
 #define lsquic_hashelem_getdata(el) ((el)->qhe_value)
 
 void
@@ -54,7 +60,7 @@ struct lsquic_hash_elem *
 lsquic_hash_next (struct lsquic_hash *);
 
 unsigned
-lsquic_hash_count (struct lsquic_hash *);
+lsquic_hash_count (const struct lsquic_hash *);
 
 size_t
 lsquic_hash_mem_used (const struct lsquic_hash *);
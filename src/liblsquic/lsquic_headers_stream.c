@@ -105,6 +105,7 @@ headers_on_new_stream (void *stream_if_ctx, lsquic_stream_t *stream)
         hs->hs_callbacks->hsc_on_conn_error(hs->hs_cb_ctx);
         return NULL;
     }
+    lsquic_frame_reader_set_readf(hs->hs_fr, lsquic_stream_readf);
     hs->hs_fw = lsquic_frame_writer_new(&hs->hs_enpub->enp_mm, stream, 0,
             &hs->hs_henc, lsquic_stream_writef,
 #if LSQUIC_CONN_STATS
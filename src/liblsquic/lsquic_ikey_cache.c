@@ -0,0 +1,116 @@
+/* Copyright (c) 2017 - 2020 LiteSpeed Technologies Inc.  See LICENSE. */
+/*
+ * lsquic_ikey_cache.c -- Cache of derived Initial keys
+ *
+ * The cache is small, so it is an array that is searched linearly:
+ * comparing a few CIDs is cheaper than hashing one.  Each entry records
+ * when it was last used, and the oldest entry is replaced when the cache
+ * is full.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "lsquic_types.h"
+#include "lsquic_ikey_cache.h"
+
+
+struct ikc_entry
+{
+    lsquic_cid_t            ike_dcid;
+    unsigned long           ike_last_used;
+    struct ikey_material    ike_material;
+};
+
+
+struct ikey_cache
+{
+    unsigned long           ikc_clock;
+    unsigned                ikc_n_entries,
+                            ikc_max_entries;
+    struct ikc_entry        ikc_entries[0];
+};
+
+
+struct ikey_cache *
+lsquic_ikc_new (unsigned n_entries)
+{
+    struct ikey_cache *cache;
+
+    if (n_entries == 0)
+        return NULL;
+
+    cache = malloc(sizeof(*cache) + sizeof(cache->ikc_entries[0]) * n_entries);
+    if (!cache)
+        return NULL;
+
+    cache->ikc_clock = 0;
+    cache->ikc_n_entries = 0;
+    cache->ikc_max_entries = n_entries;
+    return cache;
+}
+
+
+static struct ikc_entry *
+ikc_find (struct ikey_cache *cache, const lsquic_cid_t *dcid)
+{
+    struct ikc_entry *entry;
+
+    for (entry = cache->ikc_entries;
+                entry < cache->ikc_entries + cache->ikc_n_entries; ++entry)
+        if (LSQUIC_CIDS_EQ(&entry->ike_dcid, dcid))
+            return entry;
+
+    return NULL;
+}
+
+
+const struct ikey_material *
+lsquic_ikc_get (struct ikey_cache *cache, const lsquic_cid_t *dcid)
+{
+    struct ikc_entry *entry;
+
+    entry = ikc_find(cache, dcid);
+    if (entry)
+    {
+        entry->ike_last_used = ++cache->ikc_clock;
+        return &entry->ike_material;
+    }
+    else
+        return NULL;
+}
+
+
+void
+lsquic_ikc_put (struct ikey_cache *cache, const lsquic_cid_t *dcid,
+                                    const struct ikey_material *material)
+{
+    struct ikc_entry *entry, *oldest;
+
+    entry = ikc_find(cache, dcid);
+    if (!entry)
+    {
+        if (cache->ikc_n_entries < cache->ikc_max_entries)
+            entry = &cache->ikc_entries[ cache->ikc_n_entries++ ];
+        else
+        {
+            oldest = cache->ikc_entries;
+            for (entry = cache->ikc_entries + 1;
+                    entry < cache->ikc_entries + cache->ikc_n_entries; ++entry)
+                if (entry->ike_last_used < oldest->ike_last_used)
+                    oldest = entry;
+            entry = oldest;
+        }
+        entry->ike_dcid = *dcid;
+    }
+
+    entry->ike_last_used = ++cache->ikc_clock;
+    memcpy(&entry->ike_material, material, sizeof(*material));
+}
+
+
+void
+lsquic_ikc_destroy (struct ikey_cache *cache)
+{
+    free(cache);
+}
@@ -0,0 +1,45 @@
+/* Copyright (c) 2017 - 2020 LiteSpeed Technologies Inc.  See LICENSE. */
+/*
+ * lsquic_ikey_cache.h -- Cache of derived Initial keys
+ *
+ * Initial keys depend only on the DCID the client picked: the salt is the
+ * same for all supported versions.  Key material derived for a DCID is kept
+ * in a small engine-wide cache, so that when another connection is set up
+ * using the same DCID, HKDF does not have to be run again.
+ */
+
+#ifndef LSQUIC_IKEY_CACHE_H
+#define LSQUIC_IKEY_CACHE_H 1
+
+/* Initial packets are protected using AEAD_AES_128_GCM and SHA-256 */
+#define IKC_SECRET_SZ   32
+#define IKC_KEY_SZ      16
+#define IKC_IV_SZ       12
+
+struct ikey_cache;
+
+struct ikey_material
+{
+    /* Index 0 is client, index 1 is server */
+    unsigned char       ikm_secret[2][IKC_SECRET_SZ];
+    unsigned char       ikm_key[2][IKC_KEY_SZ];
+    unsigned char       ikm_iv[2][IKC_IV_SZ];
+    unsigned char       ikm_hp[2][IKC_KEY_SZ];
+};
+
+struct ikey_cache *
+lsquic_ikc_new (unsigned n_entries);
+
+/* Returns NULL if `dcid' is not in the cache */
+const struct ikey_material *
+lsquic_ikc_get (struct ikey_cache *, const lsquic_cid_t *dcid);
+
+/* Least recently used entry is replaced if the cache is full */
+void
+lsquic_ikc_put (struct ikey_cache *, const lsquic_cid_t *dcid,
+                                            const struct ikey_material *);
+
+void
+lsquic_ikc_destroy (struct ikey_cache *);
+
+#endif
@@ -0,0 +1,109 @@
+/* Copyright (c) 2017 - 2020 LiteSpeed Technologies Inc.  See LICENSE. */
+/*
+ * lsquic_lat_hist.c -- Latency histograms
+ *
+ * Buckets are log-linear, as in HDR histograms: values smaller than
+ * N_SUB are counted exactly; above that, each power of two is split into
+ * N_SUB buckets.  This gives relative error of at most 1/N_SUB.
+ */
+
+#include <assert.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "lsquic.h"
+#include "lsquic_int_types.h"
+#include "lsquic_lat_hist.h"
+
+#define SUB_BITS 3
+#define N_SUB (1u << SUB_BITS)
+#define MAX_BITS 36
+
+typedef char bucket_count_is_correct[
+    N_SUB + (MAX_BITS - SUB_BITS) * N_SUB == LSQUIC_LAT_HIST_N_BUCKETS
+                                                                    ? 1 : -1];
+
+
+/* Position of the highest bit set; `v' is not zero */
+static unsigned
+msb64 (uint64_t v)
+{
+#if __GNUC__
+    return 63 - __builtin_clzll(v);
+#else
+    unsigned n;
+    n = 0;
+    if (v >> 32) { n += 32; v >>= 32; }
+    if (v >> 16) { n += 16; v >>= 16; }
+    if (v >>  8) { n +=  8; v >>=  8; }
+    if (v >>  4) { n +=  4; v >>=  4; }
+    if (v >>  2) { n +=  2; v >>=  2; }
+    if (v >>  1) { n +=  1; }
+    return n;
+#endif
+}
+
+
+static unsigned
+bucket_idx (uint64_t usec)
+{
+    unsigned msb;
+
+    if (usec < N_SUB)
+        return usec;
+    if (usec >> MAX_BITS)
+        return LSQUIC_LAT_HIST_N_BUCKETS - 1;
+    msb = msb64(usec);
+    return (msb - SUB_BITS + 1) * N_SUB
+                            + ((usec >> (msb - SUB_BITS)) & (N_SUB - 1));
+}
+
+
+void
+lsquic_lat_hist_record (struct lsquic_lat_hist *hist, lsquic_time_t usec)
+{
+    ++hist->lh_buckets[ bucket_idx(usec) ];
+    ++hist->lh_count;
+    hist->lh_sum += usec;
+    if (usec > hist->lh_max)
+        hist->lh_max = usec;
+}
+
+
+unsigned long long
+lsquic_lat_hist_bucket_min (unsigned idx)
+{
+    unsigned shift;
+
+    assert(idx < LSQUIC_LAT_HIST_N_BUCKETS);
+    if (idx < N_SUB)
+        return idx;
+    shift = idx / N_SUB - 1;
+    return (unsigned long long) (N_SUB + idx % N_SUB) << shift;
+}
+
+
+unsigned long long
+lsquic_lat_hist_percentile (const struct lsquic_lat_hist *hist,
+                                                            double percentile)
+{
+    unsigned long long target, count;
+    unsigned idx;
+
+    if (hist->lh_count == 0)
+        return 0;
+
+    if (percentile >= 100.)
+        return hist->lh_max;
+
+    target = (unsigned long long) (percentile / 100. * hist->lh_count);
+    count = 0;
+    for (idx = 0; idx < LSQUIC_LAT_HIST_N_BUCKETS; ++idx)
+    {
+        count += hist->lh_buckets[idx];
+        if (count > target)
+            return lsquic_lat_hist_bucket_min(idx);
+    }
+
+    return hist->lh_max;
+}
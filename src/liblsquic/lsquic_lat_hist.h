@@ -0,0 +1,23 @@
+/* Copyright (c) 2017 - 2020 LiteSpeed Technologies Inc.  See LICENSE. */
+/*
+ * lsquic_lat_hist.h -- Latency histograms
+ *
+ * The engine keeps an array of N_LSQLH histograms when es_lat_hist is
+ * set.  Otherwise, enp_lat_hists is NULL and recording is a single
+ * pointer check.
+ */
+
+#ifndef LSQUIC_LAT_HIST_H
+#define LSQUIC_LAT_HIST_H 1
+
+struct lsquic_lat_hist;
+
+void
+lsquic_lat_hist_record (struct lsquic_lat_hist *, lsquic_time_t usec);
+
+#define LAT_HIST_RECORD(enpub_, which_, usec_) do {                     \
+    if ((enpub_)->enp_lat_hists)                                        \
+        lsquic_lat_hist_record(&(enpub_)->enp_lat_hists[which_], usec_); \
+} while (0)
+
+#endif
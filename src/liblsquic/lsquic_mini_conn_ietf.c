@@ -1148,6 +1148,30 @@ ignore_init (struct ietf_mini_conn *conn)
 }
 
 
+/* The engine owns packet data only for the duration of the call */
+static int
+imico_copy_packet_data (struct ietf_mini_conn *conn,
+                                        struct lsquic_packet_in *packet_in)
+{
+    unsigned char *copy;
+
+    if (packet_in->pi_flags & PI_OWN_DATA)
+        return 0;
+
+    copy = lsquic_mm_get_packet_in_buf(&conn->imc_enpub->enp_mm,
+                                                    packet_in->pi_data_sz);
+    if (!copy)
+    {
+        LSQ_WARN("cannot allocate memory to copy incoming packet data");
+        return -1;
+    }
+    memcpy(copy, packet_in->pi_data, packet_in->pi_data_sz);
+    packet_in->pi_data = copy;
+    packet_in->pi_flags |= PI_OWN_DATA;
+    return 0;
+}
+
+
 /* Only a single packet is supported */
 static void
 ietf_mini_conn_ci_packet_in (struct lsquic_conn *lconn,
@@ -1174,8 +1198,23 @@ ietf_mini_conn_ci_packet_in (struct lsquic_conn *lconn,
                                 conn->imc_enpub, &conn->imc_conn, packet_in);
     if (dec_packin != DECPI_OK)
     {
-        /* TODO: handle reordering perhaps? */
-        LSQ_DEBUG("could not decrypt packet");
+        /* 0-RTT packets that arrive before ClientHello has been processed
+         * are decrypted by the full connection.
+         */
+        if (dec_packin == DECPI_NOT_YET
+                && packet_in->pi_header_type == HETY_0RTT
+                && conn->imc_delayed_packets_count < IMICO_MAX_DELAYED_PACKETS
+                && 0 == imico_copy_packet_data(conn, packet_in))
+        {
+            lsquic_packet_in_upref(packet_in);
+            TAILQ_INSERT_TAIL(&conn->imc_app_packets, packet_in, pi_next);
+            ++conn->imc_delayed_packets_count;
+            conn->imc_bytes_in += packet_in->pi_data_sz;
+            LSQ_DEBUG("0-RTT packet arrived before keys: delay it");
+        }
+        else
+            LSQ_DEBUG("could not decrypt packet (type %s)",
+                                lsquic_hety2str[packet_in->pi_header_type]);
         return;
     }
 
@@ -1184,8 +1223,20 @@ ietf_mini_conn_ci_packet_in (struct lsquic_conn *lconn,
 
     if (pns == PNS_APP)
     {
+        /* The same limit applies as to 0-RTT packets that arrive before
+         * the keys: until the client's Handshake flight arrives, the
+         * amount of memory the client can make us use is bounded.
+         */
+        if (conn->imc_delayed_packets_count >= IMICO_MAX_DELAYED_PACKETS)
+        {
+            LSQ_DEBUG("drop packet %"PRIu64" in pns %u: already delaying "
+                "%u packets", packet_in->pi_packno, pns,
+                conn->imc_delayed_packets_count);
+            return;
+        }
         lsquic_packet_in_upref(packet_in);
         TAILQ_INSERT_TAIL(&conn->imc_app_packets, packet_in, pi_next);
+        ++conn->imc_delayed_packets_count;
         LSQ_DEBUG("delay processing of packet %"PRIu64" in pns %u",
             packet_in->pi_packno, pns);
         return;
@@ -96,6 +96,8 @@ struct ietf_mini_conn
     uint8_t                         imc_tls_alert;
 #define IMICO_MAX_STASHED_FRAMES 10u
     unsigned char                   imc_n_crypto_frames;
+#define IMICO_MAX_DELAYED_PACKETS 10u
+    unsigned char                   imc_delayed_packets_count;
     struct network_path             imc_path;
 };
 
@@ -0,0 +1,174 @@
+/* Copyright (c) 2017 - 2020 LiteSpeed Technologies Inc.  See LICENSE. */
+/*
+ * lsquic_numa.c -- CPU and NUMA placement helpers
+ *
+ * System calls are used directly so that the library does not depend on
+ * libnuma.  Memory policy applies to pages the calling thread touches for
+ * the first time: it is set while the engine allocates its data structures
+ * and by lsquic_engine_bind_thread().
+ */
+
+#if __linux__
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE         /* for sched_setaffinity */
+#endif
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "lsquic_numa.h"
+
+#define MPOL_DEFAULT    0
+#define MPOL_PREFERRED  1
+
+#define BITS_PER_LONG (sizeof(unsigned long) * 8)
+
+
+#if __linux__
+int
+lsquic_numa_n_nodes (void)
+{
+    FILE *file;
+    char buf[0x100], *p, *end;
+    unsigned long first, last;
+    int count;
+
+    file = fopen("/sys/devices/system/node/online", "r");
+    if (!file)
+        return -1;
+    p = fgets(buf, sizeof(buf), file);
+    fclose(file);
+    if (!p)
+        return -1;
+
+    /* The format is a list of ranges, for example "0-1,4" */
+    count = 0;
+    while (*p >= '0' && *p <= '9')
+    {
+        first = strtoul(p, &end, 10);
+        if (*end == '-')
+            last = strtoul(end + 1, &end, 10);
+        else
+            last = first;
+        if (last < first)
+            return -1;
+        count += last - first + 1;
+        p = end;
+        if (*p == ',')
+            ++p;
+    }
+
+    return count > 0 ? count : -1;
+}
+
+
+int
+lsquic_numa_cpu_node (int cpu)
+{
+    char path[64];
+    int node;
+
+    if (cpu < 0 || lsquic_numa_n_nodes() <= 1)
+        return -1;
+
+    for (node = 0; node < NUMA_MAX_NODES; ++node)
+    {
+        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/node%d",
+                                                                cpu, node);
+        if (0 == access(path, F_OK))
+            return node;
+    }
+
+    return -1;
+}
+
+
+int
+lsquic_numa_prefer (int node, struct numa_policy *saved)
+{
+    struct numa_policy policy;
+
+    if (node < 0 || node >= NUMA_MAX_NODES || lsquic_numa_n_nodes() <= 1)
+        return -1;
+
+    if (saved && 0 != syscall(SYS_get_mempolicy, &saved->np_mode,
+                            saved->np_nodemask, NUMA_MAX_NODES + 1, NULL, 0))
+        return -1;
+
+    memset(&policy, 0, sizeof(policy));
+    policy.np_nodemask[ node / BITS_PER_LONG ] = 1UL << (node % BITS_PER_LONG);
+    if (0 != syscall(SYS_set_mempolicy, MPOL_PREFERRED, policy.np_nodemask,
+                                                        NUMA_MAX_NODES + 1))
+        return -1;
+
+    return 0;
+}
+
+
+void
+lsquic_numa_restore (const struct numa_policy *saved)
+{
+    if (saved->np_mode == MPOL_DEFAULT)
+        (void) syscall(SYS_set_mempolicy, MPOL_DEFAULT, NULL, 0);
+    else
+        (void) syscall(SYS_set_mempolicy, saved->np_mode, saved->np_nodemask,
+                                                        NUMA_MAX_NODES + 1);
+}
+
+
+int
+lsquic_numa_bind_cpu (int cpu)
+{
+    cpu_set_t set;
+
+    if (cpu < 0 || cpu >= CPU_SETSIZE)
+        return -1;
+
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return sched_setaffinity(0, sizeof(set), &set);
+}
+
+
+#else
+
+
+int
+lsquic_numa_n_nodes (void)
+{
+    return -1;
+}
+
+
+int
+lsquic_numa_cpu_node (int cpu)
+{
+    return -1;
+}
+
+
+int
+lsquic_numa_prefer (int node, struct numa_policy *saved)
+{
+    return -1;
+}
+
+
+void
+lsquic_numa_restore (const struct numa_policy *saved)
+{
+}
+
+
+int
+lsquic_numa_bind_cpu (int cpu)
+{
+    return -1;
+}
+
+
+#endif
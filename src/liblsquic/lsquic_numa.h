@@ -0,0 +1,42 @@
+/* Copyright (c) 2017 - 2020 LiteSpeed Technologies Inc.  See LICENSE. */
+/*
+ * lsquic_numa.h -- CPU and NUMA placement helpers
+ *
+ * These are only implemented on Linux.  Elsewhere, and on hosts with a
+ * single NUMA node, they do nothing and return -1.
+ */
+
+#ifndef LSQUIC_NUMA_H
+#define LSQUIC_NUMA_H 1
+
+#define NUMA_MAX_NODES 1024
+
+struct numa_policy
+{
+    int             np_mode;
+    unsigned long   np_nodemask[NUMA_MAX_NODES / (sizeof(unsigned long) * 8)];
+};
+
+/* Returns number of online NUMA nodes, or -1 if it cannot be determined */
+int
+lsquic_numa_n_nodes (void);
+
+/* Returns node `cpu' belongs to or -1 if there is only one node */
+int
+lsquic_numa_cpu_node (int cpu);
+
+/* Make calling thread prefer allocating memory on `node'.  If `saved' is
+ * not NULL, current policy is stored there so that it can be restored
+ * using lsquic_numa_restore().  Returns 0 on success and -1 on failure.
+ */
+int
+lsquic_numa_prefer (int node, struct numa_policy *saved);
+
+void
+lsquic_numa_restore (const struct numa_policy *);
+
+/* Pin calling thread to `cpu'.  Returns 0 on success and -1 on failure. */
+int
+lsquic_numa_bind_cpu (int cpu);
+
+#endif
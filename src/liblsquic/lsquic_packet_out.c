@@ -365,6 +365,37 @@ lsquic_packet_out_chop_regen (lsquic_packet_out_t *packet_out)
 }
 
 
+/* Only called for packets that carry the first STREAM frame or a FIN.
+ * Other streams' frames may share the packet: only the frame itself says
+ * whether it carries the FIN.
+ */
+void
+lsquic_packet_out_sent_streams (struct lsquic_packet_out *packet_out,
+                                            const struct parse_funcs *pf)
+{
+    struct packet_out_srec_iter posi;
+    struct stream_rec *srec;
+    struct stream_frame stream_frame;
+    int len, fin;
+
+    for (srec = lsquic_posi_first(&posi, packet_out); srec;
+                                                srec = lsquic_posi_next(&posi))
+        if (srec->sr_frame_type == QUIC_FRAME_STREAM)
+        {
+            if (packet_out->po_lflags & POL_STREAM_FIN)
+            {
+                len = pf->pf_parse_stream_frame(
+                        packet_out->po_data + srec->sr_off, srec->sr_len,
+                        &stream_frame);
+                fin = len >= 0 && DF_FIN(&stream_frame);
+            }
+            else
+                fin = 0;
+            lsquic_stream_sent(srec->sr_stream, packet_out, fin);
+        }
+}
+
+
 void
 lsquic_packet_out_ack_streams (lsquic_packet_out_t *packet_out)
 {
@@ -791,6 +822,7 @@ lsquic_packet_out_turn_on_fin (struct lsquic_packet_out *packet_out,
             if (last_offset == stream->tosend_off)
             {
                 pf->pf_turn_on_fin(packet_out->po_data + srec->sr_off);
+                packet_out->po_lflags |= POL_STREAM_FIN;
                 EV_LOG_UPDATED_STREAM_FRAME(
                     lsquic_conn_log_cid(lsquic_stream_conn(stream)),
                     pf, packet_out->po_data + srec->sr_off, srec->sr_len);
@@ -65,6 +65,9 @@ typedef struct lsquic_packet_out
     TAILQ_ENTRY(lsquic_packet_out)
                        po_next;
     lsquic_time_t      po_sent;       /* Time sent */
+    lsquic_time_t      po_scheduled;  /* Time scheduled; only set if latency
+                                       * histograms are on.
+                                       */
     lsquic_packno_t    po_packno;
     lsquic_packno_t    po_ack2ed;       /* If packet has ACK frame, value of
                                          * largest acked in it.
@@ -146,6 +149,8 @@ typedef struct lsquic_packet_out
         POL_LOG_QL_BITS = 1 << 6,
         POL_SQUARE_BIT = 1 << 7,
         POL_LOSS_BIT = 1 << 8,
+        POL_STREAM_FIRST = 1 << 9,      /* Has first STREAM frame of a stream */
+        POL_STREAM_FIN   = 1 << 10,     /* Has STREAM frame with FIN bit */
     }                  po_lflags:16;
     unsigned char     *po_data;
 
@@ -312,6 +317,10 @@ lsquic_packet_out_split_in_two (struct lsquic_mm *, lsquic_packet_out_t *,
 void
 lsquic_packet_out_chop_regen (lsquic_packet_out_t *);
 
+void
+lsquic_packet_out_sent_streams (struct lsquic_packet_out *,
+                                            const struct parse_funcs *);
+
 void
 lsquic_packet_out_ack_streams (struct lsquic_packet_out *);
 
@@ -17,6 +17,7 @@ lsquic_packints_init (struct packints *pints)
 {
     TAILQ_INIT(&pints->pk_intervals);
     pints->pk_cur = NULL;
+    pints->pk_count = 0;
 }
 
 
@@ -95,6 +96,7 @@ lsquic_packints_add (struct packints *pints, lsquic_packno_t packno)
             prev->range.low = pi->range.low;
             TAILQ_REMOVE(&pints->pk_intervals, pi, next_pi);
             free(pi);
+            --pints->pk_count;
         }
     }
     else
@@ -107,6 +109,7 @@ lsquic_packints_add (struct packints *pints, lsquic_packno_t packno)
             TAILQ_INSERT_BEFORE(pi, newpi, next_pi);
         else
             TAILQ_INSERT_TAIL(&pints->pk_intervals, newpi, next_pi);
+        ++pints->pk_count;
     }
 
     lsquic_packints_sanity_check(pints);
@@ -138,15 +141,25 @@ lsquic_packints_next (struct packints *pints)
 }
 
 
-size_t
-lsquic_packints_mem_used (const struct packints *packints)
+void
+lsquic_packints_remove_last (struct packints *pints)
 {
-    const struct packet_interval *pi;
-    unsigned count;
+    struct packet_interval *pi;
+
+    pi = TAILQ_LAST(&pints->pk_intervals, pinhead);
+    if (pi)
+    {
+        if (pints->pk_cur == pi)
+            pints->pk_cur = NULL;
+        TAILQ_REMOVE(&pints->pk_intervals, pi, next_pi);
+        free(pi);
+        --pints->pk_count;
+    }
+}
 
-    count = 0;
-    TAILQ_FOREACH(pi, &packints->pk_intervals, next_pi)
-        ++count;
 
-    return count * sizeof(*pi);
+size_t
+lsquic_packints_mem_used (const struct packints *packints)
+{
+    return packints->pk_count * sizeof(struct packet_interval);
 }
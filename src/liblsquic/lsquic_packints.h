@@ -20,6 +20,7 @@ TAILQ_HEAD(pinhead, packet_interval);
 struct packints {
     struct pinhead                  pk_intervals;
     struct packet_interval         *pk_cur;
+    unsigned                        pk_count;   /* Number of intervals */
 };
 
 void
@@ -39,6 +40,12 @@ lsquic_packints_first (struct packints *);
 const struct lsquic_packno_range *
 lsquic_packints_next (struct packints *);
 
+/* Remove lowest interval */
+void
+lsquic_packints_remove_last (struct packints *);
+
+#define lsquic_packints_count(pints) (+(pints)->pk_count)
+
 #if LSQUIC_PACKINTS_SANITY_CHECK
 void
 lsquic_packints_sanity_check (const struct packints *);
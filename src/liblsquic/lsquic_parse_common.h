@@ -49,6 +49,15 @@ lsquic_ietf_v1_parse_packet_in_short_begin (struct lsquic_packet_in *,
             size_t length, int is_server, unsigned cid_len,
             struct packin_parse_state *);
 
+/* Parse short header packet whose DCID is `cid_len' bytes long, which must
+ * be non-zero.  The caller has already checked the first byte and the
+ * length.  The header is parsed completely: there is no need to call
+ * pf_parse_packet_in_finish().
+ */
+void
+lsquic_ietf_v1_parse_packet_in_short_fast (struct lsquic_packet_in *,
+            size_t length, unsigned cid_len);
+
 struct sockaddr;
 enum lsquic_version;
 struct lsquic_engine_public;
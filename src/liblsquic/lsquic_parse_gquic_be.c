@@ -16,6 +16,7 @@
 #include <vc_compat.h>
 #endif
 
+#include "lsquic.h"
 #include "lsquic_types.h"
 #include "lsquic_int_types.h"
 #include "lsquic_packet_common.h"
@@ -32,7 +33,6 @@
 #include "lsquic_mm.h"
 #include "lsquic_malo.h"
 #include "lsquic_version.h"
-#include "lsquic.h"
 #include "lsquic_conn.h"
 #include "lsquic_parse_gquic_be.h"  /* Include to catch mismatches */
 #include "lsquic_byteswap.h"
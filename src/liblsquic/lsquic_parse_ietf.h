@@ -13,4 +13,18 @@ lsquic_ietf_v1_gen_crypto_frame (unsigned char *buf, unsigned char first_byte,
         size_t buf_len, uint64_t offset, size_t size, gcf_read_f gcf_read,
         void *stream);
 
+/* IETF STREAM frame generator and header size are used directly by the
+ * stream code: all IETF versions share this format, so there is no need
+ * to go through the parse_funcs table for every frame.  The header size
+ * always includes the length field.  Using it requires lsquic_varint.h.
+ */
+int
+lsquic_ietf_v1_gen_stream_frame (unsigned char *buf, size_t buf_len,
+        lsquic_stream_id_t stream_id, uint64_t offset, int fin, size_t size,
+        gsf_read_f gsf_read, void *stream);
+
+#define IETF_V1_STREAM_FRAME_HEADER_SZ(stream_id, offset, data_sz) (       \
+    1 + vint_size(stream_id) + vint_size(data_sz)                           \
+      + ((offset) ? vint_size(offset) : 0))
+
 #endif
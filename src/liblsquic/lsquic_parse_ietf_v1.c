@@ -15,6 +15,7 @@
 #include <vc_compat.h>
 #endif
 
+#include "lsquic.h"
 #include "lsquic_types.h"
 #include "lsquic_int_types.h"
 #include "lsquic_sizes.h"
@@ -32,7 +33,6 @@
 #include "lsquic_mm.h"
 #include "lsquic_malo.h"
 #include "lsquic_version.h"
-#include "lsquic.h"
 #include "lsquic_byteswap.h"
 #include "lsquic_conn.h"
 #include "lsquic_enc_sess.h"
@@ -339,8 +339,8 @@ ietf_v1_packout_size (const struct lsquic_conn *lconn,
 }
 
 
-static int
-ietf_v1_gen_stream_frame (unsigned char *buf, size_t buf_len,
+int
+lsquic_ietf_v1_gen_stream_frame (unsigned char *buf, size_t buf_len,
         lsquic_stream_id_t stream_id, uint64_t offset, int fin, size_t size,
         gsf_read_f gsf_read, void *stream)
 {
@@ -625,7 +625,7 @@ ietf_v1_parse_ack_frame (const unsigned char *const buf, size_t buf_len,
     const unsigned char *const end = buf + buf_len;
     uint64_t block_count, gap, block;
     enum ecn ecn;
-    unsigned i;
+    unsigned i, n_small;
     int r;
 
     ++p;
@@ -650,16 +650,39 @@ ietf_v1_parse_ack_frame (const unsigned char *const buf, size_t buf_len,
         return -1;
     p += r;
 
+    n_small = 0;
     for (i = 1; i <= block_count; ++i)
     {
-        r = vint_read(p, end, &gap);
-        if (UNLIKELY(r < 0))
-            return -1;
-        p += r;
-        r = vint_read(p, end, &block);
-        if (UNLIKELY(r < 0))
-            return -1;
-        p += r;
+        /* Gaps and ACK blocks are usually smaller than 64, in which case
+         * they are read in batches.  Do not look past the last block.
+         */
+        if (n_small < 2)
+        {
+            if ((uint64_t) (end - p) / 2 > block_count - i)
+                n_small = lsquic_varint_n_one_byte(p,
+                                            p + 2 * (block_count - i + 1));
+            else
+                n_small = lsquic_varint_n_one_byte(p, end);
+        }
+        if (n_small >= 2)
+        {
+            gap = p[0];
+            block = p[1];
+            p += 2;
+            n_small -= 2;
+        }
+        else
+        {
+            r = vint_read(p, end, &gap);
+            if (UNLIKELY(r < 0))
+                return -1;
+            p += r;
+            r = vint_read(p, end, &block);
+            if (UNLIKELY(r < 0))
+                return -1;
+            p += r;
+            n_small = 0;
+        }
         if (i < sizeof(ack->ranges) / sizeof(ack->ranges[0]))
         {
             ack->ranges[i].high = ack->ranges[i - 1].low - gap - 2;
@@ -1038,10 +1061,20 @@ ietf_v1_gen_ack_frame (unsigned char *outbuf, size_t outbuf_sz,
                                                 p - block_count_p - 1);
             ++p;
         }
-        vint_write(p, gap - 1, a, 1 << a);
-        p += 1 << a;
-        vint_write(p, rsize, b, 1 << b);
-        p += 1 << b;
+        if ((a | b) == 0)
+        {
+            /* Common case: both values fit into one byte */
+            p[0] = gap - 1;
+            p[1] = rsize;
+            p += 2;
+        }
+        else
+        {
+            vint_write(p, gap - 1, a, 1 << a);
+            p += 1 << a;
+            vint_write(p, rsize, b, 1 << b);
+            p += 1 << b;
+        }
         ++addl_ack_blocks;
         prev_low = range->low;
     }
@@ -1076,15 +1109,7 @@ static size_t
 ietf_v1_calc_stream_frame_header_sz (lsquic_stream_id_t stream_id,
                                             uint64_t offset, unsigned data_sz)
 {
-    if (offset)
-        return 1
-            + (1 << vint_val2bits(stream_id))
-            + (1 << vint_val2bits(data_sz))
-            + (1 << vint_val2bits(offset));
-    else
-        return 1
-            + (1 << vint_val2bits(data_sz))
-            + (1 << vint_val2bits(stream_id));
+    return IETF_V1_STREAM_FRAME_HEADER_SZ(stream_id, offset, data_sz);
 }
 
 
@@ -1927,6 +1952,25 @@ lsquic_is_valid_ietf_v1_or_Q046plus_hs_packet (const unsigned char *buf,
 }
 
 
+static void
+init_short_packet_in (struct lsquic_packet_in *packet_in, unsigned char byte,
+                                        unsigned header_sz, size_t length)
+{
+    packet_in->pi_flags |= ((byte & 0x20) > 0) << PIBIT_SPIN_SHIFT;
+    packet_in->pi_flags |= (byte & 3) << PIBIT_BITS_SHIFT;
+
+    packet_in->pi_header_sz     = header_sz;
+    packet_in->pi_data_sz       = length;
+    packet_in->pi_quic_ver      = 0;
+    packet_in->pi_nonce         = 0;
+    packet_in->pi_refcnt        = 0;
+    packet_in->pi_frame_types   = 0;
+    memset(&packet_in->pi_next, 0, sizeof(packet_in->pi_next));
+    packet_in->pi_refcnt        = 0;
+    packet_in->pi_received      = 0;
+}
+
+
 int
 lsquic_ietf_v1_parse_packet_in_short_begin (struct lsquic_packet_in *packet_in,
                 size_t length, int is_server, unsigned cid_len,
@@ -1953,18 +1997,7 @@ lsquic_ietf_v1_parse_packet_in_short_begin (struct lsquic_packet_in *packet_in,
     else
         header_sz = 1;
 
-    packet_in->pi_flags |= ((byte & 0x20) > 0) << PIBIT_SPIN_SHIFT;
-    packet_in->pi_flags |= (byte & 3) << PIBIT_BITS_SHIFT;
-
-    packet_in->pi_header_sz     = header_sz;
-    packet_in->pi_data_sz       = length;
-    packet_in->pi_quic_ver      = 0;
-    packet_in->pi_nonce         = 0;
-    packet_in->pi_refcnt        = 0;
-    packet_in->pi_frame_types   = 0;
-    memset(&packet_in->pi_next, 0, sizeof(packet_in->pi_next));
-    packet_in->pi_refcnt        = 0;
-    packet_in->pi_received      = 0;
+    init_short_packet_in(packet_in, byte, header_sz, length);
 
     /* This is so that Q046 works, ID-18 code does not use it */
     state->pps_p                = packet_in->pi_data + header_sz;
@@ -1974,6 +2007,22 @@ lsquic_ietf_v1_parse_packet_in_short_begin (struct lsquic_packet_in *packet_in,
 }
 
 
+void
+lsquic_ietf_v1_parse_packet_in_short_fast (struct lsquic_packet_in *packet_in,
+                                            size_t length, unsigned cid_len)
+{
+    assert(cid_len > 0 && length > cid_len);
+    assert((packet_in->pi_data[0] & 0xC0) == 0x40);
+
+    memcpy(packet_in->pi_dcid.idbuf, packet_in->pi_data + 1, cid_len);
+    packet_in->pi_dcid.len = cid_len;
+    packet_in->pi_flags |= PI_CONN_ID;
+    init_short_packet_in(packet_in, packet_in->pi_data[0], 1 + cid_len,
+                                                                    length);
+    ietf_v1_parse_packet_in_finish(packet_in, NULL);
+}
+
+
 #if __GNUC__
 #   define popcount __builtin_popcount
 #else
@@ -2115,7 +2164,7 @@ const struct parse_funcs lsquic_parse_funcs_ietf_v1 =
 {
     .pf_gen_reg_pkt_header            =  ietf_v1_gen_reg_pkt_header,
     .pf_parse_packet_in_finish        =  ietf_v1_parse_packet_in_finish,
-    .pf_gen_stream_frame              =  ietf_v1_gen_stream_frame,
+    .pf_gen_stream_frame              =  lsquic_ietf_v1_gen_stream_frame,
     .pf_calc_stream_frame_header_sz   =  ietf_v1_calc_stream_frame_header_sz,
     .pf_parse_stream_frame            =  ietf_v1_parse_stream_frame,
     .pf_parse_ack_frame               =  ietf_v1_parse_ack_frame,
@@ -35,6 +35,19 @@
 static void
 qdh_hblock_unblocked (void *);
 
+static struct lsxpack_header *
+qdh_prepare_decode (void *, struct lsxpack_header *, size_t);
+
+static int
+qdh_process_header (void *, struct lsxpack_header *);
+
+static const struct lsqpack_dec_hset_if dhi_if =
+{
+    .dhi_unblocked      = qdh_hblock_unblocked,
+    .dhi_prepare_decode = qdh_prepare_decode,
+    .dhi_process_header = qdh_process_header,
+};
+
 
 static int
 qdh_write_decoder (struct qpack_dec_hdl *qdh, const unsigned char *buf,
@@ -131,8 +144,12 @@ lsquic_qdh_init (struct qpack_dec_hdl *qdh, struct lsquic_conn *conn,
 {
     qdh->qdh_conn = conn;
     lsquic_frab_list_init(&qdh->qdh_fral, 0x400, NULL, NULL, NULL);
+    /* Headers are decoded directly into buffers supplied by the header set
+     * interface.  Layout is always HTTP/1.x-like, with ": " and "\r\n"; this
+     * is what lsquic_hset_if users expect.
+     */
     lsqpack_dec_init(&qdh->qdh_decoder, (void *) conn, dyn_table_size,
-                        max_risked_streams, qdh_hblock_unblocked);
+                        max_risked_streams, &dhi_if, LSQPACK_DEC_OPT_HTTP1X);
     qdh->qdh_flags |= QDH_INITIALIZED;
     qdh->qdh_enpub = enpub;
     if (qdh->qdh_enpub->enp_hsi_if == lsquic_http1x_if)
@@ -432,83 +449,186 @@ process_content_length (const struct qpack_dec_hdl *qdh /* for logging */,
 }
 
 
-static int
-is_content_length (const struct lsqpack_header *header)
+/* State of a header block that is being decoded.  It lives from the
+ * moment the header block begins until it is either fully decoded or
+ * the stream is unreffed or cancelled.  Trailers are decoded into the
+ * scratch buffer and dropped.
+ */
+struct qdh_hblock_ctx
 {
-    return ((header->qh_flags & QH_ID_SET) && header->qh_static_id == 4)
-        || (header->qh_name_len == 14 && header->qh_name[0] == 'c'
-                    && 0 == memcmp(header->qh_name + 1, "ontent-length", 13))
-        ;
+    struct qpack_dec_hdl    *qdh;
+    void                    *hset;
+    struct cont_len          cont_len;
+    int                      header_err;    /* hsi_process_header() failed */
+    struct lsxpack_header    scratch_xhdr;
+    char                    *scratch_buf;
+    size_t                   scratch_sz;
+};
+
+
+static void
+qdh_hblock_ctx_destroy (struct qpack_dec_hdl *qdh,
+                                            struct lsquic_stream *stream)
+{
+    struct qdh_hblock_ctx *const hbc = stream->sm_hblock_ctx;
+
+    if (hbc)
+    {
+        if (hbc->hset)
+            qdh->qdh_enpub->enp_hsi_if->hsi_discard_header_set(hbc->hset);
+        free(hbc->scratch_buf);
+        free(hbc);
+        stream->sm_hblock_ctx = NULL;
+    }
 }
 
 
 static int
-qdh_supply_hset_to_stream (struct qpack_dec_hdl *qdh,
-            struct lsquic_stream *stream, struct lsqpack_header_list *qlist)
+qdh_hblock_ctx_new (struct qpack_dec_hdl *qdh, struct lsquic_stream *stream)
 {
     const struct lsquic_hset_if *const hset_if = qdh->qdh_enpub->enp_hsi_if;
-    struct uncompressed_headers *uh = NULL;
-    const struct lsqpack_header *header;
-    int st;
-    int push_promise;
-    unsigned i;
-    void *hset;
-    struct cont_len cl;
-    struct lsxpack_header *xhdr;
-    size_t req_space;
+    struct qdh_hblock_ctx *hbc;
 
-    push_promise = lsquic_stream_header_is_pp(stream);
-    hset = hset_if->hsi_create_header_set(qdh->qdh_hsi_ctx, push_promise);
-    if (!hset)
+    assert(!stream->sm_hblock_ctx);
+    hbc = calloc(1, sizeof(*hbc));
+    if (!hbc)
     {
-        LSQ_INFO("call to hsi_create_header_set failed");
+        LSQ_WARN("cannot allocate header block context: %s", strerror(errno));
         return -1;
     }
+    hbc->qdh = qdh;
 
-    LSQ_DEBUG("got header set for stream %"PRIu64, stream->id);
-
-    cl.has = 0;
-    for (i = 0; i < qlist->qhl_count; ++i)
+    if (!lsquic_stream_header_is_trailer(stream))
     {
-        header = qlist->qhl_headers[i];
-        LSQ_DEBUG("%.*s: %.*s", header->qh_name_len, header->qh_name,
-                                        header->qh_value_len, header->qh_value);
-        req_space = header->qh_name_len + header->qh_value_len + 4;
-        xhdr = hset_if->hsi_prepare_decode(hset, NULL, req_space);
-        if (!xhdr)
-        {
-            LSQ_DEBUG("prepare_decode(%zd) failed", req_space);
-            goto err;
-        }
-        memcpy(xhdr->buf + xhdr->name_offset, header->qh_name,
-                                                    header->qh_name_len);
-        xhdr->name_len = header->qh_name_len;
-        memcpy(xhdr->buf + xhdr->name_offset + xhdr->name_len, ": ", 2);
-        xhdr->val_offset = xhdr->name_offset + xhdr->name_len + 2;
-        memcpy(xhdr->buf + xhdr->val_offset,
-                                    header->qh_value, header->qh_value_len);
-        xhdr->val_len = header->qh_value_len;
-        memcpy(xhdr->buf + xhdr->name_offset + xhdr->name_len + 2
-                    + xhdr->val_len, "\r\n", 2);
-        xhdr->dec_overhead = 4;
-        if (header->qh_flags & QH_ID_SET)
+        hbc->hset = hset_if->hsi_create_header_set(qdh->qdh_hsi_ctx,
+                                        lsquic_stream_header_is_pp(stream));
+        if (!hbc->hset)
         {
-            xhdr->flags |= LSXPACK_QPACK_IDX;
-            xhdr->qpack_index = header->qh_static_id;
-        }
-        st = hset_if->hsi_process_header(hset, xhdr);
-        if (st != 0)
-        {
-            LSQ_INFO("header process returned non-OK code %d", st);
-            goto err;
+            LSQ_INFO("call to hsi_create_header_set failed");
+            free(hbc);
+            return -1;
         }
-        if (is_content_length(header))
-            process_content_length(qdh, &cl, header->qh_value,
-                                                        header->qh_value_len);
+        LSQ_DEBUG("got header set for stream %"PRIu64, stream->id);
+    }
+    else
+        LSQ_DEBUG("stream %"PRIu64": trailer will be discarded", stream->id);
+
+    stream->sm_hblock_ctx = hbc;
+    return 0;
+}
+
+
+static struct lsxpack_header *
+qdh_prepare_discard (struct qdh_hblock_ctx *hbc, struct lsxpack_header *xhdr,
+                                                                size_t space)
+{
+    char *buf;
+
+    if (space > LSXPACK_MAX_STRLEN)
+        return NULL;
+
+    if (space > hbc->scratch_sz)
+    {
+        buf = realloc(hbc->scratch_buf, space);
+        if (!buf)
+            return NULL;
+        hbc->scratch_buf = buf;
+        hbc->scratch_sz = space;
+    }
+
+    if (xhdr)
+    {
+        xhdr->buf = hbc->scratch_buf;
+        xhdr->val_len = space;
+    }
+    else
+    {
+        xhdr = &hbc->scratch_xhdr;
+        lsxpack_header_prepare_decode(xhdr, hbc->scratch_buf, 0, space);
+    }
+    return xhdr;
+}
+
+
+static struct lsxpack_header *
+qdh_prepare_decode (void *stream_p, struct lsxpack_header *xhdr, size_t space)
+{
+    struct lsquic_stream *const stream = stream_p;
+    struct qdh_hblock_ctx *const hbc = stream->sm_hblock_ctx;
+    struct qpack_dec_hdl *const qdh = hbc->qdh;
+
+    if (hbc->hset)
+        xhdr = qdh->qdh_enpub->enp_hsi_if->hsi_prepare_decode(hbc->hset,
+                                                                xhdr, space);
+    else
+        xhdr = qdh_prepare_discard(hbc, xhdr, space);
+
+    if (!xhdr)
+        LSQ_DEBUG("prepare_decode(%zd) failed", space);
+    return xhdr;
+}
+
+
+static int
+is_content_length (const struct lsxpack_header *xhdr)
+{
+    return ((xhdr->flags & LSXPACK_QPACK_IDX) && xhdr->qpack_index == 4)
+        || (xhdr->name_len == 14
+                && 0 == memcmp(lsxpack_header_get_name(xhdr),
+                                                    "content-length", 14))
+        ;
+}
+
+
+static int
+qdh_process_header (void *stream_p, struct lsxpack_header *xhdr)
+{
+    struct lsquic_stream *const stream = stream_p;
+    struct qdh_hblock_ctx *const hbc = stream->sm_hblock_ctx;
+    struct qpack_dec_hdl *const qdh = hbc->qdh;
+    int st;
+
+    LSQ_DEBUG("%.*s: %.*s", (int) xhdr->name_len,
+                lsxpack_header_get_name(xhdr), (int) xhdr->val_len,
+                lsxpack_header_get_value(xhdr));
+
+    if (!hbc->hset)
+        return 0;
+
+    if (is_content_length(xhdr))
+        process_content_length(qdh, &hbc->cont_len,
+                    lsxpack_header_get_value(xhdr), xhdr->val_len);
+
+    st = qdh->qdh_enpub->enp_hsi_if->hsi_process_header(hbc->hset, xhdr);
+    if (st != 0)
+    {
+        LSQ_INFO("header process returned non-OK code %d", st);
+        hbc->header_err = 1;
+        return -1;
     }
+    return 0;
+}
+
+
+/* Hands the decoded header set over to the stream.  The header block
+ * context is released.
+ */
+static int
+qdh_supply_hset_to_stream (struct qpack_dec_hdl *qdh,
+                                                struct lsquic_stream *stream)
+{
+    const struct lsquic_hset_if *const hset_if = qdh->qdh_enpub->enp_hsi_if;
+    struct qdh_hblock_ctx *const hbc = stream->sm_hblock_ctx;
+    struct uncompressed_headers *uh = NULL;
+    struct cont_len cl;
+    void *hset;
+    int st;
+
+    hset = hbc->hset;
+    cl = hbc->cont_len;
+    hbc->hset = NULL;
+    qdh_hblock_ctx_destroy(qdh, stream);
 
-    lsqpack_dec_destroy_header_list(qlist);
-    qlist = NULL;
     st = hset_if->hsi_process_header(hset, NULL);
     if (st != 0)
         goto err;
@@ -525,32 +645,29 @@ qdh_supply_hset_to_stream (struct qpack_dec_hdl *qdh,
     uh->uh_hset = hset;
     if (0 != lsquic_stream_uh_in(stream, uh))
         goto err;
-    LSQ_DEBUG("converted qlist to hset and gave it to stream %"PRIu64,
-                                                                stream->id);
+    LSQ_DEBUG("gave hset to stream %"PRIu64, stream->id);
     if (cl.has > 0)
         (void) lsquic_stream_verify_len(stream, cl.value);
     return 0;
 
   err:
-    if (qlist)
-        lsqpack_dec_destroy_header_list(qlist);
     hset_if->hsi_discard_header_set(hset);
     free(uh);
     return -1;
 }
 
 
-/* Releases qlist */
 static int
-qdh_process_qlist (struct qpack_dec_hdl *qdh,
-            struct lsquic_stream *stream, struct lsqpack_header_list *qlist)
+qdh_hblock_done (struct qpack_dec_hdl *qdh, struct lsquic_stream *stream)
 {
-    if (!lsquic_stream_header_is_trailer(stream))
-        return qdh_supply_hset_to_stream(qdh, stream, qlist);
+    struct qdh_hblock_ctx *const hbc = stream->sm_hblock_ctx;
+
+    if (hbc->hset)
+        return qdh_supply_hset_to_stream(qdh, stream);
     else
     {
         LSQ_DEBUG("discard trailer header set");
-        lsqpack_dec_destroy_header_list(qlist);
+        qdh_hblock_ctx_destroy(qdh, stream);
         return 0;
     }
 }
@@ -559,42 +676,39 @@ qdh_process_qlist (struct qpack_dec_hdl *qdh,
 static enum lsqpack_read_header_status
 qdh_header_read_results (struct qpack_dec_hdl *qdh,
         struct lsquic_stream *stream, enum lsqpack_read_header_status rhs,
-        struct lsqpack_header_list *qlist, const unsigned char *dec_buf,
-        size_t dec_buf_sz)
+        const unsigned char *dec_buf, size_t dec_buf_sz)
 {
     const struct lsqpack_dec_err *qerr;
 
     if (rhs == LQRHS_DONE)
     {
-        if (qlist)
+        if (0 != qdh_hblock_done(qdh, stream))
+            return LQRHS_ERROR;
+        if (qdh->qdh_dec_sm_out)
         {
-            if (0 != qdh_process_qlist(qdh, stream, qlist))
-                return LQRHS_ERROR;
-            if (qdh->qdh_dec_sm_out)
+            if (dec_buf_sz
+                && 0 != qdh_write_decoder(qdh, dec_buf, dec_buf_sz))
             {
-                if (dec_buf_sz
-                    && 0 != qdh_write_decoder(qdh, dec_buf, dec_buf_sz))
-                {
-                    return LQRHS_ERROR;
-                }
-                if (dec_buf_sz || lsqpack_dec_ici_pending(&qdh->qdh_decoder))
-                    lsquic_stream_wantwrite(qdh->qdh_dec_sm_out, 1);
+                return LQRHS_ERROR;
             }
-        }
-        else
-        {
-            LSQ_WARN("read header status is DONE but header list is not set");
-            assert(0);
-            return LQRHS_ERROR;
+            if (dec_buf_sz || lsqpack_dec_ici_pending(&qdh->qdh_decoder))
+                lsquic_stream_wantwrite(qdh->qdh_dec_sm_out, 1);
         }
     }
     else if (rhs == LQRHS_ERROR)
     {
-        qerr = lsqpack_dec_get_err_info(&qdh->qdh_decoder);
-        qdh->qdh_conn->cn_if->ci_abort_error(qdh->qdh_conn, 1,
-            HEC_QPACK_DECOMPRESSION_FAILED, "QPACK decompression error; "
-            "stream %"PRIu64", offset %"PRIu64", line %d", qerr->stream_id,
-            qerr->off, qerr->line);
+        /* If the header set interface rejected a header, this is not a
+         * decompression error: the caller aborts the connection.
+         */
+        if (!(stream->sm_hblock_ctx && stream->sm_hblock_ctx->header_err))
+        {
+            qerr = lsqpack_dec_get_err_info(&qdh->qdh_decoder);
+            qdh->qdh_conn->cn_if->ci_abort_error(qdh->qdh_conn, 1,
+                HEC_QPACK_DECOMPRESSION_FAILED, "QPACK decompression error; "
+                "stream %"PRIu64", offset %"PRIu64", line %d", qerr->stream_id,
+                qerr->off, qerr->line);
+        }
+        qdh_hblock_ctx_destroy(qdh, stream);
     }
 
     return rhs;
@@ -607,17 +721,17 @@ lsquic_qdh_header_in_begin (struct qpack_dec_hdl *qdh,
                         const unsigned char **buf, size_t bufsz)
 {
     enum lsqpack_read_header_status rhs;
-    struct lsqpack_header_list *qlist;
     size_t dec_buf_sz;
     unsigned char dec_buf[LSQPACK_LONGEST_HEADER_ACK];
 
     if (qdh->qdh_flags & QDH_INITIALIZED)
     {
+        if (0 != qdh_hblock_ctx_new(qdh, stream))
+            return LQRHS_ERROR;
         dec_buf_sz = sizeof(dec_buf);
         rhs = lsqpack_dec_header_in(&qdh->qdh_decoder, stream, stream->id,
-                        header_size, buf, bufsz, &qlist, dec_buf, &dec_buf_sz);
-        return qdh_header_read_results(qdh, stream, rhs, qlist, dec_buf,
-                                                                dec_buf_sz);
+                        header_size, buf, bufsz, dec_buf, &dec_buf_sz);
+        return qdh_header_read_results(qdh, stream, rhs, dec_buf, dec_buf_sz);
     }
     else
     {
@@ -633,17 +747,16 @@ lsquic_qdh_header_in_continue (struct qpack_dec_hdl *qdh,
         struct lsquic_stream *stream, const unsigned char **buf, size_t bufsz)
 {
     enum lsqpack_read_header_status rhs;
-    struct lsqpack_header_list *qlist;
     size_t dec_buf_sz;
     unsigned char dec_buf[LSQPACK_LONGEST_HEADER_ACK];
 
     if (qdh->qdh_flags & QDH_INITIALIZED)
     {
+        assert(stream->sm_hblock_ctx);
         dec_buf_sz = sizeof(dec_buf);
         rhs = lsqpack_dec_header_read(&qdh->qdh_decoder, stream,
-                                    buf, bufsz, &qlist, dec_buf, &dec_buf_sz);
-        return qdh_header_read_results(qdh, stream, rhs, qlist, dec_buf,
-                                                                dec_buf_sz);
+                                    buf, bufsz, dec_buf, &dec_buf_sz);
+        return qdh_header_read_results(qdh, stream, rhs, dec_buf, dec_buf_sz);
     }
     else
     {
@@ -661,6 +774,7 @@ lsquic_qdh_unref_stream (struct qpack_dec_hdl *qdh,
         LSQ_DEBUG("unreffed stream %"PRIu64, stream->id);
     else
         LSQ_WARN("cannot unref stream %"PRIu64, stream->id);
+    qdh_hblock_ctx_destroy(qdh, stream);
 }
 
 
@@ -671,6 +785,7 @@ lsquic_qdh_cancel_stream (struct qpack_dec_hdl *qdh,
     ssize_t nw;
     unsigned char buf[LSQPACK_LONGEST_CANCEL];
 
+    qdh_hblock_ctx_destroy(qdh, stream);
     nw = lsqpack_dec_cancel_stream(&qdh->qdh_decoder, stream, buf, sizeof(buf));
     if (nw > 0)
     {
@@ -12,6 +12,7 @@
 
 #include "lsquic.h"
 #include "lsquic_types.h"
+#include "lsxpack_header.h"
 #include "lsquic_int_types.h"
 #include "lsquic_sfcw.h"
 #include "lsquic_varint.h"
@@ -332,6 +333,7 @@ qeh_write_headers (struct qpack_enc_hdl *qeh, lsquic_stream_id_t stream_id,
     enum lsqpack_enc_status st;
     int i, s, write_to_stream;
     enum lsqpack_enc_flags enc_flags;
+    struct lsxpack_header xhdr;
     unsigned char enc_buf[ qeh->qeh_encoder.qpe_cur_max_capacity * 2 ];
 
     s = lsqpack_enc_start_header(&qeh->qeh_encoder, stream_id, 0);
@@ -354,13 +356,20 @@ qeh_write_headers (struct qpack_enc_hdl *qeh, lsquic_stream_id_t stream_id,
     total_enc_sz = 0;
     for (i = 0; i < headers->count; ++i)
     {
+        if (headers->headers[i].name.iov_len > LSXPACK_MAX_STRLEN
+                || headers->headers[i].value.iov_len > LSXPACK_MAX_STRLEN)
+        {
+            LSQ_INFO("header #%d is too long", i);
+            return QWH_ERR;
+        }
+        lsxpack_header_set_ptr(&xhdr, headers->headers[i].name.iov_base,
+                    headers->headers[i].name.iov_len,
+                    headers->headers[i].value.iov_base,
+                    headers->headers[i].value.iov_len);
         enc_sz = sizeof(enc_buf);
         hea_sz = end - p;
         st = lsqpack_enc_encode(&qeh->qeh_encoder, enc_buf, &enc_sz, p,
-                    &hea_sz, headers->headers[i].name.iov_base,
-                    headers->headers[i].name.iov_len,
-                    headers->headers[i].value.iov_base,
-                    headers->headers[i].value.iov_len, enc_flags);
+                    &hea_sz, &xhdr, enc_flags);
         switch (st)
         {
         case LQES_OK:
@@ -49,6 +49,20 @@ lsquic_rechist_cleanup (lsquic_rechist_t *rechist)
 }
 
 
+static void
+drop_lowest_range (struct lsquic_rechist *rechist)
+{
+    const struct packet_interval *pi;
+
+    pi = TAILQ_LAST(&rechist->rh_pints.pk_intervals, pinhead);
+    LSQ_INFO("too many ranges: drop lowest range [%"PRIu64", %"PRIu64"]",
+                                                pi->range.low, pi->range.high);
+    rechist->rh_n_packets -= (unsigned) (pi->range.high - pi->range.low + 1);
+    rechist->rh_forgotten = pi->range.high + 1;
+    lsquic_packints_remove_last(&rechist->rh_pints);
+}
+
+
 enum received_st
 lsquic_rechist_received (lsquic_rechist_t *rechist, lsquic_packno_t packno,
                          lsquic_time_t now)
@@ -63,6 +77,8 @@ lsquic_rechist_received (lsquic_rechist_t *rechist, lsquic_packno_t packno,
         else
             return REC_ST_ERR;
     }
+    if (packno < rechist->rh_forgotten)
+        return REC_ST_DUP;
 
     first_range = lsquic_packints_first(&rechist->rh_pints);
     if (!first_range || packno > first_range->high)
@@ -72,6 +88,9 @@ lsquic_rechist_received (lsquic_rechist_t *rechist, lsquic_packno_t packno,
     {
     case PACKINTS_OK:
         ++rechist->rh_n_packets;
+        if (lsquic_packints_count(&rechist->rh_pints)
+                                                > LSQUIC_RECHIST_MAX_RANGES)
+            drop_lowest_range(rechist);
         return REC_ST_OK;
     case PACKINTS_DUP:
         return REC_ST_DUP;
@@ -108,6 +127,7 @@ lsquic_rechist_stop_wait (lsquic_rechist_t *rechist, lsquic_packno_t cutoff)
                 rechist->rh_n_packets -= (unsigned)(pi->range.high - pi->range.low + 1);
                 TAILQ_REMOVE(&rechist->rh_pints.pk_intervals, pi, next_pi);
                 free(pi);
+                --rechist->rh_pints.pk_count;
             }
             else
             {
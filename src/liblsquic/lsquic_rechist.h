@@ -15,10 +15,15 @@ struct lsquic_conn;
 struct lsquic_rechist {
     struct packints                 rh_pints;
     lsquic_packno_t                 rh_cutoff;
+    /* Packets smaller than this were dropped from history because there
+     * were too many ranges.  They are treated as duplicates.
+     */
+    lsquic_packno_t                 rh_forgotten;
     lsquic_time_t                   rh_largest_acked_received;
     const struct lsquic_conn       *rh_conn;        /* Used for logging */
     /* Chromium limits the number of tracked packets (see
-     * kMaxTrackedPackets).  We could do this, too.
+     * kMaxTrackedPackets).  We limit the number of ranges instead: see
+     * LSQUIC_RECHIST_MAX_RANGES.
      */
     unsigned                        rh_n_packets;
     enum {
@@ -34,6 +39,14 @@ struct lsquic_rechist {
 
 typedef struct lsquic_rechist lsquic_rechist_t;
 
+/* A peer that skips packet numbers can make the history arbitrarily long.
+ * When there are more ranges than this, the lowest range is dropped.  This
+ * is many more ranges than can fit into an ACK frame.
+ */
+#ifndef LSQUIC_RECHIST_MAX_RANGES
+#define LSQUIC_RECHIST_MAX_RANGES 1000
+#endif
+
 void
 lsquic_rechist_init (struct lsquic_rechist *, const struct lsquic_conn *, int);
 
@@ -49,6 +49,7 @@
 #include "lsquic_frab_list.h"
 #include "lsquic_qdec_hdl.h"
 #include "lsquic_crand.h"
+#include "lsquic_lat_hist.h"
 
 #define LSQUIC_LOGGER_MODULE LSQLM_SENDCTL
 #define LSQUIC_LOG_CONN_ID lsquic_conn_log_cid(ctl->sc_conn_pub->lconn)
@@ -316,6 +317,7 @@ lsquic_send_ctl_init (lsquic_send_ctl_t *ctl, struct lsquic_alarmset *alset,
     TAILQ_INIT(&ctl->sc_unacked_packets[PNS_HSK]);
     TAILQ_INIT(&ctl->sc_unacked_packets[PNS_APP]);
     TAILQ_INIT(&ctl->sc_lost_packets);
+    TAILQ_INIT(&ctl->sc_0rtt_stash);
     ctl->sc_enpub = enpub;
     ctl->sc_alset = alset;
     ctl->sc_ver_neg = ver_neg;
@@ -541,6 +543,8 @@ send_ctl_sched_Xpend_common (struct lsquic_send_ctl *ctl,
                       struct lsquic_packet_out *packet_out)
 {
     packet_out->po_flags |= PO_SCHED;
+    if (ctl->sc_enpub->enp_lat_hists && !packet_out->po_scheduled)
+        packet_out->po_scheduled = lsquic_time_now();
     ++ctl->sc_n_scheduled;
     ctl->sc_bytes_scheduled += packet_out_total_sz(packet_out);
     lsquic_send_ctl_sanity_check(ctl);
@@ -655,6 +659,9 @@ lsquic_send_ctl_sent_packet (lsquic_send_ctl_t *ctl,
         packet_out->po_packno, lsquic_frame_types_to_str(frames,
             sizeof(frames), packet_out->po_frame_types));
     lsquic_senhist_add(&ctl->sc_senhist, packet_out->po_packno);
+    if (packet_out->po_lflags & (POL_STREAM_FIRST|POL_STREAM_FIN))
+        lsquic_packet_out_sent_streams(packet_out,
+                                            ctl->sc_conn_pub->lconn->cn_pf);
     if (ctl->sc_ci->cci_sent)
         ctl->sc_ci->cci_sent(CGP(ctl), packet_out, ctl->sc_bytes_unacked_all,
                                             ctl->sc_flags & SC_APP_LIMITED);
@@ -1318,6 +1325,11 @@ lsquic_send_ctl_cleanup (lsquic_send_ctl_t *ctl)
         packet_out->po_flags &= ~PO_LOST;
         send_ctl_destroy_packet(ctl, packet_out);
     }
+    while ((packet_out = TAILQ_FIRST(&ctl->sc_0rtt_stash)))
+    {
+        TAILQ_REMOVE(&ctl->sc_0rtt_stash, packet_out, po_next);
+        send_ctl_destroy_packet(ctl, packet_out);
+    }
     for (n = 0; n < sizeof(ctl->sc_buffered_packets) /
                                 sizeof(ctl->sc_buffered_packets[0]); ++n)
     {
@@ -1367,6 +1379,17 @@ lsquic_send_ctl_pacer_blocked (struct lsquic_send_ctl *ctl)
 }
 
 
+/* Until the peer address is validated, the server may send no more than
+ * three times as many bytes as it has received [draft-ietf-quic-transport-27],
+ * Section 8.1.
+ */
+static int
+send_ctl_ampl_can_send (const struct lsquic_send_ctl *ctl, size_t size)
+{
+    return ctl->sc_ampl_bytes_in * 3 >= ctl->sc_ampl_bytes_out + size;
+}
+
+
 #ifndef NDEBUG
 #if __GNUC__
 __attribute__((weak))
@@ -1379,13 +1402,31 @@ lsquic_send_ctl_can_send (lsquic_send_ctl_t *ctl)
     LSQ_DEBUG("%s: n_out: %u (unacked_all: %u); cwnd: %"PRIu64, __func__,
         n_out, ctl->sc_bytes_unacked_all,
         ctl->sc_ci->cci_get_cwnd(CGP(ctl)));
+    if ((ctl->sc_flags & SC_ANTI_AMPL)
+            && !send_ctl_ampl_can_send(ctl, ctl->sc_bytes_scheduled
+                                                        + SC_PACK_SIZE(ctl)))
+    {
+        LSQ_DEBUG("%s: amplification limit: %u bytes in, %u bytes out",
+            __func__, ctl->sc_ampl_bytes_in, ctl->sc_ampl_bytes_out);
+        return 0;
+    }
     if (ctl->sc_flags & SC_PACE)
     {
         if (n_out >= ctl->sc_ci->cci_get_cwnd(CGP(ctl)))
             return 0;
         if (lsquic_pacer_can_schedule(&ctl->sc_pacer,
                                ctl->sc_n_scheduled + ctl->sc_n_in_flight_all))
+        {
+            if (ctl->sc_pacer_delayed_since)
+            {
+                LAT_HIST_RECORD(ctl->sc_enpub, LSQLH_PACER_DELAY,
+                    ctl->sc_pacer.pa_now - ctl->sc_pacer_delayed_since);
+                ctl->sc_pacer_delayed_since = 0;
+            }
             return 1;
+        }
+        if (ctl->sc_enpub->enp_lat_hists && !ctl->sc_pacer_delayed_since)
+            ctl->sc_pacer_delayed_since = ctl->sc_pacer.pa_now;
         if (ctl->sc_flags & SC_SCHED_TICK)
         {
             ctl->sc_flags &= ~SC_SCHED_TICK;
@@ -1679,6 +1720,22 @@ lsquic_send_ctl_next_packet_to_send (struct lsquic_send_ctl *ctl, size_t size)
         }
     }
 
+    if (UNLIKELY(packet_out->po_header_type == HETY_0RTT)
+            && (ctl->sc_conn_pub->lconn->cn_flags
+                & (LSCONN_IETF|LSCONN_SERVER|LSCONN_HANDSHAKE_DONE))
+                                    == (LSCONN_IETF|LSCONN_HANDSHAKE_DONE))
+    {
+        /* 0-RTT packets that have not been sent by the time the handshake
+         * is complete go out as 1-RTT packets.
+         */
+        LSQ_DEBUG("convert 0-RTT packet %"PRIu64" to 1-RTT",
+                                                    packet_out->po_packno);
+        if (packet_out->po_flags & PO_ENCRYPTED)
+            send_ctl_return_enc_data(ctl, packet_out);
+        packet_out->po_header_type = HETY_NOT_SET;
+        packet_out->po_flags &= ~PO_LONGHEAD;
+    }
+
     if (UNLIKELY(size))
     {
         if (packet_out_total_sz(packet_out) + size > SC_PACK_SIZE(ctl))
@@ -1687,6 +1744,16 @@ lsquic_send_ctl_next_packet_to_send (struct lsquic_send_ctl *ctl, size_t size)
             "previous packet(s) (%zu bytes) (coalescing)",
             packet_out->po_packno, packet_out_total_sz(packet_out), size);
     }
+
+    if (UNLIKELY(ctl->sc_flags & SC_ANTI_AMPL)
+        && !send_ctl_ampl_can_send(ctl, packet_out_total_sz(packet_out)))
+    {
+        LSQ_DEBUG("cannot send packet %"PRIu64" of size %zu: client address "
+            "has not been validated", packet_out->po_packno,
+            packet_out_total_sz(packet_out));
+        return NULL;
+    }
+
     send_ctl_sched_remove(ctl, packet_out);
 
     if (dec_limit)
@@ -1725,6 +1792,9 @@ lsquic_send_ctl_next_packet_to_send (struct lsquic_send_ctl *ctl, size_t size)
         }
     }
 
+    if (UNLIKELY(ctl->sc_flags & SC_ANTI_AMPL))
+        ctl->sc_ampl_bytes_out += packet_out_total_sz(packet_out);
+
     return packet_out;
 }
 
@@ -1733,6 +1803,8 @@ void
 lsquic_send_ctl_delayed_one (lsquic_send_ctl_t *ctl,
                                             lsquic_packet_out_t *packet_out)
 {
+    size_t sz;
+
     send_ctl_sched_prepend(ctl, packet_out);
     if (packet_out->po_flags & PO_LIMITED)
         ++ctl->sc_next_limit;
@@ -1745,6 +1817,12 @@ lsquic_send_ctl_delayed_one (lsquic_send_ctl_t *ctl,
     if ((ctl->sc_flags & SC_QL_BITS)
                             && packet_out->po_header_type == HETY_NOT_SET)
         ctl->sc_square_count -= 1 + (ctl->sc_gap + 1 == packet_out->po_packno);
+    if (UNLIKELY(ctl->sc_flags & SC_ANTI_AMPL))
+    {
+        sz = packet_out_total_sz(packet_out);
+        ctl->sc_ampl_bytes_out -= sz < ctl->sc_ampl_bytes_out
+                                            ? sz : ctl->sc_ampl_bytes_out;
+    }
 }
 
 
@@ -1829,6 +1907,10 @@ send_ctl_allocate_packet (struct lsquic_send_ctl *ctl, enum packno_bits bits,
         else
             packet_out->po_header_type = HETY_HANDSHAKE;
     }
+    else if ((ctl->sc_flags & SC_0RTT)
+            && !(ctl->sc_conn_pub->lconn->cn_flags & LSCONN_HANDSHAKE_DONE))
+        /* Client sending application data before handshake is done */
+        packet_out->po_header_type = HETY_0RTT;
 
     lsquic_packet_out_set_pns(packet_out, pns);
     packet_out->po_lflags |= ctl->sc_ecn << POECN_SHIFT;
@@ -2986,3 +3068,122 @@ lsquic_send_ctl_begin_optack_detection (struct lsquic_send_ctl *ctl)
     rand = lsquic_crand_get_byte(ctl->sc_enpub->enp_crand);
     ctl->sc_gap = ctl->sc_cur_packno + 1 + rand;
 }
+
+
+void
+lsquic_send_ctl_anti_ampl (struct lsquic_send_ctl *ctl, unsigned bytes_in,
+                                                        unsigned bytes_out)
+{
+    LSQ_DEBUG("client address has not been validated: limit amplification "
+        "(%u bytes in, %u bytes out so far)", bytes_in, bytes_out);
+    ctl->sc_flags |= SC_ANTI_AMPL;
+    ctl->sc_ampl_bytes_in = bytes_in;
+    ctl->sc_ampl_bytes_out = bytes_out;
+}
+
+
+void
+lsquic_send_ctl_addr_validated (struct lsquic_send_ctl *ctl)
+{
+    if (ctl->sc_flags & SC_ANTI_AMPL)
+    {
+        LSQ_DEBUG("client address validated: lift amplification limit");
+        ctl->sc_flags &= ~SC_ANTI_AMPL;
+    }
+}
+
+
+static void
+send_ctl_stash_0rtt_packet (struct lsquic_send_ctl *ctl,
+                        struct lsquic_packet_out *packet_out,
+                        struct lsquic_packet_out **next)
+{
+    send_ctl_destroy_chain(ctl, packet_out, next);
+    if (packet_out->po_flags & PO_ENCRYPTED)
+        send_ctl_return_enc_data(ctl, packet_out);
+    TAILQ_INSERT_TAIL(&ctl->sc_0rtt_stash, packet_out, po_next);
+    LSQ_DEBUG("stashed 0-RTT packet %"PRIu64, packet_out->po_packno);
+}
+
+
+/* The server rejected early data.  None of the 0-RTT packets -- sent or
+ * not -- are of any use now.  They are taken off the send queues and kept
+ * until the handshake is complete, at which point they are resent in
+ * 1-RTT packets: see lsquic_send_ctl_respool_0rtt().
+ */
+void
+lsquic_send_ctl_stash_0rtt_packets (struct lsquic_send_ctl *ctl)
+{
+    struct lsquic_packet_out *packet_out, *next;
+    unsigned packet_sz;
+
+    for (packet_out = TAILQ_FIRST(&ctl->sc_unacked_packets[PNS_APP]);
+                                                packet_out; packet_out = next)
+    {
+        next = TAILQ_NEXT(packet_out, po_next);
+        if (packet_out->po_header_type == HETY_0RTT
+                && !(packet_out->po_flags & (PO_LOSS_REC|PO_POISON)))
+        {
+            packet_sz = packet_out_sent_sz(packet_out);
+            send_ctl_unacked_remove(ctl, packet_out, packet_sz);
+            send_ctl_stash_0rtt_packet(ctl, packet_out, &next);
+        }
+    }
+
+    for (packet_out = TAILQ_FIRST(&ctl->sc_lost_packets); packet_out;
+                                                            packet_out = next)
+    {
+        next = TAILQ_NEXT(packet_out, po_next);
+        if (packet_out->po_header_type == HETY_0RTT)
+        {
+            TAILQ_REMOVE(&ctl->sc_lost_packets, packet_out, po_next);
+            packet_out->po_flags &= ~PO_LOST;
+            send_ctl_stash_0rtt_packet(ctl, packet_out, NULL);
+        }
+    }
+
+    for (packet_out = TAILQ_FIRST(&ctl->sc_scheduled_packets); packet_out;
+                                                            packet_out = next)
+    {
+        next = TAILQ_NEXT(packet_out, po_next);
+        if (packet_out->po_header_type == HETY_0RTT)
+        {
+            send_ctl_maybe_renumber_sched_to_right(ctl, packet_out);
+            send_ctl_sched_remove(ctl, packet_out);
+            send_ctl_stash_0rtt_packet(ctl, packet_out, NULL);
+        }
+    }
+}
+
+
+/* Schedule stashed 0-RTT packets as 1-RTT packets with new packet numbers */
+void
+lsquic_send_ctl_respool_0rtt (struct lsquic_send_ctl *ctl)
+{
+    struct lsquic_packet_out *packet_out;
+    unsigned count;
+
+    assert(ctl->sc_conn_pub->lconn->cn_flags & LSCONN_HANDSHAKE_DONE);
+    count = 0;
+    while ((packet_out = TAILQ_FIRST(&ctl->sc_0rtt_stash)))
+    {
+        TAILQ_REMOVE(&ctl->sc_0rtt_stash, packet_out, po_next);
+        lsquic_packet_out_elide_reset_stream_frames(packet_out, 0);
+        if (packet_out->po_regen_sz >= packet_out->po_data_sz)
+        {
+            LSQ_DEBUG("nothing to resend in 0-RTT packet %"PRIu64,
+                                                    packet_out->po_packno);
+            send_ctl_destroy_packet(ctl, packet_out);
+            continue;
+        }
+        packet_out->po_header_type = HETY_NOT_SET;
+        packet_out->po_flags &= ~PO_LONGHEAD;
+        update_for_resending(ctl, packet_out);
+        send_ctl_sched_append(ctl, packet_out);
+        ++count;
+    }
+
+    if (count)
+        LSQ_DEBUG("rescheduled %u rejected 0-RTT packet%.*s as 1-RTT",
+                                                count, count != 1, "s");
+}
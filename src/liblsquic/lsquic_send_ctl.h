@@ -48,6 +48,8 @@ enum send_ctl_flags {
     SC_SANITY_CHECK =  1 << 15,
     SC_CIDLEN       =  1 << 16,     /* sc_cidlen is set */
     SC_POISON       =  1 << 17,     /* poisoned packet exists */
+    SC_0RTT         =  1 << 18,     /* client sends 0-RTT data */
+    SC_ANTI_AMPL    =  1 << 19,     /* server: peer address not validated */
 };
 
 typedef struct lsquic_send_ctl {
@@ -83,11 +85,15 @@ typedef struct lsquic_send_ctl {
 
     /* Second section: everything else. */
     struct lsquic_packets_tailq     sc_scheduled_packets,
-                                    sc_lost_packets;
+                                    sc_lost_packets,
+                                    sc_0rtt_stash;  /* Rejected 0-RTT */
     struct buf_packet_q             sc_buffered_packets[BPT_OTHER_PRIO + 1];
     const struct ver_neg           *sc_ver_neg;
     struct lsquic_conn_public      *sc_conn_pub;
     struct pacer                    sc_pacer;
+    lsquic_time_t                   sc_pacer_delayed_since; /* For latency
+                                                             * histogram
+                                                             */
     lsquic_packno_t                 sc_cur_packno;
     lsquic_packno_t                 sc_largest_sent_at_cutback;
     lsquic_packno_t                 sc_max_rtt_packno;
@@ -132,6 +138,11 @@ typedef struct lsquic_send_ctl {
     unsigned                        sc_loss_count;  /* Used to set loss bit */
     unsigned                        sc_square_count;/* Used to set square bit */
     signed char                     sc_cidlen;      /* For debug purposes */
+    /* While SC_ANTI_AMPL is set, the server does not send more than three
+     * times the number of bytes it has received.
+     */
+    unsigned                        sc_ampl_bytes_in,
+                                    sc_ampl_bytes_out;
 } lsquic_send_ctl_t;
 
 void
@@ -383,4 +394,22 @@ lsquic_send_ctl_begin_optack_detection (struct lsquic_send_ctl *);
 
 #define lsquic_send_ctl_n_unacked(ctl_) ((ctl_)->sc_n_in_flight_retx)
 
+void
+lsquic_send_ctl_anti_ampl (struct lsquic_send_ctl *, unsigned bytes_in,
+                                                        unsigned bytes_out);
+
+#define lsquic_send_ctl_ampl_bytes_in(ctl_, bytes_) do {            \
+    if ((ctl_)->sc_flags & SC_ANTI_AMPL)                            \
+        (ctl_)->sc_ampl_bytes_in += (bytes_);                       \
+} while (0)
+
+void
+lsquic_send_ctl_addr_validated (struct lsquic_send_ctl *);
+
+void
+lsquic_send_ctl_stash_0rtt_packets (struct lsquic_send_ctl *);
+
+void
+lsquic_send_ctl_respool_0rtt (struct lsquic_send_ctl *);
+
 #endif
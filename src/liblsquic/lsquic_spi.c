@@ -14,6 +14,7 @@
 #include <vc_compat.h>
 #endif
 
+#include "lsquic.h"
 #include "lsquic_types.h"
 #include "lsquic_int_types.h"
 #include "lsquic_sfcw.h"
@@ -387,3 +388,95 @@ lsquic_spi_drop_non_high (struct stream_prio_iter *iter)
 {
     spi_drop_high_or_non_high(iter, 0);
 }
+
+
+#define SPI_KEY_NO_DEADLINE (1ULL << 62)
+
+
+/* Smaller key goes first.  Zero is reserved for critical and starving
+ * streams.
+ */
+static uint64_t
+spi_sched_key (struct lsquic_stream *stream, enum spi_sched sched,
+                                    lsquic_time_t now, lsquic_time_t max_wait)
+{
+    uint64_t written, size;
+
+    if (lsquic_stream_is_critical(stream))
+        return 0;
+
+    if (stream->sm_last_write == 0)
+        stream->sm_last_write = now;
+    else if (now - stream->sm_last_write > max_wait)
+        return 0;
+
+    if (sched == SPI_SCHED_EDF && stream->sm_deadline)
+        return 1 + (stream->sm_deadline & (SPI_KEY_NO_DEADLINE - 1));
+
+    written = stream->tosend_off + stream->sm_n_buffered;
+    if (stream->sm_size_hint)
+        size = stream->sm_size_hint > written
+             ? stream->sm_size_hint - written : 0;
+    else
+        size = written;
+    if (size >= SPI_KEY_NO_DEADLINE)
+        size = SPI_KEY_NO_DEADLINE - 1;
+
+    if (sched == SPI_SCHED_EDF)
+        return SPI_KEY_NO_DEADLINE + size;
+    else
+        return 1 + size;
+}
+
+
+/* Insertion sort: stable, so that streams with equal keys keep their
+ * round-robin order.  There are usually few streams per priority and they
+ * are mostly in order already.
+ */
+static void
+spi_sort_queue (struct lsquic_streams_tailq *head)
+{
+    struct lsquic_stream *stream, *next, *pos, *prev;
+
+    stream = TAILQ_FIRST(head);
+    if (!stream)
+        return;
+
+    for (stream = TAILQ_NEXT(stream, next_prio_stream); stream; stream = next)
+    {
+        next = TAILQ_NEXT(stream, next_prio_stream);
+        pos = TAILQ_PREV(stream, lsquic_streams_tailq, next_prio_stream);
+        if (pos->sm_sched_key <= stream->sm_sched_key)
+            continue;
+        while ((prev = TAILQ_PREV(pos, lsquic_streams_tailq,
+                                                        next_prio_stream))
+                                && prev->sm_sched_key > stream->sm_sched_key)
+            pos = prev;
+        TAILQ_REMOVE(head, stream, next_prio_stream);
+        TAILQ_INSERT_BEFORE(pos, stream, next_prio_stream);
+    }
+}
+
+
+void
+lsquic_spi_sort (struct stream_prio_iter *iter, enum spi_sched sched,
+                                    lsquic_time_t now, lsquic_time_t max_wait)
+{
+    struct lsquic_stream *stream;
+    unsigned prio, set, bit;
+
+    if (sched == SPI_SCHED_RR || iter->spi_n_added < 2)
+        return;
+
+    for (prio = 0; prio < 256; ++prio)
+    {
+        set = prio >> 6;
+        bit = prio & 0x3F;
+        if (!(iter->spi_set[set] & (1ULL << bit)))
+            continue;
+        TAILQ_FOREACH(stream, &iter->spi_streams[prio], next_prio_stream)
+            stream->sm_sched_key = spi_sched_key(stream, sched, now,
+                                                                max_wait);
+        spi_sort_queue(&iter->spi_streams[prio]);
+    }
+}
@@ -16,6 +16,14 @@
 
 enum stream_q_flags;
 
+/* Values of es_stream_sched */
+enum spi_sched
+{
+    SPI_SCHED_RR,       /* Round-robin */
+    SPI_SCHED_SRF,      /* Shortest remaining first */
+    SPI_SCHED_EDF,      /* Earliest deadline first */
+};
+
 
 struct stream_prio_iter
 {
@@ -55,4 +63,12 @@ lsquic_spi_drop_non_high (struct stream_prio_iter *);
 void
 lsquic_spi_drop_high (struct stream_prio_iter *);
 
+/* Order streams of the same priority according to `sched'.  Streams that
+ * have not written for longer than `max_wait' microseconds go first.  Must
+ * be called before lsquic_spi_first().
+ */
+void
+lsquic_spi_sort (struct stream_prio_iter *, enum spi_sched sched,
+                                    lsquic_time_t now, lsquic_time_t max_wait);
+
 #endif
@@ -0,0 +1,153 @@
+/* Copyright (c) 2017 - 2020 LiteSpeed Technologies Inc.  See LICENSE. */
+/*
+ * lsquic_ssl_pool.c -- Reuse server SSL objects
+ *
+ * There are usually very few server SSL_CTX objects -- one per listening
+ * socket or even one per engine -- so they are kept in a short array that
+ * is searched linearly.  The pool holds a reference to each SSL_CTX, so
+ * that its address cannot be reused while SSL objects are kept for it.
+ */
+
+#include <assert.h>
+#include <stdlib.h>
+
+#include <openssl/ssl.h>
+
+#include "lsquic_ssl_pool.h"
+
+/* SSL objects created from other contexts are not pooled */
+#define SSLP_MAX_CTXS 8
+
+
+struct sslp_ctx
+{
+    SSL_CTX            *spc_ctx;
+    unsigned            spc_count;
+    SSL               **spc_ssls;
+};
+
+
+struct ssl_pool
+{
+    unsigned            sp_max_per_ctx;
+    unsigned            sp_n_ctxs;
+    struct sslp_ctx     sp_ctxs[SSLP_MAX_CTXS];
+};
+
+
+struct ssl_pool *
+lsquic_sslp_new (unsigned max_per_ctx)
+{
+    struct ssl_pool *pool;
+
+    pool = calloc(1, sizeof(*pool));
+    if (!pool)
+        return NULL;
+
+    pool->sp_max_per_ctx = max_per_ctx;
+    return pool;
+}
+
+
+static struct sslp_ctx *
+sslp_find_ctx (struct ssl_pool *pool, const SSL_CTX *ctx)
+{
+    struct sslp_ctx *spc;
+
+    for (spc = pool->sp_ctxs; spc < pool->sp_ctxs + pool->sp_n_ctxs; ++spc)
+        if (spc->spc_ctx == ctx)
+            return spc;
+
+    return NULL;
+}
+
+
+SSL *
+lsquic_sslp_get (struct ssl_pool *pool, SSL_CTX *ctx)
+{
+    struct sslp_ctx *spc;
+
+    spc = sslp_find_ctx(pool, ctx);
+    if (spc && spc->spc_count > 0)
+        return spc->spc_ssls[ --spc->spc_count ];
+    else
+        return NULL;
+}
+
+
+void
+lsquic_sslp_put (struct ssl_pool *pool, SSL_CTX *ctx, SSL *ssl)
+{
+    struct sslp_ctx *spc;
+
+    spc = sslp_find_ctx(pool, ctx);
+    if (!spc)
+    {
+        if (pool->sp_n_ctxs >= SSLP_MAX_CTXS)
+            goto free_ssl;
+        spc = &pool->sp_ctxs[ pool->sp_n_ctxs ];
+        spc->spc_ssls = malloc(sizeof(spc->spc_ssls[0])
+                                                    * pool->sp_max_per_ctx);
+        if (!spc->spc_ssls)
+            goto free_ssl;
+        SSL_CTX_up_ref(ctx);
+        spc->spc_ctx = ctx;
+        spc->spc_count = 0;
+        ++pool->sp_n_ctxs;
+    }
+
+    if (spc->spc_count >= pool->sp_max_per_ctx)
+        goto free_ssl;
+
+    /* Certificate lookup may have switched the SSL object to a different
+     * context and copied some of its settings.  SSL_clear() keeps
+     * configuration, so switch it back.
+     */
+    if (SSL_get_SSL_CTX(ssl) != ctx)
+    {
+        if (!SSL_set_SSL_CTX(ssl, ctx))
+            goto free_ssl;
+        SSL_set_verify(ssl, SSL_CTX_get_verify_mode(ctx), NULL);
+        SSL_set_verify_depth(ssl, SSL_CTX_get_verify_depth(ctx));
+        SSL_clear_options(ssl, SSL_get_options(ssl));
+        SSL_set_options(ssl, SSL_CTX_get_options(ctx));
+    }
+    if (!SSL_clear(ssl))
+        goto free_ssl;
+
+    spc->spc_ssls[ spc->spc_count++ ] = ssl;
+    return;
+
+  free_ssl:
+    SSL_free(ssl);
+}
+
+
+unsigned
+lsquic_sslp_count (const struct ssl_pool *pool)
+{
+    const struct sslp_ctx *spc;
+    unsigned count;
+
+    count = 0;
+    for (spc = pool->sp_ctxs; spc < pool->sp_ctxs + pool->sp_n_ctxs; ++spc)
+        count += spc->spc_count;
+
+    return count;
+}
+
+
+void
+lsquic_sslp_destroy (struct ssl_pool *pool)
+{
+    struct sslp_ctx *spc;
+
+    for (spc = pool->sp_ctxs; spc < pool->sp_ctxs + pool->sp_n_ctxs; ++spc)
+    {
+        while (spc->spc_count > 0)
+            SSL_free(spc->spc_ssls[ --spc->spc_count ]);
+        free(spc->spc_ssls);
+        SSL_CTX_free(spc->spc_ctx);
+    }
+    free(pool);
+}
@@ -0,0 +1,39 @@
+/* Copyright (c) 2017 - 2020 LiteSpeed Technologies Inc.  See LICENSE. */
+/*
+ * lsquic_ssl_pool.h -- Reuse server SSL objects
+ *
+ * SSL_new() copies much of the SSL_CTX configuration into the new object.
+ * Instead of freeing SSL objects once the handshake is done, the server
+ * resets them using SSL_clear() and keeps up to es_ssl_pool of them for
+ * each SSL_CTX.
+ */
+
+#ifndef LSQUIC_SSL_POOL_H
+#define LSQUIC_SSL_POOL_H 1
+
+struct ssl_pool;
+struct ssl_st;
+struct ssl_ctx_st;
+
+struct ssl_pool *
+lsquic_sslp_new (unsigned max_per_ctx);
+
+/* Return a reset SSL object created from `ctx' or NULL if there is none */
+struct ssl_st *
+lsquic_sslp_get (struct ssl_pool *, struct ssl_ctx_st *ctx);
+
+/* Reset SSL object created from `ctx' and keep it for reuse.  The object
+ * may have been switched to another SSL_CTX since.  If the object cannot
+ * be reset or the pool is full, the object is freed.
+ */
+void
+lsquic_sslp_put (struct ssl_pool *, struct ssl_ctx_st *ctx, struct ssl_st *);
+
+/* Number of SSL objects in the pool */
+unsigned
+lsquic_sslp_count (const struct ssl_pool *);
+
+void
+lsquic_sslp_destroy (struct ssl_pool *);
+
+#endif
@@ -67,6 +67,7 @@
 #include "lsquic_qenc_hdl.h"
 #include "lsquic_byteswap.h"
 #include "lsquic_ietf.h"
+#include "lsquic_parse_ietf.h"
 #include "lsquic_push_promise.h"
 
 #define LSQUIC_LOGGER_MODULE LSQLM_STREAM
@@ -156,6 +157,9 @@ stream_hq_frame_put (struct lsquic_stream *, struct stream_hq_frame *);
 static size_t
 stream_hq_frame_size (const struct stream_hq_frame *);
 
+static void
+stream_fill_read_buf (struct lsquic_stream *);
+
 const struct stream_filter_if hq_stream_filter_if =
 {
     .sfi_readable   = hq_filter_readable,
@@ -307,11 +311,18 @@ stream_stalled (const lsquic_stream_t *stream)
 }
 
 
+/* All IETF versions use the same STREAM frame format: call the generator
+ * and calculate header size directly instead of through parse_funcs.
+ */
 static size_t
 stream_stream_frame_header_sz (const struct lsquic_stream *stream,
                                                             unsigned data_sz)
 {
-    return stream->conn_pub->lconn->cn_pf->pf_calc_stream_frame_header_sz(
+    if (stream->sm_bflags & SMBF_IETF)
+        return IETF_V1_STREAM_FRAME_HEADER_SZ(stream->id, stream->tosend_off,
+                                                                    data_sz);
+    else
+        return stream->conn_pub->lconn->cn_pf->pf_calc_stream_frame_header_sz(
                                     stream->id, stream->tosend_off, data_sz);
 }
 
@@ -368,6 +379,10 @@ stream_new_common (lsquic_stream_id_t id, struct lsquic_conn_public *conn_pub,
     stream->sm_bflags |= ctor_flags & ((1 << N_SMBF_FLAGS) - 1);
     if (conn_pub->lconn->cn_flags & LSCONN_SERVER)
         stream->sm_bflags |= SMBF_SERVER;
+    if (conn_pub->enpub->enp_settings.es_batch_dispatch
+            && stream_if == conn_pub->enpub->enp_stream_if
+            && !(ctor_flags & SCF_CRITICAL))
+        stream->sm_bflags |= SMBF_BATCH;
 
     return stream;
 }
@@ -573,6 +588,8 @@ lsquic_stream_destroy (lsquic_stream_t *stream)
         TAILQ_REMOVE(&stream->conn_pub->service_streams, stream, next_service_stream);
     if (stream->sm_qflags & SMQF_QPACK_DEC)
         lsquic_qdh_unref_stream(stream->conn_pub->u.ietf.qdh, stream);
+    if (stream->sm_qflags & SMQF_BATCHED)
+        lsquic_engine_unbatch_stream(stream->conn_pub->enpub, stream);
     drop_buffered_data(stream);
     lsquic_sfcw_consume_rem(&stream->fc);
     drop_frames_in(stream);
@@ -745,6 +762,8 @@ lsquic_stream_readable (struct lsquic_stream *stream)
          *   able to collect the error).
          */
         ||  lsquic_stream_is_reset(stream)
+        /* - User-registered read buffer is full: */
+        ||  (stream->sm_rbuf && stream->sm_rbuf_off == stream->sm_rbuf_sz)
         /* Type-dependent readability check: */
         ||  stream->sm_readable(stream);
     ;
@@ -897,6 +916,8 @@ lsquic_stream_frame_in (lsquic_stream_t *stream, stream_frame_t *frame)
     assert(frame->packet_in);
 
     SM_HISTORY_APPEND(stream, SHE_FRAME_IN);
+    if (!stream->sm_times.st_first_recv)
+        stream->sm_times.st_first_recv = frame->packet_in->pi_received;
     LSQ_DEBUG("received stream frame, offset 0x%"PRIX64", len %u; "
         "fin: %d", frame->data_frame.df_offset, frame->data_frame.df_size, !!frame->data_frame.df_fin);
 
@@ -952,8 +973,12 @@ lsquic_stream_frame_in (lsquic_stream_t *stream, stream_frame_t *frame)
             }
         }
         if (got_next_offset)
+        {
             /* Checking the offset saves di_get_frame() call */
+            if (stream->sm_rbuf)
+                stream_fill_read_buf(stream);
             maybe_conn_to_tickable_if_readable(stream);
+        }
         rv = 0;
   end_ok:
         if (free_frame)
@@ -1535,6 +1560,84 @@ lsquic_stream_read (lsquic_stream_t *stream, void *buf, size_t len)
 }
 
 
+static size_t
+read_buf_f (void *ctx, const unsigned char *buf, size_t len, int fin)
+{
+    struct lsquic_stream *const stream = ctx;
+    size_t ntocopy;
+
+    ntocopy = stream->sm_rbuf_sz - stream->sm_rbuf_off;
+    if (ntocopy > len)
+        ntocopy = len;
+    memcpy(stream->sm_rbuf + stream->sm_rbuf_off, buf, ntocopy);
+    stream->sm_rbuf_off += ntocopy;
+    return ntocopy;
+}
+
+
+/* Copy as much contiguous payload as possible into the user-registered
+ * read buffer.  Headers are left alone: the user reads them the usual way.
+ */
+static void
+stream_fill_read_buf (struct lsquic_stream *stream)
+{
+    struct read_frames_status rfs;
+
+    if (stream->sm_rbuf_off >= stream->sm_rbuf_sz
+            || (stream->stream_flags & (STREAM_FIN_REACHED|STREAM_U_READ_DONE))
+            || lsquic_stream_is_reset(stream)
+            || stream->uh
+            || ((stream->sm_bflags & SMBF_USE_HEADERS)
+                                && !(stream->stream_flags & STREAM_HAVE_UH)))
+        return;
+
+    rfs = read_data_frames(stream, 1, read_buf_f, stream);
+    if (rfs.error)
+        LSQ_INFO("error reading frames into read buffer");
+    else if (rfs.total_nread)
+        LSQ_DEBUG("placed %zu bytes into read buffer (%zu/%zu), read offset "
+            "%"PRIu64, rfs.total_nread, stream->sm_rbuf_off,
+            stream->sm_rbuf_sz, stream->read_offset);
+}
+
+
+int
+lsquic_stream_set_read_buf (struct lsquic_stream *stream, void *buf,
+                                                                size_t buf_sz)
+{
+    if (stream->stream_flags & STREAM_U_READ_DONE)
+    {
+        errno = EBADF;
+        return -1;
+    }
+
+    if (buf && buf_sz == 0)
+    {
+        errno = EINVAL;
+        return -1;
+    }
+
+    stream->sm_rbuf = buf;
+    stream->sm_rbuf_sz = buf ? buf_sz : 0;
+    stream->sm_rbuf_off = 0;
+    if (buf)
+    {
+        stream_fill_read_buf(stream);
+        maybe_conn_to_tickable_if_readable(stream);
+    }
+    return 0;
+}
+
+
+size_t
+lsquic_stream_read_buf_len (const struct lsquic_stream *stream, int *fin)
+{
+    if (fin)
+        *fin = !!(stream->stream_flags & STREAM_FIN_REACHED);
+    return stream->sm_rbuf_off;
+}
+
+
 static void
 stream_shutdown_read (lsquic_stream_t *stream)
 {
@@ -2094,6 +2197,9 @@ lsquic_stream_dispatch_read_events (lsquic_stream_t *stream)
 {
     assert(stream->sm_qflags & SMQF_WANT_READ);
 
+    if (stream->sm_rbuf)
+        stream_fill_read_buf(stream);
+
     if (stream->sm_bflags & SMBF_RW_ONCE)
         stream_dispatch_read_events_once(stream);
     else
@@ -2101,6 +2207,28 @@ lsquic_stream_dispatch_read_events (lsquic_stream_t *stream)
 }
 
 
+int
+lsquic_stream_batch_events (struct lsquic_stream *stream)
+{
+    if (!(stream->sm_bflags & SMBF_BATCH))
+        return 0;
+
+    if (stream->sm_qflags & SMQF_BATCHED)
+        return 1;
+
+    if (0 == lsquic_engine_batch_stream(stream->conn_pub->enpub, stream))
+    {
+        LSQ_DEBUG("batched for dispatch by engine");
+        return 1;
+    }
+    else
+    {
+        LSQ_WARN("cannot batch stream: dispatch events right away");
+        return 0;
+    }
+}
+
+
 void
 lsquic_stream_dispatch_write_events (lsquic_stream_t *stream)
 {
@@ -2310,7 +2438,6 @@ struct frame_gen_ctx
      */
     size_t                fgc_nread_from_reader;
     size_t              (*fgc_size) (void *ctx);
-    int                 (*fgc_fin) (void *ctx);
     gsf_read_f            fgc_read;
 };
 
@@ -2498,7 +2625,7 @@ frame_std_gen_read (void *ctx, void *begin_buf, size_t len, int *fin)
                 maybe_resize_stream_buffer(stream);
             assert(stream->max_send_off >= stream->tosend_off + stream->sm_n_buffered);
             incr_sm_payload(stream, len);
-            *fin = fg_ctx->fgc_fin(fg_ctx);
+            *fin = frame_std_gen_fin(fg_ctx);
             return len;
         }
         memcpy(p, stream->sm_buf, stream->sm_n_buffered);
@@ -2515,7 +2642,7 @@ frame_std_gen_read (void *ctx, void *begin_buf, size_t len, int *fin)
                                               n_to_write);
     p += n_written;
     fg_ctx->fgc_nread_from_reader += n_written;
-    *fin = fg_ctx->fgc_fin(fg_ctx);
+    *fin = frame_std_gen_fin(fg_ctx);
     incr_sm_payload(stream, p - (const unsigned char *) begin_buf);
     incr_conn_cap(stream, n_written);
     return p - (const unsigned char *) begin_buf;
@@ -2761,20 +2888,28 @@ write_stream_frame (struct frame_gen_ctx *fg_ctx, const size_t size,
     lsquic_stream_t *const stream = fg_ctx->fgc_stream;
     const struct parse_funcs *const pf = stream->conn_pub->lconn->cn_pf;
     struct lsquic_send_ctl *const send_ctl = stream->conn_pub->send_ctl;
+    const uint64_t begin_off = stream->tosend_off;
     unsigned off;
-    int len, s;
+    int len, s, fin;
 
-#if LSQUIC_CONN_STATS || LSQUIC_EXTRA_CHECKS
-    const uint64_t begin_off = stream->tosend_off;
-#endif
     off = packet_out->po_data_sz;
-    len = pf->pf_gen_stream_frame(
+    fin = frame_std_gen_fin(fg_ctx);
+    if (stream->sm_bflags & SMBF_IETF)
+        len = lsquic_ietf_v1_gen_stream_frame(
                 packet_out->po_data + packet_out->po_data_sz,
                 lsquic_packet_out_avail(packet_out), stream->id,
                 stream->tosend_off,
-                fg_ctx->fgc_fin(fg_ctx), size, fg_ctx->fgc_read, fg_ctx);
+                fin, size, fg_ctx->fgc_read, fg_ctx);
+    else
+        len = pf->pf_gen_stream_frame(
+                packet_out->po_data + packet_out->po_data_sz,
+                lsquic_packet_out_avail(packet_out), stream->id,
+                stream->tosend_off,
+                fin, size, fg_ctx->fgc_read, fg_ctx);
     if (len < 0)
         return len;
+    /* The generator sets FIN if reading drained the stream: */
+    fin = frame_std_gen_fin(fg_ctx);
 
 #if LSQUIC_CONN_STATS
     stream->conn_pub->conn_stats->out.stream_frames += 1;
@@ -2794,6 +2929,11 @@ write_stream_frame (struct frame_gen_ctx *fg_ctx, const size_t size,
         LSQ_ERROR("adding stream to packet failed: %s", strerror(errno));
         return -1;
     }
+    /* Let lsquic_stream_sent() know when to record timestamps */
+    if (begin_off == 0)
+        packet_out->po_lflags |= POL_STREAM_FIRST;
+    if (fin)
+        packet_out->po_lflags |= POL_STREAM_FIN;
 #if LSQUIC_EXTRA_CHECKS
     if (stream->sm_bflags & SMBF_CONN_LIMITED)
     {
@@ -2870,7 +3010,7 @@ stream_write_to_packet_std (struct frame_gen_ctx *fg_ctx, const size_t size)
         stream->stream_flags |= STREAM_HDRS_FLUSHED;
     }
 
-    stream_header_sz = stream->sm_frame_header_sz(stream, size);
+    stream_header_sz = stream_stream_frame_header_sz(stream, size);
     need_at_least = stream_header_sz;
     if ((stream->sm_bflags & (SMBF_IETF|SMBF_USE_HEADERS))
                                        == (SMBF_IETF|SMBF_USE_HEADERS))
@@ -3050,25 +3190,23 @@ stream_write_to_packets (lsquic_stream_t *stream, struct lsquic_reader *reader,
     {
         fg_ctx.fgc_size = frame_hq_gen_size;
         fg_ctx.fgc_read = frame_hq_gen_read;
-        fg_ctx.fgc_fin = frame_std_gen_fin; /* This seems to work for either? XXX */
     }
     else
     {
         fg_ctx.fgc_size = frame_std_gen_size;
         fg_ctx.fgc_read = frame_std_gen_read;
-        fg_ctx.fgc_fin = frame_std_gen_fin;
     }
 
     seen_ok = 0;
     while ((size = fg_ctx.fgc_size(&fg_ctx), thresh ? size >= thresh : size > 0)
-           || fg_ctx.fgc_fin(&fg_ctx))
+           || frame_std_gen_fin(&fg_ctx))
     {
         switch (stream->sm_write_to_packet(&fg_ctx, size))
         {
         case SWTP_OK:
             if (!seen_ok++)
                 maybe_conn_to_tickable_if_writeable(stream, 0);
-            if (fg_ctx.fgc_fin(&fg_ctx))
+            if (frame_std_gen_fin(&fg_ctx))
             {
                 if (use_framing && seen_ok)
                     maybe_close_varsize_hq_frame(stream);
@@ -3274,6 +3412,9 @@ stream_write (lsquic_stream_t *stream, struct lsquic_reader *reader)
     if (len == 0)
         return 0;
 
+    if (!stream->sm_times.st_first_write)
+        stream->sm_times.st_first_write = lsquic_time_now();
+
     frames = 0;
     if ((stream->sm_bflags & (SMBF_IETF|SMBF_USE_HEADERS))
                                         == (SMBF_IETF|SMBF_USE_HEADERS))
@@ -3558,6 +3699,8 @@ lsquic_stream_send_headers (lsquic_stream_t *stream,
     if ((stream->sm_bflags & SMBF_USE_HEADERS)
             && !(stream->stream_flags & (STREAM_HEADERS_SENT|STREAM_U_WRITE_DONE)))
     {
+        if (!stream->sm_times.st_first_write)
+            stream->sm_times.st_first_write = lsquic_time_now();
         if (stream->sm_bflags & SMBF_IETF)
             return send_headers_ietf(stream, headers, eos);
         else
@@ -3719,7 +3862,24 @@ lsquic_stream_acked (struct lsquic_stream *stream,
         stream->stream_flags |= STREAM_RST_ACKED;
     }
     if (0 == stream->n_unacked)
+    {
+        if ((stream->stream_flags & STREAM_FIN_SENT)
+                && stream->sm_times.st_fin_sent
+                    && !stream->sm_times.st_fin_acked)
+            stream->sm_times.st_fin_acked = lsquic_time_now();
         maybe_finish_stream(stream);
+    }
+}
+
+
+void
+lsquic_stream_sent (struct lsquic_stream *stream,
+                        const struct lsquic_packet_out *packet_out, int fin)
+{
+    if (!stream->sm_times.st_first_sent)
+        stream->sm_times.st_first_sent = packet_out->po_sent;
+    if (fin && !stream->sm_times.st_fin_sent)
+        stream->sm_times.st_fin_sent = packet_out->po_sent;
 }
 
 
@@ -3733,6 +3893,14 @@ lsquic_stream_push_req (lsquic_stream_t *stream,
 }
 
 
+void
+lsquic_stream_get_times (const struct lsquic_stream *stream,
+                                        struct lsquic_stream_times *times)
+{
+    *times = stream->sm_times;
+}
+
+
 int
 lsquic_stream_is_pushed (const lsquic_stream_t *stream)
 {
@@ -3855,6 +4023,10 @@ lsquic_stream_uh_in (lsquic_stream_t *stream, struct uncompressed_headers *uh)
 {
     if (stream->sm_bflags & SMBF_USE_HEADERS)
     {
+        stream->sm_times.st_headers_done = lsquic_time_now();
+        /* gQUIC headers arrive on the headers stream */
+        if (!stream->sm_times.st_first_recv)
+            stream->sm_times.st_first_recv = stream->sm_times.st_headers_done;
         if (stream->sm_bflags & SMBF_IETF)
             return stream_uh_in_ietf(stream, uh);
         else
@@ -3932,6 +4104,25 @@ lsquic_stream_set_priority (lsquic_stream_t *stream, unsigned priority)
 }
 
 
+void
+lsquic_stream_set_size_hint (lsquic_stream_t *stream, uint64_t size)
+{
+    stream->sm_size_hint = size;
+    LSQ_DEBUG("set size hint to %"PRIu64, size);
+}
+
+
+void
+lsquic_stream_set_deadline (lsquic_stream_t *stream, unsigned usec)
+{
+    if (usec)
+        stream->sm_deadline = lsquic_time_now() + usec;
+    else
+        stream->sm_deadline = 0;
+    LSQ_DEBUG("set deadline to %"PRIu64, stream->sm_deadline);
+}
+
+
 lsquic_stream_ctx_t *
 lsquic_stream_get_ctx (const lsquic_stream_t *stream)
 {
@@ -4545,6 +4736,13 @@ lsquic_stream_is_rejected (const struct lsquic_stream *stream)
 }
 
 
+int
+lsquic_stream_is_early (const struct lsquic_stream *stream)
+{
+    return (stream->stream_flags & STREAM_EARLY_DATA) != 0;
+}
+
+
 int
 lsquic_stream_can_push (const struct lsquic_stream *stream)
 {
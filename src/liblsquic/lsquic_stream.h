@@ -16,6 +16,8 @@ struct frame_gen_ctx;
 struct data_frame;
 enum quic_frame_type;
 struct push_promise;
+struct qdh_hblock_ctx;
+struct lsquic_packet_out;
 
 TAILQ_HEAD(lsquic_streams_tailq, lsquic_stream);
 
@@ -166,6 +168,7 @@ enum stream_q_flags
     SMQF_ABORT_CONN   = 1 << 8,     /* Unrecoverable error occurred */
 
     SMQF_QPACK_DEC    = 1 << 9,     /* QPACK decoder is holding a reference to this stream */
+    SMQF_BATCHED      = 1 << 10,    /* Stream is on engine's batch dispatch list */
 };
 
 
@@ -182,7 +185,8 @@ enum stream_b_flags
     SMBF_CONN_LIMITED = 1 << 7,
     SMBF_HEADERS      = 1 << 8,  /* Headers stream */
     SMBF_VERIFY_CL    = 1 << 9,  /* Verify content-length (stored in sm_cont_len) */
-#define N_SMBF_FLAGS 10
+    SMBF_BATCH        = 1 << 10, /* Events are dispatched by engine in a batch */
+#define N_SMBF_FLAGS 11
 };
 
 
@@ -207,7 +211,7 @@ enum stream_flags {
     STREAM_ONNEW_DONE   = 1 << 17,  /* on_new_stream has been called */
     STREAM_PUSHING      = 1 << 18,
     STREAM_NOPUSH       = 1 << 19,  /* Disallow further push promises */
-    STREAM_UNUSED20     = 1 << 20,  /* Unused */
+    STREAM_EARLY_DATA   = 1 << 20,  /* Received data in 0-RTT packets */
     STREAM_UNUSED21     = 1 << 21,  /* Unused */
     STREAM_RST_ACKED    = 1 << 22,  /* Packet containing RST has been acked */
     STREAM_BLOCKED_SENT = 1 << 23,  /* Stays set once a STREAM_BLOCKED frame is sent */
@@ -240,7 +244,7 @@ struct lsquic_stream
     struct lsquic_conn_public      *conn_pub;
     TAILQ_ENTRY(lsquic_stream)      next_send_stream, next_read_stream,
                                         next_write_stream, next_service_stream,
-                                        next_prio_stream;
+                                        next_prio_stream, next_batch_stream;
 
     uint64_t                        tosend_off;
     uint64_t                        sm_payload;     /* Not counting HQ frames */
@@ -287,9 +291,19 @@ struct lsquic_stream
     unsigned char                  *sm_buf;
     void                           *sm_onnew_arg;
 
+    /* User-registered buffer for incoming payload: see
+     * lsquic_stream_set_read_buf().
+     */
+    unsigned char                  *sm_rbuf;
+    size_t                          sm_rbuf_sz,
+                                    sm_rbuf_off;
+
     unsigned char                  *sm_header_block;
     uint64_t                        sm_hb_compl;
 
+    /* Incoming header block being decoded by the QPACK decoder handler */
+    struct qdh_hblock_ctx          *sm_hblock_ctx;
+
     /* Valid if STREAM_FIN_RECVD is set: */
     uint64_t                        sm_fin_off;
 
@@ -322,6 +336,15 @@ struct lsquic_stream
     /* Sum of bytes in all incoming DATA frames.  Used for verification. */
     unsigned long long              sm_data_in;
 
+    /* Lifecycle timestamps: see lsquic_stream_get_times() */
+    struct lsquic_stream_times      sm_times;
+
+    /* Write scheduling: see es_stream_sched */
+    uint64_t                        sm_size_hint;   /* Zero if unknown */
+    lsquic_time_t                   sm_deadline;    /* Zero if not set */
+    lsquic_time_t                   sm_last_write;  /* Last write event */
+    uint64_t                        sm_sched_key;   /* Set by SPI */
+
     /* How much data there is in sm_header_block and how much of it has been
      * sent:
      */
@@ -470,6 +493,14 @@ lsquic_stream_dispatch_read_events (lsquic_stream_t *);
 void
 lsquic_stream_dispatch_write_events (lsquic_stream_t *);
 
+/* If the stream's events are dispatched by the engine (see
+ * es_batch_dispatch), put it onto the engine's batch list and return
+ * true.  Otherwise, return false: the caller should dispatch the events
+ * itself.
+ */
+int
+lsquic_stream_batch_events (struct lsquic_stream *);
+
 void
 lsquic_stream_blocked_frame_sent (lsquic_stream_t *);
 
@@ -497,6 +528,10 @@ lsquic_stream_received_goaway (lsquic_stream_t *);
 void
 lsquic_stream_acked (struct lsquic_stream *, enum quic_frame_type);
 
+void
+lsquic_stream_sent (struct lsquic_stream *, const struct lsquic_packet_out *,
+                                                                int fin);
+
 #define lsquic_stream_is_closed(s)                                          \
     (((s)->stream_flags & (STREAM_U_READ_DONE|STREAM_U_WRITE_DONE))         \
                             == (STREAM_U_READ_DONE|STREAM_U_WRITE_DONE))
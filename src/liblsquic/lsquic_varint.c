@@ -7,6 +7,10 @@
 #include <stdint.h>
 #include <string.h>
 
+#if __SSE2__
+#include <emmintrin.h>
+#endif
+
 #include "lsquic_byteswap.h"
 #include "lsquic_varint.h"
 
@@ -57,6 +61,37 @@ lsquic_varint_read (const unsigned char *p, const unsigned char *end,
 }
 
 
+unsigned
+lsquic_varint_n_one_byte (const unsigned char *p, const unsigned char *end)
+{
+    const unsigned char *const begin = p;
+#if __SSE2__
+    const __m128i two_bits = _mm_set1_epi8((char) 0xC0);
+    __m128i bytes;
+    unsigned long_ones;
+
+    /* Check sixteen bytes at a time: a byte begins a one-byte varint if
+     * its two high bits are zero.
+     */
+    while (end - p >= 16)
+    {
+        bytes = _mm_loadu_si128((const __m128i *) p);
+        bytes = _mm_cmpeq_epi8(_mm_and_si128(bytes, two_bits),
+                                                        _mm_setzero_si128());
+        long_ones = ~_mm_movemask_epi8(bytes) & 0xFFFF;
+        if (long_ones)
+            return p - begin + __builtin_ctz(long_ones);
+        p += 16;
+    }
+#endif
+
+    while (p < end && *p <= VINT_MAX_ONE_BYTE)
+        ++p;
+
+    return p - begin;
+}
+
+
 int
 lsquic_varint_read_nb (const unsigned char **pp, const unsigned char *end,
                                             struct varint_read_state *state)
@@ -31,6 +31,13 @@ lsquic_varint_read (const unsigned char *p, const unsigned char *end,
 
 #define vint_read lsquic_varint_read
 
+/* Returns number of consecutive bytes starting at `p' that are one-byte
+ * varints.  This lets callers decode runs of small values -- such as ACK
+ * gaps and block lengths -- without calling vint_read() for each one.
+ */
+unsigned
+lsquic_varint_n_one_byte (const unsigned char *p, const unsigned char *end);
+
 struct varint_read_state
 {
     uint64_t    val;
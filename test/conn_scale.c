@@ -0,0 +1,949 @@
+/* Copyright (c) 2017 - 2020 LiteSpeed Technologies Inc.  See LICENSE. */
+/*
+ * conn_scale.c -- Measure memory and CPU usage as the number of connections
+ * grows.
+ *
+ * A client engine and a server engine run in the same process and exchange
+ * packets in memory (see mem_net.h).  Each client connection is given its
+ * own fake address.
+ *
+ * Connections are added in steps.  After each step, traffic of the selected
+ * profile runs for a while and a line of statistics is printed:
+ *
+ *  idle    Connections are established and left alone.
+ *  light   Each client connection sends a small request every so often
+ *          and the server replies with a small response.
+ *  bulk    Each client connection sends data as fast as it can.
+ *
+ * RSS covers both engines, as well as this program's own data structures.
+ *
+ * With -C, the server closes all connections at the end using
+ * lsquic_engine_close_all() and the time it takes for the client to see
+ * all of them closed is printed.
+ *
+ * With -w, several client/server pairs run in separate processes, one per
+ * worker, and the first column of each line is the worker number.  With -P,
+ * each worker's engines are placed on their own CPU and its NUMA node (see
+ * es_cpu and lsquic_engine_bind_thread()).  Comparing request throughput
+ * with and without -P, as well as the cross-node allocation counts printed
+ * at the end, shows the effect of placement on multi-node hosts.
+ */
+
+#include <assert.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/queue.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include <openssl/ssl.h>
+
+#include "lsquic.h"
+#include "test_common.h"
+#include "../src/liblsquic/lsquic_hash.h"
+#include "test_cert.h"
+#include "mem_net.h"
+#include "../src/liblsquic/lsquic_logger.h"
+
+enum profile { PROF_IDLE, PROF_LIGHT, PROF_BULK, };
+
+static const char *const profile2str[] = {
+    [PROF_IDLE]     = "idle",
+    [PROF_LIGHT]    = "light",
+    [PROF_BULK]     = "bulk",
+};
+
+
+struct lsquic_conn_ctx
+{
+    TAILQ_ENTRY(lsquic_conn_ctx)    next_due;
+    struct sockaddr_in              local_sa;
+    lsquic_conn_t                  *conn;
+    uint64_t                        next_req;   /* Light profile */
+    int                             in_due;
+};
+
+
+struct lsquic_stream_ctx
+{
+    lsquic_stream_t        *stream;
+    size_t                  n_left;
+};
+
+
+static struct scale
+{
+    struct mem_net          net;
+    enum profile            profile;
+    unsigned                max_conns,
+                            step,
+                            batch,
+                            step_sec,
+                            interval_ms,
+                            req_sz,
+                            resp_sz;
+    unsigned                n_conns,
+                            n_hsk_ok,
+                            n_hsk_failed,
+                            n_closed;
+    unsigned long           n_requests;
+    struct lsquic_conn_ctx *conns;
+    TAILQ_HEAD(, lsquic_conn_ctx)
+                            due;        /* Light profile: ordered by next_req */
+    struct lsquic_hash     *certs;      /* -c; if not set, self-signed */
+    const char            **engine_opts;    /* -o arguments */
+    unsigned                n_engine_opts;
+    unsigned                n_workers,
+                            worker;
+    int                     cpu;            /* -P: CPU of this worker */
+    int                     close_all;      /* -C */
+    unsigned char           buf[0x4000];
+} sc;
+
+
+static uint64_t
+now_usec (void)
+{
+    struct timespec ts;
+
+    (void) clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+
+/* Return current resident set size in bytes */
+static unsigned long
+get_rss (void)
+{
+#if __linux__
+    FILE *file;
+    unsigned long size, resident;
+
+    file = fopen("/proc/self/statm", "r");
+    if (file)
+    {
+        if (2 != fscanf(file, "%lu %lu", &size, &resident))
+            resident = 0;
+        fclose(file);
+        if (resident)
+            return resident * (unsigned long) sysconf(_SC_PAGESIZE);
+    }
+#endif
+    struct rusage ru;
+
+    /* Not quite the same thing, but good enough as fallback */
+    if (0 == getrusage(RUSAGE_SELF, &ru))
+        return (unsigned long) ru.ru_maxrss * 1024;
+    else
+        return 0;
+}
+
+
+/* Sum `field' over NUMA nodes' numastat files.  Returns 0 if there are no
+ * such files, as on single-node hosts or systems other than Linux.
+ */
+static unsigned long long
+get_numastat (const char *field)
+{
+    DIR *dir;
+    struct dirent *ent;
+    FILE *file;
+    char path[300], name[32];
+    unsigned long long sum, val;
+
+    sum = 0;
+    dir = opendir("/sys/devices/system/node");
+    if (!dir)
+        return 0;
+    while ((ent = readdir(dir)))
+    {
+        if (0 != strncmp(ent->d_name, "node", 4)
+                            || !(ent->d_name[4] >= '0' && ent->d_name[4] <= '9'))
+            continue;
+        snprintf(path, sizeof(path), "/sys/devices/system/node/%s/numastat",
+                                                                ent->d_name);
+        file = fopen(path, "r");
+        if (!file)
+            continue;
+        while (2 == fscanf(file, "%31s %llu", name, &val))
+            if (0 == strcmp(name, field))
+                sum += val;
+        fclose(file);
+    }
+    closedir(dir);
+
+    return sum;
+}
+
+
+/* Sleep until one of the engines or the light profile needs attention,
+ * but no later than `until'.
+ */
+static void
+idle_wait (uint64_t now, uint64_t until)
+{
+    int64_t diff;
+    int adv_diff;
+
+    if (now >= until)
+        return;
+    diff = until - now;
+    if (lsquic_engine_earliest_adv_tick(sc.net.server.engine, &adv_diff)
+                                                        && adv_diff < diff)
+        diff = adv_diff;
+    if (lsquic_engine_earliest_adv_tick(sc.net.client.engine, &adv_diff)
+                                                        && adv_diff < diff)
+        diff = adv_diff;
+    if (!TAILQ_EMPTY(&sc.due)
+                    && (int64_t) (TAILQ_FIRST(&sc.due)->next_req - now) < diff)
+        diff = TAILQ_FIRST(&sc.due)->next_req - now;
+    if (diff > 0)
+        usleep(diff);
+}
+
+
+/* Light profile: issue requests that are due */
+static void
+issue_requests (uint64_t now)
+{
+    struct lsquic_conn_ctx *cc;
+
+    while ((cc = TAILQ_FIRST(&sc.due)) && cc->next_req <= now)
+    {
+        TAILQ_REMOVE(&sc.due, cc, next_due);
+        cc->in_due = 0;
+        if (cc->conn)
+            lsquic_conn_make_stream(cc->conn);
+    }
+}
+
+
+static void
+schedule_request (struct lsquic_conn_ctx *cc, uint64_t when)
+{
+    assert(!cc->in_due);
+    cc->next_req = when;
+    cc->in_due = 1;
+    TAILQ_INSERT_TAIL(&sc.due, cc, next_due);
+}
+
+
+static lsquic_conn_ctx_t *
+client_on_new_conn (void *stream_if_ctx, lsquic_conn_t *conn)
+{
+    lsquic_conn_ctx_t *const cc = lsquic_conn_get_ctx(conn);
+
+    cc->conn = conn;
+    return cc;
+}
+
+
+static void
+client_on_hsk_done (lsquic_conn_t *conn, enum lsquic_hsk_status status)
+{
+    if (status == LSQ_HSK_OK || status == LSQ_HSK_0RTT_OK)
+        ++sc.n_hsk_ok;
+    else
+        ++sc.n_hsk_failed;
+}
+
+
+static void
+client_on_conn_closed (lsquic_conn_t *conn)
+{
+    lsquic_conn_ctx_t *const cc = lsquic_conn_get_ctx(conn);
+
+    ++sc.n_closed;
+    if (cc->in_due)
+    {
+        TAILQ_REMOVE(&sc.due, cc, next_due);
+        cc->in_due = 0;
+    }
+    cc->conn = NULL;
+    lsquic_conn_set_ctx(conn, NULL);
+}
+
+
+static lsquic_stream_ctx_t *
+client_on_new_stream (void *stream_if_ctx, lsquic_stream_t *stream)
+{
+    lsquic_stream_ctx_t *st_h;
+
+    if (!stream)    /* Stream creation failed */
+        return NULL;
+
+    st_h = malloc(sizeof(*st_h));
+    st_h->stream = stream;
+    st_h->n_left = sc.req_sz;
+    lsquic_stream_wantwrite(stream, 1);
+    return st_h;
+}
+
+
+static void
+client_on_write (lsquic_stream_t *stream, lsquic_stream_ctx_t *st_h)
+{
+    ssize_t nw;
+
+    if (sc.profile == PROF_BULK)
+    {
+        (void) lsquic_stream_write(stream, sc.buf, sizeof(sc.buf));
+        return;
+    }
+
+    nw = lsquic_stream_write(stream, sc.buf, st_h->n_left < sizeof(sc.buf)
+                                            ? st_h->n_left : sizeof(sc.buf));
+    if (nw > 0)
+    {
+        st_h->n_left -= nw;
+        if (st_h->n_left == 0)
+        {
+            lsquic_stream_shutdown(stream, 1);
+            lsquic_stream_wantread(stream, 1);
+        }
+    }
+    else if (nw < 0)
+    {
+        LSQ_WARN("write error: %s", strerror(errno));
+        lsquic_stream_close(stream);
+    }
+}
+
+
+static void
+client_on_read (lsquic_stream_t *stream, lsquic_stream_ctx_t *st_h)
+{
+    ssize_t nr;
+
+    do
+        nr = lsquic_stream_read(stream, sc.buf, sizeof(sc.buf));
+    while (nr > 0);
+
+    if (nr == 0)
+    {
+        ++sc.n_requests;
+        lsquic_stream_close(stream);
+    }
+    else if (errno != EWOULDBLOCK)
+    {
+        LSQ_WARN("read error: %s", strerror(errno));
+        lsquic_stream_close(stream);
+    }
+}
+
+
+static void
+client_on_close (lsquic_stream_t *stream, lsquic_stream_ctx_t *st_h)
+{
+    lsquic_conn_ctx_t *cc;
+
+    free(st_h);
+    if (sc.profile == PROF_LIGHT)
+    {
+        cc = lsquic_conn_get_ctx(lsquic_stream_conn(stream));
+        if (cc && cc->conn)
+            schedule_request(cc, now_usec() + sc.interval_ms * 1000);
+    }
+}
+
+
+static const struct lsquic_stream_if client_stream_if = {
+    .on_new_conn            = client_on_new_conn,
+    .on_conn_closed         = client_on_conn_closed,
+    .on_new_stream          = client_on_new_stream,
+    .on_read                = client_on_read,
+    .on_write               = client_on_write,
+    .on_close               = client_on_close,
+    .on_hsk_done            = client_on_hsk_done,
+};
+
+
+static lsquic_conn_ctx_t *
+server_on_new_conn (void *stream_if_ctx, lsquic_conn_t *conn)
+{
+    return NULL;
+}
+
+
+static void
+server_on_conn_closed (lsquic_conn_t *conn)
+{
+}
+
+
+static lsquic_stream_ctx_t *
+server_on_new_stream (void *stream_if_ctx, lsquic_stream_t *stream)
+{
+    lsquic_stream_ctx_t *st_h;
+
+    st_h = malloc(sizeof(*st_h));
+    st_h->stream = stream;
+    st_h->n_left = sc.resp_sz;
+    lsquic_stream_wantread(stream, 1);
+    return st_h;
+}
+
+
+/* Read and discard request; reply once it is read completely */
+static void
+server_on_read (lsquic_stream_t *stream, lsquic_stream_ctx_t *st_h)
+{
+    ssize_t nr;
+
+    do
+        nr = lsquic_stream_read(stream, sc.buf, sizeof(sc.buf));
+    while (nr > 0);
+
+    if (nr == 0)
+    {
+        lsquic_stream_wantread(stream, 0);
+        lsquic_stream_wantwrite(stream, 1);
+    }
+    else if (errno != EWOULDBLOCK)
+    {
+        LSQ_WARN("read error: %s", strerror(errno));
+        lsquic_stream_close(stream);
+    }
+}
+
+
+static void
+server_on_write (lsquic_stream_t *stream, lsquic_stream_ctx_t *st_h)
+{
+    ssize_t nw;
+
+    nw = lsquic_stream_write(stream, sc.buf, st_h->n_left < sizeof(sc.buf)
+                                            ? st_h->n_left : sizeof(sc.buf));
+    if (nw > 0)
+        st_h->n_left -= nw;
+    if (nw < 0 || st_h->n_left == 0)
+        lsquic_stream_close(stream);
+}
+
+
+static void
+server_on_close (lsquic_stream_t *stream, lsquic_stream_ctx_t *st_h)
+{
+    free(st_h);
+}
+
+
+static const struct lsquic_stream_if server_stream_if = {
+    .on_new_conn            = server_on_new_conn,
+    .on_conn_closed         = server_on_conn_closed,
+    .on_new_stream          = server_on_new_stream,
+    .on_read                = server_on_read,
+    .on_write               = server_on_write,
+    .on_close               = server_on_close,
+};
+
+
+/* Each client connection gets its own address: 10.x.x.x:10000-59999 */
+static void
+make_client_addr (struct sockaddr_in *sa, unsigned idx)
+{
+    memset(sa, 0, sizeof(*sa));
+    sa->sin_family = AF_INET;
+    sa->sin_addr.s_addr = htonl(0x0A000000 | (idx / 50000 + 1));
+    sa->sin_port = htons(10000 + idx % 50000);
+}
+
+
+/* Connect `n' more clients, `batch' at a time, waiting for the handshakes
+ * to complete before starting the next batch.
+ */
+static int
+add_conns (unsigned n)
+{
+    struct lsquic_conn_ctx *cc;
+    unsigned target, i;
+    uint64_t now, deadline;
+
+    target = sc.n_conns + n;
+    while (sc.n_conns < target)
+    {
+        for (i = 0; i < sc.batch && sc.n_conns < target; ++i)
+        {
+            cc = &sc.conns[ sc.n_conns ];
+            make_client_addr(&cc->local_sa, sc.n_conns);
+            if (!lsquic_engine_connect(sc.net.client.engine, N_LSQVER,
+                    (struct sockaddr *) &cc->local_sa,
+                    (struct sockaddr *) &sc.net.server_sa, &sc.net.client, cc,
+                    NULL, 0, NULL, 0, NULL, 0))
+            {
+                LSQ_ERROR("cannot create connection #%u", sc.n_conns);
+                return -1;
+            }
+            ++sc.n_conns;
+        }
+        /* Existing connections may keep the network busy (bulk profile),
+         * so check the deadline on every pass, not only when idle.
+         */
+        deadline = now_usec() + 10 * 1000 * 1000;
+        while (sc.n_hsk_ok + sc.n_hsk_failed < sc.n_conns)
+        {
+            now = now_usec();
+            if (now >= deadline)
+            {
+                LSQ_ERROR("only %u out of %u handshakes completed",
+                            sc.n_hsk_ok + sc.n_hsk_failed, sc.n_conns);
+                return -1;
+            }
+            if (0 == mem_net_exchange(&sc.net))
+                idle_wait(now_usec(), deadline);
+        }
+    }
+
+    if (sc.profile == PROF_LIGHT)
+    {
+        /* Spread the new connections' first requests over one interval.
+         * This may put them slightly out of order with respect to existing
+         * connections, which only delays those a little.
+         */
+        now = now_usec();
+        for (i = target - n; i < target; ++i)
+            schedule_request(&sc.conns[i], now + (uint64_t) (i - (target - n))
+                                                * sc.interval_ms * 1000 / n);
+    }
+    else if (sc.profile == PROF_BULK)
+        for (i = target - n; i < target; ++i)
+            if (sc.conns[i].conn)
+                lsquic_conn_make_stream(sc.conns[i].conn);
+
+    return 0;
+}
+
+
+static void
+run_profile (unsigned sec)
+{
+    uint64_t now, end;
+    unsigned n;
+
+    now = now_usec();
+    end = now + (uint64_t) sec * 1000000;
+    while (now < end)
+    {
+        if (sc.profile == PROF_LIGHT)
+            issue_requests(now);
+        n = mem_net_exchange(&sc.net);
+        now = now_usec();
+        if (n == 0)
+        {
+            idle_wait(now, end);
+            now = now_usec();
+        }
+    }
+}
+
+
+static void
+print_header (void)
+{
+    if (sc.n_workers > 1)
+        printf("%3s ", "wrk");
+    printf("%9s %12s %9s %10s %10s %10s %9s %9s %21s %15s %11s %9s\n",
+        "conns", "rss", "rss/conn", "srv mm", "cli mm", "hash elems",
+        "hash mem", "packets", "srv proc us 50/99/max", "srv tick us 50/99",
+        "cli proc p99", "requests");
+}
+
+
+static void
+print_step (unsigned long rss)
+{
+    struct lsquic_engine_mem_stats s_mem, c_mem;
+    struct lsquic_lat_hist s_proc, s_tick, c_proc;
+
+    lsquic_engine_get_mem_stats(sc.net.server.engine, &s_mem);
+    lsquic_engine_get_mem_stats(sc.net.client.engine, &c_mem);
+    if (0 != lsquic_engine_get_lat_hist(sc.net.server.engine,
+                                            LSQLH_PROCESS_CONNS, &s_proc)
+        || 0 != lsquic_engine_get_lat_hist(sc.net.server.engine, LSQLH_TICK,
+                                                                    &s_tick)
+        || 0 != lsquic_engine_get_lat_hist(sc.net.client.engine,
+                                            LSQLH_PROCESS_CONNS, &c_proc))
+        return;
+
+    if (sc.n_workers > 1)
+        printf("%3u ", sc.worker);
+    printf("%9u %12lu %9lu %10llu %10llu %10u %9llu %9lu %6llu/%6llu/%7llu "
+        "%7llu/%7llu %11llu %9lu\n",
+        sc.n_conns, rss, sc.n_conns ? rss / sc.n_conns : 0,
+        s_mem.ems_mm, c_mem.ems_mm, s_mem.ems_conns_hash_count,
+        s_mem.ems_conns_hash,
+        sc.net.server.n_packets + sc.net.client.n_packets,
+        lsquic_lat_hist_percentile(&s_proc, 50.),
+        lsquic_lat_hist_percentile(&s_proc, 99.), s_proc.lh_max,
+        lsquic_lat_hist_percentile(&s_tick, 50.),
+        lsquic_lat_hist_percentile(&s_tick, 99.),
+        lsquic_lat_hist_percentile(&c_proc, 99.),
+        sc.n_requests);
+    fflush(stdout);
+}
+
+
+/* Close all connections on the server side and exchange packets until the
+ * client has seen all of them closed or ten seconds have passed.
+ */
+static void
+close_all (void)
+{
+    uint64_t start, closed, now, end;
+    unsigned n_open, n_closed, n_closed_before;
+
+    n_open = sc.n_conns - sc.n_closed;
+    n_closed_before = sc.n_closed;
+    start = now_usec();
+    n_closed = lsquic_engine_close_all(sc.net.server.engine, 0, 0, NULL);
+    closed = now = now_usec();
+    end = start + 10000000;
+    while (sc.n_closed < sc.n_conns && now < end)
+    {
+        if (0 == mem_net_exchange(&sc.net))
+            idle_wait(now_usec(), end);
+        now = now_usec();
+    }
+
+    if (sc.n_workers > 1)
+        printf("%3u ", sc.worker);
+    printf("close all: server closed %u of %u connections in %llu usec; "
+        "client saw %u closed in %llu usec\n", n_closed, n_open,
+        (unsigned long long) (closed - start), sc.n_closed - n_closed_before,
+        (unsigned long long) (now - start));
+    fflush(stdout);
+}
+
+
+static void
+usage (const char *prog)
+{
+    const char *const slash = strrchr(prog, '/');
+    if (slash)
+        prog = slash + 1;
+    printf(
+"Usage: %s [opts]\n"
+"\n"
+"Options:\n"
+"   -c SNI,CERT,KEY Server certificate.  If not specified, a self-signed\n"
+"                 certificate is generated.\n"
+"   -n CONNS    Maximum number of connections.  Defaults to 10000.\n"
+"   -s STEP     Add this many connections at each step.  Defaults to the\n"
+"                 number of connections: that is, there is a single step.\n"
+"   -b BATCH    Connect this many clients at a time.  Defaults to 1000.\n"
+"   -p PROFILE  Traffic profile: idle, light, or bulk.  Defaults to idle.\n"
+"   -t SEC      Run traffic for this many seconds after each step.\n"
+"                 Defaults to 5.\n"
+"   -i MS       Light profile: time between requests on a connection.\n"
+"                 Defaults to 1000.\n"
+"   -q BYTES    Light profile: request size.  Defaults to 100.\n"
+"   -r BYTES    Light profile: response size.  Defaults to 1000.\n"
+"   -o opt=val  Set lsquic engine setting to some value.  This applies to\n"
+"                 both client and server engines.\n"
+"   -w WORKERS  Run this many client/server pairs, each in its own process.\n"
+"                 Defaults to 1.\n"
+"   -P          Place each worker's engines on their own CPU and its NUMA\n"
+"                 node.  Workers are spread evenly over online CPUs.\n"
+"   -C          At the end, close all connections on the server side and\n"
+"                 print how long it takes to drain them.\n"
+"   -L LEVEL    Set library-wide log level.  Defaults to 'notice'.\n"
+"   -l MODULE=LEVEL  Set log level for specific module.\n"
+"   -h          Print this help screen and exit.\n"
+    , prog);
+}
+
+
+static struct lsquic_engine *
+new_engine (unsigned flags)
+{
+    struct lsquic_engine_settings settings;
+    struct lsquic_engine_api api;
+    int version_cleared;
+    unsigned i;
+    char err_buf[100];
+
+    lsquic_engine_init_settings(&settings, flags);
+    settings.es_idle_timeout = 600;
+    settings.es_lat_hist     = 1;
+    version_cleared = 0;
+    for (i = 0; i < sc.n_engine_opts; ++i)
+        if (0 != set_engine_option(&settings, &version_cleared,
+                                                        sc.engine_opts[i]))
+            return NULL;
+    if (sc.cpu >= 0)
+        settings.es_cpu = sc.cpu;
+
+    if (0 != lsquic_engine_check_settings(&settings, flags, err_buf,
+                                                            sizeof(err_buf)))
+    {
+        LSQ_ERROR("invalid settings: %s", err_buf);
+        return NULL;
+    }
+
+    memset(&api, 0, sizeof(api));
+    api.ea_settings        = &settings;
+    api.ea_stream_if       = flags & LSENG_SERVER
+                                    ? &server_stream_if : &client_stream_if;
+    api.ea_stream_if_ctx   = NULL;
+    mem_net_set_api(&sc.net, &api, flags & LSENG_SERVER);
+    if ((flags & LSENG_SERVER) && sc.certs)
+    {
+        api.ea_lookup_cert    = lookup_cert;
+        api.ea_cert_lu_ctx    = sc.certs;
+    }
+
+    return lsquic_engine_new(flags, &api);
+}
+
+
+/* Fork workers and wait for them to exit.  Returns in the workers;
+ * exits in the parent.
+ */
+static void
+run_workers (int place)
+{
+    unsigned long long local_before, other_before, local, other;
+    unsigned i, n_failed;
+    long n_cpus;
+    pid_t pid;
+    int status;
+
+    n_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    local_before = get_numastat("local_node");
+    other_before = get_numastat("other_node");
+    fflush(stdout);
+
+    for (i = 0; i < sc.n_workers; ++i)
+    {
+        pid = fork();
+        if (pid < 0)
+        {
+            perror("fork");
+            exit(EXIT_FAILURE);
+        }
+        if (pid == 0)
+        {
+            sc.worker = i;
+            if (place)
+                sc.cpu = n_cpus > 0 ? i * n_cpus / sc.n_workers % n_cpus : i;
+            return;
+        }
+    }
+
+    n_failed = 0;
+    while (-1 != wait(&status))
+        if (!(WIFEXITED(status) && WEXITSTATUS(status) == EXIT_SUCCESS))
+            ++n_failed;
+
+    local = get_numastat("local_node") - local_before;
+    other = get_numastat("other_node") - other_before;
+    if (local + other)
+        printf("NUMA allocations: local %llu; other node %llu (%.2f%%)\n",
+            local, other, (double) other * 100 / (double) (local + other));
+    else
+        printf("NUMA statistics are not available\n");
+    exit(n_failed ? EXIT_FAILURE : EXIT_SUCCESS);
+}
+
+
+int
+main (int argc, char **argv)
+{
+    unsigned long rss_base, rss;
+    int opt, place;
+
+    lsquic_global_init(LSQUIC_GLOBAL_CLIENT|LSQUIC_GLOBAL_SERVER);
+    lsquic_log_to_fstream(stderr, LLTS_HHMMSSMS);
+    lsquic_logger_lopt("=notice");
+
+    memset(&sc, 0, sizeof(sc));
+    sc.max_conns   = 10000;
+    sc.batch       = 1000;
+    sc.step_sec    = 5;
+    sc.interval_ms = 1000;
+    sc.req_sz      = 100;
+    sc.resp_sz     = 1000;
+    sc.profile     = PROF_IDLE;
+    sc.n_workers   = 1;
+    sc.cpu         = -1;
+    place          = 0;
+
+    while (-1 != (opt = getopt(argc, argv, "b:c:Chi:l:L:n:o:p:Pq:r:s:t:w:")))
+    {
+        switch (opt)
+        {
+        case 'b':
+            sc.batch = atoi(optarg);
+            break;
+        case 'c':
+            if (!sc.certs)
+                sc.certs = lsquic_hash_create();
+            if (0 != load_cert(sc.certs, optarg))
+                exit(EXIT_FAILURE);
+            break;
+        case 'i':
+            sc.interval_ms = atoi(optarg);
+            break;
+        case 'l':
+            if (0 != lsquic_logger_lopt(optarg))
+                exit(EXIT_FAILURE);
+            break;
+        case 'L':
+            if (0 != lsquic_set_log_level(optarg))
+                exit(EXIT_FAILURE);
+            break;
+        case 'n':
+            sc.max_conns = atoi(optarg);
+            break;
+        case 'o':
+            sc.engine_opts = realloc(sc.engine_opts,
+                        sizeof(sc.engine_opts[0]) * (sc.n_engine_opts + 1));
+            if (!sc.engine_opts)
+            {
+                perror("realloc");
+                exit(EXIT_FAILURE);
+            }
+            sc.engine_opts[ sc.n_engine_opts++ ] = optarg;
+            break;
+        case 'p':
+            for (sc.profile = 0; sc.profile < sizeof(profile2str)
+                                        / sizeof(profile2str[0]); ++sc.profile)
+                if (0 == strcmp(optarg, profile2str[sc.profile]))
+                    break;
+            if (sc.profile >= sizeof(profile2str) / sizeof(profile2str[0]))
+            {
+                fprintf(stderr, "unknown profile `%s'\n", optarg);
+                exit(EXIT_FAILURE);
+            }
+            break;
+        case 'q':
+            sc.req_sz = atoi(optarg);
+            break;
+        case 'r':
+            sc.resp_sz = atoi(optarg);
+            break;
+        case 's':
+            sc.step = atoi(optarg);
+            break;
+        case 't':
+            sc.step_sec = atoi(optarg);
+            break;
+        case 'w':
+            sc.n_workers = atoi(optarg);
+            break;
+        case 'P':
+            place = 1;
+            break;
+        case 'C':
+            sc.close_all = 1;
+            break;
+        case 'h':
+            usage(argv[0]);
+            exit(EXIT_SUCCESS);
+        default:
+            usage(argv[0]);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    if (sc.max_conns == 0 || sc.batch == 0)
+    {
+        fprintf(stderr, "number of connections and batch size must be "
+                                                                "positive\n");
+        exit(EXIT_FAILURE);
+    }
+    if (sc.step == 0 || sc.step > sc.max_conns)
+        sc.step = sc.max_conns;
+    if (sc.n_workers == 0)
+    {
+        fprintf(stderr, "number of workers must be positive\n");
+        exit(EXIT_FAILURE);
+    }
+
+    print_header();
+    if (sc.n_workers > 1)
+        run_workers(place);
+    else if (place)
+        sc.cpu = 0;
+
+    mem_net_init(&sc.net);
+    sc.net.server_sa.sin_addr.s_addr = htonl(0x0AFFFFFE);
+    if (sc.certs)
+    {
+        sc.net.ssl_ctx = SSL_CTX_new(TLS_method());
+        if (sc.net.ssl_ctx)
+        {
+            SSL_CTX_set_min_proto_version(sc.net.ssl_ctx, TLS1_3_VERSION);
+            SSL_CTX_set_max_proto_version(sc.net.ssl_ctx, TLS1_3_VERSION);
+        }
+    }
+    else
+        sc.net.ssl_ctx = mem_net_new_ssl_ctx("\x5h3-25\x5h3-27");
+    if (!sc.net.ssl_ctx)
+    {
+        LSQ_ERROR("cannot create SSL context");
+        exit(EXIT_FAILURE);
+    }
+
+    sc.conns = calloc(sc.max_conns, sizeof(sc.conns[0]));
+    if (!sc.conns)
+    {
+        perror("calloc");
+        exit(EXIT_FAILURE);
+    }
+    TAILQ_INIT(&sc.due);
+
+    sc.net.server.engine = new_engine(LSENG_SERVER);
+    sc.net.client.engine = new_engine(0);
+    if (!(sc.net.server.engine && sc.net.client.engine))
+        exit(EXIT_FAILURE);
+    /* Both engines have the same CPU */
+    if (sc.cpu >= 0 && 0 != lsquic_engine_bind_thread(sc.net.server.engine))
+        LSQ_WARN("could not place worker %u on CPU %d", sc.worker, sc.cpu);
+
+    rss_base = get_rss();
+    LSQ_NOTICE("profile: %s; base RSS: %lu bytes",
+                                        profile2str[sc.profile], rss_base);
+
+    while (sc.n_conns < sc.max_conns)
+    {
+        if (0 != add_conns(sc.max_conns - sc.n_conns < sc.step
+                                    ? sc.max_conns - sc.n_conns : sc.step))
+            break;
+        lsquic_engine_reset_lat_hists(sc.net.server.engine);
+        lsquic_engine_reset_lat_hists(sc.net.client.engine);
+        sc.net.server.n_packets = 0;
+        sc.net.client.n_packets = 0;
+        sc.n_requests = 0;
+        run_profile(sc.step_sec);
+        rss = get_rss();
+        print_step(rss > rss_base ? rss - rss_base : 0);
+    }
+
+    if (sc.n_hsk_failed || sc.n_closed)
+        LSQ_WARN("failed handshakes: %u; closed connections: %u",
+                                                sc.n_hsk_failed, sc.n_closed);
+
+    if (sc.close_all)
+        close_all();
+
+    lsquic_engine_destroy(sc.net.client.engine);
+    lsquic_engine_destroy(sc.net.server.engine);
+    mem_net_cleanup(&sc.net);
+    free(sc.engine_opts);
+    free(sc.conns);
+    SSL_CTX_free(sc.net.ssl_ctx);
+    if (sc.certs)
+        delete_certs(sc.certs);
+    lsquic_global_cleanup();
+
+    exit(sc.n_conns == sc.max_conns ? EXIT_SUCCESS : EXIT_FAILURE);
+}
@@ -90,6 +90,15 @@ static struct sample_stats  s_stat_to_conn,     /* Time to connect */
 static unsigned s_stat_conns_ok, s_stat_conns_failed;
 static unsigned long s_stat_downloaded_bytes;
 
+/* Request round-trip times, from stream creation to end of response, are
+ * kept when stats are printed to calculate percentiles.
+ */
+static struct {
+    unsigned long  *samples;
+    unsigned        n, n_alloc;
+    int             on;
+} s_req_rtts;
+
 static void
 update_sample_stats (struct sample_stats *stats, unsigned long val)
 {
@@ -139,6 +148,51 @@ calc_sample_stats (const struct sample_stats *stats,
 }
 
 
+static void
+add_req_rtt (unsigned long usec)
+{
+    unsigned long *samples;
+
+    if (!s_req_rtts.on)
+        return;
+
+    if (s_req_rtts.n >= s_req_rtts.n_alloc)
+    {
+        s_req_rtts.n_alloc = s_req_rtts.n_alloc ? s_req_rtts.n_alloc * 2 : 64;
+        samples = realloc(s_req_rtts.samples,
+                            sizeof(s_req_rtts.samples[0]) * s_req_rtts.n_alloc);
+        if (!samples)
+        {
+            perror("realloc");
+            exit(1);
+        }
+        s_req_rtts.samples = samples;
+    }
+    s_req_rtts.samples[ s_req_rtts.n++ ] = usec;
+}
+
+
+static int
+compare_ulongs (const void *ap, const void *bp)
+{
+    const unsigned long a = *(const unsigned long *) ap,
+                        b = *(const unsigned long *) bp;
+    return (a > b) - (a < b);
+}
+
+
+static unsigned long
+req_rtt_percentile (double percentile)
+{
+    unsigned idx;
+
+    idx = (unsigned) (percentile / 100. * s_req_rtts.n);
+    if (idx >= s_req_rtts.n)
+        idx = s_req_rtts.n - 1;
+    return s_req_rtts.samples[idx];
+}
+
+
 #ifdef WIN32
 static char *
 strndup(const char *s, size_t n)
@@ -186,6 +240,9 @@ struct http_client_ctx {
     unsigned                     hcc_n_open_conns;
     unsigned                     hcc_reset_after_nbytes;
     unsigned                     hcc_retire_cid_after_nbytes;
+    /* Pool mode: connections to prewarm and requests in flight */
+    unsigned                     hcc_pool_prewarm;
+    unsigned                     hcc_n_inflight;
     
     char                        *hcc_zero_rtt_file_name;
 
@@ -193,10 +250,14 @@ struct http_client_ctx {
         HCC_SKIP_0RTT           = (1 << 0),
         HCC_SEEN_FIN            = (1 << 1),
         HCC_ABORT_ON_INCOMPLETE = (1 << 2),
+        HCC_POOL                = (1 << 3),
     }                            hcc_flags;
     struct prog                 *prog;
     const char                  *qif_file;
     FILE                        *qif_fh;
+    /* Extra headers added to each request, see -X option */
+    lsquic_http_header_t        *hcc_extra_headers;
+    unsigned                     hcc_n_extra_headers;
 };
 
 struct lsquic_conn_ctx {
@@ -236,6 +297,66 @@ static void
 display_cert_chain (lsquic_conn_t *);
 
 
+static void
+pool_init_dest (struct http_client_ctx *client_ctx,
+                                            struct lsquic_pool_dest *dest)
+{
+    struct prog *const prog = client_ctx->prog;
+    struct service_port *sport;
+
+    sport = TAILQ_FIRST(prog->prog_sports);
+    dest->local_sa = (struct sockaddr *) &sport->sp_local_addr;
+    dest->peer_sa = (struct sockaddr *) &sport->sas;
+    dest->peer_ctx = sport;
+    dest->hostname = prog->prog_hostname ? prog->prog_hostname : sport->host;
+    dest->version = N_LSQVER;
+    dest->max_packet_size = prog->prog_max_packet_size;
+}
+
+
+/* Pool mode: keep up to CONNS times CONCUR requests in flight and let the
+ * engine pick connection for each of them.
+ */
+static void
+pool_issue_requests (struct http_client_ctx *client_ctx)
+{
+    struct lsquic_pool_dest dest;
+    unsigned max_inflight;
+    int n_conns;
+
+    pool_init_dest(client_ctx, &dest);
+    if (client_ctx->hcc_pool_prewarm)
+    {
+        n_conns = lsquic_engine_pool_prewarm(client_ctx->prog->prog_engine,
+                                        &dest, client_ctx->hcc_pool_prewarm);
+        if (n_conns < 0)
+        {
+            LSQ_ERROR("cannot prewarm connections");
+            exit(EXIT_FAILURE);
+        }
+        LSQ_INFO("prewarmed %d connection%.*s", n_conns, n_conns != 1, "s");
+        client_ctx->hcc_pool_prewarm = 0;
+    }
+
+    max_inflight = client_ctx->hcc_concurrency
+                                        * client_ctx->hcc_cc_reqs_per_conn;
+    while (client_ctx->hcc_n_inflight < max_inflight
+                                        && client_ctx->hcc_total_n_reqs > 0)
+    {
+        if (!lsquic_engine_pool_make_stream(client_ctx->prog->prog_engine,
+                                                                    &dest))
+        {
+            LSQ_ERROR("cannot place request");
+            exit(EXIT_FAILURE);
+        }
+        ++client_ctx->hcc_n_inflight;
+        --client_ctx->hcc_total_n_reqs;
+    }
+
+    prog_process_conns(client_ctx->prog);
+}
+
+
 static void
 create_connections (struct http_client_ctx *client_ctx)
 {
@@ -243,6 +364,12 @@ create_connections (struct http_client_ctx *client_ctx)
     FILE *file;
     unsigned char zero_rtt[0x2000];
 
+    if (client_ctx->hcc_flags & HCC_POOL)
+    {
+        pool_issue_requests(client_ctx);
+        return;
+    }
+
     if (0 == (client_ctx->hcc_flags & HCC_SKIP_0RTT)
                                     && client_ctx->hcc_zero_rtt_file_name)
     {
@@ -292,9 +419,12 @@ http_client_on_new_conn (void *stream_if_ctx, lsquic_conn_t *conn)
     lsquic_conn_ctx_t *conn_h = calloc(1, sizeof(*conn_h));
     conn_h->conn = conn;
     conn_h->client_ctx = client_ctx;
-    conn_h->ch_n_reqs = MIN(client_ctx->hcc_total_n_reqs,
+    if (!(client_ctx->hcc_flags & HCC_POOL))
+    {
+        conn_h->ch_n_reqs = MIN(client_ctx->hcc_total_n_reqs,
                                                 client_ctx->hcc_reqs_per_conn);
-    client_ctx->hcc_total_n_reqs -= conn_h->ch_n_reqs;
+        client_ctx->hcc_total_n_reqs -= conn_h->ch_n_reqs;
+    }
     TAILQ_INSERT_TAIL(&client_ctx->conn_ctxs, conn_h, next_ch);
     ++conn_h->client_ctx->hcc_n_open_conns;
     if (!TAILQ_EMPTY(&client_ctx->hcc_path_elems))
@@ -330,25 +460,14 @@ create_another_conn_or_stop (evutil_socket_t sock, short events, void *ctx)
 }
 
 
+/* Connections and streams cannot be created from callbacks: do it from
+ * the event loop.
+ */
 static void
-http_client_on_conn_closed (lsquic_conn_t *conn)
+schedule_create_connections (struct http_client_ctx *client_ctx)
 {
-    lsquic_conn_ctx_t *conn_h = lsquic_conn_get_ctx(conn);
     struct create_another_conn_or_stop_ctx *cacos;
-    enum LSQUIC_CONN_STATUS status;
     struct event_base *eb;
-    char errmsg[80];
-
-    status = lsquic_conn_status(conn, errmsg, sizeof(errmsg));
-    LSQ_INFO("Connection closed.  Status: %d.  Message: %s", status,
-        errmsg[0] ? errmsg : "<not set>");
-    if (conn_h->client_ctx->hcc_flags & HCC_ABORT_ON_INCOMPLETE)
-    {
-        if (!(conn_h->client_ctx->hcc_flags & HCC_SEEN_FIN))
-            abort();
-    }
-    TAILQ_REMOVE(&conn_h->client_ctx->conn_ctxs, conn_h, next_ch);
-    --conn_h->client_ctx->hcc_n_open_conns;
 
     cacos = calloc(1, sizeof(*cacos));
     if (!cacos)
@@ -356,8 +475,8 @@ http_client_on_conn_closed (lsquic_conn_t *conn)
         LSQ_ERROR("cannot allocate cacos");
         exit(1);
     }
-    eb = prog_eb(conn_h->client_ctx->prog);
-    cacos->client_ctx = conn_h->client_ctx;
+    eb = prog_eb(client_ctx->prog);
+    cacos->client_ctx = client_ctx;
     cacos->event = event_new(eb, -1, 0, create_another_conn_or_stop, cacos);
     if (!cacos->event)
     {
@@ -370,6 +489,28 @@ http_client_on_conn_closed (lsquic_conn_t *conn)
         exit(1);
     }
     event_active(cacos->event, 0, 0);
+}
+
+
+static void
+http_client_on_conn_closed (lsquic_conn_t *conn)
+{
+    lsquic_conn_ctx_t *conn_h = lsquic_conn_get_ctx(conn);
+    enum LSQUIC_CONN_STATUS status;
+    char errmsg[80];
+
+    status = lsquic_conn_status(conn, errmsg, sizeof(errmsg));
+    LSQ_INFO("Connection closed.  Status: %d.  Message: %s", status,
+        errmsg[0] ? errmsg : "<not set>");
+    if (conn_h->client_ctx->hcc_flags & HCC_ABORT_ON_INCOMPLETE)
+    {
+        if (!(conn_h->client_ctx->hcc_flags & HCC_SEEN_FIN))
+            abort();
+    }
+    TAILQ_REMOVE(&conn_h->client_ctx->conn_ctxs, conn_h, next_ch);
+    --conn_h->client_ctx->hcc_n_open_conns;
+
+    schedule_create_connections(conn_h->client_ctx);
 
     free(conn_h);
 }
@@ -484,6 +625,21 @@ struct lsquic_stream_ctx {
 static lsquic_stream_ctx_t *
 http_client_on_new_stream (void *stream_if_ctx, lsquic_stream_t *stream)
 {
+    struct http_client_ctx *const client_ctx = stream_if_ctx;
+
+    if (!stream)
+    {
+        LSQ_INFO("stream could not be created: connection is going away");
+        if (client_ctx->hcc_flags & HCC_POOL)
+        {
+            /* Place the request again */
+            --client_ctx->hcc_n_inflight;
+            ++client_ctx->hcc_total_n_reqs;
+            schedule_create_connections(client_ctx);
+        }
+        return NULL;
+    }
+
     const int pushed = lsquic_stream_is_pushed(stream);
 
     if (pushed)
@@ -581,8 +737,20 @@ send_headers (lsquic_stream_ctx_t *st_h)
         .count = sizeof(headers_arr) / sizeof(headers_arr[0]),
         .headers = headers_arr,
     };
+    const unsigned n_extra = st_h->client_ctx->hcc_n_extra_headers;
+    lsquic_http_header_t all_headers[ headers.count + n_extra ];
     if (!st_h->client_ctx->payload)
         headers.count -= 2;
+    if (n_extra)
+    {
+        memcpy(all_headers, headers_arr,
+                                headers.count * sizeof(headers_arr[0]));
+        memcpy(all_headers + headers.count,
+                st_h->client_ctx->hcc_extra_headers,
+                n_extra * sizeof(all_headers[0]));
+        headers.headers = all_headers;
+        headers.count += n_extra;
+    }
     if (0 != lsquic_stream_send_headers(st_h->stream, &headers,
                                     st_h->client_ctx->payload == NULL))
     {
@@ -592,6 +760,49 @@ send_headers (lsquic_stream_ctx_t *st_h)
 }
 
 
+/* Generate header-heavy requests to benchmark header processing: names are
+ * unique, while values repeat, giving the QPACK encoder something to index.
+ */
+static void
+make_extra_headers (struct http_client_ctx *client_ctx, unsigned count)
+{
+    static const char value[] = "a1b2c3d4e5f6a7b8c9d0e1f2a3b4c5d6e7f8a9b0";
+    lsquic_http_header_t *header;
+    char name[sizeof("x-bench-header-4294967295")];
+    unsigned n;
+    int len;
+
+    client_ctx->hcc_extra_headers = malloc(count
+                                    * sizeof(client_ctx->hcc_extra_headers[0]));
+    if (!client_ctx->hcc_extra_headers)
+    {
+        perror("malloc");
+        exit(1);
+    }
+    for (n = 0; n < count; ++n)
+    {
+        header = &client_ctx->hcc_extra_headers[n];
+        len = snprintf(name, sizeof(name), "x-bench-header-%u", n);
+        header->name.iov_base = strdup(name);
+        header->name.iov_len = len;
+        header->value.iov_base = (void *) value;
+        header->value.iov_len = 8 + n % (sizeof(value) - 1 - 8);
+    }
+    client_ctx->hcc_n_extra_headers = count;
+}
+
+
+static void
+free_extra_headers (struct http_client_ctx *client_ctx)
+{
+    unsigned n;
+
+    for (n = 0; n < client_ctx->hcc_n_extra_headers; ++n)
+        free(client_ctx->hcc_extra_headers[n].name.iov_base);
+    free(client_ctx->hcc_extra_headers);
+}
+
+
 /* This is here to exercise lsquic_conn_get_server_cert_chain() API */
 static void
 display_cert_chain (lsquic_conn_t *conn)
@@ -677,6 +888,7 @@ http_client_on_read (lsquic_stream_t *stream, lsquic_stream_ctx_t *st_h)
     unsigned old_prio, new_prio;
     unsigned char buf[0x200];
     unsigned nreads = 0;
+    lsquic_time_t now;
 #ifdef WIN32
 	srand(GetTickCount());
 #endif
@@ -746,7 +958,9 @@ http_client_on_read (lsquic_stream_t *stream, lsquic_stream_ctx_t *st_h)
         }
         else if (0 == nread)
         {
-            update_sample_stats(&s_stat_req, lsquic_time_now() - st_h->sh_ttfb);
+            now = lsquic_time_now();
+            update_sample_stats(&s_stat_req, now - st_h->sh_ttfb);
+            add_req_rtt(now - st_h->sh_created);
             client_ctx->hcc_flags |= HCC_SEEN_FIN;
             lsquic_stream_shutdown(stream, 0);
             break;
@@ -791,21 +1005,37 @@ http_client_on_close (lsquic_stream_t *stream, lsquic_stream_ctx_t *st_h)
         if (conn_h->conn == conn)
             break;
     assert(conn_h);
-    --conn_h->ch_n_reqs;
-    --conn_h->ch_n_cc_streams;
-    if (0 == conn_h->ch_n_reqs)
+    if (client_ctx->hcc_flags & HCC_POOL)
     {
-        LSQ_INFO("all requests completed, closing connection");
-        lsquic_conn_close(conn_h->conn);
+        --client_ctx->hcc_n_inflight;
+        if (client_ctx->hcc_total_n_reqs > 0)
+            schedule_create_connections(client_ctx);
+        else if (0 == client_ctx->hcc_n_inflight)
+        {
+            LSQ_INFO("all requests completed, closing connections");
+            TAILQ_FOREACH(conn_h, &client_ctx->conn_ctxs, next_ch)
+                lsquic_conn_close(conn_h->conn);
+        }
     }
     else
     {
-        LSQ_INFO("%u active stream, %u request remain, creating %u new stream",
-            conn_h->ch_n_cc_streams,
-            conn_h->ch_n_reqs - conn_h->ch_n_cc_streams,
-            MIN((conn_h->ch_n_reqs - conn_h->ch_n_cc_streams),
-                (client_ctx->hcc_cc_reqs_per_conn - conn_h->ch_n_cc_streams)));
-        create_streams(client_ctx, conn_h);
+        --conn_h->ch_n_reqs;
+        --conn_h->ch_n_cc_streams;
+        if (0 == conn_h->ch_n_reqs)
+        {
+            LSQ_INFO("all requests completed, closing connection");
+            lsquic_conn_close(conn_h->conn);
+        }
+        else
+        {
+            LSQ_INFO("%u active stream, %u request remain, creating %u new "
+                "stream", conn_h->ch_n_cc_streams,
+                conn_h->ch_n_reqs - conn_h->ch_n_cc_streams,
+                MIN((conn_h->ch_n_reqs - conn_h->ch_n_cc_streams),
+                    (client_ctx->hcc_cc_reqs_per_conn
+                                                - conn_h->ch_n_cc_streams)));
+            create_streams(client_ctx, conn_h);
+        }
     }
     if (st_h->reader.lsqr_ctx)
         destroy_lsquic_reader_ctx(st_h->reader.lsqr_ctx);
@@ -864,6 +1094,12 @@ usage (const char *prog)
 "   -q FILE     QIF mode: issue requests from the QIF file and validate\n"
 "                 server responses.\n"
 "   -e TOKEN    Hexadecimal string representing resume token.\n"
+"   -X N        Add N extra headers to each request.  Use this to benchmark\n"
+"                 header processing with header-heavy requests.\n"
+"   -O N        Pool mode: the engine places requests onto connections and\n"
+"                 opens them as needed.  N connections are opened up front.\n"
+"                 Up to CONNS times CONCUR requests are in flight.  Limit\n"
+"                 the number of connections using -o pool_max_conns=N.\n"
             , prog);
 }
 
@@ -1144,6 +1380,22 @@ display_stat (FILE *out, const struct sample_stats *stats, const char *name)
 }
 
 
+static void
+display_req_rtts (FILE *out)
+{
+    if (!s_req_rtts.n)
+        return;
+
+    qsort(s_req_rtts.samples, s_req_rtts.n, sizeof(s_req_rtts.samples[0]),
+                                                                compare_ulongs);
+    fprintf(out, "request round trip: n: %u; p50: %lu us; p90: %lu us; "
+        "p99: %lu us; p99.9: %lu us; max: %lu us\n", s_req_rtts.n,
+        req_rtt_percentile(50.), req_rtt_percentile(90.),
+        req_rtt_percentile(99.), req_rtt_percentile(99.9),
+        s_req_rtts.samples[ s_req_rtts.n - 1 ]);
+}
+
+
 static lsquic_conn_ctx_t *
 qif_client_on_new_conn (void *stream_if_ctx, lsquic_conn_t *conn)
 {
@@ -1466,7 +1718,7 @@ main (int argc, char **argv)
     prog_init(&prog, LSENG_HTTP, &sports, &http_client_if, &client_ctx);
 
     while (-1 != (opt = getopt(argc, argv, PROG_OPTS
-                                    "46Br:R:IKu:EP:M:n:w:H:p:0:q:e:hatT:b:d:"
+                                    "46Br:R:IKu:EP:M:n:w:H:p:0:q:e:hatT:b:d:X:O:"
 #ifndef WIN32
                                                                       "C:"
 #endif
@@ -1579,6 +1831,14 @@ main (int argc, char **argv)
         case 'd':
             client_ctx.hcc_retire_cid_after_nbytes = atoi(optarg);
             break;
+        case 'X':
+            if (atoi(optarg) > 0)
+                make_extra_headers(&client_ctx, atoi(optarg));
+            break;
+        case 'O':
+            client_ctx.hcc_flags |= HCC_POOL;
+            client_ctx.hcc_pool_prewarm = atoi(optarg);
+            break;
         case '0':
             http_client_if.on_zero_rtt_info = http_client_on_zero_rtt_info;
             client_ctx.hcc_zero_rtt_file_name = optarg;
@@ -1591,6 +1851,7 @@ main (int argc, char **argv)
 
 #if LSQUIC_CONN_STATS
     prog.prog_api.ea_stats_fh = stats_fh;
+    s_req_rtts.on = stats_fh != NULL;
 #endif
     prog.prog_settings.es_ua = LITESPEED_ID;
 
@@ -1653,6 +1914,7 @@ main (int argc, char **argv)
         display_stat(stats_fh, &s_stat_to_conn, "time for connect");
         display_stat(stats_fh, &s_stat_req, "time for request");
         display_stat(stats_fh, &s_stat_ttfb, "time to 1st byte");
+        display_req_rtts(stats_fh);
         fprintf(stats_fh, "downloaded %lu application bytes in %.3Lf seconds\n",
             s_stat_downloaded_bytes, elapsed);
         fprintf(stats_fh, "%.2Lf reqs/sec; %.0Lf bytes/sec\n",
@@ -1662,6 +1924,7 @@ main (int argc, char **argv)
     }
 
     prog_cleanup(&prog);
+    free(s_req_rtts.samples);
     if (promise_fd >= 0)
         (void) close(promise_fd);
 
@@ -1673,6 +1936,7 @@ main (int argc, char **argv)
 
     if (client_ctx.qif_fh)
         (void) fclose(client_ctx.qif_fh);
+    free_extra_headers(&client_ctx);
 
     exit(0 == s ? EXIT_SUCCESS : EXIT_FAILURE);
 }
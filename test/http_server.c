@@ -42,6 +42,11 @@ static const size_t IDLE_SIZE;
  */
 static int s_immediate_write;
 
+/* If set, MD5 request bodies are placed into a preallocated buffer of this
+ * size using lsquic_stream_set_read_buf().
+ */
+static size_t s_read_buf_size;
+
 #define MIN(a, b) ((a) < (b) ? (a) : (b))
 
 struct lsquic_conn_ctx;
@@ -231,6 +236,7 @@ struct lsquic_stream_ctx {
     }                    interop_u;
     struct event        *resume_resp;
     size_t               written;
+    unsigned char       *read_buf;
 };
 
 
@@ -473,6 +479,9 @@ process_request (struct lsquic_stream *stream, lsquic_stream_ctx_t *st_h)
     st_h->reader.lsqr_ctx = create_lsquic_reader_ctx(st_h->req_path);
     if (!st_h->reader.lsqr_ctx)
         exit(1);
+    /* Used by shortest-remaining-first scheduler: see es_stream_sched */
+    lsquic_stream_set_size_hint(stream,
+                                test_reader_size(st_h->reader.lsqr_ctx));
 
     if (s_immediate_write)
     {
@@ -623,12 +632,27 @@ http_server_on_read (lsquic_stream_t *stream, lsquic_stream_ctx_t *st_h)
 static void
 http_server_on_close (lsquic_stream_t *stream, lsquic_stream_ctx_t *st_h)
 {
+    struct lsquic_stream_times times;
+
+    lsquic_stream_get_times(stream, &times);
+    if (times.st_first_recv)
+    {
+#define REL(t) ((t) ? (long long) ((t) - times.st_first_recv) : -1LL)
+        LSQ_DEBUG("stream %"PRIu64": usec since first byte received: "
+            "headers done: %lld; first write: %lld; first sent: %lld; "
+            "FIN sent: %lld; FIN acked: %lld", lsquic_stream_id(stream),
+            REL(times.st_headers_done), REL(times.st_first_write),
+            REL(times.st_first_sent), REL(times.st_fin_sent),
+            REL(times.st_fin_acked));
+#undef REL
+    }
     free(st_h->req_filename);
     free(st_h->req_path);
     if (st_h->reader.lsqr_ctx)
         destroy_lsquic_reader_ctx(st_h->reader.lsqr_ctx);
     if (st_h->req)
         interop_server_hset_destroy(st_h->req);
+    free(st_h->read_buf);
     free(st_h);
     LSQ_INFO("%s called", __func__);
 }
@@ -774,6 +798,31 @@ read_md5 (void *ctx, const unsigned char *buf, size_t sz, int fin)
 }
 
 
+/* Consume payload placed into the registered read buffer.  Return value
+ * has the same meaning as that of lsquic_stream_readf().
+ */
+static ssize_t
+read_md5_buf (lsquic_stream_t *stream, struct lsquic_stream_ctx *st_h)
+{
+    size_t len;
+    int fin;
+
+    len = lsquic_stream_read_buf_len(stream, &fin);
+    if (len == 0 && !fin)
+        /* Not woken up by the read buffer: let regular read report error */
+        return lsquic_stream_readf(stream, read_md5, st_h);
+
+    MD5_Update(&st_h->interop_u.md5c.md5ctx, st_h->read_buf, len);
+    if (fin)
+        st_h->interop_u.md5c.done = 1;
+    else if (0 != lsquic_stream_set_read_buf(stream, st_h->read_buf,
+                                                            s_read_buf_size))
+        return -1;
+
+    return len;
+}
+
+
 static void
 http_server_interop_on_read (lsquic_stream_t *stream, lsquic_stream_ctx_t *st_h)
 {
@@ -815,6 +864,12 @@ http_server_interop_on_read (lsquic_stream_t *stream, lsquic_stream_ctx_t *st_h)
         else if (!(map = find_handler(st_h->req->method, st_h->req->path, matches)))
             ERROR_RESP(404, "No handler found for method: %s; path: %s",
                 st_h->req->method_str, st_h->req->path);
+        /* POST may not be idempotent: do not act on a request that could
+         * have been replayed.
+         */
+        else if (st_h->req->method != GET && lsquic_stream_is_early(stream))
+            ERROR_RESP(425, "%s request in early data: retry after handshake",
+                st_h->req->method_str);
         else
         {
             LSQ_INFO("found handler for %s %s", st_h->req->method_str, st_h->req->path);
@@ -832,6 +887,14 @@ http_server_interop_on_read (lsquic_stream_t *stream, lsquic_stream_ctx_t *st_h)
             case IOH_MD5SUM:
                 MD5_Init(&st_h->interop_u.md5c.md5ctx);
                 st_h->interop_u.md5c.done = 0;
+                if (s_read_buf_size)
+                {
+                    st_h->read_buf = malloc(s_read_buf_size);
+                    if (!st_h->read_buf || 0 != lsquic_stream_set_read_buf(
+                                    stream, st_h->read_buf, s_read_buf_size))
+                        ERROR_RESP(500, "Internal error: cannot set up read "
+                                                                    "buffer");
+                }
                 break;
             case IOH_GEN_FILE:
                 STAILQ_INIT(&st_h->interop_u.gfc.push_paths);
@@ -893,7 +956,10 @@ http_server_interop_on_read (lsquic_stream_t *stream, lsquic_stream_ctx_t *st_h)
         {
         case IOH_MD5SUM:
             assert(!st_h->interop_u.md5c.done);
-            nw = lsquic_stream_readf(stream, read_md5, st_h);
+            if (st_h->read_buf)
+                nw = read_md5_buf(stream, st_h);
+            else
+                nw = lsquic_stream_readf(stream, read_md5, st_h);
             if (nw < 0)
             {
                 LSQ_ERROR("could not read from stream for MD5: %s", strerror(errno));
@@ -1168,6 +1234,9 @@ usage (const char *prog)
 "   -w SIZE     Write immediately (LSWS mode).  Argument specifies maximum\n"
 "                 size of the immediate write.\n"
 "   -y DELAY    Delay response for this many seconds -- use for debugging\n"
+"   -B SIZE     Place request bodies of POST /cgi-bin/md5sum.cgi into a\n"
+"                 preallocated buffer of this size.  Use this to benchmark\n"
+"                 large uploads.\n"
             , prog);
 }
 
@@ -1309,7 +1378,7 @@ main (int argc, char **argv)
     prog_init(&prog, LSENG_SERVER|LSENG_HTTP, &server_ctx.sports,
                                             &http_server_if, &server_ctx);
 
-    while (-1 != (opt = getopt(argc, argv, PROG_OPTS "y:Y:n:p:r:w:h")))
+    while (-1 != (opt = getopt(argc, argv, PROG_OPTS "y:Y:n:p:r:w:B:h")))
     {
         switch (opt) {
         case 'n':
@@ -1337,6 +1406,9 @@ main (int argc, char **argv)
         case 'y':
             server_ctx.delay_resp_sec = atoi(optarg);
             break;
+        case 'B':
+            s_read_buf_size = strtoul(optarg, NULL, 10);
+            break;
         case 'h':
             usage(argv[0]);
             prog_print_common_options(&prog, stdout);
@@ -0,0 +1,247 @@
+/* Copyright (c) 2017 - 2020 LiteSpeed Technologies Inc.  See LICENSE. */
+/*
+ * mem_net.c -- In-memory network between a client and a server engine
+ */
+
+#include <assert.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/queue.h>
+#ifndef WIN32
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#endif
+
+#include <openssl/ec_key.h>
+#include <openssl/evp.h>
+#include <openssl/ssl.h>
+#include <openssl/x509.h>
+
+#include "lsquic.h"
+#include "mem_net.h"
+
+
+static SSL_CTX *
+get_ssl_ctx (void *peer_ctx)
+{
+    const struct mem_endpoint *const ep = peer_ctx;
+    return ep->net->ssl_ctx;
+}
+
+
+static SSL_CTX *
+lookup_cert (void *cert_lu_ctx, const struct sockaddr *local, const char *sni)
+{
+    const struct mem_net *const net = cert_lu_ctx;
+    return net->ssl_ctx;
+}
+
+
+void
+mem_net_init (struct mem_net *net)
+{
+    memset(net, 0, sizeof(*net));
+    STAILQ_INIT(&net->server.in_q);
+    STAILQ_INIT(&net->client.in_q);
+    STAILQ_INIT(&net->free_packets);
+    net->server.peer = &net->client;
+    net->client.peer = &net->server;
+    net->server.net = net;
+    net->client.net = net;
+    net->server_sa.sin_family = AF_INET;
+    net->server_sa.sin_addr.s_addr = htonl(0x7F000001);
+    net->server_sa.sin_port = htons(443);
+}
+
+
+void
+mem_net_set_api (struct mem_net *net, struct lsquic_engine_api *api,
+                                                                int is_server)
+{
+    api->ea_packets_out     = mem_net_packets_out;
+    api->ea_packets_out_ctx = is_server ? &net->server : &net->client;
+    if (is_server)
+    {
+        api->ea_get_ssl_ctx = get_ssl_ctx;
+        api->ea_lookup_cert = lookup_cert;
+        api->ea_cert_lu_ctx = net;
+    }
+}
+
+
+static struct mem_packet *
+packet_get (struct mem_net *net)
+{
+    struct mem_packet *packet;
+
+    packet = STAILQ_FIRST(&net->free_packets);
+    if (packet)
+        STAILQ_REMOVE_HEAD(&net->free_packets, next);
+    else
+        packet = malloc(sizeof(*packet));
+    return packet;
+}
+
+
+int
+mem_net_packets_out (void *ctx, const struct lsquic_out_spec *specs,
+                                                                unsigned count)
+{
+    struct mem_endpoint *const ep = ctx;
+    struct mem_packet *packet;
+    unsigned n, i;
+    size_t sz;
+
+    for (n = 0; n < count; ++n)
+    {
+        if (specs[n].dest_sa->sa_family != AF_INET)
+        {
+            errno = EAFNOSUPPORT;
+            break;
+        }
+        packet = packet_get(ep->net);
+        if (!packet)
+            break;
+        sz = 0;
+        for (i = 0; i < specs[n].iovlen; ++i)
+        {
+            assert(sz + specs[n].iov[i].iov_len <= sizeof(packet->data));
+            memcpy(packet->data + sz, specs[n].iov[i].iov_base,
+                                                specs[n].iov[i].iov_len);
+            sz += specs[n].iov[i].iov_len;
+        }
+        packet->sz = sz;
+        packet->ecn = specs[n].ecn;
+        memcpy(&packet->local, specs[n].dest_sa, sizeof(packet->local));
+        memcpy(&packet->peer, specs[n].local_sa, sizeof(packet->peer));
+        STAILQ_INSERT_TAIL(&ep->peer->in_q, packet, next);
+    }
+
+    ep->n_packets += n;
+    return n > 0 ? (int) n : -1;
+}
+
+
+unsigned
+mem_net_deliver (struct mem_endpoint *ep)
+{
+    struct mem_packet *packet;
+    unsigned n;
+
+    n = 0;
+    while ((packet = STAILQ_FIRST(&ep->in_q)))
+    {
+        STAILQ_REMOVE_HEAD(&ep->in_q, next);
+        (void) lsquic_engine_packet_in(ep->engine, packet->data, packet->sz,
+                    (struct sockaddr *) &packet->local,
+                    (struct sockaddr *) &packet->peer, ep, packet->ecn);
+        STAILQ_INSERT_HEAD(&ep->net->free_packets, packet, next);
+        ++n;
+    }
+
+    return n;
+}
+
+
+unsigned
+mem_net_exchange (struct mem_net *net)
+{
+    unsigned n;
+
+    lsquic_engine_process_conns(net->client.engine);
+    lsquic_engine_process_conns(net->server.engine);
+    n  = mem_net_deliver(&net->server);
+    n += mem_net_deliver(&net->client);
+    return n;
+}
+
+
+static void
+free_packets (struct mem_packet_q *q)
+{
+    struct mem_packet *packet;
+
+    while ((packet = STAILQ_FIRST(q)))
+    {
+        STAILQ_REMOVE_HEAD(q, next);
+        free(packet);
+    }
+}
+
+
+void
+mem_net_cleanup (struct mem_net *net)
+{
+    free_packets(&net->server.in_q);
+    free_packets(&net->client.in_q);
+    free_packets(&net->free_packets);
+}
+
+
+static int
+select_alpn (SSL *ssl, const unsigned char **out, unsigned char *outlen,
+                    const unsigned char *in, unsigned int inlen, void *arg)
+{
+    const char *const alpn = arg;
+
+    if (OPENSSL_NPN_NEGOTIATED == SSL_select_next_proto(
+            (unsigned char **) out, outlen, in, inlen,
+            (const unsigned char *) alpn, strlen(alpn)))
+        return SSL_TLSEXT_ERR_OK;
+    else
+        return SSL_TLSEXT_ERR_ALERT_FATAL;
+}
+
+
+SSL_CTX *
+mem_net_new_ssl_ctx (const char *alpn)
+{
+    SSL_CTX *ssl_ctx;
+    EVP_PKEY *pkey;
+    EC_KEY *ec_key;
+    X509 *cert;
+    X509_NAME *name;
+    int s;
+
+    ec_key = EC_KEY_new_by_curve_name(NID_X9_62_prime256v1);
+    if (!ec_key)
+        return NULL;
+    s = EC_KEY_generate_key(ec_key);
+    assert(s);
+    pkey = EVP_PKEY_new();
+    assert(pkey);
+    s = EVP_PKEY_assign_EC_KEY(pkey, ec_key);
+    assert(s);
+
+    cert = X509_new();
+    assert(cert);
+    X509_set_version(cert, 2);
+    ASN1_INTEGER_set(X509_get_serialNumber(cert), 1);
+    X509_gmtime_adj(X509_get_notBefore(cert), 0);
+    X509_gmtime_adj(X509_get_notAfter(cert), 3600);
+    name = X509_get_subject_name(cert);
+    X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC,
+                                (const unsigned char *) "localhost", -1, -1, 0);
+    X509_set_issuer_name(cert, name);
+    X509_set_pubkey(cert, pkey);
+    s = X509_sign(cert, pkey, EVP_sha256());
+    assert(s);
+
+    ssl_ctx = SSL_CTX_new(TLS_method());
+    if (ssl_ctx)
+    {
+        SSL_CTX_set_min_proto_version(ssl_ctx, TLS1_3_VERSION);
+        SSL_CTX_set_max_proto_version(ssl_ctx, TLS1_3_VERSION);
+        SSL_CTX_set_alpn_select_cb(ssl_ctx, select_alpn, (void *) alpn);
+        s = SSL_CTX_use_certificate(ssl_ctx, cert);
+        assert(s);
+        s = SSL_CTX_use_PrivateKey(ssl_ctx, pkey);
+        assert(s);
+    }
+
+    X509_free(cert);
+    EVP_PKEY_free(pkey);
+    return ssl_ctx;
+}
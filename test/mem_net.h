@@ -0,0 +1,92 @@
+/* Copyright (c) 2017 - 2020 LiteSpeed Technologies Inc.  See LICENSE. */
+/*
+ * mem_net.h -- In-memory network between a client and a server engine
+ *
+ * Both engines run in the same process.  Instead of sockets, their
+ * packets_out callbacks place packets onto in-memory queues, which are
+ * then fed to the peer engine using lsquic_engine_packet_in().  Addresses
+ * are IPv4.
+ */
+
+#ifndef MEM_NET_H
+#define MEM_NET_H 1
+
+#include <sys/queue.h>
+#ifndef WIN32
+#include <netinet/in.h>
+#endif
+
+struct lsquic_engine;
+struct lsquic_engine_api;
+struct lsquic_out_spec;
+struct ssl_ctx_st;
+struct sockaddr;
+
+#define MEM_NET_MAX_PACKET_SZ 1500
+
+struct mem_packet
+{
+    STAILQ_ENTRY(mem_packet)    next;
+    struct sockaddr_in          local, peer;    /* Receiver's viewpoint */
+    int                         ecn;
+    unsigned short              sz;
+    unsigned char               data[MEM_NET_MAX_PACKET_SZ];
+};
+
+STAILQ_HEAD(mem_packet_q, mem_packet);
+
+/* One side of the in-memory network */
+struct mem_endpoint
+{
+    struct lsquic_engine       *engine;
+    struct mem_packet_q         in_q;       /* To be passed to `engine' */
+    struct mem_endpoint        *peer;
+    struct mem_net             *net;
+    unsigned long               n_packets;  /* Number of packets sent */
+};
+
+struct mem_net
+{
+    struct mem_endpoint         server, client;
+    struct sockaddr_in          server_sa;  /* 127.0.0.1:443 by default */
+    struct mem_packet_q         free_packets;
+    struct ssl_ctx_st          *ssl_ctx;    /* Used by the server engine */
+};
+
+void
+mem_net_init (struct mem_net *);
+
+/* Set packets_out callback and its context.  For the server, also set
+ * callbacks that return `ssl_ctx'.
+ */
+void
+mem_net_set_api (struct mem_net *, struct lsquic_engine_api *, int is_server);
+
+int
+mem_net_packets_out (void *endpoint, const struct lsquic_out_spec *,
+                                                            unsigned count);
+
+/* Feed packets queued for `endpoint' to its engine.  Return number of
+ * packets delivered.
+ */
+unsigned
+mem_net_deliver (struct mem_endpoint *);
+
+/* Process connections of both engines once and deliver the packets.
+ * Return number of packets exchanged.
+ */
+unsigned
+mem_net_exchange (struct mem_net *);
+
+/* Free queued packets.  Engines are not destroyed. */
+void
+mem_net_cleanup (struct mem_net *);
+
+/* Create a TLS 1.3 server SSL_CTX with a freshly generated self-signed
+ * certificate for "localhost".  `alpn' is the list of protocols the server
+ * accepts in wire format, for example "\x4" "echo".
+ */
+struct ssl_ctx_st *
+mem_net_new_ssl_ctx (const char *alpn);
+
+#endif
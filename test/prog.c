@@ -32,9 +32,15 @@
 #include "../src/liblsquic/lsquic_logger.h"
 
 #include "test_config.h"
+#if HAVE_SO_BUSY_POLL
+#include <sched.h>
+#endif
 #include "test_cert.h"
 #include "test_common.h"
 #include "prog.h"
+#if LSQUIC_XDP
+#include "xdp_io.h"
+#endif
 
 static int prog_stopped;
 
@@ -72,6 +78,9 @@ prog_init (struct prog *prog, unsigned flags,
     prog->prog_api.ea_pmi           = &pmi;
     prog->prog_api.ea_pmi_ctx       = &prog->prog_pba;
     prog->prog_api.ea_get_ssl_ctx   = get_ssl_ctx;
+#if HAVE_SO_BUSY_POLL
+    prog->prog_busy_poll_cpu        = -1;
+#endif
 #if LSQUIC_PREFERRED_ADDR
     if (getenv("LSQUIC_PREFERRED_ADDR4") || getenv("LSQUIC_PREFERRED_ADDR6"))
         prog->prog_flags |= PROG_SEARCH_ADDRS;
@@ -168,6 +177,27 @@ prog_print_common_options (const struct prog *prog, FILE *out)
 "   -j          Use recvmmsg() to receive packets.\n"
     );
 #endif
+#if HAVE_SO_BUSY_POLL
+    fprintf(out,
+"   -J USECS[,CPU]\n"
+"               Busy-poll: instead of sleeping in the event loop, spin\n"
+"                 reading sockets and processing connections as soon as\n"
+"                 they are due.  USECS is the SO_BUSY_POLL value.  If CPU\n"
+"                 is specified, the program is pinned to it.  Combine with\n"
+"                 -i to lower clock granularity.\n"
+    );
+#endif
+#if LSQUIC_XDP
+    fprintf(out,
+"   -A IFNAME[,QUEUE]\n"
+"               Send and receive packets of the first service port via\n"
+"                 AF_XDP socket bound to queue QUEUE (default 0) of\n"
+"                 interface IFNAME.  The XDP program is attached in\n"
+"                 generic mode, so that interfaces without native XDP\n"
+"                 support, such as veth, can be used.  IFNAME must be an\n"
+"                 Ethernet interface: loopback does not work.  IPv4 only.\n"
+    );
+#endif
 
     if (prog->prog_engine_flags & LSENG_SERVER)
         fprintf(out,
@@ -239,6 +269,33 @@ prog_set_opt (struct prog *prog, int opt, const char *arg)
     case 'j':
         prog->prog_use_recvmmsg = 1;
         return 0;
+#endif
+#if HAVE_SO_BUSY_POLL
+    case 'J':
+        {
+            const char *cpu = strchr(arg, ',');
+            prog->prog_busy_poll = atoi(arg);
+            if (prog->prog_busy_poll <= 0)
+                return -1;
+            if (cpu)
+                prog->prog_busy_poll_cpu = atoi(cpu + 1);
+        }
+        return 0;
+#endif
+#if LSQUIC_XDP
+    case 'A':
+        {
+            const char *queue = strchr(arg, ',');
+            free(prog->prog_xdp_ifname);
+            if (queue)
+            {
+                prog->prog_xdp_ifname = strndup(arg, queue - arg);
+                prog->prog_xdp_queue = atoi(queue + 1);
+            }
+            else
+                prog->prog_xdp_ifname = strdup(arg);
+            return prog->prog_xdp_ifname ? 0 : -1;
+        }
 #endif
     case 'm':
         prog->prog_packout_max = atoi(arg);
@@ -417,6 +474,7 @@ prog_init_server (struct prog *prog)
         SSL_CTX_set_min_proto_version(prog->prog_ssl_ctx, TLS1_3_VERSION);
         SSL_CTX_set_max_proto_version(prog->prog_ssl_ctx, TLS1_3_VERSION);
         SSL_CTX_set_default_verify_paths(prog->prog_ssl_ctx);
+        SSL_CTX_set_early_data_enabled(prog->prog_ssl_ctx, 1);
 
         /* This is obviously test code: the key is just an array of NUL bytes */
         memset(ticket_keys, 0, sizeof(ticket_keys));
@@ -460,7 +518,12 @@ prog_process_conns (struct prog *prog)
             timeout.tv_usec = (unsigned) diff % 1000000;
         }
 
-        if (!prog_is_stopped())
+        if (!prog_is_stopped()
+#if HAVE_SO_BUSY_POLL
+                /* The busy-poll loop checks the engine itself */
+                && !prog->prog_busy_poll
+#endif
+                                        )
             event_add(prog->prog_timer, &timeout);
     }
 }
@@ -478,8 +541,11 @@ prog_timer_handler (int fd, short what, void *arg)
 static void
 prog_usr1_handler (int fd, short what, void *arg)
 {
-    LSQ_NOTICE("Got SIGUSR1, stopping engine");
-    prog_stop(arg);
+    struct prog *const prog = arg;
+
+    LSQ_NOTICE("Got SIGUSR1, closing all connections and stopping engine");
+    (void) lsquic_engine_close_all(prog->prog_engine, 0, 0, "shutting down");
+    prog_stop(prog);
 }
 
 
@@ -495,6 +561,60 @@ prog_usr2_handler (int fd, short what, void *arg)
 }
 
 
+#if HAVE_SO_BUSY_POLL
+/* Number of busy-poll iterations between servicing other events, such as
+ * signals, write readiness, and program timers.
+ */
+#define BUSY_POLL_EVENT_ITERS 64
+
+static void
+prog_run_busy_poll (struct prog *prog)
+{
+    struct service_port *sport;
+    cpu_set_t cpus;
+    unsigned n_iters;
+    int diff;
+
+    if (prog->prog_busy_poll_cpu >= 0)
+    {
+        CPU_ZERO(&cpus);
+        CPU_SET(prog->prog_busy_poll_cpu, &cpus);
+        if (0 != sched_setaffinity(0, sizeof(cpus), &cpus))
+            LSQ_WARN("cannot pin to CPU %d: %s", prog->prog_busy_poll_cpu,
+                                                            strerror(errno));
+    }
+
+    LSQ_NOTICE("busy-poll loop: SO_BUSY_POLL is %d usec",
+                                                        prog->prog_busy_poll);
+    for (n_iters = 0; !prog_is_stopped(); ++n_iters)
+    {
+        TAILQ_FOREACH(sport, prog->prog_sports, next_sport)
+        {
+            sport_read(sport);
+            /* Stopping the program frees all service ports */
+            if (prog_is_stopped())
+                return;
+        }
+#if LSQUIC_XDP
+        if (prog->prog_xdp)
+        {
+            xdp_io_read(prog->prog_xdp);
+            if (prog_is_stopped())
+                return;
+        }
+#endif
+
+        if (lsquic_engine_earliest_adv_tick(prog->prog_engine, &diff)
+                                                                && diff <= 0)
+            prog_process_conns(prog);
+
+        if (n_iters % BUSY_POLL_EVENT_ITERS == 0)
+            event_base_loop(prog->prog_eb, EVLOOP_NONBLOCK);
+    }
+}
+#endif
+
+
 int
 prog_run (struct prog *prog)
 {
@@ -507,16 +627,55 @@ prog_run (struct prog *prog)
     evsignal_add(prog->prog_usr2, NULL);
 #endif
 
+#if HAVE_SO_BUSY_POLL
+    if (prog->prog_busy_poll)
+        prog_run_busy_poll(prog);
+    else
+#endif
     event_base_loop(prog->prog_eb, 0);
 
     return 0;
 }
 
 
+static void
+prog_print_lat_hists (struct prog *prog)
+{
+    static const char *const names[N_LSQLH] = {
+        [LSQLH_RECV_TO_TICK]    = "receive to tick",
+        [LSQLH_TICK]            = "tick",
+        [LSQLH_SCHED_TO_SEND]   = "schedule to send",
+        [LSQLH_PACER_DELAY]     = "pacer delay",
+        [LSQLH_PROCESS_CONNS]   = "process conns",
+    };
+    struct lsquic_lat_hist hist;
+    enum lsquic_lat_hist_type type;
+
+    for (type = 0; type < N_LSQLH; ++type)
+        if (0 == lsquic_engine_get_lat_hist(prog->prog_engine, type, &hist)
+                                                            && hist.lh_count)
+            LSQ_NOTICE("latency, %s: count: %llu; mean: %llu; p50: %llu; "
+                "p99: %llu; p99.9: %llu; max: %llu usec", names[type],
+                hist.lh_count, hist.lh_sum / hist.lh_count,
+                lsquic_lat_hist_percentile(&hist, 50.),
+                lsquic_lat_hist_percentile(&hist, 99.),
+                lsquic_lat_hist_percentile(&hist, 99.9),
+                hist.lh_max);
+}
+
+
 void
 prog_cleanup (struct prog *prog)
 {
+    if (prog->prog_settings.es_lat_hist)
+        prog_print_lat_hists(prog);
     lsquic_engine_destroy(prog->prog_engine);
+#if LSQUIC_XDP
+    /* After the engine, which releases outgoing packet buffers */
+    if (prog->prog_xdp)
+        xdp_io_destroy(prog->prog_xdp);
+    free(prog->prog_xdp_ifname);
+#endif
     event_base_free(prog->prog_eb);
     if (!prog->prog_use_stock_pmi)
         pba_cleanup(&prog->prog_pba);
@@ -535,6 +694,11 @@ prog_stop (struct prog *prog)
 
     prog_stopped = 1;
 
+#if LSQUIC_XDP
+    if (prog->prog_xdp)
+        xdp_io_stop(prog->prog_xdp);
+#endif
+
     while ((sport = TAILQ_FIRST(prog->prog_sports)))
     {
         TAILQ_REMOVE(prog->prog_sports, sport, next_sport);
@@ -673,6 +837,19 @@ prog_prep (struct prog *prog)
         prog->prog_api.ea_lookup_cert = no_cert;
     }
 
+#if LSQUIC_XDP
+    if (prog->prog_xdp_ifname)
+    {
+        prog->prog_xdp = xdp_io_new(prog);
+        if (!prog->prog_xdp)
+            return -1;
+        prog->prog_api.ea_pmi = &xdp_io_pmi;
+        prog->prog_api.ea_pmi_ctx = prog->prog_xdp;
+        prog->prog_api.ea_packets_out = xdp_io_packets_out;
+        prog->prog_api.ea_packets_out_ctx = prog->prog_xdp;
+    }
+
+#endif
     prog->prog_eb = event_base_new();
     prog->prog_engine = lsquic_engine_new(prog->prog_engine_flags,
                                                             &prog->prog_api);
@@ -690,6 +867,13 @@ prog_prep (struct prog *prog)
     if (s != 0)
         return -1;
 
+#if LSQUIC_XDP
+    if (prog->prog_xdp && 0 != xdp_io_start(prog->prog_xdp,
+                prog->prog_xdp_ifname, prog->prog_xdp_queue,
+                TAILQ_FIRST(prog->prog_sports), prog->prog_eb))
+        return -1;
+#endif
+
     return 0;
 }
 
@@ -13,6 +13,7 @@ struct event_base;
 struct lsquic_hash;
 struct sport_head;
 struct ssl_ctx_st;
+struct xdp_io;
 
 struct prog
 {
@@ -32,6 +33,18 @@ struct prog
     int                             prog_use_recvmmsg;
 #endif
     int                             prog_use_stock_pmi;
+#if HAVE_SO_BUSY_POLL
+    /* If set, prog_run() spins reading sockets instead of sleeping in the
+     * event loop.  The value is used for SO_BUSY_POLL.
+     */
+    int                             prog_busy_poll;
+    int                             prog_busy_poll_cpu; /* -1: don't pin */
+#endif
+#if LSQUIC_XDP
+    char                           *prog_xdp_ifname;    /* If set, use XDP */
+    unsigned                        prog_xdp_queue;
+    struct xdp_io                  *prog_xdp;
+#endif
     struct event_base              *prog_eb;
     struct event                   *prog_timer,
                                    *prog_send,
@@ -69,6 +82,18 @@ prog_init (struct prog *, unsigned lsquic_engine_flags, struct sport_head *,
 #   define RECVMMSG_FLAG ""
 #endif
 
+#if HAVE_SO_BUSY_POLL
+#   define BUSY_POLL_FLAG "J:"
+#else
+#   define BUSY_POLL_FLAG ""
+#endif
+
+#if LSQUIC_XDP
+#   define XDP_FLAG "A:"
+#else
+#   define XDP_FLAG ""
+#endif
+
 #if LSQUIC_DONTFRAG_SUPPORTED
 #   define IP_DONTFRAG_FLAG "D"
 #else
@@ -76,7 +101,7 @@ prog_init (struct prog *, unsigned lsquic_engine_flags, struct sport_head *,
 #endif
 
 #define PROG_OPTS "i:km:c:y:L:l:o:H:s:S:Y:z:G:W" RECVMMSG_FLAG SENDMMSG_FLAG \
-                                                            IP_DONTFRAG_FLAG
+                                BUSY_POLL_FLAG XDP_FLAG IP_DONTFRAG_FLAG
 
 /* Returns:
  *  0   Applied
@@ -707,10 +707,10 @@ read_using_recvmmsg (struct read_iter *iter)
 #endif
 
 
-static void
-read_handler (evutil_socket_t fd, short flags, void *ctx)
+/* Read packets until the socket would block */
+void
+sport_read (struct service_port *sport)
 {
-    struct service_port *sport = ctx;
     lsquic_engine_t *const engine = sport->engine;
     struct packets_in *packs_in = sport->packs_in;
     struct read_iter iter;
@@ -722,7 +722,6 @@ read_handler (evutil_socket_t fd, short flags, void *ctx)
     n_batches = 0;
     iter.ri_sport = sport;
 
-    sport->sp_prog->prog_read_count += 1;
     do
     {
         iter.ri_off = 0;
@@ -775,13 +774,60 @@ read_handler (evutil_socket_t fd, short flags, void *ctx)
     if (n_batches)
         n += n_alloc * (n_batches - 1);
 
-    LSQ_DEBUG("read %u packet%.*s in %u batch%s", n, n != 1, "s", n_batches, n_batches != 1 ? "es" : "");
+    /* The busy-poll loop reads all the time: only log successful reads */
+    if (n_batches)
+        LSQ_DEBUG("read %u packet%.*s in %u batch%s", n, n != 1, "s", n_batches, n_batches != 1 ? "es" : "");
+}
+
+
+static void
+read_handler (evutil_socket_t fd, short flags, void *ctx)
+{
+    struct service_port *sport = ctx;
+
+    sport->sp_prog->prog_read_count += 1;
+    sport_read(sport);
+}
+
+
+#if HAVE_SO_BUSY_POLL
+static void
+set_busy_poll (struct service_port *sport)
+{
+    int usecs, on;
+
+    /* Raising SO_BUSY_POLL above net.core.busy_read needs CAP_NET_ADMIN.
+     * The loop still spins without it, so do not fail.
+     */
+    usecs = sport->sp_prog->prog_busy_poll;
+    if (0 != setsockopt(sport->fd, SOL_SOCKET, SO_BUSY_POLL, &usecs,
+                                                            sizeof(usecs)))
+        LSQ_WARN("cannot set SO_BUSY_POLL to %d: %s", usecs,
+                                                            strerror(errno));
+#ifdef SO_PREFER_BUSY_POLL
+    on = 1;
+    if (0 != setsockopt(sport->fd, SOL_SOCKET, SO_PREFER_BUSY_POLL, &on,
+                                                                sizeof(on)))
+        LSQ_WARN("cannot set SO_PREFER_BUSY_POLL: %s", strerror(errno));
+#else
+    (void) on;
+#endif
 }
+#endif
 
 
 static int
 add_to_event_loop (struct service_port *sport, struct event_base *eb)
 {
+#if HAVE_SO_BUSY_POLL
+    if (sport->sp_prog->prog_busy_poll)
+    {
+        /* prog_run() reads the socket itself */
+        set_busy_poll(sport);
+        return 0;
+    }
+
+#endif
     sport->ev = event_new(eb, sport->fd, EV_READ|EV_PERSIST, read_handler,
                                                                     sport);
     if (sport->ev)
@@ -1717,6 +1763,11 @@ set_engine_option (struct lsquic_engine_settings *settings,
 #endif
             return 0;
         }
+        if (0 == strncmp(name, "cpu", 3))
+        {
+            settings->es_cpu = atoi(val);
+            return 0;
+        }
         break;
     case 4:
         if (0 == strncmp(name, "cfcw", 4))
@@ -1788,6 +1839,16 @@ set_engine_option (struct lsquic_engine_settings *settings,
             settings->es_scid_len = atoi(val);
             return 0;
         }
+        if (0 == strncmp(name, "lat_hist", 8))
+        {
+            settings->es_lat_hist = atoi(val);
+            return 0;
+        }
+        if (0 == strncmp(name, "ssl_pool", 8))
+        {
+            settings->es_ssl_pool = atoi(val);
+            return 0;
+        }
         break;
     case 9:
         if (0 == strncmp(name, "send_prst", 9))
@@ -1795,6 +1856,11 @@ set_engine_option (struct lsquic_engine_settings *settings,
             settings->es_send_prst = atoi(val);
             return 0;
         }
+        if (0 == strncmp(name, "numa_node", 9))
+        {
+            settings->es_numa_node = atoi(val);
+            return 0;
+        }
         break;
     case 10:
         if (0 == strncmp(name, "honor_prst", 10))
@@ -1856,6 +1922,11 @@ set_engine_option (struct lsquic_engine_settings *settings,
             settings->es_delayed_acks = atoi(val);
             return 0;
         }
+        if (0 == strncmp(name, "stream_sched", 12))
+        {
+            settings->es_stream_sched = atoi(val);
+            return 0;
+        }
         break;
     case 13:
         if (0 == strncmp(name, "support_tcid0", 13))
@@ -1885,6 +1956,21 @@ set_engine_option (struct lsquic_engine_settings *settings,
             settings->es_progress_check = atoi(val);
             return 0;
         }
+        if (0 == strncmp(name, "batch_dispatch", 14))
+        {
+            settings->es_batch_dispatch = atoi(val);
+            return 0;
+        }
+        if (0 == strncmp(name, "pool_max_conns", 14))
+        {
+            settings->es_pool_max_conns = atoi(val);
+            return 0;
+        }
+        if (0 == strncmp(name, "sched_max_wait", 14))
+        {
+            settings->es_sched_max_wait = atoi(val);
+            return 0;
+        }
         break;
     case 15:
         if (0 == strncmp(name, "allow_migration", 15))
@@ -77,6 +77,9 @@ sport_init_client (struct service_port *, struct lsquic_engine *,
 int
 sport_packets_out (void *ctx, const struct lsquic_out_spec *, unsigned count);
 
+void
+sport_read (struct service_port *);
+
 int
 sport_set_token (struct service_port *, const char *);
 
@@ -0,0 +1,434 @@
+/* Copyright (c) 2017 - 2020 LiteSpeed Technologies Inc.  See LICENSE. */
+/*
+ * Compare time to first byte of a fresh connection with that of a resumed
+ * connection that sends its request in 0-RTT packets.
+ *
+ * A client engine and a server engine exchange packets in memory (see
+ * mem_net.h).  A round -- processing both engines once and delivering the
+ * packets -- stands for one round trip.  The client asks for a stream as
+ * soon as the connection is created, writes a short request, and the
+ * server echoes it back.
+ *
+ * With -v, print rounds and microseconds to first byte.
+ */
+
+#include <assert.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#ifdef WIN32
+#include "getopt.h"
+#else
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#endif
+
+#include <openssl/ssl.h>
+
+#include "lsquic.h"
+#include "lsquic_logger.h"
+#include "../mem_net.h"
+
+#define MAX_ROUNDS 20
+
+static const char s_request[] = "Hello from the early bird";
+
+
+struct lsquic_stream_ctx
+{
+    size_t                  n_done;
+    char                    buf[sizeof(s_request)];
+};
+
+
+static struct
+{
+    struct mem_net          net;
+    struct sockaddr_in      client_sa;
+    int                     accept_early_data;
+    unsigned char          *zero_rtt;
+    size_t                  zero_rtt_sz;
+    /* Per-connection state: */
+    unsigned                round,
+                            first_byte_round,
+                            n_early_streams;
+    uint64_t                start_usec,
+                            first_byte_usec;
+    enum lsquic_hsk_status  hsk_status;
+    int                     hsk_done,
+                            resp_done,
+                            closed;
+} t;
+
+
+static uint64_t
+now_usec (void)
+{
+    struct timespec ts;
+
+    (void) clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+
+static void
+exchange (void)
+{
+    ++t.round;
+    (void) mem_net_exchange(&t.net);
+}
+
+
+static lsquic_conn_ctx_t *
+client_on_new_conn (void *stream_if_ctx, lsquic_conn_t *conn)
+{
+    lsquic_conn_make_stream(conn);
+    return NULL;
+}
+
+
+static void
+client_on_hsk_done (lsquic_conn_t *conn, enum lsquic_hsk_status status)
+{
+    t.hsk_done = 1;
+    t.hsk_status = status;
+}
+
+
+static void
+client_on_zero_rtt_info (lsquic_conn_t *conn, const unsigned char *buf,
+                                                                    size_t sz)
+{
+    free(t.zero_rtt);
+    t.zero_rtt = malloc(sz);
+    assert(t.zero_rtt);
+    memcpy(t.zero_rtt, buf, sz);
+    t.zero_rtt_sz = sz;
+}
+
+
+static void
+client_on_conn_closed (lsquic_conn_t *conn)
+{
+    t.closed = 1;
+}
+
+
+static lsquic_stream_ctx_t *
+client_on_new_stream (void *stream_if_ctx, lsquic_stream_t *stream)
+{
+    lsquic_stream_ctx_t *st_h;
+
+    if (!stream)
+        return NULL;
+
+    st_h = calloc(1, sizeof(*st_h));
+    assert(st_h);
+    lsquic_stream_wantwrite(stream, 1);
+    return st_h;
+}
+
+
+static void
+client_on_write (lsquic_stream_t *stream, lsquic_stream_ctx_t *st_h)
+{
+    ssize_t nw;
+
+    nw = lsquic_stream_write(stream, s_request + st_h->n_done,
+                                        sizeof(s_request) - st_h->n_done);
+    assert(nw >= 0);
+    st_h->n_done += nw;
+    if (st_h->n_done == sizeof(s_request))
+    {
+        lsquic_stream_shutdown(stream, 1);
+        lsquic_stream_wantread(stream, 1);
+        st_h->n_done = 0;
+    }
+}
+
+
+static void
+client_on_read (lsquic_stream_t *stream, lsquic_stream_ctx_t *st_h)
+{
+    ssize_t nr;
+
+    nr = lsquic_stream_read(stream, st_h->buf + st_h->n_done,
+                                        sizeof(st_h->buf) - st_h->n_done);
+    if (nr > 0)
+    {
+        if (!t.first_byte_round)
+        {
+            t.first_byte_round = t.round;
+            t.first_byte_usec = now_usec();
+        }
+        st_h->n_done += nr;
+    }
+    else if (nr == 0)
+    {
+        assert(st_h->n_done == sizeof(s_request));
+        assert(0 == memcmp(st_h->buf, s_request, sizeof(s_request)));
+        t.resp_done = 1;
+        lsquic_stream_close(stream);
+    }
+    else
+        assert(errno == EWOULDBLOCK);
+}
+
+
+static void
+on_close (lsquic_stream_t *stream, lsquic_stream_ctx_t *st_h)
+{
+    free(st_h);
+}
+
+
+static const struct lsquic_stream_if client_stream_if = {
+    .on_new_conn            = client_on_new_conn,
+    .on_conn_closed         = client_on_conn_closed,
+    .on_new_stream          = client_on_new_stream,
+    .on_read                = client_on_read,
+    .on_write               = client_on_write,
+    .on_close               = on_close,
+    .on_hsk_done            = client_on_hsk_done,
+    .on_zero_rtt_info       = client_on_zero_rtt_info,
+};
+
+
+static lsquic_conn_ctx_t *
+server_on_new_conn (void *stream_if_ctx, lsquic_conn_t *conn)
+{
+    return NULL;
+}
+
+
+static void
+server_on_conn_closed (lsquic_conn_t *conn)
+{
+}
+
+
+static lsquic_stream_ctx_t *
+server_on_new_stream (void *stream_if_ctx, lsquic_stream_t *stream)
+{
+    lsquic_stream_ctx_t *st_h;
+
+    /* The request is safe to repeat: serve it even if it came in 0-RTT */
+    t.n_early_streams += lsquic_stream_is_early(stream);
+    st_h = calloc(1, sizeof(*st_h));
+    assert(st_h);
+    lsquic_stream_wantread(stream, 1);
+    return st_h;
+}
+
+
+/* Read request and echo it back */
+static void
+server_on_read (lsquic_stream_t *stream, lsquic_stream_ctx_t *st_h)
+{
+    ssize_t nr;
+
+    nr = lsquic_stream_read(stream, st_h->buf + st_h->n_done,
+                                        sizeof(st_h->buf) - st_h->n_done);
+    if (nr > 0)
+        st_h->n_done += nr;
+    else if (nr == 0)
+    {
+        assert(st_h->n_done == sizeof(s_request));
+        lsquic_stream_wantread(stream, 0);
+        lsquic_stream_wantwrite(stream, 1);
+        st_h->n_done = 0;
+    }
+    else
+        assert(errno == EWOULDBLOCK);
+}
+
+
+static void
+server_on_write (lsquic_stream_t *stream, lsquic_stream_ctx_t *st_h)
+{
+    ssize_t nw;
+
+    nw = lsquic_stream_write(stream, st_h->buf + st_h->n_done,
+                                        sizeof(st_h->buf) - st_h->n_done);
+    assert(nw >= 0);
+    st_h->n_done += nw;
+    if (st_h->n_done == sizeof(st_h->buf))
+        lsquic_stream_close(stream);
+}
+
+
+static const struct lsquic_stream_if server_stream_if = {
+    .on_new_conn            = server_on_new_conn,
+    .on_conn_closed         = server_on_conn_closed,
+    .on_new_stream          = server_on_new_stream,
+    .on_read                = server_on_read,
+    .on_write               = server_on_write,
+    .on_close               = on_close,
+};
+
+
+static int
+early_data_ok (void *ctx, const struct sockaddr *local,
+                                const struct sockaddr *peer, const char *sni)
+{
+    return t.accept_early_data;
+}
+
+
+static struct lsquic_engine *
+new_engine (unsigned flags)
+{
+    struct lsquic_engine_settings settings;
+    struct lsquic_engine_api api;
+
+    lsquic_engine_init_settings(&settings, flags);
+    settings.es_versions = 1 << LSQVER_ID27;
+
+    memset(&api, 0, sizeof(api));
+    api.ea_settings        = &settings;
+    api.ea_stream_if       = flags & LSENG_SERVER
+                                    ? &server_stream_if : &client_stream_if;
+    api.ea_alpn            = "echo";
+    mem_net_set_api(&t.net, &api, flags & LSENG_SERVER);
+    if (flags & LSENG_SERVER)
+        api.ea_early_data_ok  = early_data_ok;
+
+    return lsquic_engine_new(flags, &api);
+}
+
+
+/* Connect and run until the response is read.  Unless the handshake fails,
+ * keep going until the client has the information needed for 0-RTT, then
+ * close the connection.
+ */
+static void
+run_conn (const unsigned char *zero_rtt, size_t zero_rtt_sz)
+{
+    lsquic_conn_t *conn;
+    int closing;
+
+    t.round = 0;
+    t.first_byte_round = 0;
+    t.n_early_streams = 0;
+    t.hsk_done = 0;
+    t.resp_done = 0;
+    t.closed = 0;
+    t.start_usec = now_usec();
+
+    conn = lsquic_engine_connect(t.net.client.engine, LSQVER_ID27,
+                (struct sockaddr *) &t.client_sa,
+                (struct sockaddr *) &t.net.server_sa, &t.net.client, NULL,
+                "localhost", 0, zero_rtt, zero_rtt_sz, NULL, 0);
+    assert(conn);
+
+    closing = 0;
+    while (!t.closed && t.round < MAX_ROUNDS * 2)
+    {
+        exchange();
+        if (!closing && ((t.resp_done && t.zero_rtt)
+                    || (t.hsk_done && t.hsk_status != LSQ_HSK_OK
+                                        && t.hsk_status != LSQ_HSK_0RTT_OK)))
+        {
+            lsquic_conn_close(conn);
+            closing = 1;
+        }
+    }
+    assert(t.closed);
+}
+
+
+int
+main (int argc, char **argv)
+{
+    unsigned char *zero_rtt;
+    unsigned fresh_rounds, resumed_rounds;
+    uint64_t fresh_usec, resumed_usec;
+    int opt, verbose;
+
+    verbose = 0;
+    while (-1 != (opt = getopt(argc, argv, "l:v")))
+    {
+        switch (opt)
+        {
+        case 'l':
+            lsquic_log_to_fstream(stderr, LLTS_NONE);
+            lsquic_logger_lopt(optarg);
+            break;
+        case 'v':
+            verbose = 1;
+            break;
+        default:
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    if (0 != lsquic_global_init(LSQUIC_GLOBAL_CLIENT|LSQUIC_GLOBAL_SERVER))
+        exit(EXIT_FAILURE);
+
+    memset(&t, 0, sizeof(t));
+    mem_net_init(&t.net);
+    t.client_sa.sin_family = AF_INET;
+    t.client_sa.sin_addr.s_addr = htonl(0x7F000001);
+    t.client_sa.sin_port = htons(12345);
+    t.net.ssl_ctx = mem_net_new_ssl_ctx("\x4" "echo");
+    assert(t.net.ssl_ctx);
+    SSL_CTX_set_early_data_enabled(t.net.ssl_ctx, 1);
+    t.accept_early_data = 1;
+
+    t.net.server.engine = new_engine(LSENG_SERVER);
+    t.net.client.engine = new_engine(0);
+    assert(t.net.server.engine && t.net.client.engine);
+
+    /* Fresh connection: full handshake before the request is sent */
+    run_conn(NULL, 0);
+    assert(t.resp_done);
+    assert(t.hsk_status == LSQ_HSK_OK);
+    assert(t.n_early_streams == 0);
+    assert(t.zero_rtt);
+    fresh_rounds = t.first_byte_round;
+    fresh_usec = t.first_byte_usec - t.start_usec;
+
+    /* Resumed connection: request is sent in 0-RTT packets */
+    zero_rtt = t.zero_rtt;
+    t.zero_rtt = NULL;
+    t.client_sa.sin_port = htons(12346);
+    run_conn(zero_rtt, t.zero_rtt_sz);
+    assert(t.resp_done);
+    assert(t.hsk_status == LSQ_HSK_0RTT_OK);
+    assert(t.n_early_streams == 1);
+    resumed_rounds = t.first_byte_round;
+    resumed_usec = t.first_byte_usec - t.start_usec;
+    assert(resumed_rounds < fresh_rounds);
+
+    if (verbose)
+        printf("time to first byte: fresh: %u rounds, %"PRIu64" usec; "
+            "resumed: %u rounds, %"PRIu64" usec\n", fresh_rounds, fresh_usec,
+            resumed_rounds, resumed_usec);
+
+    /* Server application rejects early data: no stream is opened early,
+     * the handshake completes without 0-RTT, and the client resends the
+     * request in 1-RTT packets.
+     */
+    t.accept_early_data = 0;
+    t.client_sa.sin_port = htons(12347);
+    run_conn(zero_rtt, t.zero_rtt_sz);
+    assert(t.hsk_done);
+    assert(t.hsk_status == LSQ_HSK_OK);
+    assert(t.resp_done);
+    assert(t.n_early_streams == 0);
+
+    free(zero_rtt);
+    free(t.zero_rtt);
+    lsquic_engine_destroy(t.net.client.engine);
+    lsquic_engine_destroy(t.net.server.engine);
+    mem_net_cleanup(&t.net);
+    SSL_CTX_free(t.net.ssl_ctx);
+    lsquic_global_cleanup();
+    return 0;
+}
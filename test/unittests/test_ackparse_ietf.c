@@ -6,6 +6,7 @@
 #ifndef WIN32
 #include <sys/time.h>
 #endif
+#include <time.h>
 
 #include "lsquic_types.h"
 #include "lsquic_parse.h"
@@ -126,11 +127,134 @@ test_ack_truncation (void)
 }
 
 
+/* Gaps and blocks of different varint sizes are mixed */
+static void
+test_mixed_sizes (void)
+{
+    lsquic_rechist_t rechist;
+    lsquic_time_t now;
+    lsquic_packno_t packno, largest;
+    unsigned i, j;
+    int has_missing, sz[2];
+    const struct lsquic_packno_range *range;
+    unsigned char buf[1500];
+    struct ack_info acki;
+
+    lsquic_rechist_init(&rechist, &lconn, 0);
+    now = lsquic_time_now();
+
+    packno = 1;
+    for (i = 1; i <= 100; ++i)
+    {
+        for (j = 0; j < (i % 7 ? 1 : 100u + i); ++j)
+            lsquic_rechist_received(&rechist, packno++, now);
+        packno += i % 5 ? 2 : 70 + i * 200;
+    }
+
+    sz[0] = pf->pf_gen_ack_frame(buf, sizeof(buf),
+        (gaf_rechist_first_f)        lsquic_rechist_first,
+        (gaf_rechist_next_f)         lsquic_rechist_next,
+        (gaf_rechist_largest_recv_f) lsquic_rechist_largest_recv,
+        &rechist, now, &has_missing, &largest, NULL);
+    assert(sz[0] > 0);
+
+    sz[1] = pf->pf_parse_ack_frame(buf, sizeof(buf), &acki, 0);
+    assert(sz[1] == sz[0]);
+    assert(100 == acki.n_ranges);
+
+    for (range = lsquic_rechist_first(&rechist), i = 0;
+                        range && i < acki.n_ranges;
+                                    range = lsquic_rechist_next(&rechist), ++i)
+    {
+        assert(range->high == acki.ranges[i].high);
+        assert(range->low  == acki.ranges[i].low);
+    }
+    assert(i == 100);
+
+    lsquic_rechist_cleanup(&rechist);
+}
+
+
+static double
+elapsed (const struct timespec *start)
+{
+    struct timespec end;
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    return (double) (end.tv_sec - start->tv_sec)
+                        + (double) (end.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+
+/* Generate and parse ACK frame with `n_ranges' ranges `n_iters' times */
+static void
+benchmark (unsigned n_ranges, unsigned n_iters)
+{
+    lsquic_rechist_t rechist;
+    lsquic_time_t now;
+    lsquic_packno_t largest;
+    struct timespec start;
+    unsigned char buf[1500];
+    struct ack_info acki;
+    unsigned i;
+    int has_missing, sz;
+    double gen_sec, parse_sec;
+
+    lsquic_rechist_init(&rechist, &lconn, 0);
+    now = lsquic_time_now();
+    for (i = 1; i <= n_ranges; ++i)
+        lsquic_rechist_received(&rechist, i * 3, now);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = 0; i < n_iters; ++i)
+    {
+        sz = pf->pf_gen_ack_frame(buf, sizeof(buf),
+            (gaf_rechist_first_f)        lsquic_rechist_first,
+            (gaf_rechist_next_f)         lsquic_rechist_next,
+            (gaf_rechist_largest_recv_f) lsquic_rechist_largest_recv,
+            &rechist, now, &has_missing, &largest, NULL);
+        assert(sz > 0);
+    }
+    gen_sec = elapsed(&start);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = 0; i < n_iters; ++i)
+    {
+        sz = pf->pf_parse_ack_frame(buf, sizeof(buf), &acki, 0);
+        assert(sz > 0);
+    }
+    parse_sec = elapsed(&start);
+    assert(acki.n_ranges == n_ranges);
+
+    printf("%u ranges, %u iters: gen %.1f ns/ack; parse %.1f ns/ack\n",
+        n_ranges, n_iters,
+        gen_sec * 1e9 / n_iters, parse_sec * 1e9 / n_iters);
+
+    lsquic_rechist_cleanup(&rechist);
+}
+
+
 int
-main (void)
+main (int argc, char **argv)
 {
     lsquic_global_init(LSQUIC_GLOBAL_SERVER);
-    test_max_ack();
-    test_ack_truncation();
+
+    if (argc == 1)
+    {
+        test_max_ack();
+        test_ack_truncation();
+        test_mixed_sizes();
+        return 0;
+    }
+
+    if (argc != 2)
+    {
+        fprintf(stderr, "usage: %s iters\n", argv[0]);
+        return 1;
+    }
+
+    benchmark(1, atoi(argv[1]));
+    benchmark(32, atoi(argv[1]));
+    benchmark(256, atoi(argv[1]));
     return 0;
 }
@@ -125,5 +125,25 @@ main (void)
         assert(ids[0] == ids[1]);
     }
 
+    /* Coarse alarms are rounded up; a fine alarm due before the rounded
+     * time is returned instead.
+     */
+    enum alarm_id al_id;
+    alset.as_armed_set = 0;
+    lsquic_alarmset_set(&alset, AL_IDLE, 1001);
+    lsquic_alarmset_set(&alset, AL_RETX_APP, 1500);
+    assert(1001 == lsquic_alarmset_mintime(&alset, &al_id));
+    assert(AL_IDLE == al_id);
+    assert(1500 == lsquic_alarmset_mintime_coarse(&alset,
+                                    ALBIT_IDLE|ALBIT_PING, 1000, &al_id));
+    assert(AL_RETX_APP == al_id);
+    lsquic_alarmset_set(&alset, AL_RETX_APP, 2500);
+    assert(2000 == lsquic_alarmset_mintime_coarse(&alset,
+                                    ALBIT_IDLE|ALBIT_PING, 1000, &al_id));
+    assert(AL_IDLE == al_id);
+    alset.as_armed_set = 0;
+    assert(0 == lsquic_alarmset_mintime_coarse(&alset,
+                                    ALBIT_IDLE|ALBIT_PING, 1000, &al_id));
+
     return 0;
 }
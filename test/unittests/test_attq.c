@@ -7,6 +7,8 @@
 #include "lsquic_types.h"
 #include "lsquic_int_types.h"
 #include "lsquic_attq.h"
+#include "lsquic_packet_common.h"
+#include "lsquic_alarmset.h"
 #include "lsquic_hash.h"
 #include "lsquic_conn.h"
 
@@ -215,6 +217,98 @@ test_attq_removal_3 (void)
 }
 
 
+/* Idle and keep-alive alarms go into the timer wheel; their times are
+ * rounded up.  They must come out in order together with heap elements.
+ */
+static void
+test_attq_wheel (void)
+{
+    struct attq *q;
+    struct lsquic_conn *conns, *conn;
+    const struct attq_elem *next_attq;
+    const lsquic_time_t G = ATTQ_WHEEL_GRANULARITY;
+    int s;
+
+    q = lsquic_attq_create();
+    conns = calloc(6, sizeof(conns[0]));
+
+    s = lsquic_attq_add(q, &conns[0], 10 * G + 1, N_AEWS + AL_IDLE);
+    assert(0 == s);
+    assert(conns[0].cn_attq_elem->ae_heap_idx == ATTQ_IN_WHEEL);
+    assert(conns[0].cn_attq_elem->ae_adv_time == 11 * G);
+    s = lsquic_attq_add(q, &conns[1], 5 * G, N_AEWS + AL_PING);
+    assert(0 == s);
+    assert(conns[1].cn_attq_elem->ae_adv_time == 5 * G);
+    s = lsquic_attq_add(q, &conns[2], 7 * G, AEW_PACER);
+    assert(0 == s);
+    assert(conns[2].cn_attq_elem->ae_heap_idx != ATTQ_IN_WHEEL);
+    /* Too far out: goes into the heap */
+    s = lsquic_attq_add(q, &conns[3], (5 + ATTQ_WHEEL_SIZE) * G,
+                                                        N_AEWS + AL_IDLE);
+    assert(0 == s);
+    assert(conns[3].cn_attq_elem->ae_heap_idx != ATTQ_IN_WHEEL);
+    s = lsquic_attq_add(q, &conns[4], 8 * G, N_AEWS + AL_IDLE);
+    assert(0 == s);
+    s = lsquic_attq_add(q, &conns[5], 9 * G, N_AEWS + AL_IDLE);
+    assert(0 == s);
+
+    assert(2 == lsquic_attq_count_before(q, 8 * G));
+    assert(3 == lsquic_attq_count_before(q, 8 * G + 1));
+
+    lsquic_attq_remove(q, &conns[4]);
+    assert(!conns[4].cn_attq_elem);
+
+    next_attq = lsquic_attq_next(q);
+    assert(next_attq && next_attq->ae_conn == &conns[1]);
+    assert(NULL == lsquic_attq_pop(q, 5 * G));
+    conn = lsquic_attq_pop(q, 5 * G + 1);
+    assert(conn == &conns[1]);
+    conn = lsquic_attq_pop(q, ~0ULL);
+    assert(conn == &conns[2]);
+    conn = lsquic_attq_pop(q, ~0ULL);
+    assert(conn == &conns[5]);
+    conn = lsquic_attq_pop(q, ~0ULL);
+    assert(conn == &conns[0]);
+    conn = lsquic_attq_pop(q, ~0ULL);
+    assert(conn == &conns[3]);
+    assert(!lsquic_attq_next(q));
+
+    /* Coarse times are rounded up in the heap, too */
+    s = lsquic_attq_add(q, &conns[0], 10 * G, N_AEWS + AL_IDLE);
+    assert(0 == s);
+    s = lsquic_attq_add(q, &conns[1], (10 + ATTQ_WHEEL_SIZE) * G + 1,
+                                                        N_AEWS + AL_PING);
+    assert(0 == s);
+    assert(conns[1].cn_attq_elem->ae_heap_idx != ATTQ_IN_WHEEL);
+    assert(conns[1].cn_attq_elem->ae_adv_time
+                                        == (11 + ATTQ_WHEEL_SIZE) * G);
+    assert(lsquic_attq_adv_time((10 + ATTQ_WHEEL_SIZE) * G + 1,
+                    N_AEWS + AL_PING) == conns[1].cn_attq_elem->ae_adv_time);
+    assert(lsquic_attq_adv_time(G + 1, AEW_PACER) == G + 1);
+    lsquic_attq_remove(q, &conns[1]);
+
+    /* Removing the latest element shrinks the wheel window: an earlier
+     * time fits into the wheel again.
+     */
+    s = lsquic_attq_add(q, &conns[1], (9 + ATTQ_WHEEL_SIZE) * G,
+                                                        N_AEWS + AL_IDLE);
+    assert(0 == s);
+    assert(conns[1].cn_attq_elem->ae_heap_idx == ATTQ_IN_WHEEL);
+    lsquic_attq_remove(q, &conns[1]);
+    s = lsquic_attq_add(q, &conns[2], 5 * G, N_AEWS + AL_IDLE);
+    assert(0 == s);
+    assert(conns[2].cn_attq_elem->ae_heap_idx == ATTQ_IN_WHEEL);
+    conn = lsquic_attq_pop(q, ~0ULL);
+    assert(conn == &conns[2]);
+    conn = lsquic_attq_pop(q, ~0ULL);
+    assert(conn == &conns[0]);
+    assert(!lsquic_attq_next(q));
+
+    free(conns);
+    lsquic_attq_destroy(q);
+}
+
+
 int
 main (void)
 {
@@ -224,5 +318,6 @@ main (void)
     test_attq_removal_1();
     test_attq_removal_2();
     test_attq_removal_3();
+    test_attq_wheel();
     return 0;
 }
@@ -0,0 +1,433 @@
+/* Copyright (c) 2017 - 2020 LiteSpeed Technologies Inc.  See LICENSE. */
+/*
+ * Test batched stream dispatch (es_batch_dispatch and on_batch).
+ *
+ * A client engine and a server engine exchange packets in memory (see
+ * mem_net.h).  Several client connections are made at the same time; each
+ * sends a short request on one stream and the server echoes it back.  The
+ * server has batch dispatch enabled and serves all streams from on_batch.
+ *
+ * Check that on_batch is called at most once per call to
+ * lsquic_engine_process_conns(), that a single batch carries streams of
+ * all connections ticked in that call, and that the streams and their
+ * connections are valid inside the callback.
+ */
+
+#include <assert.h>
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef WIN32
+#include "getopt.h"
+#else
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#endif
+
+#include <openssl/ssl.h>
+
+#include "lsquic.h"
+#include "lsquic_logger.h"
+#include "../mem_net.h"
+
+#define MAX_ROUNDS 40
+#define N_CONNS 5
+#define STREAM_MAGIC 0x57EA3C7Cu
+#define CONN_MAGIC 0xC0CC7C7Cu
+
+static const char s_request[] = "Batch me if you can";
+
+
+struct lsquic_conn_ctx
+{
+    unsigned                magic;
+    lsquic_conn_t          *conn;
+};
+
+
+struct lsquic_stream_ctx
+{
+    unsigned                magic;
+    lsquic_stream_t        *stream;
+    int                     writing;    /* Server: request has been read */
+    size_t                  n_done;
+    char                    buf[sizeof(s_request)];
+};
+
+
+static struct
+{
+    struct mem_net          net;
+    struct sockaddr_in      client_sa[N_CONNS];
+    unsigned                n_resp_done,
+                            n_closed;
+    /* Batch dispatch statistics: */
+    int                     in_server_process,
+                            in_batch;
+    unsigned                n_batch_calls,      /* In this process_conns */
+                            n_batches,
+                            max_batch_streams,
+                            max_batch_conns;
+} t;
+
+
+static void
+exchange (void)
+{
+    lsquic_engine_process_conns(t.net.client.engine);
+    t.in_server_process = 1;
+    t.n_batch_calls = 0;
+    lsquic_engine_process_conns(t.net.server.engine);
+    assert(t.n_batch_calls <= 1);
+    t.in_server_process = 0;
+    (void) mem_net_deliver(&t.net.server);
+    (void) mem_net_deliver(&t.net.client);
+}
+
+
+static lsquic_conn_ctx_t *
+client_on_new_conn (void *stream_if_ctx, lsquic_conn_t *conn)
+{
+    lsquic_conn_make_stream(conn);
+    return NULL;
+}
+
+
+static void
+client_on_conn_closed (lsquic_conn_t *conn)
+{
+    ++t.n_closed;
+}
+
+
+static lsquic_stream_ctx_t *
+client_on_new_stream (void *stream_if_ctx, lsquic_stream_t *stream)
+{
+    lsquic_stream_ctx_t *st_h;
+
+    if (!stream)
+        return NULL;
+
+    st_h = calloc(1, sizeof(*st_h));
+    assert(st_h);
+    lsquic_stream_wantwrite(stream, 1);
+    return st_h;
+}
+
+
+static void
+client_on_write (lsquic_stream_t *stream, lsquic_stream_ctx_t *st_h)
+{
+    ssize_t nw;
+
+    nw = lsquic_stream_write(stream, s_request + st_h->n_done,
+                                        sizeof(s_request) - st_h->n_done);
+    assert(nw >= 0);
+    st_h->n_done += nw;
+    if (st_h->n_done == sizeof(s_request))
+    {
+        lsquic_stream_shutdown(stream, 1);
+        lsquic_stream_wantread(stream, 1);
+        st_h->n_done = 0;
+    }
+}
+
+
+static void
+client_on_read (lsquic_stream_t *stream, lsquic_stream_ctx_t *st_h)
+{
+    ssize_t nr;
+
+    nr = lsquic_stream_read(stream, st_h->buf + st_h->n_done,
+                                        sizeof(st_h->buf) - st_h->n_done);
+    if (nr > 0)
+        st_h->n_done += nr;
+    else if (nr == 0)
+    {
+        assert(st_h->n_done == sizeof(s_request));
+        assert(0 == memcmp(st_h->buf, s_request, sizeof(s_request)));
+        ++t.n_resp_done;
+        lsquic_stream_close(stream);
+    }
+    else
+        assert(errno == EWOULDBLOCK);
+}
+
+
+static void
+on_close (lsquic_stream_t *stream, lsquic_stream_ctx_t *st_h)
+{
+    free(st_h);
+}
+
+
+static const struct lsquic_stream_if client_stream_if = {
+    .on_new_conn            = client_on_new_conn,
+    .on_conn_closed         = client_on_conn_closed,
+    .on_new_stream          = client_on_new_stream,
+    .on_read                = client_on_read,
+    .on_write               = client_on_write,
+    .on_close               = on_close,
+};
+
+
+static lsquic_conn_ctx_t *
+server_on_new_conn (void *stream_if_ctx, lsquic_conn_t *conn)
+{
+    lsquic_conn_ctx_t *conn_h;
+
+    conn_h = calloc(1, sizeof(*conn_h));
+    assert(conn_h);
+    conn_h->magic = CONN_MAGIC;
+    conn_h->conn = conn;
+    return conn_h;
+}
+
+
+static void
+server_on_conn_closed (lsquic_conn_t *conn)
+{
+    lsquic_conn_ctx_t *const conn_h = lsquic_conn_get_ctx(conn);
+
+    assert(conn_h->magic == CONN_MAGIC);
+    conn_h->magic = 0;
+    lsquic_conn_set_ctx(conn, NULL);
+    free(conn_h);
+}
+
+
+static lsquic_stream_ctx_t *
+server_on_new_stream (void *stream_if_ctx, lsquic_stream_t *stream)
+{
+    lsquic_stream_ctx_t *st_h;
+
+    st_h = calloc(1, sizeof(*st_h));
+    assert(st_h);
+    st_h->magic = STREAM_MAGIC;
+    st_h->stream = stream;
+    lsquic_stream_wantread(stream, 1);
+    return st_h;
+}
+
+
+/* Read request and echo it back */
+static void
+server_on_read (lsquic_stream_t *stream, lsquic_stream_ctx_t *st_h)
+{
+    ssize_t nr;
+
+    assert(t.in_batch);
+    nr = lsquic_stream_read(stream, st_h->buf + st_h->n_done,
+                                        sizeof(st_h->buf) - st_h->n_done);
+    if (nr > 0)
+        st_h->n_done += nr;
+    else if (nr == 0)
+    {
+        assert(st_h->n_done == sizeof(s_request));
+        lsquic_stream_wantread(stream, 0);
+        lsquic_stream_wantwrite(stream, 1);
+        st_h->writing = 1;
+        st_h->n_done = 0;
+    }
+    else
+        assert(errno == EWOULDBLOCK);
+}
+
+
+static void
+server_on_write (lsquic_stream_t *stream, lsquic_stream_ctx_t *st_h)
+{
+    ssize_t nw;
+
+    assert(t.in_batch);
+    nw = lsquic_stream_write(stream, st_h->buf + st_h->n_done,
+                                        sizeof(st_h->buf) - st_h->n_done);
+    assert(nw >= 0);
+    st_h->n_done += nw;
+    if (st_h->n_done == sizeof(st_h->buf))
+        lsquic_stream_close(stream);
+}
+
+
+static void
+server_on_close (lsquic_stream_t *stream, lsquic_stream_ctx_t *st_h)
+{
+    assert(st_h->magic == STREAM_MAGIC);
+    st_h->magic = 0;
+    free(st_h);
+}
+
+
+static void
+server_on_batch (void *stream_if_ctx, lsquic_stream_t *const *streams,
+                                                        unsigned n_streams)
+{
+    lsquic_conn_t *conns[N_CONNS];
+    lsquic_conn_ctx_t *conn_h;
+    lsquic_stream_ctx_t *st_h;
+    lsquic_conn_t *conn;
+    unsigned i, j, n_conns;
+
+    assert(t.in_server_process);
+    assert(!t.in_batch);
+    assert(n_streams > 0);
+    ++t.n_batch_calls;
+    ++t.n_batches;
+
+    /* Every stream is a live user stream of a live connection and appears
+     * in the batch only once.
+     */
+    n_conns = 0;
+    for (i = 0; i < n_streams; ++i)
+    {
+        for (j = 0; j < i; ++j)
+            assert(streams[j] != streams[i]);
+        st_h = lsquic_stream_get_ctx(streams[i]);
+        assert(st_h && st_h->magic == STREAM_MAGIC);
+        assert(st_h->stream == streams[i]);
+        assert(!lsquic_stream_is_pushed(streams[i]));
+        conn = lsquic_stream_conn(streams[i]);
+        assert(conn);
+        conn_h = lsquic_conn_get_ctx(conn);
+        assert(conn_h && conn_h->magic == CONN_MAGIC);
+        assert(conn_h->conn == conn);
+        for (j = 0; j < n_conns; ++j)
+            if (conns[j] == conn)
+                break;
+        if (j == n_conns)
+        {
+            assert(n_conns < N_CONNS);
+            conns[n_conns++] = conn;
+        }
+    }
+    if (n_streams > t.max_batch_streams)
+        t.max_batch_streams = n_streams;
+    if (n_conns > t.max_batch_conns)
+        t.max_batch_conns = n_conns;
+
+    t.in_batch = 1;
+    for (i = 0; i < n_streams; ++i)
+    {
+        st_h = lsquic_stream_get_ctx(streams[i]);
+        if (st_h->writing)
+            server_on_write(streams[i], st_h);
+        else
+            server_on_read(streams[i], st_h);
+    }
+    t.in_batch = 0;
+}
+
+
+static const struct lsquic_stream_if server_stream_if = {
+    .on_new_conn            = server_on_new_conn,
+    .on_conn_closed         = server_on_conn_closed,
+    .on_new_stream          = server_on_new_stream,
+    .on_read                = server_on_read,
+    .on_write               = server_on_write,
+    .on_close               = server_on_close,
+    .on_batch               = server_on_batch,
+};
+
+
+static struct lsquic_engine *
+new_engine (unsigned flags)
+{
+    struct lsquic_engine_settings settings;
+    struct lsquic_engine_api api;
+
+    lsquic_engine_init_settings(&settings, flags);
+    settings.es_versions = 1 << LSQVER_ID27;
+    if (flags & LSENG_SERVER)
+        settings.es_batch_dispatch = 1;
+
+    memset(&api, 0, sizeof(api));
+    api.ea_settings        = &settings;
+    api.ea_stream_if       = flags & LSENG_SERVER
+                                    ? &server_stream_if : &client_stream_if;
+    api.ea_alpn            = "echo";
+    mem_net_set_api(&t.net, &api, flags & LSENG_SERVER);
+
+    return lsquic_engine_new(flags, &api);
+}
+
+
+int
+main (int argc, char **argv)
+{
+    lsquic_conn_t *conns[N_CONNS];
+    unsigned i, round;
+    int opt, verbose;
+
+    verbose = 0;
+    while (-1 != (opt = getopt(argc, argv, "l:v")))
+    {
+        switch (opt)
+        {
+        case 'l':
+            lsquic_log_to_fstream(stderr, LLTS_NONE);
+            lsquic_logger_lopt(optarg);
+            break;
+        case 'v':
+            verbose = 1;
+            break;
+        default:
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    if (0 != lsquic_global_init(LSQUIC_GLOBAL_CLIENT|LSQUIC_GLOBAL_SERVER))
+        exit(EXIT_FAILURE);
+
+    memset(&t, 0, sizeof(t));
+    mem_net_init(&t.net);
+    t.net.ssl_ctx = mem_net_new_ssl_ctx("\x4" "echo");
+    assert(t.net.ssl_ctx);
+
+    t.net.server.engine = new_engine(LSENG_SERVER);
+    t.net.client.engine = new_engine(0);
+    assert(t.net.server.engine && t.net.client.engine);
+
+    /* All connections handshake in lockstep, so their requests reach the
+     * server in the same round.
+     */
+    for (i = 0; i < N_CONNS; ++i)
+    {
+        t.client_sa[i].sin_family = AF_INET;
+        t.client_sa[i].sin_addr.s_addr = htonl(0x7F000001);
+        t.client_sa[i].sin_port = htons(12345 + i);
+        conns[i] = lsquic_engine_connect(t.net.client.engine, LSQVER_ID27,
+                (struct sockaddr *) &t.client_sa[i],
+                (struct sockaddr *) &t.net.server_sa, &t.net.client, NULL,
+                "localhost", 0, NULL, 0, NULL, 0);
+        assert(conns[i]);
+    }
+
+    for (round = 0; t.n_resp_done < N_CONNS && round < MAX_ROUNDS; ++round)
+        exchange();
+    assert(t.n_resp_done == N_CONNS);
+    assert(t.n_batches > 0);
+    assert(t.max_batch_conns == N_CONNS);
+    assert(t.max_batch_streams == N_CONNS);
+
+    if (verbose)
+        printf("%u rounds; %u batches; largest batch: %u streams from %u "
+            "connections\n", round, t.n_batches, t.max_batch_streams,
+            t.max_batch_conns);
+
+    for (i = 0; i < N_CONNS; ++i)
+        lsquic_conn_close(conns[i]);
+    for (round = 0; t.n_closed < N_CONNS && round < MAX_ROUNDS; ++round)
+        exchange();
+    assert(t.n_closed == N_CONNS);
+
+    lsquic_engine_destroy(t.net.client.engine);
+    lsquic_engine_destroy(t.net.server.engine);
+    mem_net_cleanup(&t.net);
+    SSL_CTX_free(t.net.ssl_ctx);
+    lsquic_global_cleanup();
+    return 0;
+}
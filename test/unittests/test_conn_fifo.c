@@ -0,0 +1,174 @@
+/* Copyright (c) 2017 - 2020 LiteSpeed Technologies Inc.  See LICENSE. */
+/*
+ * Test connection FIFO or benchmark it against the min-heap.
+ */
+
+#include <assert.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "lsquic_conn_fifo.h"
+#include "lsquic_min_heap.h"
+
+
+struct lsquic_conn
+{
+    struct lsquic_conn  *next;
+    uint64_t             last_ticked;
+    unsigned             n_popped;
+};
+
+
+static void
+test_order (void)
+{
+    struct conn_fifo fifo;
+    struct lsquic_conn conns[4], *conn;
+    unsigned i;
+
+    lsquic_cf_init(&fifo, offsetof(struct lsquic_conn, next));
+    assert(NULL == lsquic_cf_pop(&fifo));
+
+    for (i = 0; i < 3; ++i)
+        lsquic_cf_insert(&fifo, &conns[i], 0);
+    assert(3 == lsquic_cf_count(&fifo));
+    assert(&conns[0] == lsquic_cf_peek(&fifo));
+
+    conn = lsquic_cf_pop(&fifo);
+    assert(conn == &conns[0]);
+    /* Serviced in this round: goes to the back of the line... */
+    lsquic_cf_insert(&fifo, conn, 10);
+    /* ...behind a connection that has not been serviced yet. */
+    lsquic_cf_insert(&fifo, &conns[3], 0);
+
+    assert(&conns[1] == lsquic_cf_pop(&fifo));
+    assert(&conns[2] == lsquic_cf_pop(&fifo));
+    assert(&conns[3] == lsquic_cf_pop(&fifo));
+    assert(&conns[0] == lsquic_cf_pop(&fifo));
+    assert(NULL == lsquic_cf_pop(&fifo));
+    assert(0 == lsquic_cf_count(&fifo));
+}
+
+
+/* Every connection is serviced once per round, regardless of how many
+ * times the rounds wrap around.
+ */
+static void
+test_fairness (void)
+{
+    struct conn_fifo fifo;
+    struct lsquic_conn conns[100], *conn;
+    uint64_t now;
+    unsigned i;
+
+    lsquic_cf_init(&fifo, offsetof(struct lsquic_conn, next));
+    for (i = 0; i < sizeof(conns) / sizeof(conns[0]); ++i)
+    {
+        conns[i].n_popped = 0;
+        lsquic_cf_insert(&fifo, &conns[i], 0);
+    }
+
+    now = 1;
+    for (i = 0; i < 100 * sizeof(conns) / sizeof(conns[0]); ++i)
+    {
+        conn = lsquic_cf_pop(&fifo);
+        assert(conn);
+        assert(conn->n_popped == i / (sizeof(conns) / sizeof(conns[0])));
+        ++conn->n_popped;
+        conn->last_ticked = now++;
+        lsquic_cf_insert(&fifo, conn, conn->last_ticked);
+    }
+    assert(sizeof(conns) / sizeof(conns[0]) == lsquic_cf_count(&fifo));
+}
+
+
+static double
+elapsed (const struct timespec *start)
+{
+    struct timespec end;
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    return (double) (end.tv_sec - start->tv_sec)
+                        + (double) (end.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+
+/* Each iteration ticks every connection once: pop, update time, insert */
+static void
+benchmark (unsigned nconns, unsigned n_iters)
+{
+    struct lsquic_conn *conns, *conn;
+    struct min_heap heap;
+    struct conn_fifo fifo;
+    struct timespec start;
+    uint64_t now;
+    unsigned i, j;
+    double heap_sec, fifo_sec;
+
+    conns = malloc(sizeof(conns[0]) * nconns);
+    heap.mh_elems = malloc(sizeof(heap.mh_elems[0]) * nconns);
+    assert(conns && heap.mh_elems);
+    heap.mh_nalloc = nconns;
+    heap.mh_nelem = 0;
+    lsquic_cf_init(&fifo, offsetof(struct lsquic_conn, next));
+
+    now = 0;
+    for (i = 0; i < nconns; ++i)
+    {
+        conns[i].last_ticked = now++;
+        lsquic_mh_insert(&heap, &conns[i], conns[i].last_ticked);
+        lsquic_cf_insert(&fifo, &conns[i], conns[i].last_ticked);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (j = 0; j < n_iters; ++j)
+        for (i = 0; i < nconns; ++i)
+        {
+            conn = lsquic_mh_pop(&heap);
+            conn->last_ticked = now++;
+            lsquic_mh_insert(&heap, conn, conn->last_ticked);
+        }
+    heap_sec = elapsed(&start);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (j = 0; j < n_iters; ++j)
+        for (i = 0; i < nconns; ++i)
+        {
+            conn = lsquic_cf_pop(&fifo);
+            conn->last_ticked = now++;
+            lsquic_cf_insert(&fifo, conn, conn->last_ticked);
+        }
+    fifo_sec = elapsed(&start);
+
+    printf("%u conns, %u iters: heap %.1f ns/op; fifo %.1f ns/op\n",
+        nconns, n_iters,
+        heap_sec * 1e9 / ((double) nconns * n_iters),
+        fifo_sec * 1e9 / ((double) nconns * n_iters));
+
+    free(heap.mh_elems);
+    free(conns);
+}
+
+
+int
+main (int argc, char **argv)
+{
+    if (argc == 1)
+    {
+        test_order();
+        test_fairness();
+        return 0;
+    }
+
+    if (argc != 3)
+    {
+        fprintf(stderr, "usage: %s nconns iters\n", argv[0]);
+        return 1;
+    }
+
+    benchmark(atoi(argv[1]), atoi(argv[2]));
+    return 0;
+}
@@ -0,0 +1,254 @@
+/* Copyright (c) 2017 - 2020 LiteSpeed Technologies Inc.  See LICENSE. */
+/*
+ * test_conn_pool.c -- Test placement of streams in client connection pool
+ */
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/queue.h>
+#ifndef WIN32
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#else
+#include "vc_compat.h"
+#endif
+
+#include "lsquic.h"
+#include "lsquic_types.h"
+#include "lsquic_int_types.h"
+#include "lsquic_hash.h"
+#include "lsquic_conn.h"
+#include "lsquic_conn_pool.h"
+
+
+struct test_conn
+{
+    struct lsquic_conn  lconn;      /* Must be first */
+    unsigned            avail;
+    unsigned            pending;
+    lsquic_time_t       srtt;
+};
+
+
+static unsigned
+test_n_avail_streams (const struct lsquic_conn *lconn)
+{
+    return ((const struct test_conn *) lconn)->avail;
+}
+
+
+static unsigned
+test_n_pending_streams (const struct lsquic_conn *lconn)
+{
+    return ((const struct test_conn *) lconn)->pending;
+}
+
+
+static void
+test_make_stream (struct lsquic_conn *lconn)
+{
+    struct test_conn *const conn = (struct test_conn *) lconn;
+
+    if (conn->avail > 0)
+        --conn->avail;
+    else
+        ++conn->pending;
+}
+
+
+static lsquic_time_t
+test_srtt (const struct lsquic_conn *lconn)
+{
+    return ((const struct test_conn *) lconn)->srtt;
+}
+
+
+static const struct conn_iface test_conn_iface = {
+    .ci_make_stream         = test_make_stream,
+    .ci_n_avail_streams     = test_n_avail_streams,
+    .ci_n_pending_streams   = test_n_pending_streams,
+    .ci_srtt                = test_srtt,
+};
+
+
+struct test_ctx
+{
+    struct test_conn    conns[10];
+    unsigned            n_conns;
+    int                 fail;
+};
+
+
+static struct lsquic_conn *
+test_connect (void *ctx, const struct lsquic_pool_dest *dest)
+{
+    struct test_ctx *const tctx = ctx;
+    struct test_conn *conn;
+
+    if (tctx->fail || tctx->n_conns >= sizeof(tctx->conns)
+                                                / sizeof(tctx->conns[0]))
+        return NULL;
+
+    conn = &tctx->conns[ tctx->n_conns++ ];
+    memset(conn, 0, sizeof(*conn));
+    conn->lconn.cn_if = &test_conn_iface;
+    return &conn->lconn;
+}
+
+
+static void
+handshake_done (struct test_conn *conn, unsigned avail, lsquic_time_t srtt)
+{
+    conn->lconn.cn_flags |= LSCONN_HANDSHAKE_DONE;
+    conn->avail = avail > conn->pending ? avail - conn->pending : 0;
+    conn->pending = 0;
+    conn->srtt = srtt;
+}
+
+
+static void
+init_dest (struct lsquic_pool_dest *dest, struct sockaddr_in *sin,
+                                                        const char *hostname)
+{
+    memset(sin, 0, sizeof(*sin));
+    sin->sin_family = AF_INET;
+    sin->sin_port = htons(443);
+    sin->sin_addr.s_addr = htonl(0x7F000001);
+    memset(dest, 0, sizeof(*dest));
+    dest->peer_sa = (struct sockaddr *) sin;
+    dest->hostname = hostname;
+    dest->version = N_LSQVER;
+}
+
+
+/* New connections are opened only when existing ones have no credit */
+static void
+test_placement (void)
+{
+    struct test_ctx tctx;
+    struct conn_pool *pool;
+    struct lsquic_pool_dest dest;
+    struct sockaddr_in sin;
+    struct lsquic_conn *lconn;
+
+    memset(&tctx, 0, sizeof(tctx));
+    init_dest(&dest, &sin, "example.com");
+    pool = lsquic_cpool_new(3, 2, test_connect, &tctx);
+    assert(pool);
+
+    /* Before handshake, peer is assumed to allow two streams */
+    lconn = lsquic_cpool_make_stream(pool, &dest);
+    assert(lconn == &tctx.conns[0].lconn);
+    lconn = lsquic_cpool_make_stream(pool, &dest);
+    assert(lconn == &tctx.conns[0].lconn);
+    assert(2 == tctx.conns[0].pending);
+    lconn = lsquic_cpool_make_stream(pool, &dest);
+    assert(lconn == &tctx.conns[1].lconn);
+    assert(2 == tctx.n_conns);
+    assert(2 == lsquic_cpool_count(pool));
+    assert(tctx.conns[1].lconn.cn_flags & LSCONN_POOLED);
+
+    /* Same credit: lower RTT wins */
+    handshake_done(&tctx.conns[0], 12, 30000);
+    handshake_done(&tctx.conns[1], 11, 20000);
+    assert(10 == tctx.conns[0].avail && 10 == tctx.conns[1].avail);
+    lconn = lsquic_cpool_make_stream(pool, &dest);
+    assert(lconn == &tctx.conns[1].lconn);
+
+    /* More credit wins over lower RTT */
+    lconn = lsquic_cpool_make_stream(pool, &dest);
+    assert(lconn == &tctx.conns[0].lconn);
+
+    /* The limit seen after handshake is used for new connections */
+    tctx.conns[0].avail = 0;
+    tctx.conns[1].avail = 0;
+    lconn = lsquic_cpool_make_stream(pool, &dest);
+    assert(lconn == &tctx.conns[2].lconn);
+    assert(3 == tctx.n_conns);
+    tctx.conns[2].pending = 9;
+    lconn = lsquic_cpool_make_stream(pool, &dest);
+    assert(lconn == &tctx.conns[2].lconn);
+    assert(10 == tctx.conns[2].pending);
+
+    /* No credit and no room for more connections: fewest pending wins */
+    tctx.conns[0].pending = 3;
+    tctx.conns[1].pending = 1;
+    lconn = lsquic_cpool_make_stream(pool, &dest);
+    assert(lconn == &tctx.conns[1].lconn);
+    assert(2 == tctx.conns[1].pending);
+    assert(3 == tctx.n_conns);
+
+    /* Connection going away is dropped and replaced */
+    tctx.conns[1].lconn.cn_flags |= LSCONN_PEER_GOING_AWAY;
+    lconn = lsquic_cpool_make_stream(pool, &dest);
+    assert(lconn == &tctx.conns[3].lconn);
+    assert(!(tctx.conns[1].lconn.cn_flags & LSCONN_POOLED));
+    assert(3 == lsquic_cpool_count(pool));
+
+    /* Destroyed connection is removed */
+    lsquic_cpool_remove(pool, &tctx.conns[0].lconn);
+    assert(!(tctx.conns[0].lconn.cn_flags & LSCONN_POOLED));
+    assert(2 == lsquic_cpool_count(pool));
+
+    lsquic_cpool_destroy(pool);
+    assert(!(tctx.conns[2].lconn.cn_flags & LSCONN_POOLED));
+}
+
+
+static void
+test_prewarm (void)
+{
+    struct test_ctx tctx;
+    struct conn_pool *pool;
+    struct lsquic_pool_dest dest[2];
+    struct sockaddr_in sin[2];
+    struct lsquic_conn *lconn;
+    unsigned i;
+
+    memset(&tctx, 0, sizeof(tctx));
+    init_dest(&dest[0], &sin[0], "example.com");
+    init_dest(&dest[1], &sin[1], "example.org");
+    pool = lsquic_cpool_new(3, 100, test_connect, &tctx);
+    assert(pool);
+
+    assert(2 == lsquic_cpool_prewarm(pool, &dest[0], 2));
+    assert(2 == lsquic_cpool_prewarm(pool, &dest[0], 1));
+    assert(3 == lsquic_cpool_prewarm(pool, &dest[0], 5));
+    assert(3 == tctx.n_conns);
+
+    /* Streams are spread over prewarmed connections: the one with the
+     * most credit is picked.
+     */
+    for (i = 0; i < 3; ++i)
+    {
+        lconn = lsquic_cpool_make_stream(pool, &dest[0]);
+        assert(lconn);
+    }
+    assert(1 == tctx.conns[0].pending);
+    assert(1 == tctx.conns[1].pending);
+    assert(1 == tctx.conns[2].pending);
+
+    /* Different hostname is a different destination */
+    lconn = lsquic_cpool_make_stream(pool, &dest[1]);
+    assert(lconn == &tctx.conns[3].lconn);
+    assert(4 == lsquic_cpool_count(pool));
+
+    /* Failure to connect */
+    tctx.fail = 1;
+    sin[1].sin_port = htons(8443);
+    assert(-1 == lsquic_cpool_prewarm(pool, &dest[1], 1));
+    assert(NULL == lsquic_cpool_make_stream(pool, &dest[1]));
+    assert(4 == lsquic_cpool_count(pool));
+
+    lsquic_cpool_destroy(pool);
+}
+
+
+int
+main (void)
+{
+    test_placement();
+    test_prewarm();
+    return 0;
+}
@@ -29,6 +29,7 @@
 #include "lsquic_packet_in.h"
 #include "lsquic_packet_out.h"
 #include "lsquic_mm.h"
+#include "lsquic_engine_public.h"
 #include "lsquic_logger.h"
 #include "lsquic_data_in_if.h"
 
@@ -272,6 +273,7 @@ run_di_nocopy_test (const struct nocopy_test *test)
 {
     struct lsquic_mm mm;
     struct lsquic_conn_public conn_pub;
+    struct lsquic_engine_public enpub;
     struct lsquic_conn conn;
     struct stream_frame *frame;
     struct data_in *di;
@@ -284,8 +286,10 @@ run_di_nocopy_test (const struct nocopy_test *test)
 
     lsquic_mm_init(&mm);
     memset(&conn, 0, sizeof(conn));
+    memset(&enpub, 0, sizeof(enpub));
     conn_pub.lconn = &conn;
     conn_pub.mm = &mm;
+    conn_pub.enpub = &enpub;
 
     di = lsquic_data_in_nocopy_new(&conn_pub, 3);
 
@@ -324,6 +328,70 @@ run_di_nocopy_test (const struct nocopy_test *test)
     ins = di->di_if->di_insert_frame(di, frame, test->read_until);
     assert(test->ins == ins);
 
+    di->di_if->di_destroy(di);
+    assert(0 == enpub.enp_di_pinned);
+    assert(0 == enpub.enp_di_used);
+    lsquic_mm_cleanup(&mm);
+}
+
+
+/* Small frames in large packets that are not read: the data should be
+ * compacted once the packets pin enough memory.
+ */
+static void
+test_pinned_compaction (void)
+{
+    struct lsquic_mm mm;
+    struct lsquic_conn_public conn_pub;
+    struct lsquic_engine_public enpub;
+    struct lsquic_conn conn;
+    struct stream_frame *frame;
+    struct data_in *di;
+    struct data_frame *data_frame;
+    enum ins_frame ins;
+    unsigned i;
+    unsigned char buf[100];
+
+    lsquic_mm_init(&mm);
+    memset(&conn, 0, sizeof(conn));
+    memset(&enpub, 0, sizeof(enpub));
+    conn_pub.lconn = &conn;
+    conn_pub.mm = &mm;
+    conn_pub.enpub = &enpub;
+    for (i = 0; i < sizeof(buf); ++i)
+        buf[i] = i;
+
+    di = lsquic_data_in_nocopy_new(&conn_pub, 3);
+
+    for (i = 0; !(di->di_flags & DI_SWITCH_IMPL); ++i)
+    {
+        assert(i < 20);
+        frame = lsquic_malo_get(mm.malo.stream_frame);
+        frame->packet_in = lsquic_mm_get_packet_in(&mm);
+        frame->packet_in->pi_refcnt = 1;
+        frame->packet_in->pi_data_sz = 1350;
+        frame->data_frame = (struct data_frame) {
+            .df_offset = i * sizeof(buf),
+            .df_size = sizeof(buf),
+            .df_data = buf,
+        };
+        ins = di->di_if->di_insert_frame(di, frame, 0);
+        assert(INS_FRAME_OK == ins);
+    }
+    assert(enpub.enp_di_pinned == i * 1350);
+    assert(enpub.enp_di_used == i * sizeof(buf));
+    assert(0 == enpub.enp_di_compactions);
+
+    di = di->di_if->di_switch_impl(di, 0);
+    assert(di);
+    assert(0 == enpub.enp_di_pinned);
+    assert(0 == enpub.enp_di_used);
+    assert(1 == enpub.enp_di_compactions);
+
+    data_frame = di->di_if->di_get_frame(di, 0);
+    assert(data_frame);
+    assert(0 == memcmp(data_frame->df_data, buf, sizeof(buf)));
+
     di->di_if->di_destroy(di);
     lsquic_mm_cleanup(&mm);
 }
@@ -352,5 +420,7 @@ main (int argc, char **argv)
     for (test = tests; test < tests + sizeof(tests) / sizeof(tests[0]); ++test)
         run_di_nocopy_test(test);
 
+    test_pinned_compaction();
+
     return 0;
 }
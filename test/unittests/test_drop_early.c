@@ -0,0 +1,145 @@
+/* Copyright (c) 2017 - 2020 LiteSpeed Technologies Inc.  See LICENSE. */
+/*
+ * test_drop_early.c -- Test stateless checks done on incoming server
+ * datagrams before a packet_in is allocated.
+ */
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#ifndef WIN32
+#include <netinet/in.h>
+#include <sys/socket.h>
+#else
+#include "vc_compat.h"
+#endif
+
+#include "lsquic.h"
+
+
+static const unsigned char s_id27_tag[4]   = { 0xFF, 0, 0, 27, };
+static const unsigned char s_unsup_tag[4]  = { 0x1A, 0x2A, 0x3A, 0x4A, };
+static const unsigned char s_verneg_tag[4] = { 0, 0, 0, 0, };
+
+
+/* Long header: first byte, version, DCIL, DCID, SCIL, SCID; the rest of
+ * the datagram is filler.
+ */
+static size_t
+make_datagram (unsigned char *buf, size_t sz, unsigned char first_byte,
+                    const unsigned char *tag, unsigned dcil)
+{
+    unsigned char *p;
+
+    assert(sz >= 1 + 4 + 1 + dcil + 1 + 8);
+    memset(buf, 0, sz);
+    p = buf;
+    *p++ = first_byte;
+    memcpy(p, tag, 4);
+    p += 4;
+    *p++ = dcil;
+    memset(p, 0xDC, dcil);
+    p += dcil;
+    *p++ = 8;
+    memset(p, 0x5C, 8);
+    return sz;
+}
+
+
+struct test_ctx
+{
+    lsquic_engine_t                *engine;
+    struct sockaddr_in              local, peer;
+    struct lsquic_engine_drop_stats expected;
+};
+
+
+/* Feed datagram to the engine and check that only the expected counter,
+ * if any, changed.
+ */
+static void
+feed (struct test_ctx *ctx, const unsigned char *buf, size_t sz,
+                                            unsigned long *counter, int drop)
+{
+    struct lsquic_engine_drop_stats stats;
+    int s;
+
+    s = lsquic_engine_packet_in(ctx->engine, buf, sz,
+                    (struct sockaddr *) &ctx->local,
+                    (struct sockaddr *) &ctx->peer, NULL, 0);
+    if (drop)
+        assert(s == 1);
+    if (counter)
+        ++*counter;
+    lsquic_engine_get_drop_stats(ctx->engine, &stats);
+    assert(0 == memcmp(&stats, &ctx->expected, sizeof(stats)));
+}
+
+
+int
+main (void)
+{
+    struct lsquic_engine_settings settings;
+    struct lsquic_engine_api api;
+    struct test_ctx ctx;
+    unsigned char buf[1300];
+    const unsigned flags = LSENG_SERVER;
+
+    lsquic_engine_init_settings(&settings, flags);
+    settings.es_versions = 1 << LSQVER_ID27;
+    memset(&api, 0, sizeof(api));
+    api.ea_settings = &settings;
+    api.ea_packets_out = (void *) (uintptr_t) 1;
+    api.ea_stream_if = (void *) (uintptr_t) 2;
+
+    memset(&ctx, 0, sizeof(ctx));
+    ctx.engine = lsquic_engine_new(flags, &api);
+    assert(ctx.engine);
+    ctx.local.sin_family = AF_INET;
+    ctx.local.sin_port = htons(443);
+    ctx.local.sin_addr.s_addr = htonl(0x7F000001);
+    ctx.peer = ctx.local;
+    ctx.peer.sin_port = htons(12345);
+
+    /* Long header too short to hold version and DCIL */
+    buf[0] = 0xC0;
+    feed(&ctx, buf, 5, &ctx.expected.ds_short, 1);
+
+    /* Version Negotiation packets are not for servers */
+    make_datagram(buf, 100, 0xC0, s_verneg_tag, 8);
+    feed(&ctx, buf, 100, &ctx.expected.ds_verneg, 1);
+
+    /* Supported version, DCID too long */
+    make_datagram(buf, 1200, 0xC0, s_id27_tag, 21);
+    feed(&ctx, buf, 1200, &ctx.expected.ds_cid_len, 1);
+
+    /* Small datagram with unsupported version: no Version Negotiation */
+    make_datagram(buf, 100, 0xC0, s_unsup_tag, 8);
+    feed(&ctx, buf, 100, &ctx.expected.ds_small_unsup, 1);
+    make_datagram(buf, 100, 0xC0, s_unsup_tag, 21);
+    feed(&ctx, buf, 100, &ctx.expected.ds_small_unsup, 1);
+
+    /* Large enough datagrams with unsupported versions are not dropped
+     * early, whatever their DCID length: they warrant Version Negotiation.
+     */
+    make_datagram(buf, 1200, 0xC0, s_unsup_tag, 8);
+    feed(&ctx, buf, 1200, NULL, 0);
+    make_datagram(buf, 1200, 0xC0, s_unsup_tag, 21);
+    feed(&ctx, buf, 1200, NULL, 0);
+
+    /* Initial packet in a datagram that is not padded */
+    make_datagram(buf, 100, 0xC0, s_id27_tag, 8);
+    feed(&ctx, buf, 100, &ctx.expected.ds_small_initial, 1);
+
+    /* Small Handshake packet is legal */
+    make_datagram(buf, 100, 0xE0, s_id27_tag, 8);
+    feed(&ctx, buf, 100, NULL, 0);
+
+    /* gQUIC long headers are left to the regular parsers */
+    make_datagram(buf, 100, 0xC0, (unsigned char *) "Q050", 8);
+    feed(&ctx, buf, 100, NULL, 0);
+
+    lsquic_engine_destroy(ctx.engine);
+    return 0;
+}
@@ -124,12 +124,18 @@ compare_errors (const struct cv_error *got_err,
 }
 
 
+/* When header blocks are decoded in place, callbacks are called before
+ * stream offset is advanced.
+ */
+static int s_use_readf;
+
+
 static void
 compare_cb_vals (const struct callback_value *got,
                  const struct callback_value *exp)
 {
     assert(got->type == exp->type);
-    if (exp->stream_off)
+    if (exp->stream_off && !s_use_readf)
         assert(exp->stream_off == got->stream_off);
     switch (got->type)
     {
@@ -292,6 +298,26 @@ read_from_stream (struct lsquic_stream *stream, void *buf, size_t sz)
 }
 
 
+/* Like lsquic_stream_readf(), presents data in a single contiguous chunk */
+static ssize_t
+readf_from_stream (struct lsquic_stream *stream,
+        size_t (*readf)(void *, const unsigned char *, size_t, int), void *ctx)
+{
+    size_t sz, nread;
+
+    sz = input.in_sz - input.in_off;
+    if (sz > input.in_max_req_sz)
+        input.in_max_req_sz = sz;
+    if (sz > input.in_max_sz)
+        sz = input.in_max_sz;
+    if (sz == 0)
+        return 0;
+    nread = readf(ctx, input.in_buf + input.in_off, sz, 0);
+    input.in_off += nread;
+    return nread;
+}
+
+
 struct frame_reader_test {
     unsigned                        frt_lineno;
     /* Input */
@@ -1141,6 +1167,8 @@ test_one_frt (const struct frame_reader_test *frt)
                 &conn_stats,
 #endif
                 lsquic_http1x_if, NULL);
+        if (s_use_readf)
+            lsquic_frame_reader_set_readf(fr, readf_from_stream);
         do
         {
             s = lsquic_frame_reader_read(fr);
@@ -1189,7 +1217,8 @@ main (int argc, char **argv)
     }
 
     const struct frame_reader_test *frt;
-    for (frt = tests; frt->frt_bufsz > 0; ++frt)
-        test_one_frt(frt);
+    for (s_use_readf = 0; s_use_readf < 2; ++s_use_readf)
+        for (frt = tests; frt->frt_bufsz > 0; ++frt)
+            test_one_frt(frt);
     return 0;
 }
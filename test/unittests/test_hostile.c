@@ -0,0 +1,350 @@
+/* Copyright (c) 2017 - 2020 LiteSpeed Technologies Inc.  See LICENSE. */
+/*
+ * Feed patterns a hostile peer could produce to structures that process
+ * peer input and check that memory use and per-packet work stay bounded.
+ * Where the structure allows it, work is counted: number of packet ranges
+ * an insert may walk and number of ranges walked to generate an ACK frame.
+ *
+ * With -t, also check that doubling the input does not quadruple the time
+ * taken.  This depends on the machine being otherwise idle, so it is not
+ * done by default.
+ *
+ * With -b, print time and memory per packet (or frame) for each pattern
+ * instead: e.g. `test_hostile -b 1000000'.
+ */
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/queue.h>
+#include <time.h>
+#ifdef WIN32
+#include "getopt.h"
+#else
+#include <unistd.h>
+#endif
+
+#include "lsquic.h"
+#include "lsquic_types.h"
+#include "lsquic_int_types.h"
+#include "lsquic_rechist.h"
+#include "lsquic_parse.h"
+#include "lsquic_sfcw.h"
+#include "lsquic_rtt.h"
+#include "lsquic_conn_flow.h"
+#include "lsquic_varint.h"
+#include "lsquic_hq.h"
+#include "lsquic_hash.h"
+#include "lsquic_stream.h"
+#include "lsquic_conn.h"
+#include "lsquic_conn_public.h"
+#include "lsquic_packet_common.h"
+#include "lsquic_packet_in.h"
+#include "lsquic_mm.h"
+#include "lsquic_logger.h"
+#include "lsquic_data_in_if.h"
+
+
+static struct lsquic_conn lconn = LSCONN_INITIALIZER_CIDLEN(lconn, 0);
+
+static const struct parse_funcs *const pf = select_pf_by_ver(LSQVER_ID27);
+
+
+struct pattern
+{
+    const char     *name;
+    /* Run pattern `n' times.  Return memory used at the end. */
+    size_t        (*run)(unsigned n);
+    /* Benchmark: limit `n' if it would use too much memory */
+    unsigned        max_n;
+};
+
+
+static double
+now_sec (void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double) ts.tv_sec + (double) ts.tv_nsec / 1e9;
+}
+
+
+/* Inserting a packet number walks the list of ranges: the cap on their
+ * number bounds the work.
+ */
+static void
+rechist_received (struct lsquic_rechist *rechist, lsquic_packno_t packno)
+{
+    (void) lsquic_rechist_received(rechist, packno, 0);
+    assert(lsquic_packints_count(&rechist->rh_pints)
+                                            <= LSQUIC_RECHIST_MAX_RANGES);
+}
+
+
+static size_t
+finish_rechist (struct lsquic_rechist *rechist)
+{
+    size_t mem_used;
+
+    assert(lsquic_packints_count(&rechist->rh_pints)
+                                            <= LSQUIC_RECHIST_MAX_RANGES);
+    mem_used = lsquic_rechist_mem_used(rechist);
+    lsquic_rechist_cleanup(rechist);
+    return mem_used;
+}
+
+
+/* Skip every other packet number */
+static size_t
+rechist_sparse_up (unsigned n)
+{
+    struct lsquic_rechist rechist;
+    unsigned i;
+
+    lsquic_rechist_init(&rechist, &lconn, 1);
+    for (i = 0; i < n; ++i)
+        rechist_received(&rechist, i * 2);
+
+    return finish_rechist(&rechist);
+}
+
+
+/* Same, but in reverse, so that each new range is the lowest */
+static size_t
+rechist_sparse_down (unsigned n)
+{
+    struct lsquic_rechist rechist;
+    unsigned i;
+
+    lsquic_rechist_init(&rechist, &lconn, 1);
+    for (i = n; i > 0; --i)
+        rechist_received(&rechist, i * 2);
+
+    return finish_rechist(&rechist);
+}
+
+
+/* Random sparse packet numbers in a window trailing the largest */
+static size_t
+rechist_sparse_random (unsigned n)
+{
+    struct lsquic_rechist rechist;
+    lsquic_packno_t packno;
+    unsigned i;
+
+    srand(n);
+    lsquic_rechist_init(&rechist, &lconn, 1);
+    for (i = 0; i < n; ++i)
+    {
+        packno = (lsquic_packno_t) i * 4;
+        if (packno > 100000)
+            packno -= (lsquic_packno_t) (rand() % 50000) * 2;
+        rechist_received(&rechist, packno);
+    }
+
+    return finish_rechist(&rechist);
+}
+
+
+/* Number of ranges the ACK frame generator has walked */
+static unsigned s_n_ranges_walked;
+
+
+static const struct lsquic_packno_range *
+count_rechist_first (void *rechist)
+{
+    ++s_n_ranges_walked;
+    return lsquic_rechist_first(rechist);
+}
+
+
+static const struct lsquic_packno_range *
+count_rechist_next (void *rechist)
+{
+    ++s_n_ranges_walked;
+    return lsquic_rechist_next(rechist);
+}
+
+
+/* Generate and parse ACK frames from a history with many ranges */
+static size_t
+ack_many_ranges (unsigned n)
+{
+    struct lsquic_rechist rechist;
+    struct ack_info *acki;
+    lsquic_packno_t largest;
+    unsigned char buf[1500];
+    unsigned i;
+    int has_missing, w, s;
+
+    lsquic_rechist_init(&rechist, &lconn, 1);
+    for (i = 0; i < 1000; ++i)
+        rechist_received(&rechist, i * 2);
+
+    acki = malloc(sizeof(*acki));
+    for (i = 0; i < n; ++i)
+    {
+        s_n_ranges_walked = 0;
+        w = pf->pf_gen_ack_frame(buf, sizeof(buf), count_rechist_first,
+            count_rechist_next,
+            (gaf_rechist_largest_recv_f) lsquic_rechist_largest_recv,
+            &rechist, 0, &has_missing, &largest, NULL);
+        assert(w > 0);
+        /* Each range at most once, plus the NULL at the end */
+        assert(s_n_ranges_walked <= LSQUIC_RECHIST_MAX_RANGES + 1);
+        s = pf->pf_parse_ack_frame(buf, w, acki, 0);
+        assert(s == w);
+        assert(acki->n_ranges <= sizeof(acki->ranges)
+                                                / sizeof(acki->ranges[0]));
+        assert(largest == acki->ranges[0].high);
+    }
+    free(acki);
+
+    return finish_rechist(&rechist);
+}
+
+
+/* Amount of data in a block: see DB_DATA_SIZE in lsquic_di_hash.c */
+#define DI_HASH_BLOCK_SZ 3616
+
+/* One-byte frames at offsets far apart.  Offsets are a power-of-two number
+ * of blocks apart to try to get them into the same hash bucket.
+ */
+static size_t
+di_hash_scattered (unsigned n)
+{
+    struct lsquic_mm mm;
+    struct lsquic_conn_public conn_pub;
+    struct data_in *di;
+    struct data_frame data_frame;
+    enum ins_frame ins;
+    unsigned i;
+    size_t mem_used;
+    unsigned char byte;
+
+    lsquic_mm_init(&mm);
+    memset(&conn_pub, 0, sizeof(conn_pub));
+    conn_pub.lconn = &lconn;
+    conn_pub.mm = &mm;
+
+    di = lsquic_data_in_hash_new(&conn_pub, 3, 0);
+    assert(di);
+    byte = 'x';
+    for (i = 0; i < n; ++i)
+    {
+        memset(&data_frame, 0, sizeof(data_frame));
+        data_frame.df_offset = ((uint64_t) i << 10) * DI_HASH_BLOCK_SZ + 1;
+        data_frame.df_size = 1;
+        data_frame.df_data = &byte;
+        ins = lsquic_data_in_hash_insert_data_frame(di, &data_frame, 0);
+        assert(INS_FRAME_OK == ins);
+    }
+
+    mem_used = di->di_if->di_mem_used(di);
+    /* Bounded by the number of frames: one block for each */
+    assert(mem_used < (size_t) n * 0x1000 * 2 + 0x10000);
+    di->di_if->di_destroy(di);
+    lsquic_mm_cleanup(&mm);
+    return mem_used;
+}
+
+
+static const struct pattern patterns[] =
+{
+    { "rechist: sparse packet numbers",             rechist_sparse_up, },
+    { "rechist: sparse packet numbers, reversed",   rechist_sparse_down, },
+    { "rechist: sparse packet numbers, reordered",  rechist_sparse_random, },
+    { "ACK frame with many ranges: gen and parse",  ack_many_ranges, },
+    { "di_hash: scattered one-byte frames",         di_hash_scattered,
+                                                                    20000, },
+};
+
+
+/* The limits should make time per packet roughly constant: check that
+ * doubling the input does not quadruple the time.  Only done with -t.
+ */
+static void
+check_scaling (const struct pattern *pat, unsigned n)
+{
+    double start, t1, t2;
+
+    start = now_sec();
+    pat->run(n);
+    t1 = now_sec() - start;
+    start = now_sec();
+    pat->run(n * 2);
+    t2 = now_sec() - start;
+    if (t1 > 0.01 && t2 > t1 * 4)
+    {
+        fprintf(stderr, "%s: %u: %.3f sec; %u: %.3f sec\n", pat->name,
+                                                    n, t1, n * 2, t2);
+        assert(0);
+    }
+}
+
+
+static void
+benchmark (unsigned n)
+{
+    const struct pattern *pat;
+    double start, elapsed;
+    size_t mem_used;
+    unsigned count;
+
+    for (pat = patterns; pat < patterns + sizeof(patterns)
+                                                / sizeof(patterns[0]); ++pat)
+    {
+        count = pat->max_n && n > pat->max_n ? pat->max_n : n;
+        start = now_sec();
+        mem_used = pat->run(count);
+        elapsed = now_sec() - start;
+        printf("%-45s %u: %.1f ns/op; memory: %zu bytes, %.1f bytes/op\n",
+            pat->name, count, elapsed * 1e9 / count, mem_used,
+            (double) mem_used / count);
+    }
+}
+
+
+int
+main (int argc, char **argv)
+{
+    const struct pattern *pat;
+    unsigned n;
+    int opt, timing;
+
+    lsquic_log_to_fstream(stderr, LLTS_NONE);
+
+    timing = 0;
+    while (-1 != (opt = getopt(argc, argv, "b:l:t")))
+    {
+        switch (opt)
+        {
+        case 'b':
+            benchmark(atoi(optarg));
+            return 0;
+        case 'l':
+            lsquic_logger_lopt(optarg);
+            break;
+        case 't':
+            timing = 1;
+            break;
+        default:
+            return 1;
+        }
+    }
+
+    for (pat = patterns; pat < patterns + sizeof(patterns)
+                                                / sizeof(patterns[0]); ++pat)
+    {
+        n = pat->run == ack_many_ranges ? 5000
+          : pat->run == di_hash_scattered ? 5000 : 200000;
+        if (timing)
+            check_scaling(pat, n);
+        else
+            (void) pat->run(n);
+    }
+
+    return 0;
+}
@@ -0,0 +1,96 @@
+/* Copyright (c) 2017 - 2020 LiteSpeed Technologies Inc.  See LICENSE. */
+/*
+ * test_ikey_cache.c -- Test cache of derived Initial keys
+ */
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "lsquic_types.h"
+#include "lsquic_ikey_cache.h"
+
+
+static void
+make_cid (lsquic_cid_t *cid, unsigned char id)
+{
+    memset(cid, 0, sizeof(*cid));
+    cid->len = 8;
+    memset(cid->idbuf, id, cid->len);
+}
+
+
+static void
+make_material (struct ikey_material *ikm, unsigned char id)
+{
+    memset(ikm, id, sizeof(*ikm));
+}
+
+
+int
+main (void)
+{
+    struct ikey_cache *cache;
+    const struct ikey_material *got;
+    struct ikey_material ikm;
+    lsquic_cid_t cid;
+    unsigned char id;
+
+    assert(NULL == lsquic_ikc_new(0));
+    cache = lsquic_ikc_new(3);
+    assert(cache);
+
+    make_cid(&cid, 1);
+    assert(NULL == lsquic_ikc_get(cache, &cid));
+
+    for (id = 1; id <= 3; ++id)
+    {
+        make_cid(&cid, id);
+        make_material(&ikm, id);
+        lsquic_ikc_put(cache, &cid, &ikm);
+    }
+
+    for (id = 1; id <= 3; ++id)
+    {
+        make_cid(&cid, id);
+        make_material(&ikm, id);
+        got = lsquic_ikc_get(cache, &cid);
+        assert(got);
+        assert(0 == memcmp(got, &ikm, sizeof(ikm)));
+    }
+
+    /* CIDs of different length do not match */
+    make_cid(&cid, 1);
+    cid.len = 4;
+    assert(NULL == lsquic_ikc_get(cache, &cid));
+
+    /* Use entry 1 so that entry 2 becomes the least recently used */
+    make_cid(&cid, 1);
+    assert(lsquic_ikc_get(cache, &cid));
+    make_cid(&cid, 4);
+    make_material(&ikm, 4);
+    lsquic_ikc_put(cache, &cid, &ikm);
+
+    make_cid(&cid, 2);
+    assert(NULL == lsquic_ikc_get(cache, &cid));
+    make_cid(&cid, 1);
+    assert(lsquic_ikc_get(cache, &cid));
+    make_cid(&cid, 3);
+    assert(lsquic_ikc_get(cache, &cid));
+    make_cid(&cid, 4);
+    assert(lsquic_ikc_get(cache, &cid));
+
+    /* Putting existing CID replaces its material */
+    make_cid(&cid, 3);
+    make_material(&ikm, 0x33);
+    lsquic_ikc_put(cache, &cid, &ikm);
+    got = lsquic_ikc_get(cache, &cid);
+    assert(got && 0 == memcmp(got, &ikm, sizeof(ikm)));
+    make_cid(&cid, 4);
+    assert(lsquic_ikc_get(cache, &cid));
+    make_cid(&cid, 1);
+    assert(lsquic_ikc_get(cache, &cid));
+
+    lsquic_ikc_destroy(cache);
+    return 0;
+}
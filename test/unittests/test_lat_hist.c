@@ -0,0 +1,93 @@
+/* Copyright (c) 2017 - 2020 LiteSpeed Technologies Inc.  See LICENSE. */
+/*
+ * Test latency histograms
+ */
+
+#include <assert.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "lsquic.h"
+#include "lsquic_int_types.h"
+#include "lsquic_lat_hist.h"
+
+
+static unsigned
+find_bucket (const struct lsquic_lat_hist *hist)
+{
+    unsigned idx;
+
+    for (idx = 0; idx < LSQUIC_LAT_HIST_N_BUCKETS; ++idx)
+        if (hist->lh_buckets[idx])
+            return idx;
+    assert(0);
+    return 0;
+}
+
+
+/* Each value lands in the bucket whose lower bound is at most the value
+ * and within 1/8 of it.
+ */
+static void
+test_buckets (void)
+{
+    struct lsquic_lat_hist hist;
+    unsigned long long min;
+    lsquic_time_t val;
+    unsigned idx, prev_idx;
+
+    prev_idx = 0;
+    for (val = 0; val < (1ull << 36); val = val < 100 ? val + 1 : val * 9 / 8)
+    {
+        memset(&hist, 0, sizeof(hist));
+        lsquic_lat_hist_record(&hist, val);
+        idx = find_bucket(&hist);
+        assert(idx >= prev_idx);
+        assert(idx < LSQUIC_LAT_HIST_N_BUCKETS);
+        min = lsquic_lat_hist_bucket_min(idx);
+        assert(min <= val);
+        assert(val - min <= val / 8);
+        prev_idx = idx;
+    }
+
+    for (idx = 1; idx < LSQUIC_LAT_HIST_N_BUCKETS; ++idx)
+        assert(lsquic_lat_hist_bucket_min(idx - 1)
+                                        < lsquic_lat_hist_bucket_min(idx));
+
+    memset(&hist, 0, sizeof(hist));
+    lsquic_lat_hist_record(&hist, ~0ull);
+    assert(LSQUIC_LAT_HIST_N_BUCKETS - 1 == find_bucket(&hist));
+}
+
+
+static void
+test_percentiles (void)
+{
+    struct lsquic_lat_hist hist;
+    lsquic_time_t val;
+    unsigned long long p50, p99;
+
+    memset(&hist, 0, sizeof(hist));
+    assert(0 == lsquic_lat_hist_percentile(&hist, 50.));
+
+    for (val = 1; val <= 1000; ++val)
+        lsquic_lat_hist_record(&hist, val);
+    assert(1000 == hist.lh_count);
+    assert(500500 == hist.lh_sum);
+    assert(1000 == hist.lh_max);
+
+    p50 = lsquic_lat_hist_percentile(&hist, 50.);
+    assert(p50 <= 501 && p50 >= 501 - 501 / 8);
+    p99 = lsquic_lat_hist_percentile(&hist, 99.);
+    assert(p99 <= 991 && p99 >= 991 - 991 / 8);
+    assert(1000 == lsquic_lat_hist_percentile(&hist, 100.));
+}
+
+
+int
+main (void)
+{
+    test_buckets();
+    test_percentiles();
+    return 0;
+}
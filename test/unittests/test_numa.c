@@ -0,0 +1,42 @@
+/* Copyright (c) 2017 - 2020 LiteSpeed Technologies Inc.  See LICENSE. */
+/*
+ * test_numa.c -- Test CPU and NUMA placement helpers
+ *
+ * Placement only takes effect on multi-node Linux hosts; elsewhere, the
+ * helpers must fail gracefully.
+ */
+
+#include <assert.h>
+#include <stdlib.h>
+
+#include "lsquic_numa.h"
+
+
+int
+main (void)
+{
+    struct numa_policy saved;
+    int n_nodes, node;
+
+    assert(-1 == lsquic_numa_cpu_node(-1));
+    assert(-1 == lsquic_numa_prefer(-1, NULL));
+    assert(-1 == lsquic_numa_prefer(NUMA_MAX_NODES, NULL));
+    assert(-1 == lsquic_numa_bind_cpu(-1));
+
+    n_nodes = lsquic_numa_n_nodes();
+    assert(n_nodes == -1 || n_nodes >= 1);
+    node = lsquic_numa_cpu_node(0);
+    if (n_nodes > 1)
+    {
+        assert(node >= 0);
+        assert(0 == lsquic_numa_prefer(node, &saved));
+        lsquic_numa_restore(&saved);
+    }
+    else
+    {
+        assert(-1 == node);
+        assert(-1 == lsquic_numa_prefer(0, &saved));
+    }
+
+    return 0;
+}
@@ -0,0 +1,439 @@
+/* Copyright (c) 2017 - 2020 LiteSpeed Technologies Inc.  See LICENSE. */
+/*
+ * test_qdh.c -- test QPACK decoder handler
+ *
+ * Header blocks use the static table only, so they can be written out
+ * by hand.
+ */
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/queue.h>
+#ifndef WIN32
+#include <unistd.h>
+#else
+#include <getopt.h>
+#endif
+
+#include "lsquic.h"
+
+#include "lsquic_packet_common.h"
+#include "lsquic_packet_ietf.h"
+#include "lsquic_alarmset.h"
+#include "lsquic_packet_in.h"
+#include "lsquic_conn_flow.h"
+#include "lsquic_rtt.h"
+#include "lsquic_sfcw.h"
+#include "lsquic_varint.h"
+#include "lsquic_hq.h"
+#include "lsquic_hash.h"
+#include "lsquic_stream.h"
+#include "lsquic_types.h"
+#include "lsquic_malo.h"
+#include "lsquic_mm.h"
+#include "lsquic_conn_public.h"
+#include "lsquic_logger.h"
+#include "lsquic_parse.h"
+#include "lsquic_conn.h"
+#include "lsquic_engine_public.h"
+#include "lsquic_cubic.h"
+#include "lsquic_pacer.h"
+#include "lsquic_senhist.h"
+#include "lsquic_bw_sampler.h"
+#include "lsquic_minmax.h"
+#include "lsquic_bbr.h"
+#include "lsquic_send_ctl.h"
+#include "lsquic_ver_neg.h"
+#include "lsquic_packet_out.h"
+#include "lsquic_enc_sess.h"
+#include "lsqpack.h"
+#include "lsxpack_header.h"
+#include "lsquic_frab_list.h"
+#include "lsquic_http1x_if.h"
+#include "lsquic_qdec_hdl.h"
+
+
+/* :method: GET, :scheme: https, :path: /, :authority: example.com,
+ * content-length: 42
+ */
+static const unsigned char request_block[] = {
+    0x00, 0x00,                 /* Required Insert Count and Base */
+    0xD1,                       /* Static 17 */
+    0xD7,                       /* Static 23 */
+    0xC1,                       /* Static 1 */
+    0x50, 0x0B, 'e', 'x', 'a', 'm', 'p', 'l', 'e', '.', 'c', 'o', 'm',
+    0x54, 0x02, '4', '2',
+};
+
+/* etag: abc */
+static const unsigned char trailer_block[] = {
+    0x00, 0x00,
+    0x57, 0x03, 'a', 'b', 'c',
+};
+
+
+#define MAX_TEST_HEADERS 8
+
+struct test_hset
+{
+    unsigned                n_headers;
+    int                     done;
+    struct {
+        struct lsxpack_header   xhdr;
+        char                    buf[0x100];
+    }                       headers[MAX_TEST_HEADERS];
+};
+
+static unsigned n_created, n_discarded, n_aborted;
+static const char *reject_name;     /* hsi_process_header() fails on it */
+
+
+static void *
+hset_create (void *hsi_ctx, int is_push_promise)
+{
+    ++n_created;
+    return calloc(1, sizeof(struct test_hset));
+}
+
+
+static struct lsxpack_header *
+hset_prepare_decode (void *hset_p, struct lsxpack_header *xhdr, size_t space)
+{
+    struct test_hset *const hset = hset_p;
+    unsigned idx;
+
+    if (space > sizeof(hset->headers[0].buf))
+        return NULL;
+    if (xhdr)
+        /* Buffer is always large enough, so there is nothing to grow */
+        return NULL;
+    if (hset->n_headers >= MAX_TEST_HEADERS)
+        return NULL;
+    idx = hset->n_headers;
+    lsxpack_header_prepare_decode(&hset->headers[idx].xhdr,
+                hset->headers[idx].buf, 0, sizeof(hset->headers[idx].buf));
+    return &hset->headers[idx].xhdr;
+}
+
+
+static int
+hset_process_header (void *hset_p, struct lsxpack_header *xhdr)
+{
+    struct test_hset *const hset = hset_p;
+
+    if (!xhdr)
+    {
+        hset->done = 1;
+        return 0;
+    }
+    assert(xhdr == &hset->headers[hset->n_headers].xhdr);
+    if (reject_name && strlen(reject_name) == xhdr->name_len
+            && 0 == memcmp(reject_name, lsxpack_header_get_name(xhdr),
+                                                            xhdr->name_len))
+        return 1;
+    ++hset->n_headers;
+    return 0;
+}
+
+
+static void
+hset_discard (void *hset_p)
+{
+    ++n_discarded;
+    free(hset_p);
+}
+
+
+static const struct lsquic_hset_if test_hsi_if =
+{
+    .hsi_create_header_set  = hset_create,
+    .hsi_prepare_decode     = hset_prepare_decode,
+    .hsi_process_header     = hset_process_header,
+    .hsi_discard_header_set = hset_discard,
+};
+
+
+static int
+header_is (const struct test_hset *hset, unsigned idx, const char *name,
+                                                            const char *value)
+{
+    const struct lsxpack_header *const xhdr = &hset->headers[idx].xhdr;
+
+    return xhdr->name_len == strlen(name)
+        && 0 == memcmp(lsxpack_header_get_name(xhdr), name, xhdr->name_len)
+        && xhdr->val_len == strlen(value)
+        && 0 == memcmp(lsxpack_header_get_value(xhdr), value, xhdr->val_len);
+}
+
+
+/* This function is only here to avoid crash in the test: */
+void
+lsquic_engine_add_conn_to_tickable (struct lsquic_engine_public *enpub,
+                                    lsquic_conn_t *conn)
+{
+}
+
+
+static lsquic_stream_ctx_t *
+on_new_stream (void *stream_if_ctx, lsquic_stream_t *stream)
+{
+    return NULL;
+}
+
+
+static void
+on_close (lsquic_stream_t *stream, lsquic_stream_ctx_t *st_h)
+{
+}
+
+
+static const struct lsquic_stream_if stream_if = {
+    .on_new_stream          = on_new_stream,
+    .on_close               = on_close,
+};
+
+
+static void
+abort_error (struct lsquic_conn *lconn, int is_app, unsigned error_code,
+                                                        const char *fmt, ...)
+{
+    ++n_aborted;
+}
+
+
+static struct network_path network_path;
+
+static struct network_path *
+get_network_path (struct lsquic_conn *lconn, const struct sockaddr *sa)
+{
+    return &network_path;
+}
+
+
+static const struct conn_iface our_conn_if =
+{
+    .ci_abort_error   = abort_error,
+    .ci_get_path      = get_network_path,
+};
+
+
+struct test_objs {
+    struct lsquic_engine_public eng_pub;
+    struct lsquic_conn        lconn;
+    struct lsquic_conn_public conn_pub;
+    struct lsquic_send_ctl    send_ctl;
+    struct lsquic_alarmset    alset;
+    struct ver_neg            ver_neg;
+    struct qpack_dec_hdl      qdh;
+};
+
+
+static void
+init_test_objs (struct test_objs *tobjs)
+{
+    int s;
+
+    memset(tobjs, 0, sizeof(*tobjs));
+    LSCONN_INITIALIZE(&tobjs->lconn);
+    tobjs->lconn.cn_pf = select_pf_by_ver(LSQVER_ID27);
+    tobjs->lconn.cn_version = LSQVER_ID27;
+    tobjs->lconn.cn_esf_c = &lsquic_enc_session_common_ietf_v1;
+    tobjs->lconn.cn_if = &our_conn_if;
+    network_path.np_pack_size = 1370;
+    lsquic_mm_init(&tobjs->eng_pub.enp_mm);
+    tobjs->eng_pub.enp_hsi_if = &test_hsi_if;
+    TAILQ_INIT(&tobjs->conn_pub.sending_streams);
+    TAILQ_INIT(&tobjs->conn_pub.read_streams);
+    TAILQ_INIT(&tobjs->conn_pub.write_streams);
+    TAILQ_INIT(&tobjs->conn_pub.service_streams);
+    lsquic_cfcw_init(&tobjs->conn_pub.cfcw, &tobjs->conn_pub, 0x4000);
+    lsquic_conn_cap_init(&tobjs->conn_pub.conn_cap, 0x4000);
+    lsquic_alarmset_init(&tobjs->alset, 0);
+    tobjs->conn_pub.mm = &tobjs->eng_pub.enp_mm;
+    tobjs->conn_pub.lconn = &tobjs->lconn;
+    tobjs->conn_pub.enpub = &tobjs->eng_pub;
+    tobjs->conn_pub.send_ctl = &tobjs->send_ctl;
+    tobjs->conn_pub.packet_out_malo =
+                        lsquic_malo_create(sizeof(struct lsquic_packet_out));
+    tobjs->conn_pub.path = &network_path;
+    tobjs->conn_pub.u.ietf.qdh = &tobjs->qdh;
+    tobjs->eng_pub.enp_settings.es_cc_algo = 1;  /* Cubic */
+    lsquic_send_ctl_init(&tobjs->send_ctl, &tobjs->alset, &tobjs->eng_pub,
+        &tobjs->ver_neg, &tobjs->conn_pub, 0);
+    /* Zero-sized dynamic table: the decoder never blocks */
+    s = lsquic_qdh_init(&tobjs->qdh, &tobjs->lconn, 1, &tobjs->eng_pub, 0, 0);
+    assert(0 == s);
+    n_created = 0;
+    n_discarded = 0;
+    n_aborted = 0;
+    reject_name = NULL;
+}
+
+
+static void
+deinit_test_objs (struct test_objs *tobjs)
+{
+    lsquic_qdh_cleanup(&tobjs->qdh);
+    lsquic_send_ctl_cleanup(&tobjs->send_ctl);
+    lsquic_malo_destroy(tobjs->conn_pub.packet_out_malo);
+    lsquic_mm_cleanup(&tobjs->eng_pub.enp_mm);
+}
+
+
+static struct lsquic_stream *
+new_stream (struct test_objs *tobjs, lsquic_stream_id_t stream_id)
+{
+    struct lsquic_stream *stream;
+
+    stream = lsquic_stream_new(stream_id, &tobjs->conn_pub, &stream_if,
+            NULL, 0x4000, 0x4000,
+            SCF_IETF|SCF_HTTP|SCF_CALL_ON_NEW|SCF_DI_AUTOSWITCH);
+    assert(stream);
+    stream->sm_hq_filter.hqfi_type = HQFT_HEADERS;
+    return stream;
+}
+
+
+static void
+test_headers_and_trailers (void)
+{
+    struct test_objs tobjs;
+    struct lsquic_stream *stream;
+    struct test_hset *hset;
+    const unsigned char *p;
+    enum lsqpack_read_header_status rhs;
+
+    init_test_objs(&tobjs);
+    stream = new_stream(&tobjs, 0);
+
+    p = request_block;
+    rhs = lsquic_qdh_header_in_begin(&tobjs.qdh, stream,
+                    sizeof(request_block), &p, sizeof(request_block));
+    assert(LQRHS_DONE == rhs);
+    assert(p == request_block + sizeof(request_block));
+    assert(!stream->sm_hblock_ctx);
+    assert(1 == n_created);
+    assert(stream->stream_flags & STREAM_HAVE_UH);
+    /* content-length is passed on to the stream */
+    assert(stream->sm_bflags & SMBF_VERIFY_CL);
+    assert(42 == stream->sm_cont_len);
+
+    /* Trailers are decoded, but no header set is created for them */
+    p = trailer_block;
+    rhs = lsquic_qdh_header_in_begin(&tobjs.qdh, stream,
+                    sizeof(trailer_block), &p, sizeof(trailer_block));
+    assert(LQRHS_DONE == rhs);
+    assert(p == trailer_block + sizeof(trailer_block));
+    assert(!stream->sm_hblock_ctx);
+    assert(1 == n_created);
+    assert(0 == n_discarded);
+
+    hset = lsquic_stream_get_hset(stream);
+    assert(hset);
+    assert(hset->done);
+    assert(5 == hset->n_headers);
+    assert(header_is(hset, 0, ":method", "GET"));
+    assert(header_is(hset, 1, ":scheme", "https"));
+    assert(header_is(hset, 2, ":path", "/"));
+    assert(header_is(hset, 3, ":authority", "example.com"));
+    assert(header_is(hset, 4, "content-length", "42"));
+    hset_discard(hset);
+
+    assert(0 == n_aborted);
+    lsquic_stream_destroy(stream);
+    deinit_test_objs(&tobjs);
+}
+
+
+/* A header rejected by the header set interface is not a decompression
+ * error: the handler does not abort the connection, and the header set
+ * is discarded.
+ */
+static void
+test_hset_reject (void)
+{
+    struct test_objs tobjs;
+    struct lsquic_stream *stream;
+    const unsigned char *p;
+    enum lsqpack_read_header_status rhs;
+
+    init_test_objs(&tobjs);
+    stream = new_stream(&tobjs, 0);
+    reject_name = ":path";
+
+    p = request_block;
+    rhs = lsquic_qdh_header_in_begin(&tobjs.qdh, stream,
+                    sizeof(request_block), &p, sizeof(request_block));
+    assert(LQRHS_ERROR == rhs);
+    assert(!stream->sm_hblock_ctx);
+    assert(1 == n_created);
+    assert(1 == n_discarded);
+    assert(0 == n_aborted);
+    assert(!(stream->stream_flags & STREAM_HAVE_UH));
+
+    lsquic_stream_destroy(stream);
+    deinit_test_objs(&tobjs);
+}
+
+
+/* Stream is cancelled while its header block is only partially read:
+ * the header set in progress is discarded.
+ */
+static void
+test_cancel_stream (void)
+{
+    struct test_objs tobjs;
+    struct lsquic_stream *stream;
+    const unsigned char *p;
+    enum lsqpack_read_header_status rhs;
+
+    init_test_objs(&tobjs);
+    stream = new_stream(&tobjs, 0);
+
+    p = request_block;
+    rhs = lsquic_qdh_header_in_begin(&tobjs.qdh, stream,
+                    sizeof(request_block), &p, 8);
+    assert(LQRHS_NEED == rhs);
+    assert(stream->sm_hblock_ctx);
+    assert(1 == n_created);
+    assert(0 == n_discarded);
+
+    lsquic_qdh_cancel_stream(&tobjs.qdh, stream);
+    assert(!stream->sm_hblock_ctx);
+    assert(1 == n_discarded);
+    assert(!(stream->stream_flags & STREAM_HAVE_UH));
+    assert(0 == n_aborted);
+
+    lsquic_stream_destroy(stream);
+    deinit_test_objs(&tobjs);
+}
+
+
+int
+main (int argc, char **argv)
+{
+    int opt;
+
+    lsquic_global_init(LSQUIC_GLOBAL_SERVER);
+
+    while (-1 != (opt = getopt(argc, argv, "l:")))
+    {
+        switch (opt)
+        {
+        case 'l':
+            lsquic_log_to_fstream(stderr, 0);
+            lsquic_logger_lopt(optarg);
+            break;
+        default:
+            exit(1);
+        }
+    }
+
+    test_headers_and_trailers();
+    test_hset_reject();
+    test_cancel_stream();
+
+    return 0;
+}
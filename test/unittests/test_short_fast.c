@@ -0,0 +1,527 @@
+/* Copyright (c) 2017 - 2020 LiteSpeed Technologies Inc.  See LICENSE. */
+/*
+ * test_short_fast.c -- Test fast path for IETF short header packets or
+ * benchmark the receive path.
+ *
+ * Datagrams are fed to a server engine using lsquic_engine_packet_in().
+ * The connections are stubs whose CIDs are added to the engine's hash.
+ * The general path calls pf_parse_packet_in_finish() of the connection
+ * it finds, while the fast path does not: the stubs count these calls
+ * to tell which path a packet took.
+ *
+ * The engine remembers the last connection found by CID; the test also
+ * checks that it forgets it when the CID goes away.
+ */
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/queue.h>
+#include <time.h>
+#ifndef WIN32
+#include <netinet/in.h>
+#include <sys/socket.h>
+#else
+#include "vc_compat.h"
+#endif
+
+#include "lsquic.h"
+#include "lsquic_types.h"
+#include "lsquic_int_types.h"
+#include "lsquic_hash.h"
+#include "lsquic_packet_common.h"
+#include "lsquic_packet_in.h"
+#include "lsquic_parse.h"
+#include "lsquic_conn.h"
+#include "lsquic_mm.h"
+#include "lsquic_engine_public.h"
+#include "lsquic_sizes.h"
+
+
+#define CID_LEN 8
+
+#define CONN_CID(tc_) (&(tc_)->lconn.cn_cces[0].cce_cid)
+
+
+struct test_conn
+{
+    struct lsquic_conn          lconn;
+    struct network_path         path;
+    unsigned                    n_packets,      /* Delivered */
+                                n_srst;         /* Stateless resets */
+    struct lsquic_hash_elem     srst_el;
+    unsigned char               srst[IQUIC_SRESET_TOKEN_SZ];
+};
+
+
+static struct sockaddr_in s_local, s_peer;
+
+/* Number of times the general path finished parsing a packet header */
+static unsigned s_n_finish;
+
+
+static void
+count_finish (struct lsquic_packet_in *packet_in,
+                                            struct packin_parse_state *state)
+{
+    ++s_n_finish;
+}
+
+
+/* The engine only uses pf_parse_packet_in_finish on the receive path */
+static const struct parse_funcs s_counting_pf =
+{
+    .pf_parse_packet_in_finish  = count_finish,
+};
+
+
+static void
+test_conn_packet_in (struct lsquic_conn *lconn,
+                                        struct lsquic_packet_in *packet_in)
+{
+    struct test_conn *const tc = (struct test_conn *) lconn;
+    unsigned n;
+
+    for (n = 0; n < lconn->cn_n_cces; ++n)
+        if ((lconn->cn_cces_mask & (1 << n))
+                && LSQUIC_CIDS_EQ(&packet_in->pi_conn_id,
+                                                &lconn->cn_cces[n].cce_cid))
+            break;
+    assert(n < lconn->cn_n_cces);   /* Not retired */
+    ++tc->n_packets;
+}
+
+
+static void
+test_conn_stateless_reset (struct lsquic_conn *lconn)
+{
+    struct test_conn *const tc = (struct test_conn *) lconn;
+    ++tc->n_srst;
+}
+
+
+static struct network_path *
+test_conn_get_path (struct lsquic_conn *lconn, const struct sockaddr *sa)
+{
+    struct test_conn *const tc = (struct test_conn *) lconn;
+    return &tc->path;
+}
+
+
+static unsigned char
+test_conn_record_addrs (struct lsquic_conn *lconn, void *peer_ctx,
+            const struct sockaddr *local_sa, const struct sockaddr *peer_sa)
+{
+    return 0;
+}
+
+
+static const lsquic_cid_t *
+test_conn_get_log_cid (const struct lsquic_conn *lconn)
+{
+    return &lconn->cn_cces[0].cce_cid;
+}
+
+
+static int
+test_conn_is_tickable (struct lsquic_conn *lconn)
+{
+    return 0;
+}
+
+
+static const struct conn_iface s_conn_iface =
+{
+    .ci_packet_in       = test_conn_packet_in,
+    .ci_stateless_reset = test_conn_stateless_reset,
+    .ci_get_path        = test_conn_get_path,
+    .ci_record_addrs    = test_conn_record_addrs,
+    .ci_get_log_cid     = test_conn_get_log_cid,
+    .ci_is_tickable     = test_conn_is_tickable,
+};
+
+
+static void
+make_cid (lsquic_cid_t *cid, unsigned len, unsigned n)
+{
+    unsigned i;
+
+    memset(cid, 0, sizeof(*cid));
+    cid->len = len;
+    for (i = 0; i < len; ++i)
+        cid->idbuf[i] = (unsigned char) ((n + i) * 0x9E3779B1u >> 24);
+    cid->idbuf[0] = n >> 8;
+    cid->idbuf[len - 1] = n;
+}
+
+
+/* Add stub connection's CID to the engine's hash.  The connection is
+ * marked hashed and tickable, so that the engine neither queues it nor
+ * destroys it: remove_conn() must be called before the engine is
+ * destroyed.
+ */
+static void
+add_conn (struct lsquic_engine *engine, struct test_conn *tc,
+                                    enum lsquic_version version, unsigned n)
+{
+    int s;
+
+    memset(tc, 0, sizeof(*tc));
+    LSCONN_INITIALIZE(&tc->lconn);
+    tc->lconn.cn_if = &s_conn_iface;
+    tc->lconn.cn_pf = &s_counting_pf;
+    tc->lconn.cn_version = version;
+    tc->lconn.cn_flags = LSCONN_HASHED|LSCONN_TICKABLE;
+    make_cid(CONN_CID(tc), CID_LEN, n);
+    s = lsquic_engine_add_cid((struct lsquic_engine_public *) engine,
+                                                            &tc->lconn, 0);
+    assert(0 == s);
+}
+
+
+static void
+add_cid (struct lsquic_engine *engine, struct test_conn *tc, unsigned idx,
+                                                                    unsigned n)
+{
+    int s;
+
+    make_cid(&tc->lconn.cn_cces[idx].cce_cid, CID_LEN, n);
+    tc->lconn.cn_cces_mask |= 1 << idx;
+    s = lsquic_engine_add_cid((struct lsquic_engine_public *) engine,
+                                                            &tc->lconn, idx);
+    assert(0 == s);
+}
+
+
+static void
+remove_conn (struct lsquic_engine *engine, struct test_conn *tc)
+{
+    unsigned n;
+
+    for (n = 0; n < tc->lconn.cn_n_cces; ++n)
+        if (tc->lconn.cn_cces_mask & (1 << n))
+            lsquic_engine_retire_cid((struct lsquic_engine_public *) engine,
+                                                            &tc->lconn, n, 0);
+}
+
+
+static struct lsquic_engine *
+new_engine (unsigned versions)
+{
+    struct lsquic_engine_settings settings;
+    struct lsquic_engine_api api;
+    struct lsquic_engine *engine;
+
+    lsquic_engine_init_settings(&settings, LSENG_SERVER);
+    settings.es_versions = versions;
+    settings.es_scid_len = CID_LEN;
+    settings.es_honor_prst = 1;
+    memset(&api, 0, sizeof(api));
+    api.ea_settings = &settings;
+    api.ea_packets_out = (void *) (uintptr_t) 1;
+    api.ea_stream_if = (void *) (uintptr_t) 2;
+
+    engine = lsquic_engine_new(LSENG_SERVER, &api);
+    assert(engine);
+    return engine;
+}
+
+
+static void
+make_packet (unsigned char *buf, size_t bufsz, unsigned char first_byte,
+                                                    const lsquic_cid_t *cid)
+{
+    memset(buf, 0xAA, bufsz);
+    buf[0] = first_byte;
+    memcpy(buf + 1, cid->idbuf, cid->len);
+}
+
+
+static int
+packet_in (struct lsquic_engine *engine, const unsigned char *buf, size_t sz)
+{
+    return lsquic_engine_packet_in(engine, buf, sz,
+                (struct sockaddr *) &s_local, (struct sockaddr *) &s_peer,
+                NULL, 0);
+}
+
+
+/* Packets to IETF connections take the fast path */
+static void
+test_fast (void)
+{
+    struct lsquic_engine *engine;
+    struct test_conn conns[20];
+    unsigned char buf[100];
+    unsigned n, byte, n_packets;
+    int s;
+
+    engine = new_engine(1 << LSQVER_ID27);
+    for (n = 0; n < 20; ++n)
+        add_conn(engine, &conns[n], LSQVER_ID27, n);
+
+    s_n_finish = 0;
+    /* 01SRRKPP: all combinations of spin, key phase, and packet number
+     * length bits.
+     */
+    for (byte = 0x40; byte < 0x80; ++byte)
+        for (n = 0; n < 20; n += 7)
+        {
+            n_packets = conns[n].n_packets;
+            make_packet(buf, sizeof(buf), byte, CONN_CID(&conns[n]));
+            s = packet_in(engine, buf, sizeof(buf));
+            assert(0 == s);
+            assert(conns[n].n_packets == n_packets + 1);
+        }
+    assert(0 == s_n_finish);
+
+    for (n = 0; n < 20; ++n)
+        remove_conn(engine, &conns[n]);
+    lsquic_engine_destroy(engine);
+}
+
+
+/* Fast path is not used without IETF versions and not for connections
+ * that are not IETF.
+ */
+static void
+test_not_fast (void)
+{
+    struct lsquic_engine *engine;
+    struct test_conn conns[2];
+    unsigned char buf[100];
+    int s;
+
+    /* No IETF versions: no fast path */
+    engine = new_engine(1 << LSQVER_050);
+    add_conn(engine, &conns[0], LSQVER_050, 0);
+    s_n_finish = 0;
+    make_packet(buf, sizeof(buf), 0x41, CONN_CID(&conns[0]));
+    s = packet_in(engine, buf, sizeof(buf));
+    assert(0 == s);
+    assert(1 == conns[0].n_packets);
+    assert(1 == s_n_finish);
+    remove_conn(engine, &conns[0]);
+    lsquic_engine_destroy(engine);
+
+    /* Fast path finds a gQUIC connection and hands the packet off to the
+     * general path.  An IETF connection in the same engine takes the fast
+     * path.
+     */
+    engine = new_engine((1 << LSQVER_050) | (1 << LSQVER_ID27));
+    add_conn(engine, &conns[0], LSQVER_050, 0);
+    add_conn(engine, &conns[1], LSQVER_ID27, 1);
+    s_n_finish = 0;
+    make_packet(buf, sizeof(buf), 0x41, CONN_CID(&conns[0]));
+    s = packet_in(engine, buf, sizeof(buf));
+    assert(0 == s);
+    assert(1 == conns[0].n_packets);
+    assert(1 == s_n_finish);
+    make_packet(buf, sizeof(buf), 0x41, CONN_CID(&conns[1]));
+    s = packet_in(engine, buf, sizeof(buf));
+    assert(0 == s);
+    assert(1 == conns[1].n_packets);
+    assert(1 == s_n_finish);
+    remove_conn(engine, &conns[0]);
+    remove_conn(engine, &conns[1]);
+    lsquic_engine_destroy(engine);
+}
+
+
+/* Packet with unknown DCID goes to the general path, which checks it for
+ * stateless reset.
+ */
+static void
+test_unknown_cid (void)
+{
+    struct lsquic_engine_public *enpub;
+    struct lsquic_engine *engine;
+    struct lsquic_hash_elem *el;
+    struct test_conn conn;
+    lsquic_cid_t cid;
+    unsigned char buf[100];
+    int s;
+
+    engine = new_engine(1 << LSQVER_ID27);
+    enpub = (struct lsquic_engine_public *) engine;
+    add_conn(engine, &conn, LSQVER_ID27, 0);
+    memset(conn.srst, 0x5E, sizeof(conn.srst));
+    el = lsquic_hash_insert(enpub->enp_srst_hash, conn.srst,
+                                sizeof(conn.srst), &conn.lconn, &conn.srst_el);
+    assert(el);
+
+    s_n_finish = 0;
+    make_cid(&cid, CID_LEN, 1);
+    make_packet(buf, sizeof(buf), 0x41, &cid);
+    s = packet_in(engine, buf, sizeof(buf));
+    assert(1 == s);
+    assert(0 == conn.n_packets);
+    assert(0 == conn.n_srst);
+
+    memcpy(buf + sizeof(buf) - sizeof(conn.srst), conn.srst,
+                                                        sizeof(conn.srst));
+    s = packet_in(engine, buf, sizeof(buf));
+    assert(1 == s);
+    assert(0 == conn.n_packets);
+    assert(1 == conn.n_srst);
+    assert(0 == s_n_finish);
+
+    lsquic_hash_erase(enpub->enp_srst_hash, &conn.srst_el);
+    remove_conn(engine, &conn);
+    lsquic_engine_destroy(engine);
+}
+
+
+/* Packets to a retired CID or to a connection that is gone are not
+ * delivered, even if that CID was looked up last.
+ */
+static void
+test_retired_cid (void)
+{
+    struct lsquic_engine *engine;
+    struct test_conn conn, *gone;
+    lsquic_cid_t cid;
+    unsigned char buf[100];
+    int s;
+
+    engine = new_engine(1 << LSQVER_ID27);
+    add_conn(engine, &conn, LSQVER_ID27, 0);
+    add_cid(engine, &conn, 1, 1);
+
+    /* Retire the CID that was just used */
+    make_packet(buf, sizeof(buf), 0x41, &conn.lconn.cn_cces[1].cce_cid);
+    s = packet_in(engine, buf, sizeof(buf));
+    assert(0 == s);
+    assert(1 == conn.n_packets);
+    lsquic_engine_retire_cid((struct lsquic_engine_public *) engine,
+                                                            &conn.lconn, 1, 0);
+    s = packet_in(engine, buf, sizeof(buf));
+    assert(1 == s);
+    assert(1 == conn.n_packets);
+
+    /* The connection's other CID still works */
+    make_packet(buf, sizeof(buf), 0x41, CONN_CID(&conn));
+    s = packet_in(engine, buf, sizeof(buf));
+    assert(0 == s);
+    assert(2 == conn.n_packets);
+
+    /* Connection is removed from the hash and freed right after a packet
+     * was delivered to it.
+     */
+    gone = malloc(sizeof(*gone));
+    assert(gone);
+    add_conn(engine, gone, LSQVER_ID27, 2);
+    cid = *CONN_CID(gone);
+    make_packet(buf, sizeof(buf), 0x41, &cid);
+    s = packet_in(engine, buf, sizeof(buf));
+    assert(0 == s);
+    assert(1 == gone->n_packets);
+    remove_conn(engine, gone);
+    free(gone);
+    s = packet_in(engine, buf, sizeof(buf));
+    assert(1 == s);
+
+    make_packet(buf, sizeof(buf), 0x41, CONN_CID(&conn));
+    s = packet_in(engine, buf, sizeof(buf));
+    assert(0 == s);
+    assert(3 == conn.n_packets);
+
+    remove_conn(engine, &conn);
+    lsquic_engine_destroy(engine);
+}
+
+
+static double
+elapsed (const struct timespec *start)
+{
+    struct timespec end;
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    return (double) (end.tv_sec - start->tv_sec)
+                        + (double) (end.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+
+/* Datagrams are spread over all connections, `burst' datagrams at a time */
+static void
+benchmark (unsigned n_conns, unsigned n_iters, unsigned burst)
+{
+    struct lsquic_engine *engine;
+    struct test_conn *conns;
+    struct timespec start;
+    unsigned char (*bufs)[100];
+    double count;
+    unsigned i, j, k, n_found;
+
+    engine = new_engine(1 << LSQVER_ID27);
+    conns = malloc(sizeof(conns[0]) * n_conns);
+    bufs = malloc(sizeof(bufs[0]) * n_conns);
+    assert(conns && bufs);
+    for (i = 0; i < n_conns; ++i)
+    {
+        add_conn(engine, &conns[i], LSQVER_ID27, i);
+        make_packet(bufs[i], sizeof(bufs[i]), 0x41 | (i & 4),
+                                                        CONN_CID(&conns[i]));
+    }
+
+    n_found = 0;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (j = 0; j < n_iters; ++j)
+        for (i = 0; i < n_conns; ++i)
+            for (k = 0; k < burst; ++k)
+                n_found += 0 == packet_in(engine, bufs[i], sizeof(bufs[i]));
+    assert(n_found == n_conns * n_iters * burst);
+
+    count = (double) n_conns * n_iters * burst / 1e6;
+    printf("%u conns, %u iters, burst %u: %.2f M datagrams/sec\n",
+                        n_conns, n_iters, burst, count / elapsed(&start));
+
+    for (i = 0; i < n_conns; ++i)
+        remove_conn(engine, &conns[i]);
+    lsquic_engine_destroy(engine);
+    free(bufs);
+    free(conns);
+}
+
+
+int
+main (int argc, char **argv)
+{
+    unsigned n_iters;
+
+    if (0 != lsquic_global_init(LSQUIC_GLOBAL_SERVER))
+        return 1;
+
+    s_local.sin_family = AF_INET;
+    s_local.sin_port = htons(443);
+    s_local.sin_addr.s_addr = htonl(0x7F000001);
+    s_peer = s_local;
+    s_peer.sin_port = htons(12345);
+
+    if (argc == 1)
+    {
+        test_fast();
+        test_not_fast();
+        test_unknown_cid();
+        test_retired_cid();
+        lsquic_global_cleanup();
+        return 0;
+    }
+
+    if (argc != 2)
+    {
+        fprintf(stderr, "usage: %s iters\n", argv[0]);
+        return 1;
+    }
+
+    n_iters = atoi(argv[1]);
+    benchmark(10, n_iters * 100, 1);
+    benchmark(1000, n_iters, 1);
+    benchmark(1000, n_iters / 16 ? n_iters / 16 : 1, 16);
+    benchmark(100000, n_iters / 100 ? n_iters / 100 : 1, 1);
+    benchmark(100000, n_iters / 1600 ? n_iters / 1600 : 1, 16);
+    lsquic_global_cleanup();
+    return 0;
+}
@@ -106,6 +106,100 @@ test_same_priority (unsigned priority)
 }
 
 
+/* Streams of the same priority are reordered by the scheduler; streams of
+ * different priorities are not.
+ */
+static void
+test_sched (void)
+{
+    lsquic_stream_t *stream_arr[6] = {
+        new_stream(10),     /* Bulk: wrote a lot */
+        new_stream(10),     /* Small response */
+        new_stream(10),     /* Size hint: little left */
+        new_stream(10),     /* Deadline */
+        new_stream(10),     /* Starving */
+        new_stream(20),     /* Lower priority, nothing written */
+    };
+    const lsquic_time_t now = 1000000, max_wait = 100000;
+    struct lsquic_streams_tailq streams;
+    unsigned flags = 0xF00;     /* Arbitrary value */
+    lsquic_stream_t *stream;
+    unsigned n;
+
+    stream_arr[0]->tosend_off = 1000000;
+    stream_arr[1]->tosend_off = 100;
+    stream_arr[2]->tosend_off = 900000;
+    stream_arr[2]->sm_size_hint = 900010;
+    stream_arr[3]->tosend_off = 500000;
+    stream_arr[3]->sm_deadline = now + 20000;
+    stream_arr[4]->tosend_off = 2000000;
+    stream_arr[4]->sm_last_write = now - max_wait - 1;
+
+    TAILQ_INIT(&streams);
+    for (n = 0; n < sizeof(stream_arr) / sizeof(stream_arr[0]); ++n)
+    {
+        TAILQ_INSERT_TAIL(&streams, stream_arr[n], next_write_stream);
+        stream_arr[n]->sm_qflags |= flags;
+    }
+
+    /* Shortest remaining first */
+    lsquic_spi_init(&spi, TAILQ_FIRST(&streams),
+        TAILQ_LAST(&streams, lsquic_streams_tailq),
+        (uintptr_t) &TAILQ_NEXT((lsquic_stream_t *) NULL, next_write_stream),
+        flags, &lconn, __func__, NULL, NULL);
+    lsquic_spi_sort(&spi, SPI_SCHED_SRF, now, max_wait);
+    stream = lsquic_spi_first(&spi);
+    assert(stream == stream_arr[4]);
+    stream = lsquic_spi_next(&spi);
+    assert(stream == stream_arr[2]);
+    stream = lsquic_spi_next(&spi);
+    assert(stream == stream_arr[1]);
+    stream = lsquic_spi_next(&spi);
+    assert(stream == stream_arr[3]);
+    stream = lsquic_spi_next(&spi);
+    assert(stream == stream_arr[0]);
+    stream = lsquic_spi_next(&spi);
+    assert(stream == stream_arr[5]);
+    stream = lsquic_spi_next(&spi);
+    assert(stream == NULL);
+
+    /* Streams seen for the first time are not considered starving */
+    assert(stream_arr[0]->sm_last_write == now);
+
+    /* Earliest deadline first */
+    lsquic_spi_init(&spi, TAILQ_FIRST(&streams),
+        TAILQ_LAST(&streams, lsquic_streams_tailq),
+        (uintptr_t) &TAILQ_NEXT((lsquic_stream_t *) NULL, next_write_stream),
+        flags, &lconn, __func__, NULL, NULL);
+    lsquic_spi_sort(&spi, SPI_SCHED_EDF, now, max_wait);
+    stream = lsquic_spi_first(&spi);
+    assert(stream == stream_arr[4]);
+    stream = lsquic_spi_next(&spi);
+    assert(stream == stream_arr[3]);
+    stream = lsquic_spi_next(&spi);
+    assert(stream == stream_arr[2]);
+    stream = lsquic_spi_next(&spi);
+    assert(stream == stream_arr[1]);
+    stream = lsquic_spi_next(&spi);
+    assert(stream == stream_arr[0]);
+    stream = lsquic_spi_next(&spi);
+    assert(stream == stream_arr[5]);
+
+    /* Round-robin: order is unchanged */
+    lsquic_spi_init(&spi, TAILQ_FIRST(&streams),
+        TAILQ_LAST(&streams, lsquic_streams_tailq),
+        (uintptr_t) &TAILQ_NEXT((lsquic_stream_t *) NULL, next_write_stream),
+        flags, &lconn, __func__, NULL, NULL);
+    lsquic_spi_sort(&spi, SPI_SCHED_RR, now, max_wait);
+    for (n = 0, stream = lsquic_spi_first(&spi); stream;
+                                        ++n, stream = lsquic_spi_next(&spi))
+        assert(stream == stream_arr[n]);
+    assert(n == sizeof(stream_arr) / sizeof(stream_arr[0]));
+
+    free_streams(stream_arr, sizeof(stream_arr) / sizeof(stream_arr[0]));
+}
+
+
 static void
 test_different_priorities (int *priority)
 {
@@ -346,5 +440,7 @@ main (int argc, char **argv)
     for (n = 0; n < sizeof(drop_tests) / sizeof(drop_tests[0]); ++n)
         test_drop(&drop_tests[n]);
 
+    test_sched();
+
     return 0;
 }
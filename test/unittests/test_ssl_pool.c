@@ -0,0 +1,93 @@
+/* Copyright (c) 2017 - 2020 LiteSpeed Technologies Inc.  See LICENSE. */
+/*
+ * test_ssl_pool.c -- Test pool of server SSL objects
+ */
+
+#include <assert.h>
+#include <stdlib.h>
+
+#include <openssl/ssl.h>
+
+#include "lsquic_ssl_pool.h"
+
+
+static void
+test_limit (void)
+{
+    struct ssl_pool *pool;
+    SSL_CTX *ctx;
+    SSL *ssl[3];
+    unsigned i;
+
+    ctx = SSL_CTX_new(TLS_method());
+    assert(ctx);
+    pool = lsquic_sslp_new(2);
+    assert(pool);
+
+    assert(NULL == lsquic_sslp_get(pool, ctx));
+    for (i = 0; i < 3; ++i)
+    {
+        ssl[i] = SSL_new(ctx);
+        assert(ssl[i]);
+    }
+    for (i = 0; i < 3; ++i)
+        lsquic_sslp_put(pool, ctx, ssl[i]);
+    assert(2 == lsquic_sslp_count(pool));   /* Third one was freed */
+
+    /* Last in, first out */
+    assert(ssl[1] == lsquic_sslp_get(pool, ctx));
+    assert(ssl[0] == lsquic_sslp_get(pool, ctx));
+    assert(NULL == lsquic_sslp_get(pool, ctx));
+    assert(0 == lsquic_sslp_count(pool));
+
+    /* Objects in the pool are freed when it is destroyed */
+    lsquic_sslp_put(pool, ctx, ssl[0]);
+    lsquic_sslp_destroy(pool);
+    SSL_free(ssl[1]);
+    SSL_CTX_free(ctx);
+}
+
+
+/* Objects are kept per original context, even if they were switched to
+ * another one, as certificate lookup does.
+ */
+static void
+test_switched_ctx (void)
+{
+    struct ssl_pool *pool;
+    SSL_CTX *ctx[2];
+    SSL *ssl;
+
+    ctx[0] = SSL_CTX_new(TLS_method());
+    ctx[1] = SSL_CTX_new(TLS_method());
+    assert(ctx[0] && ctx[1]);
+    pool = lsquic_sslp_new(10);
+    assert(pool);
+
+    ssl = SSL_new(ctx[0]);
+    assert(ssl);
+    assert(SSL_set_SSL_CTX(ssl, ctx[1]));
+    lsquic_sslp_put(pool, ctx[0], ssl);
+    assert(NULL == lsquic_sslp_get(pool, ctx[1]));
+    assert(ssl == lsquic_sslp_get(pool, ctx[0]));
+    assert(ctx[0] == SSL_get_SSL_CTX(ssl));
+
+    /* The pool keeps a reference to the context */
+    lsquic_sslp_put(pool, ctx[0], ssl);
+    SSL_CTX_free(ctx[0]);
+    ssl = lsquic_sslp_get(pool, ctx[0]);
+    assert(ssl);
+    SSL_free(ssl);
+
+    lsquic_sslp_destroy(pool);
+    SSL_CTX_free(ctx[1]);
+}
+
+
+int
+main (void)
+{
+    test_limit();
+    test_switched_ctx();
+    return 0;
+}
@@ -1534,6 +1534,71 @@ test_read_in_middle (void)
 }
 
 
+/* Test that incoming payload is placed into user-registered read buffer
+ * as soon as it arrives.
+ */
+static void
+test_read_buf (void)
+{
+    int s, fin;
+    size_t len;
+    unsigned char buf[5];
+    const char data[] = "AAABBBCCC";
+    struct test_objs tobjs;
+    stream_frame_t *frame;
+
+    init_test_objs(&tobjs, 0x4000, 0x4000, NULL);
+
+    lsquic_stream_t *stream = new_stream(&tobjs, 123);
+    s = lsquic_stream_set_read_buf(stream, buf, sizeof(buf));
+    assert(0 == s);
+
+    frame = new_frame_in_ext(&tobjs, 0, 3, 0, &data[0]);
+    s = lsquic_stream_frame_in(stream, frame);
+    assert(0 == s);
+    len = lsquic_stream_read_buf_len(stream, &fin);
+    assert(3 == len);
+    assert(!fin);
+    assert(!lsquic_stream_readable(stream));
+
+    /* Hole */
+    frame = new_frame_in_ext(&tobjs, 6, 3, 0, &data[6]);
+    s = lsquic_stream_frame_in(stream, frame);
+    assert(0 == s);
+    len = lsquic_stream_read_buf_len(stream, &fin);
+    assert(3 == len);
+
+    /* Fill the hole: buffer becomes full */
+    frame = new_frame_in_ext(&tobjs, 3, 3, 0, &data[3]);
+    s = lsquic_stream_frame_in(stream, frame);
+    assert(0 == s);
+    len = lsquic_stream_read_buf_len(stream, &fin);
+    assert(5 == len);
+    assert(!fin);
+    assert(0 == memcmp(buf, "AAABB", 5));
+    assert(lsquic_stream_readable(stream));
+
+    /* The rest is placed into buffer when it is registered again */
+    s = lsquic_stream_set_read_buf(stream, buf, sizeof(buf));
+    assert(0 == s);
+    len = lsquic_stream_read_buf_len(stream, &fin);
+    assert(4 == len);
+    assert(0 == memcmp(buf, "BCCC", 4));
+    assert(!lsquic_stream_readable(stream));
+
+    frame = new_frame_in(&tobjs, 9, 0, 1);
+    s = lsquic_stream_frame_in(stream, frame);
+    assert(0 == s);
+    len = lsquic_stream_read_buf_len(stream, &fin);
+    assert(4 == len);
+    assert(fin);
+    assert(lsquic_stream_readable(stream));
+
+    lsquic_stream_destroy(stream);
+    deinit_test_objs(&tobjs);
+}
+
+
 /* Test that connection flow control does not go past the max when both
  * connection limited and unlimited streams are used.
  */
@@ -2969,6 +3034,64 @@ test_conn_abort (void)
 }
 
 
+/* Data and FIN are written before the flush, so they go out in a single
+ * STREAM frame.  Check that sending this frame records both the first-sent
+ * and FIN-sent times and that acking it records the FIN-acked time.
+ */
+static void
+test_stream_times (void)
+{
+    struct test_objs tobjs;
+    struct lsquic_stream *stream;
+    struct lsquic_packet_out *packet_out;
+    struct lsquic_stream_times times;
+    unsigned char buf[0x100];
+    ssize_t nw;
+    size_t n;
+    int s, fin;
+
+    init_test_ctl_settings(&g_ctl_settings);
+    g_ctl_settings.tcs_schedule_stream_packets_immediately = 1;
+
+    init_test_objs(&tobjs, 0x4000, 0x4000, NULL);
+    stream = new_stream(&tobjs, 123);
+    nw = lsquic_stream_write(stream, "Dude, where is my car?!", 23);
+    assert(23 == nw);
+    assert(0 == lsquic_send_ctl_n_scheduled(&tobjs.send_ctl));
+    s = lsquic_stream_shutdown(stream, 1);      /* Shutdown performs a flush */
+    assert(0 == s);
+    assert(1 == lsquic_send_ctl_n_scheduled(&tobjs.send_ctl));
+
+    n = read_from_scheduled_packets(&tobjs.send_ctl, stream->id, buf,
+                                                    sizeof(buf), 0, &fin, 0);
+    assert(23 == n);
+    assert(fin);
+
+    lsquic_stream_get_times(stream, &times);
+    assert(0 == times.st_first_sent);
+    assert(0 == times.st_fin_sent);
+
+    packet_out = lsquic_send_ctl_next_packet_to_send(&tobjs.send_ctl, 0);
+    assert(packet_out);
+    assert(packet_out->po_lflags & POL_STREAM_FIN);
+    packet_out->po_sent = 12345;
+    lsquic_send_ctl_sent_packet(&tobjs.send_ctl, packet_out);
+
+    lsquic_stream_get_times(stream, &times);
+    assert(12345 == times.st_first_sent);
+    assert(12345 == times.st_fin_sent);
+    assert(0 == times.st_fin_acked);
+
+    ack_packet(&tobjs.send_ctl, packet_out->po_packno);
+    lsquic_stream_get_times(stream, &times);
+    assert(times.st_fin_acked >= times.st_fin_sent);
+    assert(times.st_fin_acked != 0);
+
+    lsquic_stream_destroy(stream);
+    deinit_test_objs(&tobjs);
+}
+
+
 /* Test one: large frame first, followed by small frames to finish off
  * the packet.
  */
@@ -3154,12 +3277,16 @@ main (int argc, char **argv)
 
     test_read_in_middle();
 
+    test_read_buf();
+
     test_conn_unlimited();
 
     test_flushing();
 
     test_conn_abort();
 
+    test_stream_times();
+
     test_bad_packbits_guess_1();
     test_bad_packbits_guess_2();
     test_bad_packbits_guess_3();
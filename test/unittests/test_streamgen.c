@@ -7,10 +7,12 @@
 #ifndef WIN32
 #include <sys/time.h>
 #endif
+#include <time.h>
 
 #include "lsquic.h"
 #include "lsquic_types.h"
 #include "lsquic_parse.h"
+#include "lsquic_parse_ietf.h"
 #include "lsquic_sfcw.h"
 #include "lsquic_varint.h"
 #include "lsquic_hq.h"
@@ -444,8 +446,8 @@ run_test (int i)
 {
     const struct test *const test = &tests[i];
 
-    unsigned char out[0x100];
-    int len;
+    unsigned char out[0x100], out2[0x100];
+    int len, len2;
     size_t min;
 
     if (test->len > 0)
@@ -482,14 +484,123 @@ run_test (int i)
     {
         assert(("This test should fail", len < 0));
     }
+
+    if (test->pf == select_pf_by_ver(LSQVER_ID25))
+    {
+        /* Stream code calls IETF generator directly: check that it matches */
+        reset_ctx(test);
+        len2 = lsquic_ietf_v1_gen_stream_frame(out2, test->avail,
+                    test->stream_id, test_ctx.test->offset,
+                    stream_tosend_fin(&test_ctx), stream_tosend_size(&test_ctx),
+                    stream_tosend_read, &test_ctx);
+        assert(len2 == len);
+        assert(len < 0 || 0 == memcmp(out, out2, len));
+        assert(IETF_V1_STREAM_FRAME_HEADER_SZ(test->stream_id, test->offset,
+                                                            test->data_sz)
+            == test->pf->pf_calc_stream_frame_header_sz(test->stream_id,
+                                            test->offset, test->data_sz));
+    }
+}
+
+
+#define BENCH_N_STREAMS 16
+#define BENCH_FRAME_SZ 100
+
+static size_t bench_nread;
+
+static size_t
+bench_read (void *stream, void *buf, size_t len, int *reached_fin)
+{
+    memset(buf, 'A', len);
+    bench_nread = len;
+    *reached_fin = 0;
+    return len;
+}
+
+
+/* Fill packets with small STREAM frames from several streams, as the stream
+ * code does when many streams have a little data each.  Returns number of
+ * seconds it took.
+ */
+static double
+bench_fill (int direct, unsigned n_packets)
+{
+    const struct parse_funcs *const pf = select_pf_by_ver(LSQVER_ID25);
+    unsigned char packet[1200], *p;
+    uint64_t offsets[BENCH_N_STREAMS];
+    struct timespec start, end;
+    unsigned n, idx;
+    size_t header_sz;
+    int len;
+
+    memset(offsets, 0, sizeof(offsets));
+    idx = 0;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (n = 0; n < n_packets; ++n)
+    {
+        p = packet;
+        while (1)
+        {
+            if (direct)
+                header_sz = IETF_V1_STREAM_FRAME_HEADER_SZ(idx * 4,
+                                            offsets[idx], BENCH_FRAME_SZ);
+            else
+                header_sz = pf->pf_calc_stream_frame_header_sz(idx * 4,
+                                            offsets[idx], BENCH_FRAME_SZ);
+            if (header_sz + 1 > (size_t) (packet + sizeof(packet) - p))
+                break;
+            if (direct)
+                len = lsquic_ietf_v1_gen_stream_frame(p,
+                        packet + sizeof(packet) - p, idx * 4, offsets[idx],
+                        0, BENCH_FRAME_SZ, bench_read, NULL);
+            else
+                len = pf->pf_gen_stream_frame(p,
+                        packet + sizeof(packet) - p, idx * 4, offsets[idx],
+                        0, BENCH_FRAME_SZ, bench_read, NULL);
+            assert(len > 0);
+            p += len;
+            offsets[idx] += bench_nread;
+            idx = (idx + 1) % BENCH_N_STREAMS;
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    return (double) (end.tv_sec - start.tv_sec)
+                        + (double) (end.tv_nsec - start.tv_nsec) / 1e9;
+}
+
+
+static void
+benchmark (unsigned n_packets)
+{
+    double pf_sec, direct_sec;
+
+    pf_sec = bench_fill(0, n_packets);
+    direct_sec = bench_fill(1, n_packets);
+    printf("%u packets: parse_funcs %.0f packets/sec; direct %.0f packets/sec\n",
+        n_packets, (double) n_packets / pf_sec,
+        (double) n_packets / direct_sec);
 }
 
 
 int
-main (void)
+main (int argc, char **argv)
 {
     unsigned i;
-    for (i = 0; i < sizeof(tests) / sizeof(tests[0]); ++i)
-        run_test(i);
+
+    if (argc == 1)
+    {
+        for (i = 0; i < sizeof(tests) / sizeof(tests[0]); ++i)
+            run_test(i);
+        return 0;
+    }
+
+    if (argc != 2)
+    {
+        fprintf(stderr, "usage: %s n_packets\n", argv[0]);
+        return 1;
+    }
+
+    benchmark(atoi(argv[1]));
     return 0;
 }
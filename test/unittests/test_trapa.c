@@ -223,6 +223,72 @@ run_test (const struct trapa_test *test)
 }
 
 
+/* The server encodes parameters that are the same for all connections once
+ * and appends per-connection parameters to them.  Check that the result is
+ * the same as encoding all parameters at once.
+ */
+static void
+test_split_encoding (int id25)
+{
+    int (*const encode)(const struct transport_params *, int,
+                                            unsigned char *, size_t)
+                        = id25 ? lsquic_tp_encode_id25 : lsquic_tp_encode;
+    const unsigned conn_set = (1 << TPI_ORIGINAL_CONNECTION_ID)
+                            | (1 << TPI_STATELESS_RESET_TOKEN);
+    struct transport_params params, common, conn;
+    unsigned char full[ENC_BUF_SZ], split[ENC_BUF_SZ];
+    unsigned total;
+    int full_len, common_len, conn_len;
+
+    memset(&params, 0, sizeof(params));
+    params.tp_init_max_data = 0x123456;
+    params.tp_init_max_stream_data_bidi_local = 0x10000;
+    params.tp_init_max_stream_data_bidi_remote = 0x10000;
+    params.tp_init_max_streams_bidi = 100;
+    params.tp_max_idle_timeout = 30000;
+    params.tp_active_connection_id_limit = 8;
+    params.tp_loss_bits = 1;
+    params.tp_set = (1 << TPI_INIT_MAX_DATA)
+                  | (1 << TPI_INIT_MAX_STREAM_DATA_BIDI_LOCAL)
+                  | (1 << TPI_INIT_MAX_STREAM_DATA_BIDI_REMOTE)
+                  | (1 << TPI_INIT_MAX_STREAMS_BIDI)
+                  | (1 << TPI_MAX_IDLE_TIMEOUT)
+                  | (1 << TPI_ACTIVE_CONNECTION_ID_LIMIT)
+                  | (1 << TPI_DISABLE_ACTIVE_MIGRATION)
+                  | (1 << TPI_LOSS_BITS)
+                  | (1 << TPI_TIMESTAMPS)
+                  | conn_set
+                  ;
+    params.tp_original_cid.len = 8;
+    memcpy(params.tp_original_cid.idbuf, "ORIGINAL", 8);
+    memcpy(params.tp_stateless_reset_token, "STATELESS-RESET!", 16);
+
+    full_len = encode(&params, 1, full, sizeof(full));
+    assert(full_len > 0);
+
+    common = params;
+    common.tp_set &= ~conn_set;
+    conn = params;
+    conn.tp_set &= conn_set;
+    common_len = encode(&common, 1, split, sizeof(split));
+    assert(common_len > 0);
+    conn_len = encode(&conn, 1, split + common_len,
+                                                sizeof(split) - common_len);
+    assert(conn_len > 0);
+    if (id25)
+    {
+        memmove(split + common_len, split + common_len + 2, conn_len - 2);
+        conn_len -= 2;
+        total = common_len + conn_len - 2;
+        split[0] = total >> 8;
+        split[1] = total;
+    }
+
+    assert(common_len + conn_len == full_len);
+    assert(0 == memcmp(full, split, full_len));
+}
+
+
 static void
 decode_file (const char *name)
 {
@@ -274,5 +340,8 @@ main (int argc, char **argv)
     for (i = 0; i < sizeof(tests) / sizeof(tests[0]); ++i)
         run_test(&tests[i]);
 
+    test_split_encoding(0);
+    test_split_encoding(1);
+
     return 0;
 }
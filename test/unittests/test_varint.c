@@ -2,6 +2,7 @@
 #include <assert.h>
 #include <stddef.h>
 #include <stdint.h>
+#include <string.h>
 
 #include "lsquic_varint.h"
 
@@ -66,6 +67,31 @@ static const struct test_read_varint read_tests[] =
 };
 
 
+/* Place a two-byte varint at each position in buffers longer and shorter
+ * than SIMD width.
+ */
+static void
+test_n_one_byte (void)
+{
+    unsigned char buf[40];
+    unsigned len, pos;
+
+    for (len = 0; len <= sizeof(buf); ++len)
+    {
+        memset(buf, VINT_MAX_ONE_BYTE, sizeof(buf));
+        assert(len == lsquic_varint_n_one_byte(buf, buf + len));
+        for (pos = 0; pos < len; ++pos)
+        {
+            memset(buf, VINT_MAX_ONE_BYTE, sizeof(buf));
+            buf[pos] = 0x40;
+            assert(pos == lsquic_varint_n_one_byte(buf, buf + len));
+            buf[pos] = 0xC0;
+            assert(pos == lsquic_varint_n_one_byte(buf, buf + len));
+        }
+    }
+}
+
+
 int
 main (void)
 {
@@ -116,5 +142,7 @@ main (void)
         }
     }
 
+    test_n_one_byte();
+
     return 0;
 }
@@ -0,0 +1,845 @@
+/* Copyright (c) 2017 - 2020 LiteSpeed Technologies Inc.  See LICENSE. */
+/*
+ * xdp_io.c -- AF_XDP packet I/O for test programs
+ *
+ * UMEM is split in two.  The first half of the frames is used for
+ * receiving: these frames are always either in the fill ring or in the RX
+ * ring and go back into the fill ring as soon as the engine is done with
+ * the packet.  The second half is used for sending.  A TX frame is handed
+ * out by pmi_allocate() and becomes free after both the engine has
+ * released it and the kernel has posted it on the completion ring.
+ *
+ * No libbpf is needed: the XDP program is a few instructions assembled
+ * below and loaded using bpf(2).  It is attached via BPF link, which is
+ * detached automatically when the program exits.
+ */
+
+#include <assert.h>
+#include <errno.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/queue.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <net/if.h>
+#include <net/if_arp.h>
+#include <netinet/in.h>
+#include <netinet/ip.h>
+#include <netinet/udp.h>
+#include <linux/bpf.h>
+#include <linux/if_ether.h>
+#include <linux/if_link.h>
+#include <linux/if_xdp.h>
+
+#include <event2/event.h>
+
+#include <lsquic.h>
+
+#include "../src/liblsquic/lsquic_int_types.h"
+#include "../src/liblsquic/lsquic_logger.h"
+
+#include "test_config.h"
+#include "test_common.h"
+#include "prog.h"
+#include "xdp_io.h"
+
+#ifndef SOL_XDP
+#define SOL_XDP 283
+#endif
+
+#define FRAME_SIZE      4096
+#define N_FRAMES        4096
+#define N_RX_FRAMES     (N_FRAMES / 2)
+#define N_TX_FRAMES     (N_FRAMES - N_RX_FRAMES)
+/* Each ring is large enough to hold all frames of its kind */
+#define RING_SIZE       N_RX_FRAMES
+#define RING_MASK       (RING_SIZE - 1)
+/* Process connections after reading this many packets */
+#define RX_BATCH        64
+
+/* Ethernet header, IPv4 header without options, and UDP header */
+#define HDR_SZ (sizeof(struct ethhdr) + sizeof(struct iphdr)                \
+                                                    + sizeof(struct udphdr))
+/* Outgoing packets are written at this offset into the frame so that the
+ * IP header is aligned.
+ */
+#define TX_OFF          2
+#define MAX_PAYLOAD_SZ  (FRAME_SIZE - TX_OFF - HDR_SZ)
+
+
+struct xdp_ring
+{
+    uint32_t           *xr_producer;
+    uint32_t           *xr_consumer;
+    void               *xr_descs;
+    void               *xr_map;
+    size_t              xr_map_sz;
+};
+
+
+struct xdp_io
+{
+    struct prog            *xi_prog;
+    struct service_port    *xi_sport;
+    unsigned char          *xi_umem;
+    int                     xi_fd,
+                            xi_prog_fd,
+                            xi_map_fd,
+                            xi_link_fd;
+    struct xdp_ring         xi_fill,
+                            xi_comp,
+                            xi_rx,
+                            xi_tx;
+    struct event           *xi_ev;
+    char                    xi_ifname[IFNAMSIZ];
+    struct in_addr          xi_if_addr;
+    unsigned char           xi_if_mac[ETH_ALEN];
+    /* All peers are reached via the same next hop.  Its address is taken
+     * from the ARP table or learned from incoming packets.
+     */
+    unsigned char           xi_peer_mac[ETH_ALEN];
+    enum {
+        XI_PEER_MAC     = 1 << 0,   /* xi_peer_mac is set */
+    }                       xi_flags;
+    unsigned                xi_n_free;      /* Number of free TX frames */
+    uint32_t                xi_free[N_TX_FRAMES];
+    /* A TX frame is referenced by the engine, by the kernel, or both */
+    unsigned char           xi_refs[N_FRAMES];
+};
+
+
+static uint32_t
+ring_load (const uint32_t *p)
+{
+    return __atomic_load_n(p, __ATOMIC_ACQUIRE);
+}
+
+
+static void
+ring_store (uint32_t *p, uint32_t val)
+{
+    __atomic_store_n(p, val, __ATOMIC_RELEASE);
+}
+
+
+static int
+is_umem (const struct xdp_io *xi, const void *buf)
+{
+    return (const unsigned char *) buf >= xi->xi_umem
+        && (const unsigned char *) buf < xi->xi_umem + FRAME_SIZE * N_FRAMES;
+}
+
+
+static uint32_t
+frame_idx (const struct xdp_io *xi, const void *buf)
+{
+    return ((const unsigned char *) buf - xi->xi_umem) / FRAME_SIZE;
+}
+
+
+static void
+unref_frame (struct xdp_io *xi, uint32_t idx)
+{
+    assert(idx >= N_RX_FRAMES && idx < N_FRAMES);
+    assert(xi->xi_refs[idx] > 0);
+    if (0 == --xi->xi_refs[idx])
+        xi->xi_free[ xi->xi_n_free++ ] = idx;
+}
+
+
+static void
+reap_completions (struct xdp_io *xi)
+{
+    const uint64_t *addrs;
+    uint32_t cons, prod;
+
+    if (!xi->xi_comp.xr_map)
+        return;
+
+    addrs = xi->xi_comp.xr_descs;
+    cons = *xi->xi_comp.xr_consumer;
+    prod = ring_load(xi->xi_comp.xr_producer);
+    for ( ; cons != prod; ++cons)
+        unref_frame(xi, addrs[cons & RING_MASK] / FRAME_SIZE);
+    ring_store(xi->xi_comp.xr_consumer, cons);
+}
+
+
+static void *
+xdp_pmi_allocate (void *ctx, void *peer_ctx, unsigned short sz, char is_ipv6)
+{
+    struct xdp_io *const xi = ctx;
+    uint32_t idx;
+
+    if (xi->xi_n_free == 0)
+        reap_completions(xi);
+
+    if (xi->xi_n_free > 0 && sz <= MAX_PAYLOAD_SZ)
+    {
+        idx = xi->xi_free[ --xi->xi_n_free ];
+        xi->xi_refs[idx] = 1;
+        return xi->xi_umem + idx * FRAME_SIZE + TX_OFF + HDR_SZ;
+    }
+
+    /* Out of frames: xdp_io_packets_out() will copy this buffer */
+    return malloc(sz);
+}
+
+
+static void
+xdp_pmi_release (void *ctx, void *peer_ctx, void *buf, char is_ipv6)
+{
+    struct xdp_io *const xi = ctx;
+
+    if (is_umem(xi, buf))
+        unref_frame(xi, frame_idx(xi, buf));
+    else
+        free(buf);
+}
+
+
+const struct lsquic_packout_mem_if xdp_io_pmi = {
+    .pmi_allocate = xdp_pmi_allocate,
+    .pmi_release  = xdp_pmi_release,
+    .pmi_return   = xdp_pmi_release,
+};
+
+
+struct xdp_io *
+xdp_io_new (struct prog *prog)
+{
+    struct xdp_io *xi;
+    uint32_t idx;
+
+    xi = calloc(1, sizeof(*xi));
+    if (!xi)
+        return NULL;
+
+    xi->xi_umem = mmap(NULL, FRAME_SIZE * N_FRAMES, PROT_READ|PROT_WRITE,
+                                        MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+    if (xi->xi_umem == MAP_FAILED)
+    {
+        LSQ_ERROR("XDP: cannot allocate UMEM: %s", strerror(errno));
+        free(xi);
+        return NULL;
+    }
+
+    xi->xi_prog = prog;
+    xi->xi_fd = -1;
+    xi->xi_prog_fd = -1;
+    xi->xi_map_fd = -1;
+    xi->xi_link_fd = -1;
+    for (idx = N_FRAMES; idx > N_RX_FRAMES; --idx)
+        xi->xi_free[ xi->xi_n_free++ ] = idx - 1;
+
+    return xi;
+}
+
+
+static int
+get_if_info (struct xdp_io *xi, int fd)
+{
+    struct ifreq ifr;
+
+    memset(&ifr, 0, sizeof(ifr));
+    memcpy(ifr.ifr_name, xi->xi_ifname, sizeof(ifr.ifr_name));
+    if (0 != ioctl(fd, SIOCGIFHWADDR, &ifr))
+    {
+        LSQ_ERROR("XDP: cannot get MAC address of %s: %s", xi->xi_ifname,
+                                                            strerror(errno));
+        return -1;
+    }
+    /* Ethernet headers are parsed and written here */
+    if (ifr.ifr_hwaddr.sa_family != ARPHRD_ETHER)
+    {
+        LSQ_ERROR("XDP: %s is not an Ethernet interface", xi->xi_ifname);
+        return -1;
+    }
+    memcpy(xi->xi_if_mac, ifr.ifr_hwaddr.sa_data, ETH_ALEN);
+
+    /* Only needed if the service port is not bound to a specific address */
+    if (0 == ioctl(fd, SIOCGIFADDR, &ifr))
+        xi->xi_if_addr = ((struct sockaddr_in *) &ifr.ifr_addr)->sin_addr;
+    else
+        LSQ_WARN("XDP: cannot get IPv4 address of %s: %s", xi->xi_ifname,
+                                                            strerror(errno));
+
+    return 0;
+}
+
+
+/* Look up `addr' in the ARP table.  If it is not there, broadcast until
+ * the peer's MAC address is learned from incoming packets.
+ */
+static void
+resolve_peer_mac (struct xdp_io *xi, struct in_addr addr)
+{
+    FILE *file;
+    struct in_addr entry;
+    unsigned hw[ETH_ALEN], i;
+    char line[256], ip[64], mac[64], dev[IFNAMSIZ + 1];
+
+    memset(xi->xi_peer_mac, 0xFF, ETH_ALEN);
+    xi->xi_flags |= XI_PEER_MAC;
+
+    file = fopen("/proc/net/arp", "r");
+    if (!file)
+        return;
+
+    while (fgets(line, sizeof(line), file))
+        if (3 == sscanf(line, "%63s %*s %*s %63s %*s %16s", ip, mac, dev)
+                && 0 == strcmp(dev, xi->xi_ifname)
+                && 1 == inet_pton(AF_INET, ip, &entry)
+                && entry.s_addr == addr.s_addr
+                && ETH_ALEN == sscanf(mac, "%x:%x:%x:%x:%x:%x",
+                            &hw[0], &hw[1], &hw[2], &hw[3], &hw[4], &hw[5]))
+        {
+            for (i = 0; i < ETH_ALEN; ++i)
+                xi->xi_peer_mac[i] = hw[i];
+            break;
+        }
+
+    (void) fclose(file);
+    LSQ_INFO("XDP: send packets to %s via %02X:%02X:%02X:%02X:%02X:%02X",
+        inet_ntop(AF_INET, &addr, ip, sizeof(ip)),
+        xi->xi_peer_mac[0], xi->xi_peer_mac[1], xi->xi_peer_mac[2],
+        xi->xi_peer_mac[3], xi->xi_peer_mac[4], xi->xi_peer_mac[5]);
+}
+
+
+static uint16_t
+ip_checksum (const void *hdr, size_t len)
+{
+    const uint16_t *p = hdr;
+    uint32_t sum;
+
+    for (sum = 0; len > 1; len -= 2)
+        sum += *p++;
+    while (sum >> 16)
+        sum = (sum & 0xFFFF) + (sum >> 16);
+
+    return ~sum;
+}
+
+
+static void
+write_headers (struct xdp_io *xi, unsigned char *buf,
+                        const struct lsquic_out_spec *spec, size_t payload_sz)
+{
+    const struct sockaddr_in *const local = (void *) spec->local_sa,
+                             *const dest  = (void *) spec->dest_sa;
+    struct ethhdr *const eth = (void *) buf;
+    struct iphdr *const ip = (void *) (eth + 1);
+    struct udphdr *const udp = (void *) (ip + 1);
+
+    if (!(xi->xi_flags & XI_PEER_MAC))
+        resolve_peer_mac(xi, dest->sin_addr);
+
+    memcpy(eth->h_dest, xi->xi_peer_mac, ETH_ALEN);
+    memcpy(eth->h_source, xi->xi_if_mac, ETH_ALEN);
+    eth->h_proto = htons(ETH_P_IP);
+
+    ip->version  = 4;
+    ip->ihl      = sizeof(*ip) / 4;
+    ip->tos      = spec->ecn;
+    ip->tot_len  = htons(sizeof(*ip) + sizeof(*udp) + payload_sz);
+    ip->id       = 0;
+    ip->frag_off = htons(IP_DF);
+    ip->ttl      = 64;
+    ip->protocol = IPPROTO_UDP;
+    ip->check    = 0;
+    ip->saddr    = local->sin_addr.s_addr != htonl(INADDR_ANY)
+                 ? local->sin_addr.s_addr : xi->xi_if_addr.s_addr;
+    ip->daddr    = dest->sin_addr.s_addr;
+    ip->check    = ip_checksum(ip, sizeof(*ip));
+
+    udp->source  = local->sin_port;
+    udp->dest    = dest->sin_port;
+    udp->len     = htons(sizeof(*udp) + payload_sz);
+    udp->check   = 0;   /* Optional in IPv4 */
+}
+
+
+int
+xdp_io_packets_out (void *ctx, const struct lsquic_out_spec *specs,
+                                                                unsigned count)
+{
+    struct xdp_io *const xi = ctx;
+    const struct lsquic_out_spec *spec;
+    struct xdp_desc *desc;
+    unsigned char *buf;
+    uint32_t prod, idx;
+    size_t sz, i;
+    unsigned n;
+    int saved_errno;
+
+    reap_completions(xi);
+
+    prod = *xi->xi_tx.xr_producer;
+    for (n = 0; n < count; ++n)
+    {
+        spec = &specs[n];
+        if (spec->dest_sa->sa_family != AF_INET)
+        {
+            errno = EAFNOSUPPORT;
+            break;
+        }
+        if (prod - ring_load(xi->xi_tx.xr_consumer) >= RING_SIZE)
+        {
+            errno = EAGAIN;
+            break;
+        }
+
+        if (spec->iovlen == 1 && is_umem(xi, spec->iov[0].iov_base))
+        {
+            /* The engine wrote the packet into the frame: just add headers */
+            idx = frame_idx(xi, spec->iov[0].iov_base);
+            ++xi->xi_refs[idx];
+            sz = spec->iov[0].iov_len;
+        }
+        else
+        {
+            /* Coalesced packets or a buffer allocated when out of frames */
+            for (sz = 0, i = 0; i < spec->iovlen; ++i)
+                sz += spec->iov[i].iov_len;
+            if (sz > MAX_PAYLOAD_SZ)
+            {
+                errno = EMSGSIZE;
+                break;
+            }
+            if (xi->xi_n_free == 0)
+            {
+                errno = EAGAIN;
+                break;
+            }
+            idx = xi->xi_free[ --xi->xi_n_free ];
+            xi->xi_refs[idx] = 1;
+            buf = xi->xi_umem + idx * FRAME_SIZE + TX_OFF + HDR_SZ;
+            for (i = 0; i < spec->iovlen; ++i)
+            {
+                memcpy(buf, spec->iov[i].iov_base, spec->iov[i].iov_len);
+                buf += spec->iov[i].iov_len;
+            }
+        }
+
+        write_headers(xi, xi->xi_umem + idx * FRAME_SIZE + TX_OFF, spec, sz);
+        desc = (struct xdp_desc *) xi->xi_tx.xr_descs + (prod & RING_MASK);
+        desc->addr    = (uint64_t) idx * FRAME_SIZE + TX_OFF;
+        desc->len     = HDR_SZ + sz;
+        desc->options = 0;
+        ++prod;
+    }
+
+    saved_errno = errno;
+    if (n > 0)
+    {
+        ring_store(xi->xi_tx.xr_producer, prod);
+        /* In copy mode, the kernel sends packets when woken up */
+        if (0 != sendto(xi->xi_fd, NULL, 0, MSG_DONTWAIT, NULL, 0)
+                && !(errno == EAGAIN || errno == EBUSY || errno == ENOBUFS))
+            LSQ_WARN("XDP: sendto: %s", strerror(errno));
+    }
+
+    if (n < count)
+    {
+        LSQ_DEBUG("XDP: sent %u out of %u packets: %s", n, count,
+                                                    strerror(saved_errno));
+        prog_sport_cant_send(xi->xi_prog, xi->xi_fd);
+    }
+
+    errno = saved_errno;
+    return n > 0 ? (int) n : -1;
+}
+
+
+/* Returns true if packet was passed to the engine */
+static int
+packet_in (struct xdp_io *xi, const struct xdp_desc *desc)
+{
+    const unsigned char *const data = xi->xi_umem + desc->addr;
+    const struct ethhdr *const eth = (void *) data;
+    struct sockaddr_in local, peer;
+    struct iphdr ip;
+    struct udphdr udp;
+    size_t udp_len;
+
+    if (desc->len < HDR_SZ)
+        return 0;
+
+    /* The XDP program only lets through IPv4 UDP packets without IP
+     * options.  Copy headers, as they may not be aligned.
+     */
+    memcpy(&ip, data + sizeof(*eth), sizeof(ip));
+    memcpy(&udp, data + sizeof(*eth) + sizeof(ip), sizeof(udp));
+    udp_len = ntohs(udp.len);
+    if (udp_len < sizeof(udp) || udp_len > desc->len - sizeof(*eth)
+                                                                - sizeof(ip))
+        return 0;
+
+    memcpy(xi->xi_peer_mac, eth->h_source, ETH_ALEN);
+    xi->xi_flags |= XI_PEER_MAC;
+
+    memcpy(&local, &xi->xi_sport->sp_local_addr, sizeof(local));
+    if (xi->xi_sport->sp_flags & SPORT_SERVER)
+        local.sin_addr.s_addr = ip.daddr;   /* As with IP_PKTINFO */
+    memset(&peer, 0, sizeof(peer));
+    peer.sin_family      = AF_INET;
+    peer.sin_addr.s_addr = ip.saddr;
+    peer.sin_port        = udp.source;
+
+    (void) lsquic_engine_packet_in(xi->xi_prog->prog_engine, data + HDR_SZ,
+                udp_len - sizeof(udp), (struct sockaddr *) &local,
+                (struct sockaddr *) &peer, xi->xi_sport,
+                ip.tos & IPTOS_ECN_MASK);
+    return 1;
+}
+
+
+void
+xdp_io_read (struct xdp_io *xi)
+{
+    const struct xdp_desc *descs;
+    uint64_t *fill;
+    uint32_t rx_cons, rx_prod, fill_prod;
+    unsigned n_batch, n_in;
+
+    descs = xi->xi_rx.xr_descs;
+    fill = xi->xi_fill.xr_descs;
+    rx_cons = *xi->xi_rx.xr_consumer;
+    fill_prod = *xi->xi_fill.xr_producer;
+    while (!prog_is_stopped()
+                    && rx_cons != (rx_prod = ring_load(xi->xi_rx.xr_producer)))
+    {
+        n_in = 0;
+        for (n_batch = 0; n_batch < RX_BATCH && rx_cons != rx_prod;
+                                                        ++n_batch, ++rx_cons)
+        {
+            n_in += packet_in(xi, &descs[rx_cons & RING_MASK]);
+            /* The engine does not reference packet data after packet_in */
+            fill[fill_prod++ & RING_MASK] = descs[rx_cons & RING_MASK].addr
+                                            & ~(uint64_t) (FRAME_SIZE - 1);
+        }
+        ring_store(xi->xi_rx.xr_consumer, rx_cons);
+        ring_store(xi->xi_fill.xr_producer, fill_prod);
+        LSQ_DEBUG("XDP: read %u packet%.*s", n_batch, n_batch != 1, "s");
+        if (n_in)
+            prog_process_conns(xi->xi_prog);
+    }
+}
+
+
+static void
+read_handler (evutil_socket_t fd, short flags, void *ctx)
+{
+    struct xdp_io *const xi = ctx;
+
+    xi->xi_prog->prog_read_count += 1;
+    xdp_io_read(xi);
+}
+
+
+static int
+sys_bpf (int cmd, union bpf_attr *attr)
+{
+    return syscall(__NR_bpf, cmd, attr, sizeof(*attr));
+}
+
+
+#define INSN(code_, dst_, src_, off_, imm_) { .code = (code_),             \
+    .dst_reg = (dst_), .src_reg = (src_), .off = (off_), .imm = (imm_), }
+
+/* Offset of a packet field: Ethernet header is followed by IPv4 header
+ * without options and UDP header.
+ */
+#define ETH_OFF(field_) offsetof(struct ethhdr, field_)
+#define IP_OFF(field_) (sizeof(struct ethhdr) + offsetof(struct iphdr, field_))
+#define UDP_OFF(field_) (sizeof(struct ethhdr) + sizeof(struct iphdr)       \
+                                            + offsetof(struct udphdr, field_))
+
+/* Load XDP program that redirects IPv4 UDP packets addressed to `port' to
+ * the AF_XDP socket bound to the receive queue.  Other packets are passed
+ * to the kernel stack.
+ */
+static int
+load_xdp_prog (struct xdp_io *xi, unsigned short port)
+{
+    /* Jump offsets are relative to the next instruction: "pass" is at 19 */
+    const struct bpf_insn insns[] = {
+    /*  0 */ INSN(BPF_LDX|BPF_MEM|BPF_W, 2, 1, offsetof(struct xdp_md, data), 0),
+    /*  1 */ INSN(BPF_LDX|BPF_MEM|BPF_W, 3, 1, offsetof(struct xdp_md, data_end), 0),
+    /*  2 */ INSN(BPF_ALU64|BPF_MOV|BPF_X, 4, 2, 0, 0),
+    /*  3 */ INSN(BPF_ALU64|BPF_ADD|BPF_K, 4, 0, 0, HDR_SZ),
+    /*  4 */ INSN(BPF_JMP|BPF_JGT|BPF_X, 4, 3, 14, 0),
+    /*  5 */ INSN(BPF_LDX|BPF_MEM|BPF_H, 4, 2, ETH_OFF(h_proto), 0),
+    /*  6 */ INSN(BPF_JMP|BPF_JNE|BPF_K, 4, 0, 12, htons(ETH_P_IP)),
+    /*  7 */ INSN(BPF_LDX|BPF_MEM|BPF_B, 4, 2, sizeof(struct ethhdr), 0),
+    /*  8 */ INSN(BPF_JMP|BPF_JNE|BPF_K, 4, 0, 10, 0x45),
+    /*  9 */ INSN(BPF_LDX|BPF_MEM|BPF_B, 4, 2, IP_OFF(protocol), 0),
+    /* 10 */ INSN(BPF_JMP|BPF_JNE|BPF_K, 4, 0, 8, IPPROTO_UDP),
+    /* 11 */ INSN(BPF_LDX|BPF_MEM|BPF_H, 4, 2, UDP_OFF(dest), 0),
+    /* 12 */ INSN(BPF_JMP|BPF_JNE|BPF_K, 4, 0, 6, port),
+    /* 13 */ INSN(BPF_LDX|BPF_MEM|BPF_W, 2, 1,
+                                    offsetof(struct xdp_md, rx_queue_index), 0),
+    /* 14 */ INSN(BPF_LD|BPF_DW|BPF_IMM, 1, BPF_PSEUDO_MAP_FD, 0, xi->xi_map_fd),
+    /* 15 */ INSN(0, 0, 0, 0, 0),
+    /* 16 */ INSN(BPF_ALU64|BPF_MOV|BPF_K, 3, 0, 0, XDP_PASS),
+    /* 17 */ INSN(BPF_JMP|BPF_CALL, 0, 0, 0, BPF_FUNC_redirect_map),
+    /* 18 */ INSN(BPF_JMP|BPF_EXIT, 0, 0, 0, 0),
+    /* 19 */ INSN(BPF_ALU64|BPF_MOV|BPF_K, 0, 0, 0, XDP_PASS),
+    /* 20 */ INSN(BPF_JMP|BPF_EXIT, 0, 0, 0, 0),
+    };
+    union bpf_attr attr;
+    char *log;
+    int saved_errno;
+
+    memset(&attr, 0, sizeof(attr));
+    attr.prog_type = BPF_PROG_TYPE_XDP;
+    attr.insns     = (uintptr_t) insns;
+    attr.insn_cnt  = sizeof(insns) / sizeof(insns[0]);
+    attr.license   = (uintptr_t) "MIT";
+    xi->xi_prog_fd = sys_bpf(BPF_PROG_LOAD, &attr);
+    if (xi->xi_prog_fd >= 0)
+        return 0;
+
+    /* Load again to get the verifier log */
+    saved_errno = errno;
+    log = calloc(1, 0x10000);
+    if (log)
+    {
+        attr.log_level = 1;
+        attr.log_buf   = (uintptr_t) log;
+        attr.log_size  = 0x10000;
+        (void) sys_bpf(BPF_PROG_LOAD, &attr);
+    }
+    LSQ_ERROR("XDP: cannot load program: %s%s%s", strerror(saved_errno),
+        log && log[0] ? "; verifier log:\n" : "", log ? log : "");
+    free(log);
+    return -1;
+}
+
+
+static int
+map_ring (struct xdp_ring *ring, int fd, const struct xdp_ring_offset *off,
+                                                size_t desc_sz, off_t pgoff)
+{
+    ring->xr_map_sz = off->desc + RING_SIZE * desc_sz;
+    ring->xr_map = mmap(NULL, ring->xr_map_sz, PROT_READ|PROT_WRITE,
+                                        MAP_SHARED|MAP_POPULATE, fd, pgoff);
+    if (ring->xr_map == MAP_FAILED)
+    {
+        ring->xr_map = NULL;
+        LSQ_ERROR("XDP: cannot map ring: %s", strerror(errno));
+        return -1;
+    }
+
+    ring->xr_producer = (void *) ((char *) ring->xr_map + off->producer);
+    ring->xr_consumer = (void *) ((char *) ring->xr_map + off->consumer);
+    ring->xr_descs    = (char *) ring->xr_map + off->desc;
+    return 0;
+}
+
+
+static int
+setup_socket (struct xdp_io *xi)
+{
+    static const int ring_opts[] = { XDP_UMEM_FILL_RING,
+                    XDP_UMEM_COMPLETION_RING, XDP_RX_RING, XDP_TX_RING, };
+    struct xdp_umem_reg reg;
+    struct xdp_mmap_offsets off;
+    socklen_t optlen;
+    uint64_t *fill;
+    unsigned i;
+    int ring_sz;
+
+    xi->xi_fd = socket(AF_XDP, SOCK_RAW, 0);
+    if (xi->xi_fd < 0)
+    {
+        LSQ_ERROR("XDP: cannot create socket: %s", strerror(errno));
+        return -1;
+    }
+
+    memset(&reg, 0, sizeof(reg));
+    reg.addr       = (uintptr_t) xi->xi_umem;
+    reg.len        = FRAME_SIZE * N_FRAMES;
+    reg.chunk_size = FRAME_SIZE;
+    if (0 != setsockopt(xi->xi_fd, SOL_XDP, XDP_UMEM_REG, &reg, sizeof(reg)))
+    {
+        LSQ_ERROR("XDP: cannot register UMEM: %s", strerror(errno));
+        return -1;
+    }
+
+    ring_sz = RING_SIZE;
+    for (i = 0; i < sizeof(ring_opts) / sizeof(ring_opts[0]); ++i)
+        if (0 != setsockopt(xi->xi_fd, SOL_XDP, ring_opts[i], &ring_sz,
+                                                            sizeof(ring_sz)))
+        {
+            LSQ_ERROR("XDP: cannot set ring size: %s", strerror(errno));
+            return -1;
+        }
+
+    optlen = sizeof(off);
+    if (0 != getsockopt(xi->xi_fd, SOL_XDP, XDP_MMAP_OFFSETS, &off, &optlen))
+    {
+        LSQ_ERROR("XDP: cannot get ring offsets: %s", strerror(errno));
+        return -1;
+    }
+
+    if (0 != map_ring(&xi->xi_fill, xi->xi_fd, &off.fr, sizeof(uint64_t),
+                                                    XDP_UMEM_PGOFF_FILL_RING)
+        || 0 != map_ring(&xi->xi_comp, xi->xi_fd, &off.cr, sizeof(uint64_t),
+                                            XDP_UMEM_PGOFF_COMPLETION_RING)
+        || 0 != map_ring(&xi->xi_rx, xi->xi_fd, &off.rx,
+                            sizeof(struct xdp_desc), XDP_PGOFF_RX_RING)
+        || 0 != map_ring(&xi->xi_tx, xi->xi_fd, &off.tx,
+                            sizeof(struct xdp_desc), XDP_PGOFF_TX_RING))
+        return -1;
+
+    fill = xi->xi_fill.xr_descs;
+    for (i = 0; i < N_RX_FRAMES; ++i)
+        fill[i] = (uint64_t) i * FRAME_SIZE;
+    ring_store(xi->xi_fill.xr_producer, N_RX_FRAMES);
+
+    return 0;
+}
+
+
+int
+xdp_io_start (struct xdp_io *xi, const char *ifname, unsigned queue,
+                            struct service_port *sport, struct event_base *eb)
+{
+    const struct sockaddr_in *const local = (void *) &sport->sp_local_addr;
+    struct sockaddr_xdp sxdp;
+    union bpf_attr attr;
+    unsigned ifindex;
+
+    if (local->sin_family != AF_INET)
+    {
+        LSQ_ERROR("XDP: only IPv4 is supported");
+        return -1;
+    }
+
+    ifindex = if_nametoindex(ifname);
+    if (!ifindex)
+    {
+        LSQ_ERROR("XDP: unknown interface `%s'", ifname);
+        return -1;
+    }
+    snprintf(xi->xi_ifname, sizeof(xi->xi_ifname), "%s", ifname);
+    if (0 != get_if_info(xi, sport->fd))
+        return -1;
+    xi->xi_sport = sport;
+
+    if (0 != setup_socket(xi))
+        return -1;
+
+    memset(&sxdp, 0, sizeof(sxdp));
+    sxdp.sxdp_family   = AF_XDP;
+    sxdp.sxdp_ifindex  = ifindex;
+    sxdp.sxdp_queue_id = queue;
+    sxdp.sxdp_flags    = XDP_COPY;  /* Generic mode needs copy mode */
+    if (0 != bind(xi->xi_fd, (struct sockaddr *) &sxdp, sizeof(sxdp)))
+    {
+        LSQ_ERROR("XDP: cannot bind to %s queue %u: %s", ifname, queue,
+                                                            strerror(errno));
+        return -1;
+    }
+
+    memset(&attr, 0, sizeof(attr));
+    attr.map_type    = BPF_MAP_TYPE_XSKMAP;
+    attr.key_size    = sizeof(uint32_t);
+    attr.value_size  = sizeof(int);
+    attr.max_entries = queue + 1;
+    xi->xi_map_fd = sys_bpf(BPF_MAP_CREATE, &attr);
+    if (xi->xi_map_fd < 0)
+    {
+        LSQ_ERROR("XDP: cannot create XSK map: %s", strerror(errno));
+        return -1;
+    }
+
+    memset(&attr, 0, sizeof(attr));
+    attr.map_fd = xi->xi_map_fd;
+    attr.key    = (uintptr_t) &queue;
+    attr.value  = (uintptr_t) &xi->xi_fd;
+    attr.flags  = BPF_ANY;
+    if (0 != sys_bpf(BPF_MAP_UPDATE_ELEM, &attr))
+    {
+        LSQ_ERROR("XDP: cannot add socket to XSK map: %s", strerror(errno));
+        return -1;
+    }
+
+    if (0 != load_xdp_prog(xi, local->sin_port))
+        return -1;
+
+    memset(&attr, 0, sizeof(attr));
+    attr.link_create.prog_fd        = xi->xi_prog_fd;
+    attr.link_create.target_ifindex = ifindex;
+    attr.link_create.attach_type    = BPF_XDP;
+    attr.link_create.flags          = XDP_FLAGS_SKB_MODE;
+    xi->xi_link_fd = sys_bpf(BPF_LINK_CREATE, &attr);
+    if (xi->xi_link_fd < 0)
+    {
+        LSQ_ERROR("XDP: cannot attach program to %s: %s", ifname,
+                                                            strerror(errno));
+        return -1;
+    }
+
+#if HAVE_SO_BUSY_POLL
+    /* The busy-poll loop calls xdp_io_read() itself */
+    if (!xi->xi_prog->prog_busy_poll)
+#endif
+    {
+        xi->xi_ev = event_new(eb, xi->xi_fd, EV_READ|EV_PERSIST,
+                                                            read_handler, xi);
+        if (!xi->xi_ev || 0 != event_add(xi->xi_ev, NULL))
+            return -1;
+    }
+
+    LSQ_NOTICE("XDP: UDP port %hu on %s, queue %u", ntohs(local->sin_port),
+                                                            ifname, queue);
+    return 0;
+}
+
+
+void
+xdp_io_stop (struct xdp_io *xi)
+{
+    if (xi->xi_ev)
+    {
+        event_del(xi->xi_ev);
+        event_free(xi->xi_ev);
+        xi->xi_ev = NULL;
+    }
+}
+
+
+void
+xdp_io_destroy (struct xdp_io *xi)
+{
+    struct xdp_ring *const rings[] = {
+                        &xi->xi_fill, &xi->xi_comp, &xi->xi_rx, &xi->xi_tx, };
+    unsigned i;
+
+    xdp_io_stop(xi);
+    /* Closing the link detaches the program */
+    if (xi->xi_link_fd >= 0)
+        (void) close(xi->xi_link_fd);
+    if (xi->xi_prog_fd >= 0)
+        (void) close(xi->xi_prog_fd);
+    if (xi->xi_map_fd >= 0)
+        (void) close(xi->xi_map_fd);
+    for (i = 0; i < sizeof(rings) / sizeof(rings[0]); ++i)
+        if (rings[i]->xr_map)
+            (void) munmap(rings[i]->xr_map, rings[i]->xr_map_sz);
+    if (xi->xi_fd >= 0)
+        (void) close(xi->xi_fd);
+    (void) munmap(xi->xi_umem, FRAME_SIZE * N_FRAMES);
+    free(xi);
+}
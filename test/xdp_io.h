@@ -0,0 +1,59 @@
+/* Copyright (c) 2017 - 2020 LiteSpeed Technologies Inc.  See LICENSE. */
+/*
+ * xdp_io.h -- AF_XDP packet I/O for test programs
+ *
+ * Packets to and from the first service port bypass the kernel UDP stack:
+ * they are read from and written to an AF_XDP socket.  Ethernet, IPv4, and
+ * UDP headers are parsed and written here.  The engine encrypts outgoing
+ * packets directly into UMEM frames allocated by xdp_io_pmi, which are
+ * then placed onto the TX ring without copying.
+ *
+ * The XDP program runs in generic (SKB) mode, so that any interface, such
+ * as veth, can be used.  Loopback does not work: the kernel drops packets
+ * sent to it via AF_XDP.  Only IPv4 is supported.
+ */
+
+#ifndef XDP_IO_H
+#define XDP_IO_H 1
+
+struct event_base;
+struct lsquic_out_spec;
+struct lsquic_packout_mem_if;
+struct prog;
+struct service_port;
+struct xdp_io;
+
+extern const struct lsquic_packout_mem_if xdp_io_pmi;
+
+/* Allocate UMEM.  This is done before the engine is created, as the
+ * object is used as packets-out and PMI context.
+ */
+struct xdp_io *
+xdp_io_new (struct prog *);
+
+/* Create AF_XDP socket bound to `queue' of interface `ifname', attach XDP
+ * program that redirects UDP packets addressed to the port of `sport' to
+ * it, and start reading.
+ */
+int
+xdp_io_start (struct xdp_io *, const char *ifname, unsigned queue,
+                            struct service_port *sport, struct event_base *);
+
+/* Read all available packets.  The busy-poll loop calls this directly. */
+void
+xdp_io_read (struct xdp_io *);
+
+int
+xdp_io_packets_out (void *xdp_io, const struct lsquic_out_spec *,
+                                                            unsigned count);
+
+/* Stop reading.  UMEM stays until xdp_io_destroy(), as the engine may still
+ * release buffers.
+ */
+void
+xdp_io_stop (struct xdp_io *);
+
+void
+xdp_io_destroy (struct xdp_io *);
+
+#endif